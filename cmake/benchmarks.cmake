@@ -0,0 +1,12 @@
+# Copyright (c) 2021 The Orbit Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+# Benchmarks are built like tests but they are not registered with ctest, as
+# their results are only meaningful when they are run on purpose on a quiet
+# machine, e.g.:
+#   ./bin/LinuxTracingBenchmarks --benchmark_filter=PerfEventAllocator
+if(NOT TARGET benchmark::benchmark)
+  add_library(benchmark::benchmark INTERFACE IMPORTED)
+  target_link_libraries(benchmark::benchmark INTERFACE CONAN_PKG::benchmark)
+endif()
@@ -69,6 +69,7 @@ class OrbitConan(ConanFile):
         self.build_requires('protoc_installer/3.9.1@bincrafters/stable#0')
         self.build_requires('grpc_codegen/1.27.3@{}'.format(self._orbit_channel))
         self.build_requires('gtest/1.11.0', force_host_context=True)
+        self.build_requires('benchmark/1.5.6', force_host_context=True)
 
     def requirements(self):
         if self.settings.os != "Windows" and self.options.with_gui and not self.options.system_qt and self.options.system_mesa:
@@ -250,6 +251,8 @@ class OrbitConan(ConanFile):
                       dst="{}-{}/opt/developer/tools/".format(self.name, self._version()))
             self.copy("liborbituserspaceinstrumentation.so", src="lib/",
                       dst="{}-{}/opt/developer/tools/".format(self.name, self._version()))
+            self.copy("liborbituserspaceinstrumentationfastpath.so", src="lib/",
+                      dst="{}-{}/opt/developer/tools/".format(self.name, self._version()))
             self.copy("NOTICE",
                       dst="{}-{}/usr/share/doc/{}/".format(self.name, self._version(), self.name))
             self.copy("LICENSE",
@@ -300,6 +303,7 @@ chmod -v 4775 /opt/developer/tools/OrbitService
         self.copy("LICENSE")
         self.copy("liborbit.so", src="lib/", dst="lib")
         self.copy("liborbituserspaceinstrumentation.so", src="lib/", dst="lib")
+        self.copy("liborbituserspaceinstrumentationfastpath.so", src="lib/", dst="lib")
         self.copy("libOrbitVulkanLayer.so", src="lib/", dst="lib")
         self.copy("VkLayer_Orbit_implicit.json", src="lib/", dst="lib")
         self.copy("LinuxTracingIntegrationTests", src="bin/", dst="bin")
@@ -4,9 +4,25 @@
 
 #include "LockFreeApiEventProducer.h"
 
+#include <absl/base/casts.h>
+#include <absl/container/flat_hash_map.h>
+
+#include <cstring>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "OrbitBase/Profiling.h"
+#include "SharedMemoryTransport/ProducerEventRecords.h"
+
 namespace orbit_api {
 namespace {
 
+using orbit_shared_memory_transport::ApiEventRecord;
+using orbit_shared_memory_transport::ApiTrackSummaryRecord;
+using orbit_shared_memory_transport::ProducerEventRecordType;
+
 inline void CreateCaptureEvent(const ApiScopeStart& scope_start,
                                orbit_grpc_protos::ProducerCaptureEvent* capture_event) {
   auto* api_event = capture_event->mutable_api_scope_start();
@@ -72,6 +88,18 @@ inline void CreateCaptureEvent(const ApiTrackUint64& track_uint64,
   track_uint64.CopyToGrpcProto(api_event);
 }
 
+inline void CreateCaptureEvent(const ApiTrackSummary& track_summary,
+                               orbit_grpc_protos::ProducerCaptureEvent* capture_event) {
+  auto* api_event = capture_event->mutable_api_track_summary();
+  track_summary.CopyToGrpcProto(api_event);
+}
+
+inline void CreateCaptureEvent(const ApiInternedString& interned_string,
+                               orbit_grpc_protos::ProducerCaptureEvent* capture_event) {
+  auto* grpc_interned_string = capture_event->mutable_interned_string();
+  interned_string.CopyToGrpcProto(grpc_interned_string);
+}
+
 // The variant type `ApiEventVariant` requires to contain `std::monostate` in order to be default-
 // constructable. However, that state is never expected to be called in the visitor.
 inline void CreateCaptureEvent(const std::monostate& /*unused*/,
@@ -79,8 +107,290 @@ inline void CreateCaptureEvent(const std::monostate& /*unused*/,
   UNREACHABLE();
 }
 
+// An event of the Orbit API in the format of the shared memory ring buffer: the record is followed
+// by the encoded name's additional values, if any.
+struct ApiEventRecordToWrite {
+  ProducerEventRecordType type;
+  ApiEventRecord record{};
+  const std::vector<uint64_t>* encoded_name_additional = nullptr;
+};
+
+inline void FillRecord(const ApiEventMetaData& meta_data, ApiEventRecordToWrite* out) {
+  out->record.pid = meta_data.pid;
+  out->record.tid = meta_data.tid;
+  out->record.timestamp_ns = meta_data.timestamp_ns;
+}
+
+inline void FillRecord(const ApiEncodedString& encoded_name, ApiEventRecordToWrite* out) {
+  out->record.encoded_name[0] = encoded_name.encoded_name_1;
+  out->record.encoded_name[1] = encoded_name.encoded_name_2;
+  out->record.encoded_name[2] = encoded_name.encoded_name_3;
+  out->record.encoded_name[3] = encoded_name.encoded_name_4;
+  out->record.encoded_name[4] = encoded_name.encoded_name_5;
+  out->record.encoded_name[5] = encoded_name.encoded_name_6;
+  out->record.encoded_name[6] = encoded_name.encoded_name_7;
+  out->record.encoded_name[7] = encoded_name.encoded_name_8;
+  out->record.encoded_name_additional_count =
+      static_cast<uint32_t>(encoded_name.encoded_name_additional.size());
+  out->encoded_name_additional = &encoded_name.encoded_name_additional;
+  out->record.name_key = encoded_name.name_key;
+}
+
+inline void FillRecord(const ApiScopeStart& scope_start, ApiEventRecordToWrite* out) {
+  out->type = ProducerEventRecordType::kApiScopeStart;
+  FillRecord(scope_start.meta_data, out);
+  FillRecord(scope_start.encoded_name, out);
+  out->record.id = scope_start.group_id;
+  out->record.address_in_function = scope_start.address_in_function;
+  out->record.color_rgba = scope_start.color_rgba;
+}
+
+inline void FillRecord(const ApiScopeStop& scope_stop, ApiEventRecordToWrite* out) {
+  out->type = ProducerEventRecordType::kApiScopeStop;
+  FillRecord(scope_stop.meta_data, out);
+}
+
+inline void FillRecord(const ApiScopeStartAsync& scope_start_async, ApiEventRecordToWrite* out) {
+  out->type = ProducerEventRecordType::kApiScopeStartAsync;
+  FillRecord(scope_start_async.meta_data, out);
+  FillRecord(scope_start_async.encoded_name, out);
+  out->record.id = scope_start_async.id;
+  out->record.address_in_function = scope_start_async.address_in_function;
+  out->record.color_rgba = scope_start_async.color_rgba;
+}
+
+inline void FillRecord(const ApiScopeStopAsync& scope_stop_async, ApiEventRecordToWrite* out) {
+  out->type = ProducerEventRecordType::kApiScopeStopAsync;
+  FillRecord(scope_stop_async.meta_data, out);
+  out->record.id = scope_stop_async.id;
+}
+
+inline void FillRecord(const ApiStringEvent& string_event, ApiEventRecordToWrite* out) {
+  out->type = ProducerEventRecordType::kApiStringEvent;
+  FillRecord(string_event.meta_data, out);
+  FillRecord(string_event.encoded_name, out);
+  out->record.id = string_event.id;
+  out->record.color_rgba = string_event.color_rgba;
+}
+
+template <typename ApiTrackT>
+inline void FillTrackRecord(ProducerEventRecordType type, const ApiTrackT& track, uint64_t data,
+                            ApiEventRecordToWrite* out) {
+  out->type = type;
+  FillRecord(track.meta_data, out);
+  FillRecord(track.encoded_name, out);
+  out->record.data = data;
+  out->record.color_rgba = track.color_rgba;
+}
+
+inline void FillRecord(const ApiTrackDouble& track_double, ApiEventRecordToWrite* out) {
+  FillTrackRecord(ProducerEventRecordType::kApiTrackDouble, track_double,
+                  absl::bit_cast<uint64_t>(track_double.data), out);
+}
+
+inline void FillRecord(const ApiTrackFloat& track_float, ApiEventRecordToWrite* out) {
+  FillTrackRecord(ProducerEventRecordType::kApiTrackFloat, track_float,
+                  absl::bit_cast<uint32_t>(track_float.data), out);
+}
+
+inline void FillRecord(const ApiTrackInt& track_int, ApiEventRecordToWrite* out) {
+  FillTrackRecord(ProducerEventRecordType::kApiTrackInt, track_int,
+                  static_cast<uint64_t>(int64_t{track_int.data}), out);
+}
+
+inline void FillRecord(const ApiTrackInt64& track_int64, ApiEventRecordToWrite* out) {
+  FillTrackRecord(ProducerEventRecordType::kApiTrackInt64, track_int64,
+                  static_cast<uint64_t>(track_int64.data), out);
+}
+
+inline void FillRecord(const ApiTrackUint& track_uint, ApiEventRecordToWrite* out) {
+  FillTrackRecord(ProducerEventRecordType::kApiTrackUint, track_uint, track_uint.data, out);
+}
+
+inline void FillRecord(const ApiTrackUint64& track_uint64, ApiEventRecordToWrite* out) {
+  FillTrackRecord(ProducerEventRecordType::kApiTrackUint64, track_uint64, track_uint64.data, out);
+}
+
+// `ApiInternedString`s don't have the layout of an `ApiEventRecord`, see
+// `TryWriteInternedStringToSharedMemory`.
+inline void FillRecord(const ApiInternedString& /*unused*/, ApiEventRecordToWrite* /*unused*/) {
+  UNREACHABLE();
+}
+
+// `ApiTrackSummary`s are written as an `ApiTrackSummaryRecord`, see
+// `TryWriteTrackSummaryToSharedMemory`.
+inline void FillRecord(const ApiTrackSummary& /*unused*/, ApiEventRecordToWrite* /*unused*/) {
+  UNREACHABLE();
+}
+
+// As for CreateCaptureEvent, `std::monostate` is never expected to be visited.
+inline void FillRecord(const std::monostate& /*unused*/, ApiEventRecordToWrite* /*unused*/) {
+  UNREACHABLE();
+}
+
+bool TryWriteInternedStringToSharedMemory(
+    const ApiInternedString& interned_string,
+    orbit_shared_memory_transport::SharedMemoryRingBuffer* ring_buffer) {
+  char* payload = ring_buffer->TryReserveRecord(
+      static_cast<uint32_t>(ProducerEventRecordType::kInternedString),
+      static_cast<uint32_t>(sizeof(interned_string.key) + interned_string.name.size()));
+  if (payload == nullptr) {
+    return false;
+  }
+  memcpy(payload, &interned_string.key, sizeof(interned_string.key));
+  memcpy(payload + sizeof(interned_string.key), interned_string.name.data(),
+         interned_string.name.size());
+  ring_buffer->CommitRecord();
+  return true;
+}
+
+bool TryWriteTrackSummaryToSharedMemory(
+    const ApiTrackSummary& track_summary,
+    orbit_shared_memory_transport::SharedMemoryRingBuffer* ring_buffer) {
+  ApiEventRecordToWrite to_write;
+  FillRecord(track_summary.meta_data, &to_write);
+  FillRecord(track_summary.encoded_name, &to_write);
+  to_write.record.color_rgba = track_summary.color_rgba;
+
+  ApiTrackSummaryRecord record{};
+  record.event = to_write.record;
+  record.first_timestamp_ns = track_summary.first_timestamp_ns;
+  record.min = track_summary.min;
+  record.max = track_summary.max;
+  record.last = track_summary.last;
+  record.sum = track_summary.sum;
+  record.count = track_summary.count;
+
+  const size_t encoded_name_additional_size =
+      record.event.encoded_name_additional_count * sizeof(uint64_t);
+  char* payload = ring_buffer->TryReserveRecord(
+      static_cast<uint32_t>(ProducerEventRecordType::kApiTrackSummary),
+      static_cast<uint32_t>(sizeof(ApiTrackSummaryRecord) + encoded_name_additional_size));
+  if (payload == nullptr) {
+    return false;
+  }
+  memcpy(payload, &record, sizeof(ApiTrackSummaryRecord));
+  if (encoded_name_additional_size > 0) {
+    memcpy(payload + sizeof(ApiTrackSummaryRecord), to_write.encoded_name_additional->data(),
+           encoded_name_additional_size);
+  }
+  ring_buffer->CommitRecord();
+  return true;
+}
+
+// The names interned by each thread, by address. They are only valid for the capture they were
+// sent in. There is only one LockFreeApiEventProducer per process, so these can be thread_local.
+struct ThreadInternedNames {
+  struct InternedName {
+    uint64_t key;
+    std::string name;
+  };
+  uint64_t capture_count = 0;
+  absl::flat_hash_map<const char*, InternedName> names_by_address;
+};
+
+// Bounds the memory used by threads that produce names dynamically: their events fall back to
+// encoding the names.
+constexpr size_t kMaxInternedNamesPerThread = 1024;
+
+// Windows of aggregated track values are only summarized this long after they end, as the values
+// of a window can still be in the queue for a while after the window ended.
+constexpr uint64_t kApiTrackSummaryDelayNs = 10'000'000;
+
 }  // namespace
 
+uint64_t LockFreeApiEventProducer::GetOrInternName(const char* name) {
+  if (name == nullptr) {
+    return 0;
+  }
+
+  thread_local ThreadInternedNames thread_interned_names;
+  const uint64_t capture_count = GetCaptureCount();
+  if (thread_interned_names.capture_count != capture_count) {
+    thread_interned_names.names_by_address.clear();
+    thread_interned_names.capture_count = capture_count;
+  }
+
+  auto it = thread_interned_names.names_by_address.find(name);
+  if (it != thread_interned_names.names_by_address.end()) {
+    if (it->second.name == name) {
+      return it->second.key;
+    }
+    thread_interned_names.names_by_address.erase(it);
+  } else if (thread_interned_names.names_by_address.size() >= kMaxInternedNamesPerThread) {
+    return 0;
+  }
+
+  const uint64_t key = next_name_key_.fetch_add(1, std::memory_order_relaxed);
+  std::string name_copy{name};
+  // Only events enqueued after the ApiInternedString can reference it, so if it's dropped the name
+  // needs to be encoded, and interning is attempted again on the next call.
+  if (!EnqueueIntermediateEvent(ApiInternedString{key, name_copy})) {
+    return 0;
+  }
+  thread_interned_names.names_by_address.emplace(
+      name, ThreadInternedNames::InternedName{key, std::move(name_copy)});
+  return key;
+}
+
+void LockFreeApiEventProducer::OnCaptureStart(orbit_grpc_protos::CaptureOptions capture_options) {
+  // Stored before the base class starts forwarding the events of the new capture.
+  api_track_aggregation_window_ns_ = capture_options.api_track_aggregation_window_ns();
+  LockFreeBufferCaptureEventProducer::OnCaptureStart(std::move(capture_options));
+}
+
+size_t LockFreeApiEventProducer::ProcessDequeuedIntermediateEvents(
+    std::vector<ApiEventVariant>* events, size_t event_count, bool is_last_call_of_capture) {
+  const uint64_t capture_count = GetCaptureCount();
+  if (api_track_aggregator_capture_count_ != capture_count) {
+    // The values of a previous capture that was not stopped properly are dropped.
+    api_track_aggregator_.reset();
+    const uint64_t window_ns = api_track_aggregation_window_ns_;
+    if (window_ns > 0) {
+      api_track_aggregator_.emplace(window_ns);
+    }
+    api_track_aggregator_capture_count_ = capture_count;
+  }
+  if (!api_track_aggregator_.has_value()) {
+    return event_count;
+  }
+
+  // Keep the events that are not aggregated in order at the start of `events`.
+  size_t forwarded_event_count = 0;
+  for (size_t i = 0; i < event_count; ++i) {
+    if (api_track_aggregator_->Aggregate((*events)[i], &api_track_summaries_)) {
+      continue;
+    }
+    if (forwarded_event_count != i) {
+      (*events)[forwarded_event_count] = std::move((*events)[i]);
+    }
+    ++forwarded_event_count;
+  }
+
+  if (is_last_call_of_capture) {
+    api_track_aggregator_->FlushAllWindows(&api_track_summaries_);
+  } else {
+    const uint64_t now_ns = orbit_base::CaptureTimestampNs();
+    if (now_ns > kApiTrackSummaryDelayNs) {
+      api_track_aggregator_->FlushWindowsEndingBefore(now_ns - kApiTrackSummaryDelayNs,
+                                                      &api_track_summaries_);
+    }
+  }
+
+  // Summaries reference interned names with keys sent before the values they summarize, so they
+  // can be forwarded after all the other events.
+  for (ApiTrackSummary& summary : api_track_summaries_) {
+    if (forwarded_event_count < events->size()) {
+      (*events)[forwarded_event_count] = std::move(summary);
+    } else {
+      events->emplace_back(std::move(summary));
+    }
+    ++forwarded_event_count;
+  }
+  api_track_summaries_.clear();
+  return forwarded_event_count;
+}
+
 orbit_grpc_protos::ProducerCaptureEvent* LockFreeApiEventProducer::TranslateIntermediateEvent(
     ApiEventVariant&& raw_api_event, google::protobuf::Arena* arena) {
   auto* capture_event =
@@ -91,4 +401,35 @@ orbit_grpc_protos::ProducerCaptureEvent* LockFreeApiEventProducer::TranslateInte
 
   return capture_event;
 }
-}  // namespace orbit_api
\ No newline at end of file
+
+bool LockFreeApiEventProducer::TryWriteIntermediateEventToSharedMemory(
+    const ApiEventVariant& raw_api_event,
+    orbit_shared_memory_transport::SharedMemoryRingBuffer* ring_buffer) {
+  if (const auto* interned_string = std::get_if<ApiInternedString>(&raw_api_event)) {
+    return TryWriteInternedStringToSharedMemory(*interned_string, ring_buffer);
+  }
+  if (const auto* track_summary = std::get_if<ApiTrackSummary>(&raw_api_event)) {
+    return TryWriteTrackSummaryToSharedMemory(*track_summary, ring_buffer);
+  }
+
+  ApiEventRecordToWrite to_write;
+  std::visit([&to_write](const auto& event) { FillRecord(event, &to_write); }, raw_api_event);
+
+  const size_t encoded_name_additional_size =
+      to_write.record.encoded_name_additional_count * sizeof(uint64_t);
+  char* payload = ring_buffer->TryReserveRecord(
+      static_cast<uint32_t>(to_write.type),
+      static_cast<uint32_t>(sizeof(ApiEventRecord) + encoded_name_additional_size));
+  if (payload == nullptr) {
+    return false;
+  }
+  memcpy(payload, &to_write.record, sizeof(ApiEventRecord));
+  if (encoded_name_additional_size > 0) {
+    memcpy(payload + sizeof(ApiEventRecord), to_write.encoded_name_additional->data(),
+           encoded_name_additional_size);
+  }
+  ring_buffer->CommitRecord();
+  return true;
+}
+
+}  // namespace orbit_api
@@ -5,8 +5,13 @@
 #ifndef API_LOCK_FREE_API_EVENT_PRODUCER_H_
 #define API_LOCK_FREE_API_EVENT_PRODUCER_H_
 
+#include <atomic>
+#include <cstdint>
+#include <optional>
 #include <variant>
+#include <vector>
 
+#include "ApiUtils/ApiTrackAggregator.h"
 #include "ApiUtils/Event.h"
 #include "CaptureEventProducer/LockFreeBufferCaptureEventProducer.h"
 #include "ProducerSideChannel/ProducerSideChannel.h"
@@ -15,6 +20,8 @@ namespace orbit_api {
 
 // This class is used to enqueue orbit_api::ApiEvent events from multiple threads and relay them to
 // OrbitService in the form of orbit_grpc_protos::ApiEvent events.
+// When the capture has `api_track_aggregation_window_ns` set, the forwarder thread replaces the
+// track events with an `ApiTrackSummary` per thread, name and window.
 class LockFreeApiEventProducer
     : public orbit_capture_event_producer::LockFreeBufferCaptureEventProducer<ApiEventVariant> {
  public:
@@ -24,9 +31,40 @@ class LockFreeApiEventProducer
 
   ~LockFreeApiEventProducer() { ShutdownAndWait(); }
 
+  // Returns the key under which `name` can be referenced by the events of the calling thread,
+  // through `ApiInternedName`. The first time a thread uses a name in a capture, this enqueues the
+  // corresponding `ApiInternedString`, which is then forwarded before the events of that thread
+  // that reference it. Names are identified by their address, as they are usually string literals,
+  // but their content is still compared on each call in case the same buffer was reused for a
+  // different name. Returns zero if the name can't be interned, in which case the caller needs to
+  // encode it in the event.
+  [[nodiscard]] uint64_t GetOrInternName(const char* name);
+
  protected:
+  void OnCaptureStart(orbit_grpc_protos::CaptureOptions capture_options) override;
+
+  [[nodiscard]] size_t ProcessDequeuedIntermediateEvents(std::vector<ApiEventVariant>* events,
+                                                         size_t event_count,
+                                                         bool is_last_call_of_capture) override;
+
   [[nodiscard]] orbit_grpc_protos::ProducerCaptureEvent* TranslateIntermediateEvent(
       ApiEventVariant&& raw_api_event, google::protobuf::Arena* arena) override;
+
+  [[nodiscard]] bool CanWriteIntermediateEventsToSharedMemory() const override { return true; }
+  [[nodiscard]] bool TryWriteIntermediateEventToSharedMemory(
+      const ApiEventVariant& raw_api_event,
+      orbit_shared_memory_transport::SharedMemoryRingBuffer* ring_buffer) override;
+
+ private:
+  // Keys are unique across threads and captures, as OrbitService rejects a key being reused by
+  // the same producer.
+  std::atomic<uint64_t> next_name_key_ = 1;
+
+  std::atomic<uint64_t> api_track_aggregation_window_ns_ = 0;
+  // Only accessed by the forwarder thread. Recreated for each capture.
+  std::optional<ApiTrackAggregator> api_track_aggregator_;
+  uint64_t api_track_aggregator_capture_count_ = 0;
+  std::vector<ApiTrackSummary> api_track_summaries_;
 };
 
 }  // namespace orbit_api
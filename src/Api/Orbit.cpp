@@ -7,6 +7,8 @@
 
 #include <absl/base/casts.h>
 
+#include <utility>
+
 #include "ApiUtils/Event.h"
 #include "LockFreeApiEventProducer.h"
 #include "OrbitApiVersions.h"
@@ -32,50 +34,69 @@ void EnqueueApiEvent(Types... args) {
   producer.EnqueueIntermediateEvent(event);
 }
 
+// For the events with a name: after the first use of `name` in a thread, only its interned key is
+// sent instead of the encoded name.
+template <typename Event, typename... Types>
+void EnqueueApiEventWithInternedName(const char* name, Types... args) {
+  orbit_api::LockFreeApiEventProducer& producer = GetEventProducer();
+
+  if (!producer.IsCapturing()) return;
+
+  static uint32_t pid = orbit_base::GetCurrentProcessId();
+  thread_local uint32_t tid = orbit_base::GetCurrentThreadId();
+  uint64_t timestamp_ns = orbit_base::CaptureTimestampNs();
+  uint64_t name_key = producer.GetOrInternName(name);
+  orbit_api::ApiEncodedString encoded_name =
+      name_key != 0 ? orbit_api::ApiEncodedString{orbit_api::ApiInternedName{name_key}}
+                    : orbit_api::ApiEncodedString{name};
+  producer.EnqueueIntermediateEvent(Event{pid, tid, timestamp_ns, std::move(encoded_name), args...});
+}
+
 void orbit_api_start_v1(const char* name, orbit_api_color color, uint64_t group_id,
                         uint64_t caller_address) {
   if (caller_address == kOrbitCallerAddressAuto) {
     caller_address = ORBIT_GET_CALLER_PC();
   }
-  EnqueueApiEvent<orbit_api::ApiScopeStart>(name, color, group_id, caller_address);
+  EnqueueApiEventWithInternedName<orbit_api::ApiScopeStart>(name, color, group_id, caller_address);
 }
 
 void orbit_api_start(const char* name, orbit_api_color color) {
   uint64_t return_address = ORBIT_GET_CALLER_PC();
-  EnqueueApiEvent<orbit_api::ApiScopeStart>(name, color, kOrbitDefaultGroupId, return_address);
+  EnqueueApiEventWithInternedName<orbit_api::ApiScopeStart>(name, color, kOrbitDefaultGroupId,
+                                                            return_address);
 }
 
 void orbit_api_stop() { EnqueueApiEvent<orbit_api::ApiScopeStop>(); }
 
 void orbit_api_start_async(const char* name, uint64_t id, orbit_api_color color) {
   uint64_t return_address = ORBIT_GET_CALLER_PC();
-  EnqueueApiEvent<orbit_api::ApiScopeStartAsync>(name, id, color, return_address);
+  EnqueueApiEventWithInternedName<orbit_api::ApiScopeStartAsync>(name, id, color, return_address);
 }
 
 void orbit_api_stop_async(uint64_t id) { EnqueueApiEvent<orbit_api::ApiScopeStopAsync>(id); }
 
 void orbit_api_track_int(const char* name, int value, orbit_api_color color) {
-  EnqueueApiEvent<orbit_api::ApiTrackInt>(name, value, color);
+  EnqueueApiEventWithInternedName<orbit_api::ApiTrackInt>(name, value, color);
 }
 
 void orbit_api_track_int64(const char* name, int64_t value, orbit_api_color color) {
-  EnqueueApiEvent<orbit_api::ApiTrackInt64>(name, value, color);
+  EnqueueApiEventWithInternedName<orbit_api::ApiTrackInt64>(name, value, color);
 }
 
 void orbit_api_track_uint(const char* name, uint32_t value, orbit_api_color color) {
-  EnqueueApiEvent<orbit_api::ApiTrackUint>(name, value, color);
+  EnqueueApiEventWithInternedName<orbit_api::ApiTrackUint>(name, value, color);
 }
 
 void orbit_api_track_uint64(const char* name, uint64_t value, orbit_api_color color) {
-  EnqueueApiEvent<orbit_api::ApiTrackUint64>(name, value, color);
+  EnqueueApiEventWithInternedName<orbit_api::ApiTrackUint64>(name, value, color);
 }
 
 void orbit_api_track_float(const char* name, float value, orbit_api_color color) {
-  EnqueueApiEvent<orbit_api::ApiTrackFloat>(name, value, color);
+  EnqueueApiEventWithInternedName<orbit_api::ApiTrackFloat>(name, value, color);
 }
 
 void orbit_api_track_double(const char* name, double value, orbit_api_color color) {
-  EnqueueApiEvent<orbit_api::ApiTrackDouble>(name, value, color);
+  EnqueueApiEventWithInternedName<orbit_api::ApiTrackDouble>(name, value, color);
 }
 
 void orbit_api_async_string(const char* str, uint64_t id, orbit_api_color color) {
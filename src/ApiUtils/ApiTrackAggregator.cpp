@@ -0,0 +1,95 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ApiUtils/ApiTrackAggregator.h"
+
+#include <algorithm>
+#include <type_traits>
+#include <variant>
+
+namespace orbit_api {
+
+namespace {
+
+template <typename T>
+constexpr bool kIsApiTrackEvent =
+    std::is_same_v<T, ApiTrackDouble> || std::is_same_v<T, ApiTrackFloat> ||
+    std::is_same_v<T, ApiTrackInt> || std::is_same_v<T, ApiTrackInt64> ||
+    std::is_same_v<T, ApiTrackUint> || std::is_same_v<T, ApiTrackUint64>;
+
+}  // namespace
+
+bool ApiTrackAggregator::Aggregate(const ApiEventVariant& event,
+                                   std::vector<ApiTrackSummary>* summaries) {
+  return std::visit(
+      [this, summaries](const auto& api_event) {
+        using EventT = std::decay_t<decltype(api_event)>;
+        if constexpr (kIsApiTrackEvent<EventT>) {
+          AddValue(api_event.meta_data, api_event.encoded_name, api_event.color_rgba,
+                   static_cast<double>(api_event.data), summaries);
+          return true;
+        } else {
+          return false;
+        }
+      },
+      event);
+}
+
+void ApiTrackAggregator::AddValue(const ApiEventMetaData& meta_data,
+                                  const ApiEncodedString& encoded_name, uint32_t color_rgba,
+                                  double value, std::vector<ApiTrackSummary>* summaries) {
+  const uint64_t window_end_ns = (meta_data.timestamp_ns / window_ns_ + 1) * window_ns_;
+  TrackKey key{meta_data.tid,
+               encoded_name.name_key,
+               {encoded_name.encoded_name_1, encoded_name.encoded_name_2,
+                encoded_name.encoded_name_3, encoded_name.encoded_name_4,
+                encoded_name.encoded_name_5, encoded_name.encoded_name_6,
+                encoded_name.encoded_name_7, encoded_name.encoded_name_8},
+               encoded_name.encoded_name_additional};
+
+  auto it = windows_.find(key);
+  if (it != windows_.end() && it->second.end_ns != window_end_ns) {
+    summaries->push_back(std::move(it->second.summary));
+    windows_.erase(it);
+    it = windows_.end();
+  }
+  if (it == windows_.end()) {
+    ApiTrackSummary summary{meta_data.pid, meta_data.tid, meta_data.timestamp_ns, encoded_name,
+                            color_rgba};
+    summary.first_timestamp_ns = meta_data.timestamp_ns;
+    summary.min = value;
+    summary.max = value;
+    it = windows_.emplace(std::move(key), Window{window_end_ns, std::move(summary)}).first;
+  }
+
+  ApiTrackSummary& summary = it->second.summary;
+  summary.meta_data.timestamp_ns = meta_data.timestamp_ns;
+  summary.color_rgba = color_rgba;
+  summary.min = std::min(summary.min, value);
+  summary.max = std::max(summary.max, value);
+  summary.last = value;
+  summary.sum += value;
+  ++summary.count;
+}
+
+void ApiTrackAggregator::FlushWindowsEndingBefore(uint64_t timestamp_ns,
+                                                  std::vector<ApiTrackSummary>* summaries) {
+  for (auto it = windows_.begin(); it != windows_.end();) {
+    if (it->second.end_ns <= timestamp_ns) {
+      summaries->push_back(std::move(it->second.summary));
+      windows_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void ApiTrackAggregator::FlushAllWindows(std::vector<ApiTrackSummary>* summaries) {
+  for (auto& [unused_key, window] : windows_) {
+    summaries->push_back(std::move(window.summary));
+  }
+  windows_.clear();
+}
+
+}  // namespace orbit_api
@@ -0,0 +1,103 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "ApiUtils/ApiTrackAggregator.h"
+#include "ApiUtils/Event.h"
+
+namespace orbit_api {
+
+namespace {
+
+constexpr uint32_t kPid = 1;
+constexpr uint32_t kTid = 2;
+constexpr uint64_t kWindowNs = 1000;
+
+}  // namespace
+
+TEST(ApiTrackAggregator, IgnoresEventsThatAreNotTrackEvents) {
+  ApiTrackAggregator aggregator{kWindowNs};
+  std::vector<ApiTrackSummary> summaries;
+  EXPECT_FALSE(aggregator.Aggregate(ApiScopeStart{kPid, kTid, 1, "Scope"}, &summaries));
+  EXPECT_FALSE(aggregator.Aggregate(ApiInternedString{1, "Name"}, &summaries));
+  aggregator.FlushAllWindows(&summaries);
+  EXPECT_TRUE(summaries.empty());
+}
+
+TEST(ApiTrackAggregator, SummarizesValuesOfWindow) {
+  ApiTrackAggregator aggregator{kWindowNs};
+  std::vector<ApiTrackSummary> summaries;
+  EXPECT_TRUE(aggregator.Aggregate(ApiTrackInt{kPid, kTid, 1100, "Track", 3}, &summaries));
+  EXPECT_TRUE(aggregator.Aggregate(ApiTrackInt{kPid, kTid, 1200, "Track", -1}, &summaries));
+  EXPECT_TRUE(aggregator.Aggregate(ApiTrackInt{kPid, kTid, 1300, "Track", 5, kOrbitColorRed},
+                                   &summaries));
+  EXPECT_TRUE(aggregator.Aggregate(ApiTrackInt{kPid, kTid, 1400, "Track", 2, kOrbitColorRed},
+                                   &summaries));
+  EXPECT_TRUE(summaries.empty());
+
+  // The window ends at 2000.
+  aggregator.FlushWindowsEndingBefore(1999, &summaries);
+  EXPECT_TRUE(summaries.empty());
+  aggregator.FlushWindowsEndingBefore(2000, &summaries);
+  ASSERT_EQ(summaries.size(), 1);
+  const ApiTrackSummary& summary = summaries[0];
+  EXPECT_EQ(summary.meta_data.pid, kPid);
+  EXPECT_EQ(summary.meta_data.tid, kTid);
+  EXPECT_EQ(summary.meta_data.timestamp_ns, 1400);
+  EXPECT_EQ(summary.first_timestamp_ns, 1100);
+  EXPECT_EQ(summary.min, -1.);
+  EXPECT_EQ(summary.max, 5.);
+  EXPECT_EQ(summary.last, 2.);
+  EXPECT_EQ(summary.sum, 9.);
+  EXPECT_EQ(summary.count, 4);
+  EXPECT_EQ(summary.color_rgba, kOrbitColorRed);
+
+  summaries.clear();
+  aggregator.FlushAllWindows(&summaries);
+  EXPECT_TRUE(summaries.empty());
+}
+
+TEST(ApiTrackAggregator, ValueInLaterWindowFlushesPreviousWindow) {
+  ApiTrackAggregator aggregator{kWindowNs};
+  std::vector<ApiTrackSummary> summaries;
+  EXPECT_TRUE(aggregator.Aggregate(ApiTrackDouble{kPid, kTid, 100, "Track", 1.5}, &summaries));
+  EXPECT_TRUE(aggregator.Aggregate(ApiTrackDouble{kPid, kTid, 900, "Track", 2.5}, &summaries));
+  EXPECT_TRUE(aggregator.Aggregate(ApiTrackDouble{kPid, kTid, 5100, "Track", 4.}, &summaries));
+  ASSERT_EQ(summaries.size(), 1);
+  EXPECT_EQ(summaries[0].count, 2);
+  EXPECT_EQ(summaries[0].sum, 4.);
+
+  aggregator.FlushAllWindows(&summaries);
+  ASSERT_EQ(summaries.size(), 2);
+  EXPECT_EQ(summaries[1].first_timestamp_ns, 5100);
+  EXPECT_EQ(summaries[1].count, 1);
+  EXPECT_EQ(summaries[1].min, 4.);
+  EXPECT_EQ(summaries[1].max, 4.);
+}
+
+TEST(ApiTrackAggregator, SeparatesThreadsAndNames) {
+  ApiTrackAggregator aggregator{kWindowNs};
+  std::vector<ApiTrackSummary> summaries;
+  EXPECT_TRUE(aggregator.Aggregate(ApiTrackUint{kPid, kTid, 100, "Track", 1}, &summaries));
+  EXPECT_TRUE(aggregator.Aggregate(ApiTrackUint{kPid, kTid + 1, 200, "Track", 2}, &summaries));
+  EXPECT_TRUE(aggregator.Aggregate(ApiTrackUint{kPid, kTid, 300, "Other", 3}, &summaries));
+  EXPECT_TRUE(
+      aggregator.Aggregate(ApiTrackUint{kPid, kTid, 400, ApiInternedName{7}, 4}, &summaries));
+  EXPECT_TRUE(
+      aggregator.Aggregate(ApiTrackUint64{kPid, kTid, 500, ApiInternedName{7}, 5}, &summaries));
+  EXPECT_TRUE(summaries.empty());
+
+  aggregator.FlushAllWindows(&summaries);
+  std::vector<uint64_t> counts;
+  for (const ApiTrackSummary& summary : summaries) {
+    counts.push_back(summary.count);
+  }
+  EXPECT_THAT(counts, testing::UnorderedElementsAre(1, 1, 1, 2));
+}
+
+}  // namespace orbit_api
@@ -30,6 +30,7 @@ inline void SetEncodedName(const ApiEncodedString& encoded_name, CaptureEventT*
   out->set_encoded_name_8(encoded_name.encoded_name_8);
   out->mutable_encoded_name_additional()->Add(encoded_name.encoded_name_additional.begin(),
                                               encoded_name.encoded_name_additional.end());
+  out->set_name_key(encoded_name.name_key);
 }
 
 void ApiScopeStart::CopyToGrpcProto(orbit_grpc_protos::ApiScopeStart* grpc_proto) const {
@@ -105,4 +106,21 @@ void ApiTrackFloat::CopyToGrpcProto(orbit_grpc_protos::ApiTrackFloat* grpc_proto
   grpc_proto->set_data(data);
   grpc_proto->set_color_rgba(color_rgba);
 }
+
+void ApiTrackSummary::CopyToGrpcProto(orbit_grpc_protos::ApiTrackSummary* grpc_proto) const {
+  SetMetaData(meta_data, grpc_proto);
+  SetEncodedName(encoded_name, grpc_proto);
+  grpc_proto->set_color_rgba(color_rgba);
+  grpc_proto->set_first_timestamp_ns(first_timestamp_ns);
+  grpc_proto->set_min(min);
+  grpc_proto->set_max(max);
+  grpc_proto->set_last(last);
+  grpc_proto->set_sum(sum);
+  grpc_proto->set_count(count);
+}
+
+void ApiInternedString::CopyToGrpcProto(orbit_grpc_protos::InternedString* grpc_proto) const {
+  grpc_proto->set_key(key);
+  grpc_proto->set_intern(name);
+}
 }  // namespace orbit_api
\ No newline at end of file
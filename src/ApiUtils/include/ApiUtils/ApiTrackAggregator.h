@@ -0,0 +1,70 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_API_UTILS_API_TRACK_AGGREGATOR_H_
+#define ORBIT_API_UTILS_API_TRACK_AGGREGATOR_H_
+
+#include <absl/container/flat_hash_map.h>
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "ApiUtils/Event.h"
+
+namespace orbit_api {
+
+// Aggregates the values of the track events (`ApiTrackDouble`, `ApiTrackInt`, ...) of each thread
+// and name into one `ApiTrackSummary` per window of `window_ns`. Windows are aligned to multiples
+// of `window_ns` in capture time. The values of each thread are expected in timestamp order, as
+// they are enqueued by that thread: a value that arrives after its window was flushed starts a new
+// summary for that window.
+class ApiTrackAggregator {
+ public:
+  explicit ApiTrackAggregator(uint64_t window_ns) : window_ns_{window_ns} { CHECK(window_ns > 0); }
+
+  // Returns false, and ignores the event, if it is not a track event. When the value starts a new
+  // window for its thread and name, the summary of the previous window is appended to `summaries`.
+  bool Aggregate(const ApiEventVariant& event, std::vector<ApiTrackSummary>* summaries);
+
+  // Appends to `summaries` the summaries of the windows that end at or before `timestamp_ns`.
+  void FlushWindowsEndingBefore(uint64_t timestamp_ns, std::vector<ApiTrackSummary>* summaries);
+  void FlushAllWindows(std::vector<ApiTrackSummary>* summaries);
+
+ private:
+  struct TrackKey {
+    uint32_t tid;
+    uint64_t name_key;
+    std::array<uint64_t, 8> encoded_name;
+    std::vector<uint64_t> encoded_name_additional;
+
+    friend bool operator==(const TrackKey& lhs, const TrackKey& rhs) {
+      return lhs.tid == rhs.tid && lhs.name_key == rhs.name_key &&
+             lhs.encoded_name == rhs.encoded_name &&
+             lhs.encoded_name_additional == rhs.encoded_name_additional;
+    }
+
+    template <typename H>
+    friend H AbslHashValue(H state, const TrackKey& key) {
+      return H::combine(std::move(state), key.tid, key.name_key, key.encoded_name,
+                        key.encoded_name_additional);
+    }
+  };
+
+  struct Window {
+    uint64_t end_ns;
+    ApiTrackSummary summary;
+  };
+
+  void AddValue(const ApiEventMetaData& meta_data, const ApiEncodedString& encoded_name,
+                uint32_t color_rgba, double value, std::vector<ApiTrackSummary>* summaries);
+
+  uint64_t window_ns_;
+  absl::flat_hash_map<TrackKey, Window> windows_;
+};
+
+}  // namespace orbit_api
+
+#endif  // ORBIT_API_UTILS_API_TRACK_AGGREGATOR_H_
@@ -6,6 +6,8 @@
 #define ORBIT_API_UTILS_EVENT_H_
 
 #include <cstdint>
+#include <string>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -28,8 +30,15 @@ struct ApiEventMetaData {
   uint64_t timestamp_ns = 0;
 };
 
+// Key of a name interned by the producer, see `ApiInternedString`.
+struct ApiInternedName {
+  uint64_t key = 0;
+};
+
 struct ApiEncodedString {
   ApiEncodedString(const char* name) { EncodeString(name, this); }
+  // The name is only referenced by its key, the encoded_name_* fields stay zero.
+  ApiEncodedString(ApiInternedName interned_name) : name_key(interned_name.key) {}
   void set_encoded_name_1(uint64_t value) { encoded_name_1 = value; }
   void set_encoded_name_2(uint64_t value) { encoded_name_2 = value; }
   void set_encoded_name_3(uint64_t value) { encoded_name_3 = value; }
@@ -48,14 +57,15 @@ struct ApiEncodedString {
   uint64_t encoded_name_7 = 0;
   uint64_t encoded_name_8 = 0;
   std::vector<uint64_t> encoded_name_additional{};
+  uint64_t name_key = 0;
 };
 
 struct ApiScopeStart {
-  ApiScopeStart(uint32_t pid, uint32_t tid, uint64_t timestamp_ns, const char* name,
+  ApiScopeStart(uint32_t pid, uint32_t tid, uint64_t timestamp_ns, ApiEncodedString name,
                 orbit_api_color color_rgba = kOrbitColorAuto, uint64_t group_id = 0,
                 uint64_t address_in_function = 0)
       : meta_data(pid, tid, timestamp_ns),
-        encoded_name(name),
+        encoded_name(std::move(name)),
         group_id(group_id),
         address_in_function(address_in_function),
         color_rgba(color_rgba) {}
@@ -79,11 +89,11 @@ struct ApiScopeStop {
 };
 
 struct ApiScopeStartAsync {
-  ApiScopeStartAsync(uint32_t pid, uint32_t tid, uint64_t timestamp_ns, const char* name,
+  ApiScopeStartAsync(uint32_t pid, uint32_t tid, uint64_t timestamp_ns, ApiEncodedString name,
                      uint64_t id, orbit_api_color color_rgba = kOrbitColorAuto,
                      uint64_t address_in_function = 0)
       : meta_data(pid, tid, timestamp_ns),
-        encoded_name(name),
+        encoded_name(std::move(name)),
         id(id),
         address_in_function(address_in_function),
         color_rgba(color_rgba) {}
@@ -108,9 +118,12 @@ struct ApiScopeStopAsync {
 };
 
 struct ApiStringEvent {
-  ApiStringEvent(uint32_t pid, uint32_t tid, uint64_t timestamp_ns, const char* name, uint64_t id,
-                 orbit_api_color color_rgba = kOrbitColorAuto)
-      : meta_data(pid, tid, timestamp_ns), encoded_name(name), id(id), color_rgba(color_rgba) {}
+  ApiStringEvent(uint32_t pid, uint32_t tid, uint64_t timestamp_ns, ApiEncodedString name,
+                 uint64_t id, orbit_api_color color_rgba = kOrbitColorAuto)
+      : meta_data(pid, tid, timestamp_ns),
+        encoded_name(std::move(name)),
+        id(id),
+        color_rgba(color_rgba) {}
 
   void CopyToGrpcProto(orbit_grpc_protos::ApiStringEvent* grpc_proto) const;
 
@@ -121,9 +134,12 @@ struct ApiStringEvent {
 };
 
 struct ApiTrackInt {
-  ApiTrackInt(uint32_t pid, uint32_t tid, uint64_t timestamp_ns, const char* name, int32_t data,
-              orbit_api_color color_rgba = kOrbitColorAuto)
-      : meta_data(pid, tid, timestamp_ns), encoded_name(name), data(data), color_rgba(color_rgba) {}
+  ApiTrackInt(uint32_t pid, uint32_t tid, uint64_t timestamp_ns, ApiEncodedString name,
+              int32_t data, orbit_api_color color_rgba = kOrbitColorAuto)
+      : meta_data(pid, tid, timestamp_ns),
+        encoded_name(std::move(name)),
+        data(data),
+        color_rgba(color_rgba) {}
 
   void CopyToGrpcProto(orbit_grpc_protos::ApiTrackInt* grpc_proto) const;
 
@@ -134,9 +150,12 @@ struct ApiTrackInt {
 };
 
 struct ApiTrackInt64 {
-  ApiTrackInt64(uint32_t pid, uint32_t tid, uint64_t timestamp_ns, const char* name, int64_t data,
-                orbit_api_color color_rgba = kOrbitColorAuto)
-      : meta_data(pid, tid, timestamp_ns), encoded_name(name), data(data), color_rgba(color_rgba) {}
+  ApiTrackInt64(uint32_t pid, uint32_t tid, uint64_t timestamp_ns, ApiEncodedString name,
+                int64_t data, orbit_api_color color_rgba = kOrbitColorAuto)
+      : meta_data(pid, tid, timestamp_ns),
+        encoded_name(std::move(name)),
+        data(data),
+        color_rgba(color_rgba) {}
 
   void CopyToGrpcProto(orbit_grpc_protos::ApiTrackInt64* grpc_proto) const;
 
@@ -147,9 +166,12 @@ struct ApiTrackInt64 {
 };
 
 struct ApiTrackUint {
-  ApiTrackUint(uint32_t pid, uint32_t tid, uint64_t timestamp_ns, const char* name, uint32_t data,
-               orbit_api_color color_rgba = kOrbitColorAuto)
-      : meta_data(pid, tid, timestamp_ns), encoded_name(name), data(data), color_rgba(color_rgba) {}
+  ApiTrackUint(uint32_t pid, uint32_t tid, uint64_t timestamp_ns, ApiEncodedString name,
+               uint32_t data, orbit_api_color color_rgba = kOrbitColorAuto)
+      : meta_data(pid, tid, timestamp_ns),
+        encoded_name(std::move(name)),
+        data(data),
+        color_rgba(color_rgba) {}
 
   void CopyToGrpcProto(orbit_grpc_protos::ApiTrackUint* grpc_proto) const;
 
@@ -160,9 +182,12 @@ struct ApiTrackUint {
 };
 
 struct ApiTrackUint64 {
-  ApiTrackUint64(uint32_t pid, uint32_t tid, uint64_t timestamp_ns, const char* name, uint64_t data,
-                 orbit_api_color color_rgba = kOrbitColorAuto)
-      : meta_data(pid, tid, timestamp_ns), encoded_name(name), data(data), color_rgba(color_rgba) {}
+  ApiTrackUint64(uint32_t pid, uint32_t tid, uint64_t timestamp_ns, ApiEncodedString name,
+                 uint64_t data, orbit_api_color color_rgba = kOrbitColorAuto)
+      : meta_data(pid, tid, timestamp_ns),
+        encoded_name(std::move(name)),
+        data(data),
+        color_rgba(color_rgba) {}
 
   void CopyToGrpcProto(orbit_grpc_protos::ApiTrackUint64* grpc_proto) const;
 
@@ -173,9 +198,12 @@ struct ApiTrackUint64 {
 };
 
 struct ApiTrackDouble {
-  ApiTrackDouble(uint32_t pid, uint32_t tid, uint64_t timestamp_ns, const char* name, double data,
-                 orbit_api_color color_rgba = kOrbitColorAuto)
-      : meta_data(pid, tid, timestamp_ns), encoded_name(name), data(data), color_rgba(color_rgba) {}
+  ApiTrackDouble(uint32_t pid, uint32_t tid, uint64_t timestamp_ns, ApiEncodedString name,
+                 double data, orbit_api_color color_rgba = kOrbitColorAuto)
+      : meta_data(pid, tid, timestamp_ns),
+        encoded_name(std::move(name)),
+        data(data),
+        color_rgba(color_rgba) {}
 
   void CopyToGrpcProto(orbit_grpc_protos::ApiTrackDouble* grpc_proto) const;
 
@@ -186,9 +214,12 @@ struct ApiTrackDouble {
 };
 
 struct ApiTrackFloat {
-  ApiTrackFloat(uint32_t pid, uint32_t tid, uint64_t timestamp_ns, const char* name, float data,
-                orbit_api_color color_rgba = kOrbitColorAuto)
-      : meta_data(pid, tid, timestamp_ns), encoded_name(name), data(data), color_rgba(color_rgba) {}
+  ApiTrackFloat(uint32_t pid, uint32_t tid, uint64_t timestamp_ns, ApiEncodedString name,
+                float data, orbit_api_color color_rgba = kOrbitColorAuto)
+      : meta_data(pid, tid, timestamp_ns),
+        encoded_name(std::move(name)),
+        data(data),
+        color_rgba(color_rgba) {}
 
   void CopyToGrpcProto(orbit_grpc_protos::ApiTrackFloat* grpc_proto) const;
 
@@ -198,12 +229,43 @@ struct ApiTrackFloat {
   uint32_t color_rgba = 0;
 };
 
+// Built by `LockFreeApiEventProducer` from the track events of a thread with the same name, when
+// the capture aggregates them. `meta_data.timestamp_ns` is the timestamp of the last value.
+struct ApiTrackSummary {
+  ApiTrackSummary(uint32_t pid, uint32_t tid, uint64_t timestamp_ns, ApiEncodedString name,
+                  uint32_t color_rgba)
+      : meta_data(pid, tid, timestamp_ns), encoded_name(std::move(name)), color_rgba(color_rgba) {}
+
+  void CopyToGrpcProto(orbit_grpc_protos::ApiTrackSummary* grpc_proto) const;
+
+  ApiEventMetaData meta_data;
+  ApiEncodedString encoded_name;
+  uint32_t color_rgba = 0;
+  uint64_t first_timestamp_ns = 0;
+  double min = 0.;
+  double max = 0.;
+  double last = 0.;
+  double sum = 0.;
+  uint64_t count = 0;
+};
+
+// Sent by a producer before the first event that references `key` in its `name_key`, so that
+// the name doesn't need to be encoded in every event.
+struct ApiInternedString {
+  ApiInternedString(uint64_t key, std::string name) : key(key), name(std::move(name)) {}
+
+  void CopyToGrpcProto(orbit_grpc_protos::InternedString* grpc_proto) const;
+
+  uint64_t key = 0;
+  std::string name;
+};
+
 // Used in `LockFreeApiEventProducer`. The `std::monostate` is required make this variant default
 // constructable. However, real (fully instantiated) values will never be of type `std::monostate`.
 using ApiEventVariant =
     std::variant<std::monostate, ApiScopeStart, ApiScopeStop, ApiScopeStartAsync, ApiScopeStopAsync,
                  ApiStringEvent, ApiTrackDouble, ApiTrackFloat, ApiTrackInt, ApiTrackInt64,
-                 ApiTrackUint, ApiTrackUint64>;
+                 ApiTrackUint, ApiTrackUint64, ApiInternedString, ApiTrackSummary>;
 
 }  // namespace orbit_api
 
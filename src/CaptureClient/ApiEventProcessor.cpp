@@ -18,7 +18,19 @@ using orbit_grpc_protos::ApiScopeStartAsync;
 
 namespace {
 template <typename Source>
-inline std::string DecodeString(const Source& encoded_source) {
+inline std::string DecodeString(
+    const Source& encoded_source,
+    const absl::flat_hash_map<uint64_t, std::string>* string_intern_pool) {
+  if (encoded_source.name_key() != 0) {
+    if (string_intern_pool != nullptr) {
+      auto it = string_intern_pool->find(encoded_source.name_key());
+      if (it != string_intern_pool->end()) {
+        return it->second;
+      }
+    }
+    ERROR("Unknown key %u for the name of an Orbit API event", encoded_source.name_key());
+    return "";
+  }
   return orbit_api::DecodeString(encoded_source.encoded_name_1(), encoded_source.encoded_name_2(),
                                  encoded_source.encoded_name_3(), encoded_source.encoded_name_4(),
                                  encoded_source.encoded_name_5(), encoded_source.encoded_name_6(),
@@ -35,7 +47,10 @@ void EncodedColorToColor(uint32_t encoded_color, orbit_client_protos::Color* col
 }
 }  // namespace
 
-ApiEventProcessor::ApiEventProcessor(CaptureListener* listener) : capture_listener_(listener) {
+ApiEventProcessor::ApiEventProcessor(
+    CaptureListener* listener,
+    const absl::flat_hash_map<uint64_t, std::string>* string_intern_pool)
+    : capture_listener_(listener), string_intern_pool_(string_intern_pool) {
   CHECK(listener != nullptr);
 }
 
@@ -241,7 +256,7 @@ void ApiEventProcessor::ProcessApiScopeStop(
   timer_info.set_group_id(start_event.group_id());
   timer_info.set_address_in_function(start_event.address_in_function());
 
-  timer_info.set_api_scope_name(DecodeString(start_event));
+  timer_info.set_api_scope_name(DecodeString(start_event, string_intern_pool_));
 
   capture_listener_->OnTimer(timer_info);
   event_stack.pop_back();
@@ -278,7 +293,7 @@ void ApiEventProcessor::ProcessApiScopeStopAsync(
   timer_info.set_api_async_scope_id(event_id);
   timer_info.set_address_in_function(start_event.address_in_function());
 
-  timer_info.set_api_scope_name(DecodeString(start_event));
+  timer_info.set_api_scope_name(DecodeString(start_event, string_intern_pool_));
 
   capture_listener_->OnTimer(timer_info);
   asynchronous_events_by_id_.erase(event_id);
@@ -291,7 +306,7 @@ void ApiEventProcessor::ProcessApiStringEvent(
   api_string_event.set_thread_id(grpc_api_string_event.tid());
   api_string_event.set_timestamp_ns(grpc_api_string_event.timestamp_ns());
   api_string_event.set_async_scope_id(grpc_api_string_event.id());
-  api_string_event.set_name(DecodeString(grpc_api_string_event));
+  api_string_event.set_name(DecodeString(grpc_api_string_event, string_intern_pool_));
   capture_listener_->OnApiStringEvent(api_string_event);
 }
 
@@ -303,7 +318,7 @@ void ApiEventProcessor::ProcessApiTrackDouble(
   api_track_value.set_timestamp_ns(grpc_api_track_double.timestamp_ns());
   api_track_value.set_data_double(grpc_api_track_double.data());
 
-  api_track_value.set_name(DecodeString(grpc_api_track_double));
+  api_track_value.set_name(DecodeString(grpc_api_track_double, string_intern_pool_));
 
   capture_listener_->OnApiTrackValue(api_track_value);
 }
@@ -316,7 +331,7 @@ void ApiEventProcessor::ProcessApiTrackFloat(
   api_track_value.set_timestamp_ns(grpc_api_track_float.timestamp_ns());
   api_track_value.set_data_float(grpc_api_track_float.data());
 
-  api_track_value.set_name(DecodeString(grpc_api_track_float));
+  api_track_value.set_name(DecodeString(grpc_api_track_float, string_intern_pool_));
 
   capture_listener_->OnApiTrackValue(api_track_value);
 }
@@ -329,7 +344,7 @@ void ApiEventProcessor::ProcessApiTrackInt(
   api_track_value.set_timestamp_ns(grpc_api_track_int.timestamp_ns());
   api_track_value.set_data_int(grpc_api_track_int.data());
 
-  api_track_value.set_name(DecodeString(grpc_api_track_int));
+  api_track_value.set_name(DecodeString(grpc_api_track_int, string_intern_pool_));
 
   capture_listener_->OnApiTrackValue(api_track_value);
 }
@@ -342,7 +357,7 @@ void ApiEventProcessor::ProcessApiTrackInt64(
   api_track_value.set_timestamp_ns(grpc_api_track_int64.timestamp_ns());
   api_track_value.set_data_int64(grpc_api_track_int64.data());
 
-  api_track_value.set_name(DecodeString(grpc_api_track_int64));
+  api_track_value.set_name(DecodeString(grpc_api_track_int64, string_intern_pool_));
 
   capture_listener_->OnApiTrackValue(api_track_value);
 }
@@ -355,7 +370,7 @@ void ApiEventProcessor::ProcessApiTrackUint(
   api_track_value.set_timestamp_ns(grpc_api_track_uint.timestamp_ns());
   api_track_value.set_data_uint(grpc_api_track_uint.data());
 
-  api_track_value.set_name(DecodeString(grpc_api_track_uint));
+  api_track_value.set_name(DecodeString(grpc_api_track_uint, string_intern_pool_));
 
   capture_listener_->OnApiTrackValue(api_track_value);
 }
@@ -368,7 +383,27 @@ void ApiEventProcessor::ProcessApiTrackUint64(
   api_track_value.set_timestamp_ns(grpc_api_track_uint64.timestamp_ns());
   api_track_value.set_data_uint64(grpc_api_track_uint64.data());
 
-  api_track_value.set_name(DecodeString(grpc_api_track_uint64));
+  api_track_value.set_name(DecodeString(grpc_api_track_uint64, string_intern_pool_));
+
+  capture_listener_->OnApiTrackValue(api_track_value);
+}
+
+void ApiEventProcessor::ProcessApiTrackSummary(
+    const orbit_grpc_protos::ApiTrackSummary& grpc_api_track_summary) {
+  ApiTrackValue api_track_value;
+  api_track_value.set_process_id(grpc_api_track_summary.pid());
+  api_track_value.set_thread_id(grpc_api_track_summary.tid());
+  api_track_value.set_timestamp_ns(grpc_api_track_summary.timestamp_ns());
+  api_track_value.set_data_double(grpc_api_track_summary.last());
+
+  orbit_client_protos::ApiTrackValueRange* range = api_track_value.mutable_range();
+  range->set_first_timestamp_ns(grpc_api_track_summary.first_timestamp_ns());
+  range->set_min(grpc_api_track_summary.min());
+  range->set_max(grpc_api_track_summary.max());
+  range->set_sum(grpc_api_track_summary.sum());
+  range->set_count(grpc_api_track_summary.count());
+
+  api_track_value.set_name(DecodeString(grpc_api_track_summary, string_intern_pool_));
 
   capture_listener_->OnApiTrackValue(api_track_value);
 }
@@ -2,11 +2,13 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <absl/container/flat_hash_map.h>
 #include <gmock/gmock.h>
 #include <google/protobuf/util/message_differencer.h>
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <string>
 #include <vector>
 
 #include "ApiUtils/EncodedString.h"
@@ -38,6 +40,8 @@ class MockCaptureListener : public CaptureListener {
               (override));
   MOCK_METHOD(void, OnCaptureFinished, (const orbit_grpc_protos::CaptureFinished&), (override));
   MOCK_METHOD(void, OnTimer, (const TimerInfo&), (override));
+  MOCK_METHOD(void, OnFunctionCallStats, (const orbit_grpc_protos::FunctionCallStats&),
+              (override));
   MOCK_METHOD(void, OnKeyAndString, (uint64_t /*key*/, std::string), (override));
   MOCK_METHOD(void, OnUniqueCallstack, (uint64_t /*callstack_id*/, CallstackInfo /*callstack*/),
               (override));
@@ -83,7 +87,7 @@ class MockCaptureListener : public CaptureListener {
 
 class ApiEventProcessorTest : public ::testing::Test {
  public:
-  ApiEventProcessorTest() : api_event_processor_{&capture_listener_} {}
+  ApiEventProcessorTest() : api_event_processor_{&capture_listener_, &string_intern_pool_} {}
 
  protected:
   void SetUp() override {}
@@ -239,6 +243,7 @@ class ApiEventProcessorTest : public ::testing::Test {
   }
 
   MockCaptureListener capture_listener_;
+  absl::flat_hash_map<uint64_t, std::string> string_intern_pool_;
   ApiEventProcessor api_event_processor_;
 
   static constexpr int32_t kProcessId = 42;
@@ -497,6 +502,61 @@ TEST_F(ApiEventProcessorTest, TrackUint64) {
   EXPECT_TRUE(MessageDifferencer::Equivalent(expected_track_value, actual_track_value));
 }
 
+TEST_F(ApiEventProcessorTest, InternedNames) {
+  constexpr uint64_t kScopeNameKey = 5;
+  constexpr uint64_t kTrackNameKey = 6;
+  string_intern_pool_.emplace(kScopeNameKey, "Interned scope");
+  string_intern_pool_.emplace(kTrackNameKey, "Interned track");
+
+  orbit_grpc_protos::ApiScopeStart start;
+  start.set_timestamp_ns(1);
+  start.set_pid(kProcessId);
+  start.set_tid(kThreadId1);
+  start.set_group_id(kGroupId);
+  start.set_address_in_function(kAddressInFunction);
+  start.set_name_key(kScopeNameKey);
+  auto stop = CreateStopScope(2, kProcessId, kThreadId1);
+
+  orbit_grpc_protos::ApiTrackInt track_int;
+  track_int.set_timestamp_ns(3);
+  track_int.set_pid(kProcessId);
+  track_int.set_tid(kThreadId1);
+  track_int.set_data(7);
+  track_int.set_name_key(kTrackNameKey);
+
+  TimerInfo actual_timer;
+  EXPECT_CALL(capture_listener_, OnTimer).Times(1).WillOnce(SaveArg<0>(&actual_timer));
+  orbit_client_protos::ApiTrackValue actual_track_value;
+  EXPECT_CALL(capture_listener_, OnApiTrackValue)
+      .Times(1)
+      .WillOnce(SaveArg<0>(&actual_track_value));
+
+  api_event_processor_.ProcessApiScopeStart(start);
+  api_event_processor_.ProcessApiScopeStop(stop);
+  api_event_processor_.ProcessApiTrackInt(track_int);
+
+  EXPECT_EQ(actual_timer.api_scope_name(), "Interned scope");
+  EXPECT_EQ(actual_track_value.name(), "Interned track");
+  EXPECT_EQ(actual_track_value.data_int(), 7);
+}
+
+TEST_F(ApiEventProcessorTest, UnknownInternedNameIsEmpty) {
+  orbit_grpc_protos::ApiTrackInt track_int;
+  track_int.set_timestamp_ns(1);
+  track_int.set_pid(kProcessId);
+  track_int.set_tid(kThreadId1);
+  track_int.set_name_key(42);
+
+  orbit_client_protos::ApiTrackValue actual_track_value;
+  EXPECT_CALL(capture_listener_, OnApiTrackValue)
+      .Times(1)
+      .WillOnce(SaveArg<0>(&actual_track_value));
+
+  api_event_processor_.ProcessApiTrackInt(track_int);
+
+  EXPECT_EQ(actual_track_value.name(), "");
+}
+
 TEST_F(ApiEventProcessorTest, ScopesFromSameThreadLegacy) {
   ApiEvent start_0 =
       CreateApiEventLegacy(kProcessId, kThreadId1, 1, orbit_api::EventType::kScopeStart, "Scope0");
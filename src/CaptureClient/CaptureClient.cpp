@@ -19,6 +19,7 @@
 #include "CaptureClient/CaptureListener.h"
 #include "ClientData/FunctionUtils.h"
 #include "ClientData/ModuleData.h"
+#include "CompactCaptureEventDecoder.h"
 #include "Introspection/Introspection.h"
 #include "OrbitBase/Future.h"
 #include "OrbitBase/Logging.h"
@@ -51,9 +52,11 @@ Future<ErrorMessageOr<CaptureListener::CaptureOutcome>> CaptureClient::Capture(
     absl::flat_hash_map<uint64_t, FunctionInfo> selected_functions, bool record_arguments,
     bool record_return_values, TracepointInfoSet selected_tracepoints, double samples_per_second,
     uint16_t stack_dump_size, UnwindingMethod unwinding_method, bool collect_scheduling_info,
-    bool collect_thread_state, bool collect_gpu_jobs, bool enable_api, bool enable_introspection,
-    bool enable_user_space_instrumentation, uint64_t max_local_marker_depth_per_command_buffer,
-    bool collect_memory_info, uint64_t memory_sampling_period_ms,
+    bool collect_thread_state, bool collect_gpu_jobs, bool enable_api,
+    uint64_t api_track_aggregation_window_ns, bool enable_introspection,
+    bool enable_user_space_instrumentation, bool user_space_instrumentation_statistics_only,
+    uint64_t max_local_marker_depth_per_command_buffer, bool collect_memory_info,
+    uint64_t memory_sampling_period_ms,
     std::unique_ptr<CaptureEventProcessor> capture_event_processor) {
   absl::MutexLock lock(&state_mutex_);
   if (state_ != State::kStopped) {
@@ -70,14 +73,17 @@ Future<ErrorMessageOr<CaptureListener::CaptureOutcome>> CaptureClient::Capture(
        record_arguments, record_return_values,
        selected_tracepoints = std::move(selected_tracepoints), samples_per_second, stack_dump_size,
        unwinding_method, collect_scheduling_info, collect_thread_state, collect_gpu_jobs,
-       enable_api, enable_introspection, enable_user_space_instrumentation,
+       enable_api, api_track_aggregation_window_ns, enable_introspection,
+       enable_user_space_instrumentation, user_space_instrumentation_statistics_only,
        max_local_marker_depth_per_command_buffer, collect_memory_info, memory_sampling_period_ms,
        capture_event_processor = std::move(capture_event_processor)]() mutable {
         return CaptureSync(process_id, module_manager, selected_functions, record_arguments,
                            record_return_values, selected_tracepoints, samples_per_second,
                            stack_dump_size, unwinding_method, collect_scheduling_info,
-                           collect_thread_state, collect_gpu_jobs, enable_api, enable_introspection,
+                           collect_thread_state, collect_gpu_jobs, enable_api,
+                           api_track_aggregation_window_ns, enable_introspection,
                            enable_user_space_instrumentation,
+                           user_space_instrumentation_statistics_only,
                            max_local_marker_depth_per_command_buffer, collect_memory_info,
                            memory_sampling_period_ms, capture_event_processor.get());
       });
@@ -116,7 +122,8 @@ ErrorMessageOr<CaptureListener::CaptureOutcome> CaptureClient::CaptureSync(
     bool record_return_values, const TracepointInfoSet& selected_tracepoints,
     double samples_per_second, uint16_t stack_dump_size, UnwindingMethod unwinding_method,
     bool collect_scheduling_info, bool collect_thread_state, bool collect_gpu_jobs, bool enable_api,
-    bool enable_introspection, bool enable_user_space_instrumentation,
+    uint64_t api_track_aggregation_window_ns, bool enable_introspection,
+    bool enable_user_space_instrumentation, bool user_space_instrumentation_statistics_only,
     uint64_t max_local_marker_depth_per_command_buffer, bool collect_memory_info,
     uint64_t memory_sampling_period_ms, CaptureEventProcessor* capture_event_processor) {
   ORBIT_SCOPE_FUNCTION;
@@ -179,8 +186,12 @@ ErrorMessageOr<CaptureListener::CaptureOutcome> CaptureClient::CaptureSync(
   }
 
   capture_options->set_enable_api(enable_api);
+  capture_options->set_api_track_aggregation_window_ns(api_track_aggregation_window_ns);
   capture_options->set_enable_introspection(enable_introspection);
   capture_options->set_enable_user_space_instrumentation(enable_user_space_instrumentation);
+  capture_options->set_user_space_instrumentation_statistics_only(
+      user_space_instrumentation_statistics_only);
+  capture_options->set_compact_capture_event_encoding(true);
 
   auto api_functions = FindApiFunctions(module_manager);
   *(capture_options->mutable_api_functions()) = {api_functions.begin(), api_functions.end()};
@@ -212,6 +223,13 @@ ErrorMessageOr<CaptureListener::CaptureOutcome> CaptureClient::CaptureSync(
     }
     if (read_succeeded) {
       ProcessEvents(capture_event_processor, response.capture_events());
+      ErrorMessageOr<void> decode_result = DecodeCompactCaptureEvents(
+          response, [capture_event_processor](const ClientCaptureEvent& event) {
+            capture_event_processor->ProcessEvent(event);
+          });
+      if (decode_result.has_error()) {
+        ERROR("Decoding compact events of CaptureResponse: %s", decode_result.error().message());
+      }
     } else {
       break;
     }
@@ -47,7 +47,7 @@ class CaptureEventProcessorForListener : public CaptureEventProcessor {
       : file_path_{std::move(file_path)},
         frame_track_function_ids_(std::move(frame_track_function_ids)),
         capture_listener_(capture_listener),
-        api_event_processor_{capture_listener} {}
+        api_event_processor_{capture_listener, &string_intern_pool_} {}
   ~CaptureEventProcessorForListener() override = default;
 
   void ProcessEvent(const orbit_grpc_protos::ClientCaptureEvent& event) override;
@@ -59,6 +59,7 @@ class CaptureEventProcessorForListener : public CaptureEventProcessor {
   void ProcessInternedCallstack(orbit_grpc_protos::InternedCallstack interned_callstack);
   void ProcessCallstackSample(const orbit_grpc_protos::CallstackSample& callstack_sample);
   void ProcessFunctionCall(const orbit_grpc_protos::FunctionCall& function_call);
+  void ProcessFunctionCallStats(const orbit_grpc_protos::FunctionCallStats& function_call_stats);
   void ProcessInternedString(orbit_grpc_protos::InternedString interned_string);
   void ProcessModuleUpdate(orbit_grpc_protos::ModuleUpdateEvent module_update);
   void ProcessModulesSnapshot(const orbit_grpc_protos::ModulesSnapshot& modules_snapshot);
@@ -133,6 +134,9 @@ void CaptureEventProcessorForListener::ProcessEvent(const ClientCaptureEvent& ev
     case ClientCaptureEvent::kFunctionCall:
       ProcessFunctionCall(event.function_call());
       break;
+    case ClientCaptureEvent::kFunctionCallStats:
+      ProcessFunctionCallStats(event.function_call_stats());
+      break;
     case ClientCaptureEvent::kInternedString:
       ProcessInternedString(event.interned_string());
       break;
@@ -205,6 +209,9 @@ void CaptureEventProcessorForListener::ProcessEvent(const ClientCaptureEvent& ev
     case ClientCaptureEvent::kApiTrackUint64:
       api_event_processor_.ProcessApiTrackUint64(event.api_track_uint64());
       break;
+    case ClientCaptureEvent::kApiTrackSummary:
+      api_event_processor_.ProcessApiTrackSummary(event.api_track_summary());
+      break;
     case ClientCaptureEvent::kWarningEvent:
       ProcessWarningEvent(event.warning_event());
       break;
@@ -314,6 +321,11 @@ void CaptureEventProcessorForListener::ProcessFunctionCall(const FunctionCall& f
   capture_listener_->OnTimer(timer_info);
 }
 
+void CaptureEventProcessorForListener::ProcessFunctionCallStats(
+    const orbit_grpc_protos::FunctionCallStats& function_call_stats) {
+  capture_listener_->OnFunctionCallStats(function_call_stats);
+}
+
 void CaptureEventProcessorForListener::ProcessInternedString(InternedString interned_string) {
   if (string_intern_pool_.contains(interned_string.key())) {
     ERROR("Overwriting InternedString with key %llu", interned_string.key());
@@ -80,6 +80,8 @@ class MockCaptureListener : public CaptureListener {
               (override));
   MOCK_METHOD(void, OnCaptureFinished, (const CaptureFinished&), (override));
   MOCK_METHOD(void, OnTimer, (const TimerInfo&), (override));
+  MOCK_METHOD(void, OnFunctionCallStats, (const orbit_grpc_protos::FunctionCallStats&),
+              (override));
   MOCK_METHOD(void, OnKeyAndString, (uint64_t /*key*/, std::string), (override));
   MOCK_METHOD(void, OnUniqueCallstack, (uint64_t /*callstack_id*/, CallstackInfo /*callstack*/),
               (override));
@@ -363,6 +365,33 @@ TEST(CaptureEventProcessor, CanHandleFunctionCalls) {
   EXPECT_EQ(actual_timer.type(), TimerInfo::kNone);
 }
 
+TEST(CaptureEventProcessor, CanHandleFunctionCallStats) {
+  MockCaptureListener listener;
+  auto event_processor =
+      CaptureEventProcessor::CreateForCaptureListener(&listener, std::filesystem::path{}, {});
+
+  ClientCaptureEvent event;
+  orbit_grpc_protos::FunctionCallStats* function_call_stats = event.mutable_function_call_stats();
+  function_call_stats->set_pid(42);
+  function_call_stats->set_tid(24);
+  function_call_stats->set_function_id(123);
+  function_call_stats->set_count(3);
+  function_call_stats->set_total_time_ns(300);
+  function_call_stats->add_duration_histogram(0);
+  function_call_stats->add_duration_histogram(3);
+
+  orbit_grpc_protos::FunctionCallStats actual_function_call_stats;
+  EXPECT_CALL(listener, OnFunctionCallStats)
+      .Times(1)
+      .WillOnce(SaveArg<0>(&actual_function_call_stats));
+  EXPECT_CALL(listener, OnTimer).Times(0);
+
+  event_processor->ProcessEvent(event);
+
+  EXPECT_EQ(actual_function_call_stats.SerializeAsString(),
+            function_call_stats->SerializeAsString());
+}
+
 TEST(CaptureEventProcessor, CanHandleThreadNames) {
   MockCaptureListener listener;
   auto event_processor =
@@ -0,0 +1,89 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "CompactCaptureEventDecoder.h"
+
+#include <absl/strings/str_format.h>
+
+#include <cstdint>
+
+namespace orbit_capture_client {
+
+using orbit_grpc_protos::CaptureResponse;
+using orbit_grpc_protos::ClientCaptureEvent;
+using orbit_grpc_protos::CompactFunctionCalls;
+using orbit_grpc_protos::CompactSchedulingSlices;
+
+namespace {
+
+[[nodiscard]] ErrorMessageOr<void> CheckSchedulingSlices(const CompactSchedulingSlices& columns) {
+  const int size = columns.pid_deltas_size();
+  if (columns.tid_deltas_size() != size || columns.cores_size() != size ||
+      columns.durations_ns_size() != size || columns.out_timestamp_ns_deltas_size() != size) {
+    return ErrorMessage{"Inconsistent sizes of compact SchedulingSlices"};
+  }
+  return outcome::success();
+}
+
+[[nodiscard]] ErrorMessageOr<void> CheckFunctionCalls(const CompactFunctionCalls& columns) {
+  const int size = columns.pid_deltas_size();
+  if (columns.tid_deltas_size() != size || columns.function_ids_size() != size ||
+      columns.durations_ns_size() != size || columns.end_timestamp_ns_deltas_size() != size ||
+      columns.depths_size() != size ||
+      (columns.return_values_size() != 0 && columns.return_values_size() != size)) {
+    return ErrorMessage{"Inconsistent sizes of compact FunctionCalls"};
+  }
+  return outcome::success();
+}
+
+}  // namespace
+
+ErrorMessageOr<void> DecodeCompactCaptureEvents(
+    const CaptureResponse& response,
+    const std::function<void(const ClientCaptureEvent&)>& process_event) {
+  const CompactSchedulingSlices& scheduling_slices = response.compact_scheduling_slices();
+  const CompactFunctionCalls& function_calls = response.compact_function_calls();
+  OUTCOME_TRY(CheckSchedulingSlices(scheduling_slices));
+  OUTCOME_TRY(CheckFunctionCalls(function_calls));
+
+  // The event is reused, as all its fields are overwritten for each value.
+  ClientCaptureEvent event;
+  uint64_t pid = 0;
+  uint64_t tid = 0;
+  uint64_t timestamp_ns = 0;
+  orbit_grpc_protos::SchedulingSlice* scheduling_slice = event.mutable_scheduling_slice();
+  for (int i = 0; i < scheduling_slices.pid_deltas_size(); ++i) {
+    pid += scheduling_slices.pid_deltas(i);
+    tid += scheduling_slices.tid_deltas(i);
+    timestamp_ns += scheduling_slices.out_timestamp_ns_deltas(i);
+    scheduling_slice->set_pid(static_cast<uint32_t>(pid));
+    scheduling_slice->set_tid(static_cast<uint32_t>(tid));
+    scheduling_slice->set_core(scheduling_slices.cores(i));
+    scheduling_slice->set_duration_ns(scheduling_slices.durations_ns(i));
+    scheduling_slice->set_out_timestamp_ns(timestamp_ns);
+    process_event(event);
+  }
+
+  pid = 0;
+  tid = 0;
+  timestamp_ns = 0;
+  const bool has_return_values = function_calls.return_values_size() > 0;
+  orbit_grpc_protos::FunctionCall* function_call = event.mutable_function_call();
+  for (int i = 0; i < function_calls.pid_deltas_size(); ++i) {
+    pid += function_calls.pid_deltas(i);
+    tid += function_calls.tid_deltas(i);
+    timestamp_ns += function_calls.end_timestamp_ns_deltas(i);
+    function_call->set_pid(static_cast<uint32_t>(pid));
+    function_call->set_tid(static_cast<uint32_t>(tid));
+    function_call->set_function_id(function_calls.function_ids(i));
+    function_call->set_duration_ns(function_calls.durations_ns(i));
+    function_call->set_end_timestamp_ns(timestamp_ns);
+    function_call->set_depth(function_calls.depths(i));
+    function_call->set_return_value(has_return_values ? function_calls.return_values(i) : 0);
+    process_event(event);
+  }
+  return outcome::success();
+}
+
+}  // namespace orbit_capture_client
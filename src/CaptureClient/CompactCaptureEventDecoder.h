@@ -0,0 +1,26 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CAPTURE_CLIENT_COMPACT_CAPTURE_EVENT_DECODER_H_
+#define CAPTURE_CLIENT_COMPACT_CAPTURE_EVENT_DECODER_H_
+
+#include <functional>
+
+#include "OrbitBase/Result.h"
+#include "capture.pb.h"
+#include "services.pb.h"
+
+namespace orbit_capture_client {
+
+// Converts the compact columns of a CaptureResponse (see CompactSchedulingSlices and
+// CompactFunctionCalls in services.proto) back to ClientCaptureEvents and calls `process_event` on
+// each of them, SchedulingSlices first. Returns an error, without calling `process_event`, if the
+// columns don't all have the same size.
+[[nodiscard]] ErrorMessageOr<void> DecodeCompactCaptureEvents(
+    const orbit_grpc_protos::CaptureResponse& response,
+    const std::function<void(const orbit_grpc_protos::ClientCaptureEvent&)>& process_event);
+
+}  // namespace orbit_capture_client
+
+#endif  // CAPTURE_CLIENT_COMPACT_CAPTURE_EVENT_DECODER_H_
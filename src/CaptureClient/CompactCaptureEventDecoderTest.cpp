@@ -0,0 +1,104 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <google/protobuf/util/message_differencer.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "CompactCaptureEventDecoder.h"
+#include "capture.pb.h"
+#include "services.pb.h"
+
+namespace orbit_capture_client {
+
+using orbit_grpc_protos::CaptureResponse;
+using orbit_grpc_protos::ClientCaptureEvent;
+
+namespace {
+
+std::vector<ClientCaptureEvent> DecodeAll(const CaptureResponse& response) {
+  std::vector<ClientCaptureEvent> events;
+  ErrorMessageOr<void> result = DecodeCompactCaptureEvents(
+      response, [&events](const ClientCaptureEvent& event) { events.push_back(event); });
+  EXPECT_FALSE(result.has_error());
+  return events;
+}
+
+}  // namespace
+
+TEST(CompactCaptureEventDecoder, DecodesSchedulingSlicesThenFunctionCalls) {
+  CaptureResponse response;
+  orbit_grpc_protos::CompactSchedulingSlices* scheduling_slices =
+      response.mutable_compact_scheduling_slices();
+  for (int64_t tid_delta : {11, -2}) {
+    scheduling_slices->add_pid_deltas(tid_delta == 11 ? 10 : 0);
+    scheduling_slices->add_tid_deltas(tid_delta);
+    scheduling_slices->add_cores(3);
+    scheduling_slices->add_durations_ns(100);
+    scheduling_slices->add_out_timestamp_ns_deltas(1000);
+  }
+  orbit_grpc_protos::CompactFunctionCalls* function_calls =
+      response.mutable_compact_function_calls();
+  function_calls->add_pid_deltas(10);
+  function_calls->add_tid_deltas(12);
+  function_calls->add_function_ids(5);
+  function_calls->add_durations_ns(50);
+  function_calls->add_end_timestamp_ns_deltas(3000);
+  function_calls->add_depths(1);
+
+  std::vector<ClientCaptureEvent> events = DecodeAll(response);
+  ASSERT_EQ(events.size(), 3);
+
+  ClientCaptureEvent expected_scheduling_slice;
+  orbit_grpc_protos::SchedulingSlice* scheduling_slice =
+      expected_scheduling_slice.mutable_scheduling_slice();
+  scheduling_slice->set_pid(10);
+  scheduling_slice->set_tid(11);
+  scheduling_slice->set_core(3);
+  scheduling_slice->set_duration_ns(100);
+  scheduling_slice->set_out_timestamp_ns(1000);
+  EXPECT_TRUE(
+      google::protobuf::util::MessageDifferencer::Equals(events[0], expected_scheduling_slice));
+  scheduling_slice->set_tid(9);
+  scheduling_slice->set_out_timestamp_ns(2000);
+  EXPECT_TRUE(
+      google::protobuf::util::MessageDifferencer::Equals(events[1], expected_scheduling_slice));
+
+  ClientCaptureEvent expected_function_call;
+  orbit_grpc_protos::FunctionCall* function_call = expected_function_call.mutable_function_call();
+  function_call->set_pid(10);
+  function_call->set_tid(12);
+  function_call->set_function_id(5);
+  function_call->set_duration_ns(50);
+  function_call->set_end_timestamp_ns(3000);
+  function_call->set_depth(1);
+  EXPECT_TRUE(google::protobuf::util::MessageDifferencer::Equals(events[2], expected_function_call));
+}
+
+TEST(CompactCaptureEventDecoder, EmptyResponseHasNoEvents) {
+  EXPECT_TRUE(DecodeAll(CaptureResponse{}).empty());
+}
+
+TEST(CompactCaptureEventDecoder, FailsOnInconsistentColumns) {
+  CaptureResponse response;
+  orbit_grpc_protos::CompactFunctionCalls* function_calls =
+      response.mutable_compact_function_calls();
+  function_calls->add_pid_deltas(10);
+  function_calls->add_tid_deltas(12);
+  function_calls->add_function_ids(5);
+  function_calls->add_durations_ns(50);
+  function_calls->add_end_timestamp_ns_deltas(3000);
+  function_calls->add_depths(1);
+  function_calls->add_return_values(1);
+  function_calls->add_return_values(2);
+
+  bool called = false;
+  ErrorMessageOr<void> result = DecodeCompactCaptureEvents(
+      response, [&called](const ClientCaptureEvent& /*event*/) { called = true; });
+  EXPECT_TRUE(result.has_error());
+  EXPECT_FALSE(called);
+}
+
+}  // namespace orbit_capture_client
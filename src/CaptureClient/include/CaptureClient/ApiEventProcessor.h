@@ -7,6 +7,10 @@
 
 #include <absl/container/flat_hash_map.h>
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 #include "ApiUtils/EncodedEvent.h"
 #include "CaptureClient/CaptureListener.h"
 #include "capture.pb.h"
@@ -20,7 +24,11 @@ namespace orbit_capture_client {
 // however, they are translated to TimerInfo objects that are directly passed to the listener.
 class ApiEventProcessor {
  public:
-  explicit ApiEventProcessor(CaptureListener* listener);
+  // `string_intern_pool` resolves the names of the events that are interned (those with a
+  // `name_key`). It is owned by the caller, who fills it with the InternedStrings of the capture.
+  explicit ApiEventProcessor(
+      CaptureListener* listener,
+      const absl::flat_hash_map<uint64_t, std::string>* string_intern_pool = nullptr);
   // The new manual instrumentation events (see below) could not use `ApiEvent`, so this is
   // deprecated. The methods for the concrete (new) events should be used instead.
   [[deprecated]] void ProcessApiEventLegacy(const orbit_grpc_protos::ApiEvent& grpc_api_event);
@@ -37,6 +45,7 @@ class ApiEventProcessor {
   void ProcessApiTrackInt64(const orbit_grpc_protos::ApiTrackInt64& grpc_api_track_int64);
   void ProcessApiTrackUint(const orbit_grpc_protos::ApiTrackUint& grpc_api_track_uint);
   void ProcessApiTrackUint64(const orbit_grpc_protos::ApiTrackUint64& grpc_api_track_uint64);
+  void ProcessApiTrackSummary(const orbit_grpc_protos::ApiTrackSummary& grpc_api_track_summary);
 
  private:
   [[deprecated]] void ProcessApiEventLegacy(const orbit_api::ApiEvent& api_event);
@@ -48,6 +57,7 @@ class ApiEventProcessor {
   [[deprecated]] void ProcessStringEventLegacy(const orbit_api::ApiEvent& api_event);
 
   CaptureListener* capture_listener_ = nullptr;
+  const absl::flat_hash_map<uint64_t, std::string>* string_intern_pool_ = nullptr;
   absl::flat_hash_map<int32_t, std::vector<orbit_api::ApiEvent>> synchronous_event_stack_by_tid_;
   absl::flat_hash_map<int32_t, std::vector<orbit_grpc_protos::ApiScopeStart>>
       synchronous_scopes_stack_by_tid_;
@@ -46,7 +46,8 @@ class CaptureClient {
       orbit_client_data::TracepointInfoSet selected_tracepoints, double samples_per_second,
       uint16_t stack_dump_size, orbit_grpc_protos::UnwindingMethod unwinding_method,
       bool collect_scheduling_info, bool collect_thread_state, bool collect_gpu_jobs,
-      bool enable_api, bool enable_introspection, bool enable_user_space_instrumentation,
+      bool enable_api, uint64_t api_track_aggregation_window_ns, bool enable_introspection,
+      bool enable_user_space_instrumentation, bool user_space_instrumentation_statistics_only,
       uint64_t max_local_marker_depth_per_command_buffer, bool collect_memory_info,
       uint64_t memory_sampling_period_ms,
       std::unique_ptr<CaptureEventProcessor> capture_event_processor);
@@ -79,7 +80,8 @@ class CaptureClient {
       const orbit_client_data::TracepointInfoSet& selected_tracepoints, double samples_per_second,
       uint16_t stack_dump_size, orbit_grpc_protos::UnwindingMethod unwinding_method,
       bool collect_scheduling_info, bool collect_thread_state, bool collect_gpu_jobs,
-      bool enable_api, bool enable_introspection, bool enable_user_space_instrumentation,
+      bool enable_api, uint64_t api_track_aggregation_window_ns, bool enable_introspection,
+      bool enable_user_space_instrumentation, bool user_space_instrumentation_statistics_only,
       uint64_t max_local_marker_depth_per_command_buffer, bool collect_memory_info,
       uint64_t memory_sampling_period_ms, CaptureEventProcessor* capture_event_processor);
 
@@ -4,12 +4,15 @@
 
 #include "CaptureEventProducer/CaptureEventProducer.h"
 
+#include <absl/random/random.h>
 #include <absl/synchronization/mutex.h>
 #include <absl/time/time.h>
 
 #include <chrono>
 
 #include "OrbitBase/Logging.h"
+#include "OrbitBase/Result.h"
+#include "SharedMemoryTransport/FdPassing.h"
 
 using orbit_grpc_protos::ProducerSideService;
 using orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest;
@@ -107,6 +110,46 @@ bool CaptureEventProducer::NotifyAllEventsSent() {
   return write_succeeded;
 }
 
+bool CaptureEventProducer::NotifySharedMemoryRingBufferCreated(
+    int32_t pid, int fd, std::string_view shared_memory_fd_socket_path) {
+  CHECK(producer_side_service_stub_ != nullptr);
+  {
+    absl::ReaderMutexLock lock{&shutdown_requested_mutex_};
+    CHECK(!shutdown_requested_);
+  }
+
+  // The token lets OrbitService match the file descriptor to this message. It is random so that
+  // another process can't easily pass its own file descriptor for it.
+  absl::BitGen gen;
+  const uint64_t fd_token = absl::Uniform<uint64_t>(gen);
+  ErrorMessageOr<void> send_fd_result =
+      orbit_shared_memory_transport::ConnectAndSendFd(shared_memory_fd_socket_path, fd_token, fd);
+  if (send_fd_result.has_error()) {
+    ERROR("Passing shared memory ring buffer to OrbitService: %s",
+          send_fd_result.error().message());
+    return false;
+  }
+
+  orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest ring_buffer_created_request;
+  ring_buffer_created_request.mutable_shared_memory_ring_buffer_created()->set_pid(pid);
+  ring_buffer_created_request.mutable_shared_memory_ring_buffer_created()->set_fd_token(fd_token);
+  bool write_succeeded;
+  {
+    absl::ReaderMutexLock lock{&context_and_stream_mutex_};
+    if (stream_ == nullptr) {
+      ERROR("Sending SharedMemoryRingBufferCreated to ProducerSideService: not connected");
+      return false;
+    }
+    write_succeeded = stream_->Write(ring_buffer_created_request);
+  }
+  if (write_succeeded) {
+    LOG("Sent SharedMemoryRingBufferCreated to ProducerSideService");
+  } else {
+    ERROR("Sending SharedMemoryRingBufferCreated to ProducerSideService");
+  }
+  return write_succeeded;
+}
+
 void CaptureEventProducer::ConnectAndReceiveCommandsThread() {
   CHECK(producer_side_service_stub_ != nullptr);
 
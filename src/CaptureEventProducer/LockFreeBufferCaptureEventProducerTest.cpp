@@ -9,6 +9,7 @@
 #include <gtest/gtest.h>
 #include <stdint.h>
 
+#include <atomic>
 #include <chrono>
 #include <memory>
 #include <optional>
@@ -27,11 +28,37 @@ namespace {
 
 class LockFreeBufferCaptureEventProducerImpl
     : public LockFreeBufferCaptureEventProducer<std::string> {
+ public:
+  // Behaves like a subclass that aggregates events: they are only forwarded at the end of the
+  // capture.
+  void HoldBackEventsUntilEndOfCapture() { hold_back_events_ = true; }
+
  protected:
   orbit_grpc_protos::ProducerCaptureEvent* TranslateIntermediateEvent(
       std::string&& /*intermediate_event*/, google::protobuf::Arena* arena) override {
     return google::protobuf::Arena::CreateMessage<orbit_grpc_protos::ProducerCaptureEvent>(arena);
   }
+
+  size_t ProcessDequeuedIntermediateEvents(std::vector<std::string>* events, size_t event_count,
+                                           bool is_last_call_of_capture) override {
+    if (!hold_back_events_) {
+      return event_count;
+    }
+    held_back_event_count_ += event_count;
+    if (!is_last_call_of_capture) {
+      return 0;
+    }
+    size_t forwarded_event_count = held_back_event_count_;
+    held_back_event_count_ = 0;
+    if (events->size() < forwarded_event_count) {
+      events->resize(forwarded_event_count);
+    }
+    return forwarded_event_count;
+  }
+
+ private:
+  std::atomic<bool> hold_back_events_ = false;
+  size_t held_back_event_count_ = 0;
 };
 
 class LockFreeBufferCaptureEventProducerTest : public ::testing::Test {
@@ -404,4 +431,130 @@ TEST_F(LockFreeBufferCaptureEventProducerTest, DisconnectAndReconnect) {
   EXPECT_FALSE(buffer_producer_->IsCapturing());
 }
 
+TEST_F(LockFreeBufferCaptureEventProducerTest, BoundedQueueDropsAndReportsEvents) {
+  orbit_grpc_protos::CaptureOptions capture_options;
+  capture_options.set_producer_side_max_buffered_events(1);
+  fake_service_->SendStartCaptureCommand(capture_options);
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  EXPECT_TRUE(buffer_producer_->IsCapturing());
+
+  int32_t capture_events_received_count = 0;
+  int32_t warning_events_received_count = 0;
+  ON_CALL(*fake_service_, OnCaptureEventsReceived)
+      .WillByDefault([&capture_events_received_count, &warning_events_received_count](
+                         const std::vector<orbit_grpc_protos::ProducerCaptureEvent>& events) {
+        for (const orbit_grpc_protos::ProducerCaptureEvent& event : events) {
+          if (event.has_warning_event()) {
+            ++warning_events_received_count;
+          } else {
+            ++capture_events_received_count;
+          }
+        }
+      });
+  EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(::testing::AtLeast(1));
+  EXPECT_CALL(*fake_service_, OnAllEventsSentReceived).Times(1);
+
+  // The forwarder thread can't keep up with a queue of one event.
+  constexpr int32_t kEnqueuedEventCount = 1000;
+  int32_t accepted_event_count = 0;
+  for (int32_t i = 0; i < kEnqueuedEventCount; ++i) {
+    if (buffer_producer_->EnqueueIntermediateEvent("")) {
+      ++accepted_event_count;
+    }
+  }
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  fake_service_->SendStopCaptureCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+
+  EXPECT_GE(capture_events_received_count, 1);
+  EXPECT_LT(capture_events_received_count, kEnqueuedEventCount);
+  // Exactly the events that were not rejected are sent.
+  EXPECT_EQ(capture_events_received_count, accepted_event_count);
+  EXPECT_EQ(warning_events_received_count, 1);
+
+  ::testing::Mock::VerifyAndClearExpectations(&*fake_service_);
+
+  fake_service_->SendCaptureFinishedCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+}
+
+TEST_F(LockFreeBufferCaptureEventProducerTest, EventsFromThreadsThatExitedAreSent) {
+  fake_service_->SendStartCaptureCommand(orbit_grpc_protos::CaptureOptions{});
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  EXPECT_TRUE(buffer_producer_->IsCapturing());
+
+  int32_t capture_events_received_count = 0;
+  ON_CALL(*fake_service_, OnCaptureEventsReceived)
+      .WillByDefault([&capture_events_received_count](
+                         const std::vector<orbit_grpc_protos::ProducerCaptureEvent>& events) {
+        capture_events_received_count += events.size();
+      });
+  EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(::testing::AtLeast(1));
+  EXPECT_CALL(*fake_service_, OnAllEventsSentReceived).Times(1);
+
+  // Each thread enqueues through its own ProducerToken, which is released when the thread exits,
+  // possibly before the forwarder thread has dequeued its events.
+  constexpr int32_t kThreadCount = 8;
+  constexpr int32_t kEventCountPerThread = 100;
+  std::vector<std::thread> threads;
+  for (int32_t i = 0; i < kThreadCount; ++i) {
+    threads.emplace_back([this] {
+      for (int32_t j = 0; j < kEventCountPerThread; ++j) {
+        EXPECT_TRUE(buffer_producer_->EnqueueIntermediateEvent(""));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  // Also enqueue from a thread that keeps its token.
+  EXPECT_TRUE(buffer_producer_->EnqueueIntermediateEvent(""));
+
+  fake_service_->SendStopCaptureCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  EXPECT_EQ(capture_events_received_count, kThreadCount * kEventCountPerThread + 1);
+
+  ::testing::Mock::VerifyAndClearExpectations(&*fake_service_);
+
+  fake_service_->SendCaptureFinishedCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+}
+
+TEST_F(LockFreeBufferCaptureEventProducerTest, EventsHeldBackBySubclassAreSentAtCaptureStop) {
+  buffer_producer_->HoldBackEventsUntilEndOfCapture();
+  fake_service_->SendStartCaptureCommand(orbit_grpc_protos::CaptureOptions{});
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  EXPECT_TRUE(buffer_producer_->IsCapturing());
+
+  int32_t capture_events_received_count = 0;
+  ON_CALL(*fake_service_, OnCaptureEventsReceived)
+      .WillByDefault([&capture_events_received_count](
+                         const std::vector<orbit_grpc_protos::ProducerCaptureEvent>& events) {
+        capture_events_received_count += events.size();
+      });
+
+  constexpr int32_t kEnqueuedEventCount = 20'000;
+  for (int32_t i = 0; i < kEnqueuedEventCount; ++i) {
+    EXPECT_TRUE(buffer_producer_->EnqueueIntermediateEvent(""));
+  }
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  EXPECT_EQ(capture_events_received_count, 0);
+
+  {
+    ::testing::InSequence in_sequence;
+    EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(1);
+    EXPECT_CALL(*fake_service_, OnAllEventsSentReceived).Times(1);
+  }
+  fake_service_->SendStopCaptureCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  // The events are sent in one batch, even if there are more than the forwarder thread dequeues at
+  // once.
+  EXPECT_EQ(capture_events_received_count, kEnqueuedEventCount);
+
+  ::testing::Mock::VerifyAndClearExpectations(&*fake_service_);
+
+  fake_service_->SendCaptureFinishedCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+}
+
 }  // namespace orbit_capture_event_producer
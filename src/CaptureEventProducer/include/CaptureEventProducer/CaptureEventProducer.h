@@ -10,8 +10,10 @@
 
 #include <atomic>
 #include <memory>
+#include <string_view>
 #include <thread>
 
+#include "ProducerSideChannel/ProducerSideChannel.h"
 #include "absl/synchronization/mutex.h"
 #include "capture.pb.h"
 #include "producer_side_services.grpc.pb.h"
@@ -59,6 +61,14 @@ class CaptureEventProducer {
   // Subclasses should use this method to notify the ProducerSideService that
   // they have sent all their CaptureEvents after the capture has been stopped.
   [[nodiscard]] bool NotifyAllEventsSent();
+  // Subclasses that write their CaptureEvents to a SharedMemoryRingBuffer instead of sending them
+  // with SendCaptureEvents use this method to tell ProducerSideService where to read them from.
+  // The memfd `fd` of the ring buffer is passed to OrbitService on the Unix domain socket at
+  // `shared_memory_fd_socket_path`, and then announced on the gRPC stream.
+  [[nodiscard]] bool NotifySharedMemoryRingBufferCreated(
+      int32_t pid, int fd,
+      std::string_view shared_memory_fd_socket_path =
+          orbit_producer_side_channel::kProducerSideSharedMemoryFdSocketPath);
 
  private:
   void ConnectAndReceiveCommandsThread();
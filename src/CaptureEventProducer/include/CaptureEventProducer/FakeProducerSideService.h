@@ -41,6 +41,9 @@ class FakeProducerSideService : public orbit_grpc_protos::ProducerSideService::S
         case orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::kAllEventsSent:
           OnAllEventsSentReceived();
           break;
+        case orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::
+            kSharedMemoryRingBufferCreated:
+          break;
         case orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::EVENT_NOT_SET:
           break;
       }
@@ -5,12 +5,25 @@
 #ifndef CAPTURE_EVENT_PRODUCER_LOCK_FREE_BUFFER_CAPTURE_EVENT_PRODUCER_H_
 #define CAPTURE_EVENT_PRODUCER_LOCK_FREE_BUFFER_CAPTURE_EVENT_PRODUCER_H_
 
+#include <absl/base/optimization.h>
+#include <absl/container/flat_hash_set.h>
+#include <absl/strings/str_format.h>
+#include <absl/synchronization/mutex.h>
+#include <absl/time/time.h>
 #include <google/protobuf/arena.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
 #include "CaptureEventProducer/CaptureEventProducer.h"
 #include "OrbitBase/Logging.h"
 #include "OrbitBase/MakeUniqueForOverwrite.h"
+#include "OrbitBase/Profiling.h"
 #include "OrbitBase/ThreadUtils.h"
+#include "SharedMemoryTransport/SharedMemoryRingBuffer.h"
 #include "concurrentqueue.h"
 
 namespace orbit_capture_event_producer {
@@ -31,9 +44,23 @@ namespace orbit_capture_event_producer {
 // In particular, when hundreds of thousands of events are produced per second, it is recommended
 // that IntermediateEventT not be a protobuf or another type that involves heap allocations, as the
 // cost of dynamic allocations and de-allocations can add up quickly.
+//
+// The thread reading from the queue parks when the queue is empty, and is woken up by the
+// producing threads when enough events have been enqueued, or after a short timeout. With
+// `producer_side_max_buffered_events` in the CaptureOptions, the queue is bounded: events enqueued
+// while it is full are dropped, and their number is reported with a WarningEvent.
+//
+// Subclasses can rewrite the events that the thread dequeues before they are forwarded, for example
+// to aggregate them, by overriding ProcessDequeuedIntermediateEvents.
+//
+// Subclasses can also support writing IntermediateEventT directly to a SharedMemoryRingBuffer read
+// by OrbitService, skipping ProducerCaptureEvents and gRPC altogether for the events. This is used
+// when the CaptureOptions have `producer_side_shared_memory` set.
 template <typename IntermediateEventT>
 class LockFreeBufferCaptureEventProducer : public CaptureEventProducer {
  public:
+  ~LockFreeBufferCaptureEventProducer() override { ReleaseThreadProducerTokens(); }
+
   void BuildAndStart(const std::shared_ptr<grpc::Channel>& channel) final {
     CaptureEventProducer::BuildAndStart(channel);
 
@@ -42,6 +69,7 @@ class LockFreeBufferCaptureEventProducer : public CaptureEventProducer {
 
   void ShutdownAndWait() final {
     shutdown_requested_ = true;
+    WakeUpForwarderThread();
 
     CHECK(forwarder_thread_.joinable());
     forwarder_thread_.join();
@@ -49,38 +77,63 @@ class LockFreeBufferCaptureEventProducer : public CaptureEventProducer {
     CaptureEventProducer::ShutdownAndWait();
   }
 
-  void EnqueueIntermediateEvent(const IntermediateEventT& event) {
-    lock_free_queue_.enqueue(event);
+  // Returns false if the event was dropped because the queue was full.
+  bool EnqueueIntermediateEvent(const IntermediateEventT& event) {
+    if (!TryReserveSlotInQueue()) {
+      return false;
+    }
+    lock_free_queue_.enqueue(GetThreadProducerToken(), event);
+    return true;
   }
 
-  void EnqueueIntermediateEvent(IntermediateEventT&& event) {
-    lock_free_queue_.enqueue(std::move(event));
+  bool EnqueueIntermediateEvent(IntermediateEventT&& event) {
+    if (!TryReserveSlotInQueue()) {
+      return false;
+    }
+    lock_free_queue_.enqueue(GetThreadProducerToken(), std::move(event));
+    return true;
   }
 
+  // Returns whether a capture is in progress, even if the event was dropped because the queue was
+  // full (in which case event_builder_if_capturing is not called).
   bool EnqueueIntermediateEventIfCapturing(
       const std::function<IntermediateEventT()>& event_builder_if_capturing) {
     if (IsCapturing()) {
-      lock_free_queue_.enqueue(event_builder_if_capturing());
+      if (TryReserveSlotInQueue()) {
+        lock_free_queue_.enqueue(GetThreadProducerToken(), event_builder_if_capturing());
+      }
       return true;
     }
     return false;
   }
 
  protected:
-  void OnCaptureStart(orbit_grpc_protos::CaptureOptions /*capture_options*/) override {
-    absl::MutexLock lock{&status_mutex_};
+  // These are all called from the thread that receives the commands. The forwarder thread reads
+  // status_ without locking: the other settings of the capture are stored before status_.
+  void OnCaptureStart(orbit_grpc_protos::CaptureOptions capture_options) override {
+    // Events enqueued outside of a capture are dropped, but the forwarder thread could still be
+    // parked with some of them in the queue: drop them here, or they would be sent.
+    DiscardQueuedEvents();
+    use_shared_memory_ring_buffer_ = capture_options.producer_side_shared_memory() &&
+                                     CanWriteIntermediateEventsToSharedMemory();
+    max_buffered_event_count_ = capture_options.producer_side_max_buffered_events();
+    dropped_event_count_ = 0;
+    ++capture_count_;
     status_ = ProducerStatus::kShouldSendEvents;
+    // The forwarder thread could be parked with the longer timeout used outside of captures.
+    WakeUpForwarderThread();
   }
 
   void OnCaptureStop() override {
-    absl::MutexLock lock{&status_mutex_};
     status_ = ProducerStatus::kShouldNotifyAllEventsSent;
+    WakeUpForwarderThread();
   }
 
-  void OnCaptureFinished() override {
-    absl::MutexLock lock{&status_mutex_};
-    status_ = ProducerStatus::kShouldDropEvents;
-  }
+  void OnCaptureFinished() override { status_ = ProducerStatus::kShouldDropEvents; }
+
+  // Incremented at the start of each capture, before the events enqueued from then on are
+  // forwarded. Subclasses can use it to reset per-capture state kept by the producing threads.
+  [[nodiscard]] uint64_t GetCaptureCount() const { return capture_count_; }
 
   // Subclasses need to implement this method to convert an `IntermediateEventT` enqueued in the
   // internal lock-free buffer to a `CaptureEvent` to be sent to ProducerSideService.
@@ -95,6 +148,28 @@ class LockFreeBufferCaptureEventProducer : public CaptureEventProducer {
   [[nodiscard]] virtual orbit_grpc_protos::ProducerCaptureEvent* TranslateIntermediateEvent(
       IntermediateEventT&& intermediate_event, google::protobuf::Arena* arena) = 0;
 
+  // Called by the forwarder thread with the `event_count` events it just dequeued at the start of
+  // `events`, before they are forwarded. Subclasses can replace, remove or add events, and return
+  // how many events from the start of `events` need to be forwarded. This is also called
+  // periodically with no events while a capture is in progress, and with
+  // `is_last_call_of_capture` set right before AllEventsSent is sent, so that events held back by
+  // the subclass can still be forwarded.
+  [[nodiscard]] virtual size_t ProcessDequeuedIntermediateEvents(
+      std::vector<IntermediateEventT>* /*events*/, size_t event_count,
+      bool /*is_last_call_of_capture*/) {
+    return event_count;
+  }
+
+  // Subclasses that can write an `IntermediateEventT` as a record of a SharedMemoryRingBuffer, in
+  // one of the formats of SharedMemoryTransport/ProducerEventRecords.h, override these two methods.
+  // TryWriteIntermediateEventToSharedMemory returns false if the ring buffer is full.
+  [[nodiscard]] virtual bool CanWriteIntermediateEventsToSharedMemory() const { return false; }
+  [[nodiscard]] virtual bool TryWriteIntermediateEventToSharedMemory(
+      const IntermediateEventT& /*intermediate_event*/,
+      orbit_shared_memory_transport::SharedMemoryRingBuffer* /*ring_buffer*/) {
+    UNREACHABLE();
+  }
+
  private:
   void ForwarderThread() {
     orbit_base::SetCurrentThreadName("ForwarderThread");
@@ -114,35 +189,52 @@ class LockFreeBufferCaptureEventProducer : public CaptureEventProducer {
       while (true) {
         size_t dequeued_event_count =
             lock_free_queue_.try_dequeue_bulk(dequeued_events.begin(), kMaxEventsPerRequest);
+        ReleaseSlotsInQueue(dequeued_event_count);
         bool queue_was_emptied = dequeued_event_count < kMaxEventsPerRequest;
 
-        ProducerStatus current_status;
-        {
-          absl::MutexLock lock{&status_mutex_};
-          current_status = status_;
-          if (status_ == ProducerStatus::kShouldNotifyAllEventsSent && queue_was_emptied) {
-            // We are about to send AllEventsSent: update status_ while we hold the mutex.
-            status_ = ProducerStatus::kShouldDropEvents;
-          }
+        ProducerStatus current_status = status_;
+        if (current_status == ProducerStatus::kShouldNotifyAllEventsSent && queue_was_emptied) {
+          // We are about to send AllEventsSent: update status_, unless it was changed in the
+          // meantime, in which case current_status receives the new value.
+          status_.compare_exchange_strong(current_status, ProducerStatus::kShouldDropEvents);
         }
-
-        if ((current_status == ProducerStatus::kShouldSendEvents ||
-             current_status == ProducerStatus::kShouldNotifyAllEventsSent) &&
-            dequeued_event_count > 0) {
+        const bool use_shared_memory_ring_buffer = use_shared_memory_ring_buffer_;
+        const uint64_t capture_count = capture_count_;
+
+        size_t forwarded_event_count = 0;
+        if (current_status == ProducerStatus::kShouldSendEvents ||
+            current_status == ProducerStatus::kShouldNotifyAllEventsSent) {
+          forwarded_event_count = ProcessDequeuedIntermediateEvents(
+              &dequeued_events, dequeued_event_count,
+              current_status == ProducerStatus::kShouldNotifyAllEventsSent && queue_was_emptied);
+        }
+        const bool should_forward_events = forwarded_event_count > 0;
+
+        if (should_forward_events && use_shared_memory_ring_buffer) {
+          orbit_shared_memory_transport::SharedMemoryRingBuffer* ring_buffer =
+              GetAnnouncedSharedMemoryRingBuffer(capture_count);
+          if (ring_buffer != nullptr) {
+            WriteIntermediateEventsToSharedMemory(dequeued_events, forwarded_event_count,
+                                                  ring_buffer);
+          } else {
+            ERROR("Dropping %lu CaptureEvents as the shared memory ring buffer is not available",
+                  forwarded_event_count);
+          }
+        } else if (should_forward_events) {
           google::protobuf::Arena arena{arena_options};
           auto* send_request = google::protobuf::Arena::CreateMessage<
               orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest>(&arena);
           auto* capture_events =
               send_request->mutable_buffered_capture_events()->mutable_capture_events();
-          capture_events->Reserve(dequeued_event_count);
+          capture_events->Reserve(forwarded_event_count);
 
-          for (size_t i = 0; i < dequeued_event_count; ++i) {
+          for (size_t i = 0; i < forwarded_event_count; ++i) {
             capture_events->AddAllocated(
                 TranslateIntermediateEvent(std::move(dequeued_events[i]), &arena));
           }
 
           if (!SendCaptureEvents(*send_request)) {
-            ERROR("Forwarding %lu CaptureEvents", dequeued_event_count);
+            ERROR("Forwarding %lu CaptureEvents", forwarded_event_count);
             break;
           }
         }
@@ -150,6 +242,7 @@ class LockFreeBufferCaptureEventProducer : public CaptureEventProducer {
         if (current_status == ProducerStatus::kShouldNotifyAllEventsSent && queue_was_emptied) {
           // lock_free_queue_ is now empty and status_ == kShouldNotifyAllEventsSent,
           // send AllEventsSent. status_ has already been changed to kShouldDropEvents.
+          SendDroppedEventsWarningIfAny();
           if (!NotifyAllEventsSent()) {
             ERROR("Notifying that all CaptureEvents have been sent");
           }
@@ -164,21 +257,243 @@ class LockFreeBufferCaptureEventProducer : public CaptureEventProducer {
         }
       }
 
-      static constexpr std::chrono::duration kSleepOnEmptyQueue = std::chrono::microseconds{1000};
-      // Wait for lock_free_queue_ to fill up with new CaptureEvents.
-      std::this_thread::sleep_for(kSleepOnEmptyQueue);
+      WaitForEventsInQueue();
+    }
+  }
+
+  // Called before each enqueue. Returns false if the event must be dropped as the queue is full.
+  // Wakes up the forwarder thread when kWakeUpThreshold events are waiting.
+  // When the queue is unbounded, the shared counter is not touched at all, as every producing
+  // thread incrementing the same cache line is what limits scaling. Each thread then only counts
+  // its own enqueues, and wakes up the forwarder thread every kWakeUpThreshold of them.
+  bool TryReserveSlotInQueue() {
+    const uint64_t max_buffered_event_count = max_buffered_event_count_;
+    if (max_buffered_event_count == 0) {
+      thread_local uint64_t enqueued_event_count_since_wake_up = 0;
+      if (++enqueued_event_count_since_wake_up == kWakeUpThreshold) {
+        enqueued_event_count_since_wake_up = 0;
+        WakeUpForwarderThread();
+      }
+      return true;
+    }
+
+    const uint64_t previous_count = buffered_event_count_.fetch_add(1, std::memory_order_relaxed);
+    if (previous_count >= max_buffered_event_count) {
+      buffered_event_count_.fetch_sub(1, std::memory_order_relaxed);
+      dropped_event_count_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    if (previous_count + 1 == kWakeUpThreshold) {
+      WakeUpForwarderThread();
     }
+    return true;
+  }
+
+  // Saturates at zero, as events enqueued while the queue was unbounded were never counted.
+  void ReleaseSlotsInQueue(uint64_t event_count) {
+    uint64_t current_count = buffered_event_count_.load(std::memory_order_relaxed);
+    while (current_count > 0 &&
+           !buffered_event_count_.compare_exchange_weak(
+               current_count, current_count - std::min(current_count, event_count),
+               std::memory_order_relaxed)) {
+    }
+  }
+
+  // The queue allows multiple consumers, so this can run concurrently with the forwarder thread.
+  void DiscardQueuedEvents() {
+    constexpr size_t kMaxEventsPerDequeue = 256;
+    std::vector<IntermediateEventT> discarded_events(kMaxEventsPerDequeue);
+    size_t discarded_event_count;
+    do {
+      discarded_event_count =
+          lock_free_queue_.try_dequeue_bulk(discarded_events.begin(), kMaxEventsPerDequeue);
+      ReleaseSlotsInQueue(discarded_event_count);
+    } while (discarded_event_count == kMaxEventsPerDequeue);
+  }
+
+  // Enqueuing through a ProducerToken skips the lookup of the calling thread's implicit producer
+  // in the hash table of the queue, which otherwise dominates the cost of an enqueue. Each thread
+  // creates its token on its first enqueue. As the tokens are thread_local, they are released
+  // either when their thread exits or when this object is destroyed, whichever comes first: events
+  // that a thread enqueued before exiting are still dequeued normally.
+  struct ThreadProducerToken {
+    ~ThreadProducerToken() {
+      absl::MutexLock lock{&thread_producer_tokens_mutex_};
+      LockFreeBufferCaptureEventProducer* current_owner = owner.load(std::memory_order_relaxed);
+      if (current_owner != nullptr) {
+        current_owner->thread_producer_tokens_.erase(this);
+        token.reset();
+      }
+    }
+
+    std::atomic<LockFreeBufferCaptureEventProducer*> owner = nullptr;
+    std::unique_ptr<moodycamel::ProducerToken> token;
+  };
+
+  moodycamel::ProducerToken& GetThreadProducerToken() {
+    thread_local ThreadProducerToken thread_producer_token;
+    if (ABSL_PREDICT_FALSE(thread_producer_token.owner.load(std::memory_order_relaxed) != this)) {
+      RegisterThreadProducerToken(&thread_producer_token);
+    }
+    return *thread_producer_token.token;
+  }
+
+  // Also called when the thread enqueues to a different instance, as there is one
+  // ThreadProducerToken per thread and IntermediateEventT.
+  void RegisterThreadProducerToken(ThreadProducerToken* thread_producer_token) {
+    absl::MutexLock lock{&thread_producer_tokens_mutex_};
+    LockFreeBufferCaptureEventProducer* previous_owner =
+        thread_producer_token->owner.load(std::memory_order_relaxed);
+    if (previous_owner != nullptr) {
+      previous_owner->thread_producer_tokens_.erase(thread_producer_token);
+      thread_producer_token->token.reset();
+    }
+    thread_producer_token->token = std::make_unique<moodycamel::ProducerToken>(lock_free_queue_);
+    thread_producer_token->owner.store(this, std::memory_order_relaxed);
+    thread_producer_tokens_.insert(thread_producer_token);
+  }
+
+  void ReleaseThreadProducerTokens() {
+    absl::MutexLock lock{&thread_producer_tokens_mutex_};
+    for (ThreadProducerToken* thread_producer_token : thread_producer_tokens_) {
+      thread_producer_token->token.reset();
+      thread_producer_token->owner.store(nullptr, std::memory_order_relaxed);
+    }
+    thread_producer_tokens_.clear();
+  }
+
+  void WakeUpForwarderThread() {
+    absl::MutexLock lock{&wake_up_mutex_};
+    wake_up_requested_ = true;
+  }
+
+  // Spins for a short time first, as under load new events arrive immediately, then parks until
+  // WakeUpForwarderThread is called. The timeout bounds the latency of events that arrive slowly.
+  // It's longer outside of captures, where the events are dropped anyway.
+  void WaitForEventsInQueue() {
+    static constexpr std::chrono::duration kSpinDuration = std::chrono::microseconds{50};
+    static constexpr absl::Duration kMaxParkDurationWhileCapturing = absl::Milliseconds(5);
+    static constexpr absl::Duration kMaxParkDurationOtherwise = absl::Milliseconds(100);
+
+    const auto spin_end = std::chrono::steady_clock::now() + kSpinDuration;
+    while (std::chrono::steady_clock::now() < spin_end) {
+      if (buffered_event_count_.load(std::memory_order_relaxed) > 0 ||
+          (max_buffered_event_count_ == 0 && lock_free_queue_.size_approx() > 0)) {
+        return;
+      }
+      std::this_thread::yield();
+    }
+
+    absl::MutexLock lock{&wake_up_mutex_};
+    wake_up_mutex_.AwaitWithTimeout(absl::Condition(&wake_up_requested_),
+                                    status_ == ProducerStatus::kShouldDropEvents
+                                        ? kMaxParkDurationOtherwise
+                                        : kMaxParkDurationWhileCapturing);
+    wake_up_requested_ = false;
+  }
+
+  void SendDroppedEventsWarningIfAny() {
+    const uint64_t dropped_event_count = dropped_event_count_.exchange(0);
+    if (dropped_event_count == 0) {
+      return;
+    }
+    ERROR("Dropped %lu CaptureEvents as the producer's buffer was full", dropped_event_count);
+    orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest send_request;
+    orbit_grpc_protos::WarningEvent* warning_event = send_request.mutable_buffered_capture_events()
+                                                         ->add_capture_events()
+                                                         ->mutable_warning_event();
+    warning_event->set_timestamp_ns(orbit_base::CaptureTimestampNs());
+    warning_event->set_message(absl::StrFormat(
+        "A producer in process %d dropped %lu events as its buffer of %lu events was full.",
+        orbit_base::GetCurrentProcessIdNative(), dropped_event_count,
+        max_buffered_event_count_.load()));
+    if (!SendCaptureEvents(send_request)) {
+      ERROR("Sending WarningEvent about dropped CaptureEvents");
+    }
+  }
+
+  // Returns the ring buffer to write the events of the current capture to, after creating it if
+  // needed and notifying ProducerSideService of it once per capture (as the connection could have
+  // changed in between), or nullptr if either failed.
+  orbit_shared_memory_transport::SharedMemoryRingBuffer* GetAnnouncedSharedMemoryRingBuffer(
+      uint64_t capture_count) {
+    if (shared_memory_ring_buffer_ == nullptr) {
+      constexpr uint64_t kSharedMemoryRingBufferCapacity = 16 * 1024 * 1024;
+      auto ring_buffer_or_error = orbit_shared_memory_transport::SharedMemoryRingBuffer::Create(
+          kSharedMemoryRingBufferCapacity);
+      if (ring_buffer_or_error.has_error()) {
+        ERROR("Creating shared memory ring buffer: %s", ring_buffer_or_error.error().message());
+        return nullptr;
+      }
+      shared_memory_ring_buffer_ = std::move(ring_buffer_or_error.value());
+    }
+
+    if (shared_memory_ring_buffer_announced_capture_count_ != capture_count) {
+      if (!NotifySharedMemoryRingBufferCreated(orbit_base::GetCurrentProcessIdNative(),
+                                               shared_memory_ring_buffer_->GetFd())) {
+        return nullptr;
+      }
+      shared_memory_ring_buffer_announced_capture_count_ = capture_count;
+    }
+    return shared_memory_ring_buffer_.get();
+  }
+
+  // Waits for the reader to make space when the ring buffer is full, as the service drains it
+  // continuously, but gives up on the remaining events if that doesn't happen in reasonable time.
+  // The wait is bounded for the whole batch, not for each event, and blocks on a futex that the
+  // reader signals when it frees space, rather than polling.
+  void WriteIntermediateEventsToSharedMemory(
+      const std::vector<IntermediateEventT>& events, size_t event_count,
+      orbit_shared_memory_transport::SharedMemoryRingBuffer* ring_buffer) {
+    static constexpr absl::Duration kMaxWaitOnFullRingBuffer = absl::Seconds(1);
+    const absl::Time deadline = absl::Now() + kMaxWaitOnFullRingBuffer;
+    for (size_t i = 0; i < event_count; ++i) {
+      while (!TryWriteIntermediateEventToSharedMemory(events[i], ring_buffer)) {
+        ring_buffer->NotifyReader();
+        const absl::Duration remaining_wait = deadline - absl::Now();
+        if (shutdown_requested_ || remaining_wait <= absl::ZeroDuration() ||
+            !ring_buffer->WaitForFreeSpace(remaining_wait)) {
+          ERROR("Dropping %lu CaptureEvents as the shared memory ring buffer is full",
+                event_count - i);
+          ring_buffer->NotifyReader();
+          return;
+        }
+      }
+    }
+    ring_buffer->NotifyReader();
   }
 
  private:
   moodycamel::ConcurrentQueue<IntermediateEventT> lock_free_queue_;
 
+  // Global rather than per instance, as exiting threads can't know whether their owner still
+  // exists.
+  ABSL_CONST_INIT static inline absl::Mutex thread_producer_tokens_mutex_{absl::kConstInit};
+  absl::flat_hash_set<ThreadProducerToken*> thread_producer_tokens_
+      ABSL_GUARDED_BY(thread_producer_tokens_mutex_);
+
   std::thread forwarder_thread_;
   std::atomic<bool> shutdown_requested_ = false;
 
   enum class ProducerStatus { kShouldSendEvents, kShouldNotifyAllEventsSent, kShouldDropEvents };
-  ProducerStatus status_ = ProducerStatus::kShouldDropEvents;
-  absl::Mutex status_mutex_;
+  std::atomic<ProducerStatus> status_ = ProducerStatus::kShouldDropEvents;
+  std::atomic<bool> use_shared_memory_ring_buffer_ = false;
+  std::atomic<uint64_t> capture_count_ = 0;
+
+  // Number of events in lock_free_queue_ (approximately, as the forwarder thread only updates it
+  // after dequeuing), used both to bound the queue and to wake up the forwarder thread. Only
+  // maintained while max_buffered_event_count_ is not zero.
+  static constexpr uint64_t kWakeUpThreshold = 1024;
+  std::atomic<uint64_t> buffered_event_count_ = 0;
+  std::atomic<uint64_t> max_buffered_event_count_ = 0;
+  std::atomic<uint64_t> dropped_event_count_ = 0;
+
+  bool wake_up_requested_ ABSL_GUARDED_BY(wake_up_mutex_) = false;
+  absl::Mutex wake_up_mutex_;
+
+  // Only accessed by the forwarder thread.
+  std::unique_ptr<orbit_shared_memory_transport::SharedMemoryRingBuffer> shared_memory_ring_buffer_;
+  uint64_t shared_memory_ring_buffer_announced_capture_count_ = 0;
 };
 
 }  // namespace orbit_capture_event_producer
@@ -22,8 +22,8 @@ void CallstackData::AddCallstackEvent(CallstackEvent callstack_event) {
   std::lock_guard lock(mutex_);
   CHECK(unique_callstacks_.contains(callstack_event.callstack_id()));
   RegisterTime(callstack_event.time());
-  callstack_events_by_tid_[callstack_event.thread_id()][callstack_event.time()] =
-      std::move(callstack_event);
+  callstack_events_by_tid_[callstack_event.thread_id()].Add(callstack_event.time(),
+                                                           callstack_event.callstack_id());
 }
 
 void CallstackData::RegisterTime(uint64_t time) {
@@ -49,19 +49,11 @@ uint32_t CallstackData::GetCallstackEventsCount() const {
 
 std::vector<orbit_client_protos::CallstackEvent> CallstackData::GetCallstackEventsInTimeRange(
     uint64_t time_begin, uint64_t time_end) const {
-  std::lock_guard lock(mutex_);
   std::vector<CallstackEvent> callstack_events;
-  for (const auto& tid_and_events : callstack_events_by_tid_) {
-    const std::map<uint64_t, CallstackEvent>& events = tid_and_events.second;
-    for (auto event_it = events.lower_bound(time_begin); event_it != events.end(); ++event_it) {
-      uint64_t time = event_it->first;
-      if (time < time_end) {
-        callstack_events.push_back(event_it->second);
-      } else {
-        break;
-      }
-    }
-  }
+  if (time_begin >= time_end) return callstack_events;
+  ForEachCallstackEventInTimeRange(
+      time_begin, time_end - 1,
+      [&callstack_events](const CallstackEvent& event) { callstack_events.push_back(event); });
   return callstack_events;
 }
 
@@ -76,33 +68,25 @@ uint32_t CallstackData::GetCallstackEventsOfTidCount(uint32_t thread_id) const {
 
 std::vector<CallstackEvent> CallstackData::GetCallstackEventsOfTidInTimeRange(
     uint32_t tid, uint64_t time_begin, uint64_t time_end) const {
-  std::lock_guard lock(mutex_);
   std::vector<CallstackEvent> callstack_events;
-
-  auto tid_and_events_it = callstack_events_by_tid_.find(tid);
-  if (tid_and_events_it == callstack_events_by_tid_.end()) {
-    return callstack_events;
-  }
-
-  const std::map<uint64_t, CallstackEvent>& events = tid_and_events_it->second;
-  for (auto event_it = events.lower_bound(time_begin); event_it != events.end(); ++event_it) {
-    uint64_t time = event_it->first;
-    if (time < time_end) {
-      callstack_events.push_back(event_it->second);
-    } else {
-      break;
-    }
-  }
+  if (time_begin >= time_end) return callstack_events;
+  ForEachCallstackEventOfTidInTimeRange(
+      tid, time_begin, time_end - 1,
+      [&callstack_events](const CallstackEvent& event) { callstack_events.push_back(event); });
   return callstack_events;
 }
 
 void CallstackData::ForEachCallstackEvent(
     const std::function<void(const orbit_client_protos::CallstackEvent&)>& action) const {
   std::lock_guard lock(mutex_);
-  for (const auto& [unused_tid, events] : callstack_events_by_tid_) {
-    for (const auto& [unused_timestamp, event] : events) {
+  CallstackEvent event;
+  for (const auto& [tid, events] : callstack_events_by_tid_) {
+    event.set_thread_id(tid);
+    events.ForEach([&event, &action](uint64_t timestamp, uint64_t callstack_id) {
+      event.set_time(timestamp);
+      event.set_callstack_id(callstack_id);
       action(event);
-    }
+    });
   }
 }
 
@@ -111,11 +95,15 @@ void CallstackData::ForEachCallstackEventInTimeRange(
     const std::function<void(const orbit_client_protos::CallstackEvent&)>& action) const {
   std::lock_guard lock(mutex_);
   CHECK(min_timestamp <= max_timestamp);
-  for (const auto& [unused_tid, events] : callstack_events_by_tid_) {
-    for (auto event_it = events.lower_bound(min_timestamp);
-         event_it != events.upper_bound(max_timestamp); ++event_it) {
-      action(event_it->second);
-    }
+  CallstackEvent event;
+  for (const auto& [tid, events] : callstack_events_by_tid_) {
+    event.set_thread_id(tid);
+    events.ForEachInTimeRange(min_timestamp, max_timestamp,
+                              [&event, &action](uint64_t timestamp, uint64_t callstack_id) {
+                                event.set_time(timestamp);
+                                event.set_callstack_id(callstack_id);
+                                action(event);
+                              });
   }
 }
 
@@ -128,11 +116,14 @@ void CallstackData::ForEachCallstackEventOfTidInTimeRange(
   if (tid_and_events_it == callstack_events_by_tid_.end()) {
     return;
   }
-  const auto& events = tid_and_events_it->second;
-  for (auto event_it = events.lower_bound(min_timestamp);
-       event_it != events.upper_bound(max_timestamp); ++event_it) {
-    action(event_it->second);
-  }
+  CallstackEvent event;
+  event.set_thread_id(tid);
+  tid_and_events_it->second.ForEachInTimeRange(
+      min_timestamp, max_timestamp, [&event, &action](uint64_t timestamp, uint64_t callstack_id) {
+        event.set_time(timestamp);
+        event.set_callstack_id(callstack_id);
+        action(event);
+      });
 }
 
 void CallstackData::AddCallstackFromKnownCallstackData(const CallstackEvent& event,
@@ -147,7 +138,7 @@ void CallstackData::AddCallstackFromKnownCallstackData(const CallstackEvent& eve
 
   // The insertion only happens if the hash isn't already present.
   unique_callstacks_.emplace(callstack_id, std::move(unique_callstack));
-  callstack_events_by_tid_[event.thread_id()][event.time()] = CallstackEvent(event);
+  callstack_events_by_tid_[event.thread_id()].Add(event.time(), callstack_id);
 }
 
 const orbit_client_protos::CallstackInfo* CallstackData::GetCallstack(uint64_t callstack_id) const {
@@ -193,16 +184,16 @@ void CallstackData::UpdateCallstackTypeBasedOnMajorityStart() {
 
   absl::flat_hash_set<uint64_t> callstack_ids_to_filter;
 
-  for (auto& [tid, timestamps_and_callstack_events] : callstack_events_by_tid_) {
+  for (auto& [tid, callstack_events] : callstack_events_by_tid_) {
     uint64_t count_for_this_thread = 0;
 
     // Count the number of occurrences of each outer frame for this thread.
     absl::flat_hash_map<uint64_t, uint64_t> count_by_outer_frame;
-    for (const auto& [unused_timestamp_ns, event] : timestamps_and_callstack_events) {
-      const CallstackInfo& callstack = *unique_callstacks_.at(event.callstack_id());
+    callstack_events.ForEach([&](uint64_t /*timestamp_ns*/, uint64_t callstack_id) {
+      const CallstackInfo& callstack = *unique_callstacks_.at(callstack_id);
       CHECK(callstack.type() != CallstackInfo::kFilteredByMajorityOutermostFrame);
       if (callstack.type() != CallstackInfo::kComplete) {
-        continue;
+        return;
       }
       ++count_for_this_thread;
 
@@ -210,7 +201,7 @@ void CallstackData::UpdateCallstackTypeBasedOnMajorityStart() {
       CHECK(!frames.empty());
       uint64_t outer_frame = *frames.rbegin();
       ++count_by_outer_frame[outer_frame];
-    }
+    });
 
     // Find the outer frame with the most occurrences.
     if (count_by_outer_frame.empty()) {
@@ -240,19 +231,19 @@ void CallstackData::UpdateCallstackTypeBasedOnMajorityStart() {
     // doesn't match the (super)majority outer frame.
     // Note that if a CallstackEvent from another thread references a filtered CallstackInfo, that
     // CallstackEvent will also be affected.
-    for (const auto& [unused_timestamp_ns, event] : timestamps_and_callstack_events) {
-      const CallstackInfo& callstack = *unique_callstacks_.at(event.callstack_id());
+    callstack_events.ForEach([&](uint64_t /*timestamp_ns*/, uint64_t callstack_id) {
+      const CallstackInfo& callstack = *unique_callstacks_.at(callstack_id);
       CHECK(callstack.type() != CallstackInfo::kFilteredByMajorityOutermostFrame);
       if (callstack.type() != CallstackInfo::kComplete) {
-        continue;
+        return;
       }
 
-      const auto& frames = unique_callstacks_.at(event.callstack_id())->frames();
+      const auto& frames = callstack.frames();
       CHECK(!frames.empty());
       if (*frames.rbegin() != majority_outer_frame) {
-        callstack_ids_to_filter.insert(event.callstack_id());
+        callstack_ids_to_filter.insert(callstack_id);
       }
-    }
+    });
   }
 
   // Change the type of the recorded CallstackInfos.
@@ -264,13 +255,13 @@ void CallstackData::UpdateCallstackTypeBasedOnMajorityStart() {
 
   // Count how many CallstackEvents had their CallstackInfo affected by the type change.
   uint64_t affected_event_count = 0;
-  for (auto& [tid, timestamps_and_callstack_events] : callstack_events_by_tid_) {
-    for (const auto& [unused_timestamp_ns, event] : timestamps_and_callstack_events) {
-      if (unique_callstacks_.at(event.callstack_id())->type() ==
+  for (const auto& [unused_tid, callstack_events] : callstack_events_by_tid_) {
+    callstack_events.ForEach([&](uint64_t /*timestamp_ns*/, uint64_t callstack_id) {
+      if (unique_callstacks_.at(callstack_id)->type() ==
           CallstackInfo::kFilteredByMajorityOutermostFrame) {
         ++affected_event_count;
       }
-    }
+    });
   }
 
   uint32_t callstack_event_count = GetCallstackEventsCount();
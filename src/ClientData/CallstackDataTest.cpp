@@ -162,4 +162,73 @@ TEST(CallstackData, FilterCallstackEventsBasedOnMajorityStart) {
       testing::Pointwise(CallstackEventEq(), std::vector<CallstackEvent>{event8, event9, event10}));
 }
 
+TEST(CallstackData, CallstackEventsInTimeRange) {
+  CallstackData callstack_data;
+
+  const uint64_t cs_id = 12;
+  CallstackInfo cs;
+  cs.add_frames(0x10);
+  cs.set_type(CallstackInfo::kComplete);
+  callstack_data.AddUniqueCallstack(cs_id, cs);
+
+  const uint32_t tid1 = 42;
+  const uint32_t tid2 = 43;
+  auto make_event = [cs_id](uint64_t time, uint32_t tid) {
+    CallstackEvent event;
+    event.set_time(time);
+    event.set_thread_id(tid);
+    event.set_callstack_id(cs_id);
+    return event;
+  };
+  const CallstackEvent event1 = make_event(100, tid1);
+  const CallstackEvent event2 = make_event(200, tid1);
+  const CallstackEvent event3 = make_event(300, tid1);
+  const CallstackEvent event4 = make_event(150, tid2);
+  const CallstackEvent event5 = make_event(250, tid2);
+  // Add some of the events out of order.
+  callstack_data.AddCallstackEvent(event3);
+  callstack_data.AddCallstackEvent(event1);
+  callstack_data.AddCallstackEvent(event5);
+  callstack_data.AddCallstackEvent(event2);
+  callstack_data.AddCallstackEvent(event4);
+
+  EXPECT_EQ(callstack_data.GetCallstackEventsCount(), 5);
+  EXPECT_EQ(callstack_data.GetCallstackEventsOfTidCount(tid1), 3);
+  EXPECT_EQ(callstack_data.GetCallstackEventsOfTidCount(tid2), 2);
+  EXPECT_EQ(callstack_data.min_time(), 100);
+  EXPECT_EQ(callstack_data.max_time(), 300);
+
+  // The end of the range is exclusive.
+  EXPECT_THAT(callstack_data.GetCallstackEventsOfTidInTimeRange(tid1, 100, 300),
+              testing::Pointwise(CallstackEventEq(), std::vector<CallstackEvent>{event1, event2}));
+  EXPECT_THAT(callstack_data.GetCallstackEventsOfTidInTimeRange(tid1, 200, 200),
+              testing::IsEmpty());
+  EXPECT_THAT(callstack_data.GetCallstackEventsInTimeRange(150, 251),
+              testing::UnorderedPointwise(CallstackEventEq(),
+                                          std::vector<CallstackEvent>{event2, event4, event5}));
+
+  // The end of the range is inclusive.
+  std::vector<CallstackEvent> visited_events;
+  callstack_data.ForEachCallstackEventOfTidInTimeRange(
+      tid2, 150, 250,
+      [&visited_events](const CallstackEvent& event) { visited_events.push_back(event); });
+  EXPECT_THAT(visited_events,
+              testing::Pointwise(CallstackEventEq(), std::vector<CallstackEvent>{event4, event5}));
+
+  visited_events.clear();
+  callstack_data.ForEachCallstackEventInTimeRange(
+      200, 300,
+      [&visited_events](const CallstackEvent& event) { visited_events.push_back(event); });
+  EXPECT_THAT(visited_events,
+              testing::UnorderedPointwise(CallstackEventEq(),
+                                          std::vector<CallstackEvent>{event2, event3, event5}));
+
+  visited_events.clear();
+  callstack_data.ForEachCallstackEvent(
+      [&visited_events](const CallstackEvent& event) { visited_events.push_back(event); });
+  EXPECT_THAT(visited_events, testing::UnorderedPointwise(
+                                  CallstackEventEq(), std::vector<CallstackEvent>{
+                                                          event1, event2, event3, event4, event5}));
+}
+
 }  // namespace orbit_client_data
@@ -0,0 +1,72 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ClientData/CallstackEventColumns.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "OrbitBase/Logging.h"
+
+namespace orbit_client_data {
+
+void CallstackEventColumns::Add(uint64_t timestamp, uint64_t callstack_id) {
+  if (blocks_.empty() || blocks_.back().timestamps.back() < timestamp) {
+    if (blocks_.empty() || blocks_.back().timestamps.size() == kBlockSize) {
+      blocks_.emplace_back();
+    }
+    Block& last_block = blocks_.back();
+    last_block.timestamps.push_back(timestamp);
+    last_block.callstack_ids.push_back(callstack_id);
+    ++size_;
+    return;
+  }
+
+  // The event is not after all existing events, so there is an event with a timestamp not less
+  // than `timestamp`.
+  auto [block_index, index_in_block] = LowerBound(timestamp);
+  CHECK(block_index < blocks_.size());
+  Block* block = &blocks_[block_index];
+  if (block->timestamps[index_in_block] == timestamp) {
+    block->callstack_ids[index_in_block] = callstack_id;
+    return;
+  }
+
+  if (block->timestamps.size() == kBlockSize) {
+    constexpr size_t kHalfBlockSize = kBlockSize / 2;
+    Block second_half;
+    second_half.timestamps.assign(block->timestamps.begin() + kHalfBlockSize,
+                                  block->timestamps.end());
+    second_half.callstack_ids.assign(block->callstack_ids.begin() + kHalfBlockSize,
+                                     block->callstack_ids.end());
+    block->timestamps.resize(kHalfBlockSize);
+    block->callstack_ids.resize(kHalfBlockSize);
+    blocks_.insert(blocks_.begin() + block_index + 1, std::move(second_half));
+    if (index_in_block > kHalfBlockSize) {
+      ++block_index;
+      index_in_block -= kHalfBlockSize;
+    }
+    block = &blocks_[block_index];
+  }
+
+  block->timestamps.insert(block->timestamps.begin() + index_in_block, timestamp);
+  block->callstack_ids.insert(block->callstack_ids.begin() + index_in_block, callstack_id);
+  ++size_;
+}
+
+std::pair<size_t, size_t> CallstackEventColumns::LowerBound(uint64_t timestamp) const {
+  // The first block whose last event is not before `timestamp` contains the event we look for.
+  auto block_it = std::partition_point(
+      blocks_.begin(), blocks_.end(),
+      [timestamp](const Block& block) { return block.timestamps.back() < timestamp; });
+  if (block_it == blocks_.end()) {
+    return {blocks_.size(), 0};
+  }
+  auto timestamp_it =
+      std::lower_bound(block_it->timestamps.begin(), block_it->timestamps.end(), timestamp);
+  return {static_cast<size_t>(std::distance(blocks_.begin(), block_it)),
+          static_cast<size_t>(std::distance(block_it->timestamps.begin(), timestamp_it))};
+}
+
+}  // namespace orbit_client_data
@@ -0,0 +1,126 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "ClientData/CallstackEventColumns.h"
+
+using ::testing::ElementsAre;
+using ::testing::ElementsAreArray;
+using ::testing::IsEmpty;
+using ::testing::Pair;
+
+namespace orbit_client_data {
+
+namespace {
+
+[[nodiscard]] std::vector<std::pair<uint64_t, uint64_t>> GetEventsInTimeRange(
+    const CallstackEventColumns& columns, uint64_t min_timestamp, uint64_t max_timestamp) {
+  std::vector<std::pair<uint64_t, uint64_t>> events;
+  columns.ForEachInTimeRange(min_timestamp, max_timestamp,
+                             [&events](uint64_t timestamp, uint64_t callstack_id) {
+                               events.emplace_back(timestamp, callstack_id);
+                             });
+  return events;
+}
+
+[[nodiscard]] std::vector<std::pair<uint64_t, uint64_t>> GetAllEvents(
+    const CallstackEventColumns& columns) {
+  std::vector<std::pair<uint64_t, uint64_t>> events;
+  columns.ForEach([&events](uint64_t timestamp, uint64_t callstack_id) {
+    events.emplace_back(timestamp, callstack_id);
+  });
+  return events;
+}
+
+}  // namespace
+
+TEST(CallstackEventColumns, EmptyAndSize) {
+  CallstackEventColumns columns;
+  EXPECT_TRUE(columns.empty());
+  EXPECT_EQ(columns.size(), 0);
+  EXPECT_THAT(GetAllEvents(columns), IsEmpty());
+  EXPECT_THAT(GetEventsInTimeRange(columns, 0, std::numeric_limits<uint64_t>::max()), IsEmpty());
+
+  columns.Add(10, 1);
+  EXPECT_FALSE(columns.empty());
+  EXPECT_EQ(columns.size(), 1);
+
+  columns.Add(20, 2);
+  EXPECT_EQ(columns.size(), 2);
+}
+
+TEST(CallstackEventColumns, ForEachInTimeRange) {
+  CallstackEventColumns columns;
+  columns.Add(10, 1);
+  columns.Add(20, 2);
+  columns.Add(30, 3);
+
+  EXPECT_THAT(GetEventsInTimeRange(columns, 0, 9), IsEmpty());
+  EXPECT_THAT(GetEventsInTimeRange(columns, 10, 10), ElementsAre(Pair(10, 1)));
+  EXPECT_THAT(GetEventsInTimeRange(columns, 11, 29), ElementsAre(Pair(20, 2)));
+  EXPECT_THAT(GetEventsInTimeRange(columns, 15, 30), ElementsAre(Pair(20, 2), Pair(30, 3)));
+  EXPECT_THAT(GetEventsInTimeRange(columns, 31, 100), IsEmpty());
+  EXPECT_THAT(GetEventsInTimeRange(columns, 0, std::numeric_limits<uint64_t>::max()),
+              ElementsAre(Pair(10, 1), Pair(20, 2), Pair(30, 3)));
+}
+
+TEST(CallstackEventColumns, AddOutOfOrderAndDuplicates) {
+  CallstackEventColumns columns;
+  columns.Add(20, 2);
+  columns.Add(10, 1);
+  columns.Add(30, 3);
+  columns.Add(15, 4);
+  EXPECT_THAT(GetAllEvents(columns),
+              ElementsAre(Pair(10, 1), Pair(15, 4), Pair(20, 2), Pair(30, 3)));
+
+  // An event with the timestamp of an existing event replaces it.
+  columns.Add(15, 5);
+  columns.Add(30, 6);
+  EXPECT_EQ(columns.size(), 4);
+  EXPECT_THAT(GetAllEvents(columns),
+              ElementsAre(Pair(10, 1), Pair(15, 5), Pair(20, 2), Pair(30, 6)));
+}
+
+TEST(CallstackEventColumns, BehavesLikeMapAcrossManyBlocks) {
+  CallstackEventColumns columns;
+  std::map<uint64_t, uint64_t> expected;
+
+  // Mostly increasing timestamps with some events out of order, like samples from several cpus.
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<uint64_t> jitter(0, 20);
+  for (uint64_t i = 0; i < 10'000; ++i) {
+    const uint64_t timestamp = i * 10 + jitter(gen);
+    const uint64_t callstack_id = i;
+    columns.Add(timestamp, callstack_id);
+    expected[timestamp] = callstack_id;
+  }
+  // Also insert many events at the beginning, which repeatedly splits the first block.
+  for (uint64_t i = 0; i < 3'000; ++i) {
+    columns.Add(3'000 - i, i);
+    expected[3'000 - i] = i;
+  }
+
+  EXPECT_EQ(columns.size(), expected.size());
+  EXPECT_THAT(GetAllEvents(columns), ElementsAreArray(expected.begin(), expected.end()));
+
+  for (auto [min_timestamp, max_timestamp] :
+       std::vector<std::pair<uint64_t, uint64_t>>{{0, 0}, {1, 5'000}, {2'999, 3'001},
+                                                  {55'555, 77'777}, {99'000, 200'000}}) {
+    std::vector<std::pair<uint64_t, uint64_t>> expected_in_range(
+        expected.lower_bound(min_timestamp), expected.upper_bound(max_timestamp));
+    EXPECT_THAT(GetEventsInTimeRange(columns, min_timestamp, max_timestamp),
+                ElementsAreArray(expected_in_range));
+  }
+}
+
+}  // namespace orbit_client_data
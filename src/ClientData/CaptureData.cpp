@@ -105,6 +105,49 @@ void CaptureData::UpdateFunctionStats(uint64_t instrumented_function_id, uint64_
   }
 }
 
+void CaptureData::UpdateFunctionStats(
+    const orbit_grpc_protos::FunctionCallStats& function_call_stats) {
+  const uint64_t function_id = function_call_stats.function_id();
+  auto& function_call_stats_by_thread = function_call_stats_[function_id];
+  function_call_stats_by_thread.insert_or_assign(function_call_stats.tid(), function_call_stats);
+  RecomputeFunctionStatsFromFunctionCallStats(function_id, function_call_stats_by_thread);
+}
+
+void CaptureData::RecomputeFunctionStatsFromFunctionCallStats(
+    uint64_t instrumented_function_id,
+    const absl::flat_hash_map<uint32_t, orbit_grpc_protos::FunctionCallStats>&
+        function_call_stats_by_thread) {
+  FunctionStats stats;
+  double sum_of_squared_durations_ns = 0;
+  for (const auto& [unused_tid, thread_stats] : function_call_stats_by_thread) {
+    if (thread_stats.count() == 0) continue;
+    if (stats.count() == 0 || thread_stats.min_ns() < stats.min_ns()) {
+      stats.set_min_ns(thread_stats.min_ns());
+    }
+    stats.set_max_ns(std::max(stats.max_ns(), thread_stats.max_ns()));
+    stats.set_count(stats.count() + thread_stats.count());
+    stats.set_total_time_ns(stats.total_time_ns() + thread_stats.total_time_ns());
+    sum_of_squared_durations_ns += thread_stats.sum_of_squared_durations_ns();
+
+    auto* histogram = stats.mutable_duration_histogram();
+    for (int i = 0; i < thread_stats.duration_histogram_size(); ++i) {
+      if (i == histogram->size()) histogram->Add(0);
+      histogram->Set(i, histogram->Get(i) + thread_stats.duration_histogram(i));
+    }
+  }
+
+  if (stats.count() > 0) {
+    const double count = static_cast<double>(stats.count());
+    const double average_ns = static_cast<double>(stats.total_time_ns()) / count;
+    stats.set_average_time_ns(stats.total_time_ns() / stats.count());
+    // variance = E[x^2] - E[x]^2, which rounding can make slightly negative.
+    stats.set_variance_ns(
+        std::max(0.0, sum_of_squared_durations_ns / count - average_ns * average_ns));
+    stats.set_std_dev_ns(static_cast<uint64_t>(sqrt(stats.variance_ns())));
+  }
+  functions_stats_.insert_or_assign(instrumented_function_id, std::move(stats));
+}
+
 void CaptureData::AddFunctionStats(uint64_t instrumented_function_id,
                                    orbit_client_protos::FunctionStats stats) {
   functions_stats_.insert_or_assign(instrumented_function_id, std::move(stats));
@@ -142,6 +185,11 @@ void CaptureData::OnCaptureComplete(
       stats.set_std_dev_ns(static_cast<uint64_t>(sqrt(stats.variance_ns())));
     }
   }
+
+  // There are no timers for the functions captured with statistics only.
+  for (const auto& [function_id, function_call_stats_by_thread] : function_call_stats_) {
+    RecomputeFunctionStatsFromFunctionCallStats(function_id, function_call_stats_by_thread);
+  }
 }
 
 const InstrumentedFunction* CaptureData::GetInstrumentedFunctionById(uint64_t function_id) const {
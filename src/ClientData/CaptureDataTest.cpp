@@ -0,0 +1,85 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "ClientData/CaptureData.h"
+#include "capture.pb.h"
+#include "capture_data.pb.h"
+
+namespace orbit_client_data {
+
+namespace {
+
+constexpr uint64_t kFunctionId = 42;
+
+orbit_grpc_protos::FunctionCallStats MakeFunctionCallStats(uint32_t tid,
+                                                           const std::vector<uint64_t>& durations) {
+  orbit_grpc_protos::FunctionCallStats stats;
+  stats.set_pid(1);
+  stats.set_tid(tid);
+  stats.set_function_id(kFunctionId);
+  for (uint64_t duration : durations) {
+    if (stats.count() == 0 || duration < stats.min_ns()) stats.set_min_ns(duration);
+    stats.set_max_ns(std::max(stats.max_ns(), duration));
+    stats.set_count(stats.count() + 1);
+    stats.set_total_time_ns(stats.total_time_ns() + duration);
+    stats.set_sum_of_squared_durations_ns(stats.sum_of_squared_durations_ns() +
+                                          static_cast<double>(duration * duration));
+  }
+  return stats;
+}
+
+}  // namespace
+
+TEST(CaptureData, UpdateFunctionStatsFromFunctionCallStatsMergesThreads) {
+  CaptureData capture_data{nullptr, orbit_grpc_protos::CaptureStarted{}, std::nullopt, {}};
+
+  orbit_grpc_protos::FunctionCallStats first_thread_stats = MakeFunctionCallStats(10, {2, 4});
+  first_thread_stats.add_duration_histogram(0);
+  first_thread_stats.add_duration_histogram(1);
+  first_thread_stats.add_duration_histogram(1);
+  capture_data.UpdateFunctionStats(first_thread_stats);
+
+  orbit_grpc_protos::FunctionCallStats second_thread_stats = MakeFunctionCallStats(11, {6});
+  second_thread_stats.add_duration_histogram(0);
+  second_thread_stats.add_duration_histogram(0);
+  second_thread_stats.add_duration_histogram(1);
+  capture_data.UpdateFunctionStats(second_thread_stats);
+
+  const orbit_client_protos::FunctionStats& stats =
+      capture_data.GetFunctionStatsOrDefault(kFunctionId);
+  EXPECT_EQ(stats.count(), 3);
+  EXPECT_EQ(stats.total_time_ns(), 12);
+  EXPECT_EQ(stats.average_time_ns(), 4);
+  EXPECT_EQ(stats.min_ns(), 2);
+  EXPECT_EQ(stats.max_ns(), 6);
+  EXPECT_DOUBLE_EQ(stats.variance_ns(), 8. / 3);
+  EXPECT_EQ(stats.std_dev_ns(), 1);
+  EXPECT_THAT(stats.duration_histogram(), testing::ElementsAre(0, 1, 2));
+}
+
+TEST(CaptureData, UpdateFunctionStatsFromFunctionCallStatsReplacesPreviousStatsOfThread) {
+  CaptureData capture_data{nullptr, orbit_grpc_protos::CaptureStarted{}, std::nullopt, {}};
+
+  capture_data.UpdateFunctionStats(MakeFunctionCallStats(10, {2, 4}));
+  // Statistics are cumulative: the second message includes the calls of the first one.
+  capture_data.UpdateFunctionStats(MakeFunctionCallStats(10, {2, 4, 9}));
+
+  orbit_client_protos::FunctionStats stats = capture_data.GetFunctionStatsOrDefault(kFunctionId);
+  EXPECT_EQ(stats.count(), 3);
+  EXPECT_EQ(stats.total_time_ns(), 15);
+  EXPECT_EQ(stats.max_ns(), 9);
+  EXPECT_GT(stats.variance_ns(), 0);
+
+  // Completing the capture doesn't discard the variance, even though there are no timers.
+  capture_data.OnCaptureComplete({});
+  EXPECT_EQ(capture_data.GetFunctionStatsOrDefault(kFunctionId).variance_ns(), stats.variance_ns());
+}
+
+}  // namespace orbit_client_data
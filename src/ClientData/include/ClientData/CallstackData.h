@@ -9,12 +9,12 @@
 
 #include <functional>
 #include <limits>
-#include <map>
 #include <memory>
 #include <mutex>
 #include <vector>
 
 #include "CallstackTypes.h"
+#include "ClientData/CallstackEventColumns.h"
 #include "absl/container/flat_hash_map.h"
 #include "capture_data.pb.h"
 
@@ -48,6 +48,8 @@ class CallstackData {
   [[nodiscard]] std::vector<orbit_client_protos::CallstackEvent> GetCallstackEventsOfTidInTimeRange(
       uint32_t tid, uint64_t time_begin, uint64_t time_end) const;
 
+  // The CallstackEvents are not stored as such: the ForEach... methods below pass a temporary
+  // CallstackEvent to `action`, which must not keep a reference to it.
   void ForEachCallstackEvent(
       const std::function<void(const orbit_client_protos::CallstackEvent&)>& action) const;
 
@@ -97,8 +99,7 @@ class CallstackData {
   mutable std::recursive_mutex mutex_;
   absl::flat_hash_map<uint64_t, std::shared_ptr<orbit_client_protos::CallstackInfo>>
       unique_callstacks_ GUARDED_BY(mutex_);
-  absl::flat_hash_map<int32_t, std::map<uint64_t, orbit_client_protos::CallstackEvent>>
-      callstack_events_by_tid_ GUARDED_BY(mutex_);
+  absl::flat_hash_map<int32_t, CallstackEventColumns> callstack_events_by_tid_ GUARDED_BY(mutex_);
 
   uint64_t max_time_ GUARDED_BY(mutex_) = 0;
   uint64_t min_time_ GUARDED_BY(mutex_) = std::numeric_limits<uint64_t>::max();
@@ -0,0 +1,83 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CLIENT_DATA_CALLSTACK_EVENT_COLUMNS_H_
+#define CLIENT_DATA_CALLSTACK_EVENT_COLUMNS_H_
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace orbit_client_data {
+
+// This class keeps the CallstackEvents of one thread as two separate columns, one with the
+// timestamps and one with the callstack ids, sorted by timestamp. Time ranges are found with a
+// binary search and visited with a linear scan over contiguous memory.
+//
+// The columns are split into blocks of at most kBlockSize events, so that growing the columns
+// never moves more than one block. Appending events in increasing order of timestamp, which is how
+// they arrive during a capture, is the fast path. An event that arrives out of order is inserted
+// into the block it belongs to, splitting the block first if it is full. Like in a map keyed by
+// timestamp, adding an event with the timestamp of an existing event replaces its callstack id.
+//
+// Example usage:
+//
+// CallstackEventColumns columns;
+// columns.Add(10, 1);
+// columns.Add(20, 2);
+// columns.ForEachInTimeRange(5, 15, [](uint64_t timestamp, uint64_t callstack_id) {...});
+class CallstackEventColumns {
+ public:
+  void Add(uint64_t timestamp, uint64_t callstack_id);
+
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+  [[nodiscard]] size_t size() const { return size_; }
+
+  // Calls `action(timestamp, callstack_id)` for all events with a timestamp in
+  // [min_timestamp, max_timestamp], in increasing order of timestamp.
+  template <typename Action>
+  void ForEachInTimeRange(uint64_t min_timestamp, uint64_t max_timestamp, Action&& action) const {
+    auto [block_index, index_in_block] = LowerBound(min_timestamp);
+    for (; block_index < blocks_.size(); ++block_index, index_in_block = 0) {
+      const Block& block = blocks_[block_index];
+      for (; index_in_block < block.timestamps.size(); ++index_in_block) {
+        const uint64_t timestamp = block.timestamps[index_in_block];
+        if (timestamp > max_timestamp) return;
+        action(timestamp, block.callstack_ids[index_in_block]);
+      }
+    }
+  }
+
+  // Calls `action(timestamp, callstack_id)` for all events, in increasing order of timestamp.
+  template <typename Action>
+  void ForEach(Action&& action) const {
+    for (const Block& block : blocks_) {
+      for (size_t i = 0; i < block.timestamps.size(); ++i) {
+        action(block.timestamps[i], block.callstack_ids[i]);
+      }
+    }
+  }
+
+ private:
+  static constexpr size_t kBlockSize = 1024;
+
+  // Both columns always have the same size, which is between 1 and kBlockSize.
+  struct Block {
+    std::vector<uint64_t> timestamps;
+    std::vector<uint64_t> callstack_ids;
+  };
+
+  // Returns the block index and the index in that block of the first event with a timestamp not
+  // less than `timestamp`, or {blocks_.size(), 0} if there is no such event.
+  [[nodiscard]] std::pair<size_t, size_t> LowerBound(uint64_t timestamp) const;
+
+  std::vector<Block> blocks_;
+  size_t size_ = 0;
+};
+
+}  // namespace orbit_client_data
+
+#endif  // CLIENT_DATA_CALLSTACK_EVENT_COLUMNS_H_
@@ -146,6 +146,9 @@ class CaptureData {
       uint64_t instrumented_function_id) const;
 
   void UpdateFunctionStats(uint64_t instrumented_function_id, uint64_t elapsed_nanos);
+  // Replaces the statistics of the thread and function of `function_call_stats`, and recomputes
+  // the FunctionStats of the function from the latest statistics of all its threads.
+  void UpdateFunctionStats(const orbit_grpc_protos::FunctionCallStats& function_call_stats);
   void AddFunctionStats(uint64_t instrumented_function_id,
                         orbit_client_protos::FunctionStats stats);
 
@@ -240,6 +243,11 @@ class CaptureData {
   }
 
  private:
+  void RecomputeFunctionStatsFromFunctionCallStats(
+      uint64_t instrumented_function_id,
+      const absl::flat_hash_map<uint32_t, orbit_grpc_protos::FunctionCallStats>&
+          function_call_stats_by_thread);
+
   [[nodiscard]] std::optional<uint64_t>
   FindFunctionAbsoluteAddressByInstructionAbsoluteAddressUsingModulesInMemory(
       uint64_t absolute_address) const;
@@ -262,6 +270,9 @@ class CaptureData {
   absl::flat_hash_map<uint64_t, orbit_client_protos::LinuxAddressInfo> address_infos_;
 
   absl::flat_hash_map<uint64_t, orbit_client_protos::FunctionStats> functions_stats_;
+  // Function id to thread id to the latest statistics received for the function and thread.
+  absl::flat_hash_map<uint64_t, absl::flat_hash_map<uint32_t, orbit_grpc_protos::FunctionCallStats>>
+      function_call_stats_;
 
   absl::flat_hash_map<int32_t, std::string> thread_names_;
 
@@ -78,6 +78,13 @@ class DataManager final {
   void set_enable_api(bool enable_api) { enable_api_ = enable_api; }
   [[nodiscard]] bool get_enable_api() const { return enable_api_; }
 
+  void set_api_track_aggregation_window_ns(uint64_t api_track_aggregation_window_ns) {
+    api_track_aggregation_window_ns_ = api_track_aggregation_window_ns;
+  }
+  [[nodiscard]] uint64_t api_track_aggregation_window_ns() const {
+    return api_track_aggregation_window_ns_;
+  }
+
   void set_enable_introspection(bool enable_introspection) {
     enable_introspection_ = enable_introspection;
   }
@@ -90,6 +97,13 @@ class DataManager final {
     return enable_user_space_instrumentation_;
   }
 
+  void set_user_space_instrumentation_statistics_only(bool statistics_only) {
+    user_space_instrumentation_statistics_only_ = statistics_only;
+  }
+  [[nodiscard]] bool user_space_instrumentation_statistics_only() const {
+    return user_space_instrumentation_statistics_only_;
+  }
+
   void set_samples_per_second(double samples_per_second) {
     samples_per_second_ = samples_per_second;
   }
@@ -147,8 +161,10 @@ class DataManager final {
 
   bool collect_thread_states_ = false;
   bool enable_api_ = false;
+  uint64_t api_track_aggregation_window_ns_ = 0;
   bool enable_introspection_ = false;
   bool enable_user_space_instrumentation_ = false;
+  bool user_space_instrumentation_statistics_only_ = false;
   uint64_t max_local_marker_depth_per_command_buffer_ = std::numeric_limits<uint64_t>::max();
   double samples_per_second_ = 0;
   uint16_t stack_dump_size_ = 0;
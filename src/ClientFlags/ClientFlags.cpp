@@ -34,6 +34,18 @@ ABSL_FLAG(uint16_t, sampling_rate, 1000, "Frequency of callstack sampling in sam
 ABSL_FLAG(uint16_t, stack_dump_size, 65000,
           "Number of bytes to copy from the stack per sample. Max: 65000");
 
+// When non-zero, the values of the Orbit API tracks are summarized by the target process in
+// windows of this many microseconds, instead of being sent one by one.
+ABSL_FLAG(uint32_t, api_track_aggregation_window_us, 0,
+          "Summarize the values of Orbit API tracks (min, max, last, sum, count) in windows of "
+          "this many microseconds. 0 sends every value");
+
+// When set, user space instrumentation only collects the statistics of the instrumented functions
+// in the target process, instead of sending every call.
+ABSL_FLAG(bool, user_space_instrumentation_statistics_only, false,
+          "Only collect the statistics (count, min, max, average, histogram of durations) of the "
+          "functions instrumented in user space, without the individual calls");
+
 // TODO(b/160549506): Remove this flag once it can be specified in the ui.
 ABSL_FLAG(bool, frame_pointer_unwinding, false, "Use frame pointers for unwinding");
 
@@ -35,6 +35,14 @@ ABSL_DECLARE_FLAG(uint16_t, sampling_rate);
 // `PerfEventOpen.cpp`).
 ABSL_DECLARE_FLAG(uint16_t, stack_dump_size);
 
+// When non-zero, the values of the Orbit API tracks are summarized by the target process in
+// windows of this many microseconds, instead of being sent one by one.
+ABSL_DECLARE_FLAG(uint32_t, api_track_aggregation_window_us);
+
+// When set, user space instrumentation only collects the statistics of the instrumented functions
+// in the target process, instead of sending every call.
+ABSL_DECLARE_FLAG(bool, user_space_instrumentation_statistics_only);
+
 // TODO(b/160549506): Remove this flag once it can be specified in the ui.
 ABSL_DECLARE_FLAG(bool, frame_pointer_unwinding);
 
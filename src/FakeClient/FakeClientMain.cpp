@@ -243,7 +243,8 @@ int main(int argc, char* argv[]) {
       thread_pool.get(), process_id, module_manager, selected_functions, kAlwaysRecordArguments,
       kRecordReturnValues, orbit_client_data::TracepointInfoSet{}, samples_per_second,
       kStackDumpSize, unwinding_method, collect_scheduling_info, collect_thread_state,
-      collect_gpu_jobs, kEnableApi, kEnableIntrospection, kEnableUserSpaceInstrumentation,
+      collect_gpu_jobs, kEnableApi, /*api_track_aggregation_window_ns=*/0, kEnableIntrospection,
+      kEnableUserSpaceInstrumentation, /*user_space_instrumentation_statistics_only=*/false,
       kMaxLocalMarkerDepthPerCommandBuffer, collect_memory_info, memory_sampling_period_ms,
       std::move(capture_event_processor));
   LOG("Asked to start capture");
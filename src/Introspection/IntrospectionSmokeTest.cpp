@@ -51,6 +51,12 @@ inline int32_t RetrieveThreadId(const orbit_api::ApiTrackUint& /*track_uint*/) {
 inline int32_t RetrieveThreadId(const orbit_api::ApiTrackUint64& /*track_uint64*/) {
   UNREACHABLE();
 }
+inline int32_t RetrieveThreadId(const orbit_api::ApiInternedString& /*interned_string*/) {
+  UNREACHABLE();
+}
+inline int32_t RetrieveThreadId(const orbit_api::ApiTrackSummary& /*track_summary*/) {
+  UNREACHABLE();
+}
 
 // The variant type `ApiEventVariant` requires to contain `std::monostate` in order to be default-
 // constructable. However, that state is never expected to be called in the visitor.
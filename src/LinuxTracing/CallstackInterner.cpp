@@ -0,0 +1,24 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "CallstackInterner.h"
+
+namespace orbit_linux_tracing {
+
+std::pair<uint64_t, bool> CallstackInterner::GetOrAssignId(
+    const orbit_grpc_protos::Callstack& callstack) {
+  CallstackView view{absl::MakeConstSpan(callstack.pcs().data(), callstack.pcs_size()),
+                     callstack.type()};
+  if (auto it = callstack_to_id_.find(view); it != callstack_to_id_.end()) {
+    return {it->second, false};
+  }
+
+  uint64_t id = next_callstack_id_->fetch_add(1);
+  callstack_to_id_.emplace(
+      InternedCallstackKey{{callstack.pcs().begin(), callstack.pcs().end()}, callstack.type()},
+      id);
+  return {id, true};
+}
+
+}  // namespace orbit_linux_tracing
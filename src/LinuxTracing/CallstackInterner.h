@@ -0,0 +1,82 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LINUX_TRACING_CALLSTACK_INTERNER_H_
+#define LINUX_TRACING_CALLSTACK_INTERNER_H_
+
+#include <absl/container/flat_hash_map.h>
+#include <absl/hash/hash.h>
+#include <absl/types/span.h>
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "capture.pb.h"
+
+namespace orbit_linux_tracing {
+
+// Assigns ids to callstacks, so that each distinct callstack only needs to be sent once, as an
+// InternedCallstack, and then each sample only needs to refer to it by id, in a CallstackSample.
+//
+// Not thread-safe: each thread that sends callstack samples needs its own CallstackInterner, so
+// that looking up a callstack doesn't require any synchronization. CallstackInterners that share
+// `next_callstack_id` assign different ids to different callstacks, though each of them can assign
+// its own id to the same callstack.
+class CallstackInterner {
+ public:
+  explicit CallstackInterner(std::atomic<uint64_t>* next_callstack_id)
+      : next_callstack_id_{next_callstack_id} {}
+
+  // Returns the id of the callstack, and true if the id was just assigned, i.e., if the callstack
+  // needs to be sent.
+  [[nodiscard]] std::pair<uint64_t, bool> GetOrAssignId(
+      const orbit_grpc_protos::Callstack& callstack);
+
+ private:
+  struct CallstackView {
+    absl::Span<const uint64_t> pcs;
+    orbit_grpc_protos::Callstack::CallstackType type;
+
+    template <typename H>
+    friend H AbslHashValue(H h, const CallstackView& view) {
+      return H::combine(std::move(h), view.pcs, view.type);
+    }
+  };
+
+  struct InternedCallstackKey {
+    std::vector<uint64_t> pcs;
+    orbit_grpc_protos::Callstack::CallstackType type;
+  };
+
+  // Allows looking up a callstack directly from the pcs of the proto, without copying them.
+  struct CallstackHash {
+    using is_transparent = void;
+    size_t operator()(const CallstackView& view) const { return absl::Hash<CallstackView>{}(view); }
+    size_t operator()(const InternedCallstackKey& key) const {
+      return (*this)(CallstackView{key.pcs, key.type});
+    }
+  };
+
+  struct CallstackEq {
+    using is_transparent = void;
+    static CallstackView ToView(const CallstackView& view) { return view; }
+    static CallstackView ToView(const InternedCallstackKey& key) { return {key.pcs, key.type}; }
+    template <typename L, typename R>
+    bool operator()(const L& lhs, const R& rhs) const {
+      CallstackView lhs_view = ToView(lhs);
+      CallstackView rhs_view = ToView(rhs);
+      return lhs_view.type == rhs_view.type && lhs_view.pcs == rhs_view.pcs;
+    }
+  };
+
+  std::atomic<uint64_t>* next_callstack_id_;
+  absl::flat_hash_map<InternedCallstackKey, uint64_t, CallstackHash, CallstackEq>
+      callstack_to_id_;
+};
+
+}  // namespace orbit_linux_tracing
+
+#endif  // LINUX_TRACING_CALLSTACK_INTERNER_H_
@@ -0,0 +1,91 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "CallstackInterner.h"
+#include "capture.pb.h"
+
+namespace orbit_linux_tracing {
+
+using orbit_grpc_protos::Callstack;
+
+namespace {
+
+Callstack MakeCallstack(const std::vector<uint64_t>& pcs, Callstack::CallstackType type) {
+  Callstack callstack;
+  for (uint64_t pc : pcs) {
+    callstack.add_pcs(pc);
+  }
+  callstack.set_type(type);
+  return callstack;
+}
+
+}  // namespace
+
+TEST(CallstackInterner, SameCallstackGetsSameId) {
+  std::atomic<uint64_t> next_callstack_id = 1;
+  CallstackInterner interner{&next_callstack_id};
+
+  auto [first_id, first_is_new] =
+      interner.GetOrAssignId(MakeCallstack({1, 2, 3}, Callstack::kComplete));
+  EXPECT_EQ(first_id, 1);
+  EXPECT_TRUE(first_is_new);
+
+  auto [second_id, second_is_new] =
+      interner.GetOrAssignId(MakeCallstack({1, 2, 3}, Callstack::kComplete));
+  EXPECT_EQ(second_id, first_id);
+  EXPECT_FALSE(second_is_new);
+}
+
+TEST(CallstackInterner, DifferentPcsOrTypeGetDifferentIds) {
+  std::atomic<uint64_t> next_callstack_id = 1;
+  CallstackInterner interner{&next_callstack_id};
+
+  auto [id, is_new] = interner.GetOrAssignId(MakeCallstack({1, 2, 3}, Callstack::kComplete));
+  EXPECT_TRUE(is_new);
+
+  auto [other_pcs_id, other_pcs_is_new] =
+      interner.GetOrAssignId(MakeCallstack({1, 2, 4}, Callstack::kComplete));
+  EXPECT_TRUE(other_pcs_is_new);
+  EXPECT_NE(other_pcs_id, id);
+
+  auto [prefix_id, prefix_is_new] =
+      interner.GetOrAssignId(MakeCallstack({1, 2}, Callstack::kComplete));
+  EXPECT_TRUE(prefix_is_new);
+  EXPECT_NE(prefix_id, id);
+  EXPECT_NE(prefix_id, other_pcs_id);
+
+  auto [other_type_id, other_type_is_new] =
+      interner.GetOrAssignId(MakeCallstack({1, 2, 3}, Callstack::kDwarfUnwindingError));
+  EXPECT_TRUE(other_type_is_new);
+  EXPECT_NE(other_type_id, id);
+  EXPECT_NE(other_type_id, other_pcs_id);
+  EXPECT_NE(other_type_id, prefix_id);
+}
+
+TEST(CallstackInterner, InternersSharingNextIdNeverReuseIds) {
+  std::atomic<uint64_t> next_callstack_id = 1;
+  CallstackInterner interner1{&next_callstack_id};
+  CallstackInterner interner2{&next_callstack_id};
+
+  auto [id1, is_new1] = interner1.GetOrAssignId(MakeCallstack({1, 2, 3}, Callstack::kComplete));
+  EXPECT_TRUE(is_new1);
+  auto [id2, is_new2] = interner2.GetOrAssignId(MakeCallstack({4, 5, 6}, Callstack::kComplete));
+  EXPECT_TRUE(is_new2);
+  EXPECT_NE(id1, id2);
+
+  // Each interner sends the same callstack once, with its own id.
+  auto [id3, is_new3] = interner2.GetOrAssignId(MakeCallstack({1, 2, 3}, Callstack::kComplete));
+  EXPECT_TRUE(is_new3);
+  EXPECT_NE(id3, id1);
+  EXPECT_NE(id3, id2);
+  EXPECT_EQ(next_callstack_id, 4);
+}
+
+}  // namespace orbit_linux_tracing
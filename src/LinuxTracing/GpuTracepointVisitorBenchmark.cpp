@@ -0,0 +1,75 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+#include <sys/types.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GpuTracepointVisitor.h"
+#include "PerfEvent.h"
+#include "SyntheticPerfEvents.h"
+
+namespace orbit_linux_tracing {
+
+namespace {
+
+// Visits 4096 GPU jobs, each made of an amdgpu_cs_ioctl, an amdgpu_sched_run_job and a
+// dma_fence_signaled event, submitted on range(0) timelines. Up to eight jobs per timeline are in
+// flight at the same time, so that the three events of a job are not visited one after the other.
+void BM_GpuTracepointVisitorGpuJobs(benchmark::State& state) {
+  constexpr pid_t kPid = 42;
+  constexpr uint32_t kJobCount = 4096;
+  constexpr uint32_t kJobsInFlight = 8;
+  const auto timeline_count = static_cast<uint32_t>(state.range(0));
+
+  std::vector<std::string> timelines;
+  for (uint32_t i = 0; i < timeline_count; ++i) {
+    timelines.push_back("gfx" + std::to_string(i));
+  }
+
+  std::vector<std::unique_ptr<PerfEvent>> events;
+  uint64_t timestamp_ns = 1'000'000;
+  for (uint32_t first_seqno = 0; first_seqno < kJobCount; first_seqno += kJobsInFlight) {
+    for (uint32_t seqno = first_seqno; seqno < first_seqno + kJobsInFlight; ++seqno) {
+      const std::string& timeline = timelines[seqno % timeline_count];
+      events.emplace_back(MakeAmdgpuCsIoctlPerfEvent(timestamp_ns++, kPid, kPid + seqno % 4,
+                                                     /*context=*/1, seqno, timeline));
+    }
+    for (uint32_t seqno = first_seqno; seqno < first_seqno + kJobsInFlight; ++seqno) {
+      events.emplace_back(MakeAmdgpuSchedRunJobPerfEvent(timestamp_ns++, /*context=*/1, seqno,
+                                                         timelines[seqno % timeline_count]));
+    }
+    for (uint32_t seqno = first_seqno; seqno < first_seqno + kJobsInFlight; ++seqno) {
+      events.emplace_back(MakeDmaFenceSignaledPerfEvent(timestamp_ns++, /*context=*/1, seqno,
+                                                        timelines[seqno % timeline_count]));
+    }
+  }
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    CountingTracerListener listener;
+    auto visitor = std::make_unique<GpuTracepointVisitor>(&listener);
+    state.ResumeTiming();
+
+    for (std::unique_ptr<PerfEvent>& event : events) {
+      event->Accept(visitor.get());
+    }
+
+    state.PauseTiming();
+    benchmark::DoNotOptimize(listener.event_count());
+    visitor.reset();
+    state.ResumeTiming();
+  }
+  SetPerEventCounters(state, events.size());
+}
+
+}  // namespace
+
+BENCHMARK(BM_GpuTracepointVisitorGpuJobs)->ArgName("timelines")->Arg(1)->Arg(4);
+
+}  // namespace orbit_linux_tracing
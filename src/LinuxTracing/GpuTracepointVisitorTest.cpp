@@ -29,6 +29,8 @@ class MockTracerListener : public orbit_tracing_interface::TracerListener {
  public:
   MOCK_METHOD(void, OnSchedulingSlice, (orbit_grpc_protos::SchedulingSlice), (override));
   MOCK_METHOD(void, OnCallstackSample, (orbit_grpc_protos::FullCallstackSample), (override));
+  MOCK_METHOD(void, OnInternedCallstack, (orbit_grpc_protos::InternedCallstack), (override));
+  MOCK_METHOD(void, OnInternedCallstackSample, (orbit_grpc_protos::CallstackSample), (override));
   MOCK_METHOD(void, OnFunctionCall, (orbit_grpc_protos::FunctionCall), (override));
   MOCK_METHOD(void, OnGpuJob, (orbit_grpc_protos::FullGpuJob full_gpu_job), (override));
   MOCK_METHOD(void, OnThreadName, (orbit_grpc_protos::ThreadName), (override));
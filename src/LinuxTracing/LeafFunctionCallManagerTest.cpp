@@ -28,6 +28,7 @@ class MockLibunwindstackMaps : public LibunwindstackMaps {
   MOCK_METHOD(unwindstack::Maps*, Get, (), (override));
   MOCK_METHOD(void, AddAndSort,
               (uint64_t, uint64_t, uint64_t, uint64_t, const std::string&, uint64_t), (override));
+  MOCK_METHOD(uint64_t, GetGeneration, (), (const, override));
 };
 
 class MockLibunwindstackUnwinder : public LibunwindstackUnwinder {
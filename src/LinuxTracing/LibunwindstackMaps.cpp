@@ -4,13 +4,73 @@
 
 #include "LibunwindstackMaps.h"
 
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+
 namespace orbit_linux_tracing {
 
 namespace {
 
+// unwindstack::BufferMaps that inserts new maps directly in the right position, instead of
+// appending them and then sorting all the maps again like unwindstack::Maps::Add and Sort do.
+// The maps still have to be stored in the sorted vector of unwindstack::Maps, as that's where
+// unwindstack::Maps::Find, used by unwindstack::Unwinder, looks for them with a binary search.
+class SortedBufferMaps : public unwindstack::BufferMaps {
+ public:
+  explicit SortedBufferMaps(const char* buffer) : unwindstack::BufferMaps{buffer} {}
+
+  // Maps that are completely covered by the new map are removed, as the new mapping replaced them.
+  void Insert(uint64_t start, uint64_t end, uint64_t offset, uint64_t flags,
+              const std::string& name, uint64_t load_bias) {
+    auto map_info =
+        std::make_unique<unwindstack::MapInfo>(nullptr, nullptr, start, end, offset, flags, name);
+    map_info->set_load_bias(load_bias);
+
+    auto first_covered_it = std::lower_bound(
+        maps_.begin(), maps_.end(), start,
+        [](const std::unique_ptr<unwindstack::MapInfo>& map_info, uint64_t start) {
+          return map_info->start() < start;
+        });
+    auto last_covered_it = first_covered_it;
+    while (last_covered_it != maps_.end() && (*last_covered_it)->end() <= end) {
+      ++last_covered_it;
+    }
+
+    const size_t index = first_covered_it - maps_.begin();
+    if (first_covered_it != last_covered_it) {
+      *first_covered_it = std::move(map_info);
+      maps_.erase(first_covered_it + 1, last_covered_it);
+    } else {
+      maps_.insert(first_covered_it, std::move(map_info));
+    }
+    UpdatePrevMaps(index);
+  }
+
+ private:
+  // Sets prev_map and prev_real_map of the map at `index` and of the following maps that depend on
+  // it, in the same way as unwindstack::Maps::Sort does for all maps.
+  void UpdatePrevMaps(size_t index) {
+    for (size_t i = index; i < maps_.size(); ++i) {
+      unwindstack::MapInfo* prev_map = (i == 0) ? nullptr : maps_[i - 1].get();
+      unwindstack::MapInfo* prev_real_map = prev_map;
+      if (prev_real_map != nullptr && prev_real_map->IsBlank()) {
+        prev_real_map = prev_real_map->prev_real_map();
+      }
+      maps_[i]->set_prev_map(prev_map);
+      maps_[i]->set_prev_real_map(prev_real_map);
+      // The prev_real_map of the maps after the first non-blank map only depends on that map.
+      if (i > index && !maps_[i]->IsBlank()) {
+        break;
+      }
+    }
+  }
+};
+
 class LibunwindstackMapsImpl : public LibunwindstackMaps {
  public:
-  explicit LibunwindstackMapsImpl(std::unique_ptr<unwindstack::BufferMaps> maps)
+  explicit LibunwindstackMapsImpl(std::unique_ptr<SortedBufferMaps> maps)
       : maps_{std::move(maps)} {}
 
   unwindstack::MapInfo* Find(uint64_t pc) override { return maps_->Find(pc); }
@@ -19,21 +79,24 @@ class LibunwindstackMapsImpl : public LibunwindstackMaps {
 
   void AddAndSort(uint64_t start, uint64_t end, uint64_t offset, uint64_t flags,
                   const std::string& name, uint64_t load_bias) override {
-    maps_->Add(start, end, offset, flags, name, load_bias);
-    maps_->Sort();
+    maps_->Insert(start, end, offset, flags, name, load_bias);
+    ++generation_;
   }
 
+  [[nodiscard]] uint64_t GetGeneration() const override { return generation_; }
+
  private:
-  std::unique_ptr<unwindstack::BufferMaps> maps_;
+  std::unique_ptr<SortedBufferMaps> maps_;
+  uint64_t generation_ = 0;
 };
 }  // namespace
 
 std::unique_ptr<LibunwindstackMaps> LibunwindstackMaps::ParseMaps(const std::string& maps_buffer) {
-  auto maps = std::make_unique<unwindstack::BufferMaps>(maps_buffer.c_str());
+  auto maps = std::make_unique<SortedBufferMaps>(maps_buffer.c_str());
   if (!maps->Parse()) {
     return nullptr;
   }
   return std::make_unique<LibunwindstackMapsImpl>(std::move(maps));
 }
 
-}  // namespace orbit_linux_tracing
\ No newline at end of file
+}  // namespace orbit_linux_tracing
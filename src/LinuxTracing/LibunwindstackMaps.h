@@ -16,8 +16,12 @@ class LibunwindstackMaps {
 
   virtual unwindstack::MapInfo* Find(uint64_t pc) = 0;
   virtual unwindstack::Maps* Get() = 0;
+  // Adds the map keeping the maps sorted, and removes the maps completely covered by the new one.
   virtual void AddAndSort(uint64_t start, uint64_t end, uint64_t offset, uint64_t flags,
                           const std::string& name, uint64_t load_bias) = 0;
+  // Changes every time the maps change, so that results computed from the maps can be reused only
+  // as long as the maps stay the same.
+  [[nodiscard]] virtual uint64_t GetGeneration() const = 0;
 
   static std::unique_ptr<LibunwindstackMaps> ParseMaps(const std::string& maps_buffer);
 };
@@ -0,0 +1,126 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <unwindstack/MapInfo.h>
+#include <unwindstack/Maps.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "LibunwindstackMaps.h"
+
+namespace orbit_linux_tracing {
+
+namespace {
+
+const std::string kMapsBuffer =
+    "100000-101000 r--p 00000000 01:02 42 /path/to/lib\n"
+    "101000-102000 r-xp 00001000 01:02 42 /path/to/lib\n"
+    "102000-103000 ---p 00000000 00:00 0\n"
+    "200000-201000 r-xp 00000000 01:02 43 /path/to/other\n";
+
+// Checks that the maps are sorted and that prev_map and prev_real_map are the same as
+// unwindstack::Maps::Sort would set them.
+void ExpectMapsSortedAndLinked(unwindstack::Maps* maps) {
+  unwindstack::MapInfo* prev_map = nullptr;
+  unwindstack::MapInfo* prev_real_map = nullptr;
+  for (const auto& map_info : *maps) {
+    if (prev_map != nullptr) {
+      EXPECT_LE(prev_map->start(), map_info->start());
+    }
+    EXPECT_EQ(map_info->prev_map(), prev_map);
+    EXPECT_EQ(map_info->prev_real_map(), prev_real_map);
+    prev_map = map_info.get();
+    if (!map_info->IsBlank()) {
+      prev_real_map = map_info.get();
+    }
+  }
+}
+
+}  // namespace
+
+TEST(LibunwindstackMaps, ParseMaps) {
+  std::unique_ptr<LibunwindstackMaps> maps = LibunwindstackMaps::ParseMaps(kMapsBuffer);
+  ASSERT_NE(maps, nullptr);
+  EXPECT_EQ(maps->Get()->Total(), 4);
+  ASSERT_NE(maps->Find(0x101800), nullptr);
+  EXPECT_EQ(maps->Find(0x101800)->start(), 0x101000);
+  EXPECT_EQ(maps->Find(0x150000), nullptr);
+  ExpectMapsSortedAndLinked(maps->Get());
+}
+
+TEST(LibunwindstackMaps, AddAndSortInsertsInOrder) {
+  std::unique_ptr<LibunwindstackMaps> maps = LibunwindstackMaps::ParseMaps(kMapsBuffer);
+  ASSERT_NE(maps, nullptr);
+
+  maps->AddAndSort(0x150000, 0x151000, 0, PROT_READ | PROT_EXEC, "/path/to/new", 0);
+  maps->AddAndSort(0x10000, 0x11000, 0, PROT_READ | PROT_EXEC, "/path/to/first", 0);
+  maps->AddAndSort(0x300000, 0x301000, 0, PROT_READ | PROT_EXEC, "/path/to/last", 0);
+
+  EXPECT_EQ(maps->Get()->Total(), 7);
+  ASSERT_NE(maps->Find(0x150800), nullptr);
+  EXPECT_EQ(maps->Find(0x150800)->name(), "/path/to/new");
+  ASSERT_NE(maps->Find(0x10800), nullptr);
+  EXPECT_EQ(maps->Find(0x10800)->name(), "/path/to/first");
+  ASSERT_NE(maps->Find(0x300800), nullptr);
+  EXPECT_EQ(maps->Find(0x300800)->name(), "/path/to/last");
+  ExpectMapsSortedAndLinked(maps->Get());
+}
+
+TEST(LibunwindstackMaps, AddAndSortAfterBlankMapUpdatesPrevRealMap) {
+  std::unique_ptr<LibunwindstackMaps> maps = LibunwindstackMaps::ParseMaps(kMapsBuffer);
+  ASSERT_NE(maps, nullptr);
+
+  // Between the blank map at 0x102000 and the map at 0x200000.
+  maps->AddAndSort(0x103000, 0x104000, 0, PROT_READ | PROT_EXEC, "/path/to/new", 0);
+
+  unwindstack::MapInfo* other_map = maps->Find(0x200800);
+  ASSERT_NE(other_map, nullptr);
+  ASSERT_NE(other_map->prev_real_map(), nullptr);
+  EXPECT_EQ(other_map->prev_real_map()->name(), "/path/to/new");
+  ExpectMapsSortedAndLinked(maps->Get());
+}
+
+TEST(LibunwindstackMaps, AddAndSortReplacesCoveredMaps) {
+  std::unique_ptr<LibunwindstackMaps> maps = LibunwindstackMaps::ParseMaps(kMapsBuffer);
+  ASSERT_NE(maps, nullptr);
+
+  maps->AddAndSort(0x100000, 0x103000, 0, PROT_READ | PROT_EXEC, "/path/to/new", 0);
+
+  EXPECT_EQ(maps->Get()->Total(), 2);
+  for (uint64_t pc : {0x100800, 0x101800, 0x102800}) {
+    ASSERT_NE(maps->Find(pc), nullptr);
+    EXPECT_EQ(maps->Find(pc)->name(), "/path/to/new");
+  }
+  ExpectMapsSortedAndLinked(maps->Get());
+}
+
+TEST(LibunwindstackMaps, AddAndSortKeepsPartiallyCoveredMaps) {
+  std::unique_ptr<LibunwindstackMaps> maps = LibunwindstackMaps::ParseMaps(kMapsBuffer);
+  ASSERT_NE(maps, nullptr);
+
+  maps->AddAndSort(0x101000, 0x101800, 0, PROT_READ | PROT_EXEC, "/path/to/new", 0);
+
+  EXPECT_EQ(maps->Get()->Total(), 5);
+  ExpectMapsSortedAndLinked(maps->Get());
+}
+
+TEST(LibunwindstackMaps, GenerationChangesWithMaps) {
+  std::unique_ptr<LibunwindstackMaps> maps = LibunwindstackMaps::ParseMaps(kMapsBuffer);
+  ASSERT_NE(maps, nullptr);
+  const uint64_t initial_generation = maps->GetGeneration();
+
+  maps->AddAndSort(0x150000, 0x151000, 0, PROT_READ | PROT_EXEC, "/path/to/new", 0);
+  const uint64_t generation = maps->GetGeneration();
+  EXPECT_NE(generation, initial_generation);
+
+  maps->Find(0x150800);
+  maps->Get();
+  EXPECT_EQ(maps->GetGeneration(), generation);
+}
+
+}  // namespace orbit_linux_tracing
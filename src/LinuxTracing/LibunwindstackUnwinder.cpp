@@ -8,8 +8,10 @@
 #include <unwindstack/Regs.h>
 #include <unwindstack/RegsX86_64.h>
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <optional>
 
 #include "OrbitBase/Logging.h"  // IWYU pragma: keep
 
@@ -30,12 +32,20 @@ class StackAndProcessMemory : public unwindstack::Memory {
     // If the requested address range is entirely in the stack sample's address range, read from the
     // stack buffer.
     if (addr_start >= stack_start_ && addr_end <= stack_end_) {
+      stack_read_end_ = std::max(stack_read_end_, addr_end);
       return stack_memory_->Read(addr, dst, size);
     }
 
+    // Reading the stack past the end of the stack sample makes the result depend on the size of the
+    // stack sample, so consider the whole stack sample as read.
+    if (addr_end > stack_end_ && addr_start >= stack_start_) {
+      stack_read_end_ = stack_end_;
+    }
+
     // If the requested address range is entirely disjoint from the stack sample's address range,
     // read from the memory of the process.
     if (addr_end <= stack_start_ || addr_start >= stack_end_) {
+      read_process_memory_ = true;
       return process_memory_->Read(addr, dst, size);
     }
 
@@ -43,8 +53,14 @@ class StackAndProcessMemory : public unwindstack::Memory {
     return 0;
   }
 
-  static std::shared_ptr<Memory> Create(pid_t pid, const uint8_t* stack_data, uint64_t stack_start,
-                                        uint64_t stack_end) {
+  // Returns the size of the prefix of the stack sample that contains all the bytes read from it.
+  [[nodiscard]] uint64_t GetStackSizeRead() const { return stack_read_end_ - stack_start_; }
+
+  // Returns whether memory outside of the stack sample was read from the process.
+  [[nodiscard]] bool HasReadProcessMemory() const { return read_process_memory_; }
+
+  static std::shared_ptr<StackAndProcessMemory> Create(pid_t pid, const uint8_t* stack_data,
+                                                       uint64_t stack_start, uint64_t stack_end) {
     return std::shared_ptr<StackAndProcessMemory>(
         new StackAndProcessMemory(pid, stack_data, stack_start, stack_end));
   }
@@ -55,12 +71,15 @@ class StackAndProcessMemory : public unwindstack::Memory {
       : process_memory_{unwindstack::Memory::CreateProcessMemoryCached(pid)},
         stack_memory_{unwindstack::Memory::CreateOfflineMemory(stack_data, stack_start, stack_end)},
         stack_start_{stack_start},
-        stack_end_{stack_end} {}
+        stack_end_{stack_end},
+        stack_read_end_{stack_start} {}
 
   std::shared_ptr<Memory> process_memory_;
   std::shared_ptr<Memory> stack_memory_;
   uint64_t stack_start_;
   uint64_t stack_end_;
+  uint64_t stack_read_end_;
+  bool read_process_memory_ = false;
 };
 
 class LibunwindstackUnwinderImpl : public LibunwindstackUnwinder {
@@ -92,14 +111,16 @@ LibunwindstackResult LibunwindstackUnwinderImpl::Unwind(
   }
 
   std::shared_ptr<unwindstack::Memory> memory = nullptr;
+  std::shared_ptr<StackAndProcessMemory> stack_and_process_memory = nullptr;
   if (offline_memory_only) {
     memory = unwindstack::Memory::CreateOfflineMemory(
         static_cast<const uint8_t*>(stack_dump), regs[unwindstack::X86_64_REG_RSP],
         regs[unwindstack::X86_64_REG_RSP] + stack_dump_size);
   } else {
-    memory = StackAndProcessMemory::Create(pid, static_cast<const uint8_t*>(stack_dump),
-                                           regs[unwindstack::X86_64_REG_RSP],
-                                           regs[unwindstack::X86_64_REG_RSP] + stack_dump_size);
+    stack_and_process_memory = StackAndProcessMemory::Create(
+        pid, static_cast<const uint8_t*>(stack_dump), regs[unwindstack::X86_64_REG_RSP],
+        regs[unwindstack::X86_64_REG_RSP] + stack_dump_size);
+    memory = stack_and_process_memory;
   }
 
   unwindstack::Unwinder unwinder{max_frames, maps, &regs, memory};
@@ -113,7 +134,14 @@ LibunwindstackResult LibunwindstackUnwinderImpl::Unwind(
   }
 #endif
 
-  return LibunwindstackResult{unwinder.ConsumeFrames(), unwinder.LastErrorCode()};
+  std::optional<uint64_t> stack_dump_size_read;
+  bool read_process_memory = false;
+  if (stack_and_process_memory != nullptr) {
+    stack_dump_size_read = stack_and_process_memory->GetStackSizeRead();
+    read_process_memory = stack_and_process_memory->HasReadProcessMemory();
+  }
+  return LibunwindstackResult{unwinder.ConsumeFrames(), unwinder.LastErrorCode(),
+                              stack_dump_size_read, read_process_memory};
 }
 
 }  // namespace
@@ -15,6 +15,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -25,8 +26,13 @@ class LibunwindstackResult {
  public:
   explicit LibunwindstackResult(
       std::vector<unwindstack::FrameData> frames,
-      unwindstack::ErrorCode error_code = unwindstack::ErrorCode::ERROR_NONE)
-      : frames_{std::move(frames)}, error_code_{error_code} {}
+      unwindstack::ErrorCode error_code = unwindstack::ErrorCode::ERROR_NONE,
+      std::optional<uint64_t> stack_dump_size_read = std::nullopt,
+      bool read_process_memory = false)
+      : frames_{std::move(frames)},
+        error_code_{error_code},
+        stack_dump_size_read_{stack_dump_size_read},
+        read_process_memory_{read_process_memory} {}
 
   [[nodiscard]] const std::vector<unwindstack::FrameData>& frames() const { return frames_; }
 
@@ -34,9 +40,22 @@ class LibunwindstackResult {
 
   [[nodiscard]] bool IsSuccess() const { return error_code_ == unwindstack::ErrorCode::ERROR_NONE; }
 
+  // The size of the prefix of the stack dump that contains all the bytes of the stack dump that
+  // the unwinder read. This is the whole stack dump if the unwinder tried to read past its end, as
+  // the result then also depends on the size of the stack dump. Not set if this is unknown.
+  [[nodiscard]] std::optional<uint64_t> stack_dump_size_read() const {
+    return stack_dump_size_read_;
+  }
+
+  // True if the unwinder read memory of the process outside of the stack dump. The result then also
+  // depends on memory that is not part of the sample.
+  [[nodiscard]] bool read_process_memory() const { return read_process_memory_; }
+
  private:
   std::vector<unwindstack::FrameData> frames_;
   unwindstack::ErrorCode error_code_;
+  std::optional<uint64_t> stack_dump_size_read_;
+  bool read_process_memory_;
 };
 
 class LibunwindstackUnwinder {
@@ -6,6 +6,7 @@
 #include <absl/strings/str_format.h>
 #include <absl/strings/str_split.h>
 #include <errno.h>
+#include <sched.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <sys/resource.h>
@@ -212,4 +213,33 @@ bool SetMaxOpenFilesSoftLimit(uint64_t soft_limit) {
   return true;
 }
 
+std::vector<std::vector<int32_t>> PartitionCpusIntoShards(std::vector<int32_t> cpus,
+                                                          size_t shard_count) {
+  CHECK(shard_count > 0);
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  shard_count = std::min(shard_count, cpus.size());
+
+  std::vector<std::vector<int32_t>> shards(shard_count);
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    // Shard j gets the cpus with index in [j * size / count, (j + 1) * size / count).
+    shards[i * shard_count / cpus.size()].push_back(cpus[i]);
+  }
+  return shards;
+}
+
+bool SetCurrentThreadAffinity(const std::vector<int32_t>& cpus) {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (int32_t cpu : cpus) {
+    CPU_SET(cpu, &cpu_set);
+  }
+  int ret = sched_setaffinity(0, sizeof(cpu_set), &cpu_set);
+  if (ret != 0) {
+    ERROR("sched_setaffinity: %s", SafeStrerror(errno));
+    return false;
+  }
+  return true;
+}
+
 }  // namespace orbit_linux_tracing
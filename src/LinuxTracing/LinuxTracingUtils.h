@@ -9,6 +9,8 @@
 
 #include <ctime>
 #include <optional>
+#include <string>
+#include <vector>
 
 #include "OrbitBase/Logging.h"
 #include "OrbitBase/Profiling.h"
@@ -39,6 +41,14 @@ uint64_t GetMaxOpenFilesHardLimit();
 
 bool SetMaxOpenFilesSoftLimit(uint64_t soft_limit);
 
+// Splits the (sorted) cpus into at most shard_count groups of consecutive cpus of similar size, so
+// that each group can be handled by a different thread that stays close to the cpus it serves.
+std::vector<std::vector<int32_t>> PartitionCpusIntoShards(std::vector<int32_t> cpus,
+                                                          size_t shard_count);
+
+// Restricts the calling thread to run only on the given cpus. Returns false on failure.
+bool SetCurrentThreadAffinity(const std::vector<int32_t>& cpus);
+
 #if defined(__x86_64__)
 
 #define READ_ONCE(x) (*static_cast<volatile typeof(x)*>(&x))
@@ -7,6 +7,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <pthread.h>
+#include <sched.h>
 #include <sys/types.h>
 #include <syscall.h>
 #include <unistd.h>
@@ -133,4 +134,50 @@ TEST(ParseCpusetCpus, SingleValuesAndRanges) {
   EXPECT_THAT(returned_cpus, ::testing::ElementsAre(0, 1, 2, 4, 7, 12, 13, 14));
 }
 
+TEST(PartitionCpusIntoShards, EvenSplitKeepsNeighboringCpusTogether) {
+  std::vector<std::vector<int32_t>> shards = PartitionCpusIntoShards({3, 0, 2, 1, 5, 4}, 3);
+  EXPECT_THAT(shards, ::testing::ElementsAre(::testing::ElementsAre(0, 1),
+                                             ::testing::ElementsAre(2, 3),
+                                             ::testing::ElementsAre(4, 5)));
+}
+
+TEST(PartitionCpusIntoShards, UnevenSplit) {
+  std::vector<std::vector<int32_t>> shards = PartitionCpusIntoShards({0, 1, 2, 3, 4}, 2);
+  EXPECT_THAT(shards, ::testing::ElementsAre(::testing::ElementsAre(0, 1, 2),
+                                             ::testing::ElementsAre(3, 4)));
+}
+
+TEST(PartitionCpusIntoShards, MoreShardsThanCpus) {
+  std::vector<std::vector<int32_t>> shards = PartitionCpusIntoShards({4, 7}, 8);
+  EXPECT_THAT(shards,
+              ::testing::ElementsAre(::testing::ElementsAre(4), ::testing::ElementsAre(7)));
+}
+
+TEST(SetCurrentThreadAffinity, PinsToSingleCpu) {
+  // The test might not be allowed to run on all cpus (e.g., in a container or under taskset), so
+  // pin to the first cpu it is allowed to run on.
+  cpu_set_t allowed_cpu_set;
+  CPU_ZERO(&allowed_cpu_set);
+  ASSERT_EQ(sched_getaffinity(0, sizeof(allowed_cpu_set), &allowed_cpu_set), 0);
+  int first_allowed_cpu = -1;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &allowed_cpu_set)) {
+      first_allowed_cpu = cpu;
+      break;
+    }
+  }
+  ASSERT_NE(first_allowed_cpu, -1);
+
+  std::thread pinned_thread{[first_allowed_cpu] {
+    ASSERT_TRUE(SetCurrentThreadAffinity({first_allowed_cpu}));
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    ASSERT_EQ(sched_getaffinity(0, sizeof(cpu_set), &cpu_set), 0);
+    EXPECT_EQ(CPU_COUNT(&cpu_set), 1);
+    EXPECT_TRUE(CPU_ISSET(first_allowed_cpu, &cpu_set));
+    EXPECT_EQ(sched_getcpu(), first_allowed_cpu);
+  }};
+  pinned_thread.join();
+}
+
 }  // namespace orbit_linux_tracing
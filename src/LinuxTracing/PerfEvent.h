@@ -20,6 +20,7 @@
 #include "Function.h"
 #include "KernelTracepoints.h"
 #include "OrbitBase/MakeUniqueForOverwrite.h"
+#include "PerfEventAllocator.h"
 #include "PerfEventRecords.h"
 
 namespace orbit_linux_tracing {
@@ -35,6 +36,13 @@ class PerfEventVisitor;
 class PerfEvent {
  public:
   virtual ~PerfEvent() = default;
+
+  // Objects of all subclasses are allocated with PerfEventAllocator, as they are created and
+  // destroyed at a very high rate. As the destructor is virtual, the sized operator delete receives
+  // the size of the most derived class.
+  static void* operator new(size_t size) { return PerfEventAllocator::Allocate(size); }
+  static void operator delete(void* ptr, size_t size) { PerfEventAllocator::Deallocate(ptr, size); }
+
   virtual uint64_t GetTimestamp() const = 0;
   virtual void Accept(PerfEventVisitor* visitor) = 0;
 
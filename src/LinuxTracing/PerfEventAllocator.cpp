@@ -0,0 +1,231 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "PerfEventAllocator.h"
+
+#include <absl/base/thread_annotations.h>
+#include <absl/container/flat_hash_map.h>
+#include <absl/container/flat_hash_set.h>
+#include <absl/synchronization/mutex.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "OrbitBase/Logging.h"
+#include "OrbitBase/MakeUniqueForOverwrite.h"
+
+namespace orbit_linux_tracing {
+
+namespace {
+
+constexpr size_t kSizeClassCount =
+    PerfEventAllocator::kMaxPooledSize / PerfEventAllocator::kSizeClassGranularity;
+static_assert(PerfEventAllocator::kMaxPooledSize % PerfEventAllocator::kSizeClassGranularity == 0);
+static_assert(PerfEventAllocator::kSizeClassGranularity % alignof(std::max_align_t) == 0);
+
+[[nodiscard]] size_t SizeClassIndex(size_t size) {
+  return (size + PerfEventAllocator::kSizeClassGranularity - 1) /
+             PerfEventAllocator::kSizeClassGranularity -
+         1;
+}
+
+[[nodiscard]] size_t SizeClassBlockSize(size_t size_class_index) {
+  return (size_class_index + 1) * PerfEventAllocator::kSizeClassGranularity;
+}
+
+// The free blocks shared by all threads, and the slabs they are carved from.
+class SharedFreeLists {
+ public:
+  // Moves up to kTransferBatchSize free blocks of the size class into `blocks`. Carves a new slab
+  // if there are no free blocks.
+  void TakeBatch(size_t size_class_index, std::vector<void*>* blocks) {
+    absl::MutexLock lock{&mutex_};
+    std::vector<void*>& free_blocks = free_blocks_per_size_class_[size_class_index];
+    if (free_blocks.empty()) {
+      CarveNewSlab(size_class_index, &free_blocks);
+    }
+    size_t count = std::min(free_blocks.size(), PerfEventAllocator::kTransferBatchSize);
+    blocks->insert(blocks->end(), free_blocks.end() - count, free_blocks.end());
+    free_blocks.resize(free_blocks.size() - count);
+  }
+
+  // Moves the last `count` blocks of `blocks` to the free blocks of the size class.
+  void ReturnBatch(size_t size_class_index, std::vector<void*>* blocks, size_t count) {
+    CHECK(count <= blocks->size());
+    absl::MutexLock lock{&mutex_};
+    std::vector<void*>& free_blocks = free_blocks_per_size_class_[size_class_index];
+    free_blocks.insert(free_blocks.end(), blocks->end() - count, blocks->end());
+    blocks->resize(blocks->size() - count);
+    MaybeReleaseFreeSlabs(size_class_index);
+  }
+
+  // Single-block versions of the above, for threads whose ThreadCache was already destroyed.
+  [[nodiscard]] void* TakeOne(size_t size_class_index) {
+    std::vector<void*> blocks;
+    TakeBatch(size_class_index, &blocks);
+    void* block = blocks.back();
+    blocks.pop_back();
+    ReturnBatch(size_class_index, &blocks, blocks.size());
+    return block;
+  }
+
+  void ReturnOne(size_t size_class_index, void* block) {
+    std::vector<void*> blocks{block};
+    ReturnBatch(size_class_index, &blocks, 1);
+  }
+
+ private:
+  // Free blocks are only scanned for entirely free slabs when there are at least this many slabs'
+  // worth of them, and when their number has doubled since the last scan. This keeps the cost of
+  // releasing memory amortized constant per deallocation.
+  static constexpr size_t kMinFreeSlabsBeforeRelease = 4;
+
+  void CarveNewSlab(size_t size_class_index, std::vector<void*>* free_blocks)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    const size_t block_size = SizeClassBlockSize(size_class_index);
+    auto slab = make_unique_for_overwrite<char[]>(PerfEventAllocator::kSlabSize);
+    for (size_t offset = 0; offset + block_size <= PerfEventAllocator::kSlabSize;
+         offset += block_size) {
+      free_blocks->push_back(slab.get() + offset);
+    }
+    char* slab_begin = slab.get();
+    slabs_per_size_class_[size_class_index].emplace(slab_begin, std::move(slab));
+  }
+
+  void MaybeReleaseFreeSlabs(size_t size_class_index) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    const size_t blocks_per_slab =
+        PerfEventAllocator::kSlabSize / SizeClassBlockSize(size_class_index);
+    std::vector<void*>& free_blocks = free_blocks_per_size_class_[size_class_index];
+    size_t& release_threshold = release_threshold_per_size_class_[size_class_index];
+    release_threshold = std::max(release_threshold, kMinFreeSlabsBeforeRelease * blocks_per_slab);
+    if (free_blocks.size() < release_threshold) return;
+
+    std::map<char*, std::unique_ptr<char[]>>& slabs = slabs_per_size_class_[size_class_index];
+    auto get_slab_begin = [&slabs](void* block) {
+      auto slab_it = slabs.upper_bound(static_cast<char*>(block));
+      CHECK(slab_it != slabs.begin());
+      return std::prev(slab_it)->first;
+    };
+    absl::flat_hash_map<char*, size_t> free_block_count_per_slab;
+    for (void* block : free_blocks) {
+      ++free_block_count_per_slab[get_slab_begin(block)];
+    }
+    absl::flat_hash_set<char*> slabs_to_release;
+    for (const auto& [slab_begin, free_block_count] : free_block_count_per_slab) {
+      if (free_block_count == blocks_per_slab) slabs_to_release.insert(slab_begin);
+    }
+    if (!slabs_to_release.empty()) {
+      free_blocks.erase(std::remove_if(free_blocks.begin(), free_blocks.end(),
+                                       [&](void* block) {
+                                         return slabs_to_release.contains(get_slab_begin(block));
+                                       }),
+                        free_blocks.end());
+      for (char* slab_begin : slabs_to_release) {
+        slabs.erase(slab_begin);
+      }
+    }
+    release_threshold = 2 * free_blocks.size();
+  }
+
+  absl::Mutex mutex_;
+  std::array<std::vector<void*>, kSizeClassCount> free_blocks_per_size_class_
+      ABSL_GUARDED_BY(mutex_);
+  // The slabs of each size class, keyed by their first byte.
+  std::array<std::map<char*, std::unique_ptr<char[]>>, kSizeClassCount> slabs_per_size_class_
+      ABSL_GUARDED_BY(mutex_);
+  std::array<size_t, kSizeClassCount> release_threshold_per_size_class_ ABSL_GUARDED_BY(mutex_){};
+};
+
+SharedFreeLists& GetSharedFreeLists() {
+  // Never destroyed, as the per-thread caches return their blocks here when their thread exits,
+  // which can happen after static destruction.
+  static auto* shared_free_lists = new SharedFreeLists{};
+  return *shared_free_lists;
+}
+
+// Set once the ThreadCache of this thread has been destroyed. Other thread_local objects can still
+// allocate or deallocate PerfEvents in their destructors, and they then use SharedFreeLists
+// directly. This is trivially destructible, so it is still valid when that happens.
+thread_local bool thread_cache_destroyed = false;
+
+// Allocations and deallocations only need to take the lock of SharedFreeLists once every
+// kTransferBatchSize operations.
+class ThreadCache {
+ public:
+  ThreadCache() = default;
+  ThreadCache(const ThreadCache&) = delete;
+  ThreadCache& operator=(const ThreadCache&) = delete;
+
+  ~ThreadCache() {
+    for (size_t size_class_index = 0; size_class_index < kSizeClassCount; ++size_class_index) {
+      std::vector<void*>& blocks = blocks_per_size_class_[size_class_index];
+      GetSharedFreeLists().ReturnBatch(size_class_index, &blocks, blocks.size());
+    }
+    thread_cache_destroyed = true;
+  }
+
+  [[nodiscard]] void* Allocate(size_t size_class_index) {
+    std::vector<void*>& blocks = blocks_per_size_class_[size_class_index];
+    if (blocks.empty()) {
+      GetSharedFreeLists().TakeBatch(size_class_index, &blocks);
+    }
+    void* block = blocks.back();
+    blocks.pop_back();
+    return block;
+  }
+
+  void Deallocate(void* block, size_t size_class_index) {
+    std::vector<void*>& blocks = blocks_per_size_class_[size_class_index];
+    blocks.push_back(block);
+    // Keep one batch for the next allocations on this thread, and give back the rest. This matters
+    // as PerfEvents are mostly allocated and deallocated on different threads.
+    if (blocks.size() >= 2 * PerfEventAllocator::kTransferBatchSize) {
+      GetSharedFreeLists().ReturnBatch(size_class_index, &blocks,
+                                       PerfEventAllocator::kTransferBatchSize);
+    }
+  }
+
+ private:
+  std::array<std::vector<void*>, kSizeClassCount> blocks_per_size_class_;
+};
+
+ThreadCache& GetThreadCache() {
+  thread_local ThreadCache thread_cache;
+  return thread_cache;
+}
+
+}  // namespace
+
+void* PerfEventAllocator::Allocate(size_t size) {
+  if (size == 0 || size > kMaxPooledSize) {
+    return ::operator new(size);
+  }
+  if (thread_cache_destroyed) {
+    return GetSharedFreeLists().TakeOne(SizeClassIndex(size));
+  }
+  return GetThreadCache().Allocate(SizeClassIndex(size));
+}
+
+void PerfEventAllocator::Deallocate(void* ptr, size_t size) {
+  if (ptr == nullptr) {
+    return;
+  }
+  if (size == 0 || size > kMaxPooledSize) {
+    ::operator delete(ptr);
+    return;
+  }
+  if (thread_cache_destroyed) {
+    GetSharedFreeLists().ReturnOne(SizeClassIndex(size), ptr);
+    return;
+  }
+  GetThreadCache().Deallocate(ptr, SizeClassIndex(size));
+}
+
+}  // namespace orbit_linux_tracing
@@ -0,0 +1,39 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LINUX_TRACING_PERF_EVENT_ALLOCATOR_H_
+#define LINUX_TRACING_PERF_EVENT_ALLOCATOR_H_
+
+#include <stddef.h>
+
+namespace orbit_linux_tracing {
+
+// Slab allocator for the objects of the PerfEvent hierarchy. Every perf_event_open record we keep
+// is copied into a new PerfEvent by the threads reading the ring buffers, and that PerfEvent is
+// destroyed on the thread running PerfEventProcessor, once the event has been processed in order
+// and visited. At tens of thousands of events per second this makes for a lot of small,
+// cross-thread new/delete pairs.
+//
+// Instead, sizes up to kMaxPooledSize are rounded up to a size class, and blocks of each size class
+// are carved out of slabs of kSlabSize bytes. Freed blocks are kept in a per-thread cache, and
+// batches of kTransferBatchSize blocks are moved between the per-thread caches and a shared free
+// list. This way, the memory of events consumed by PerfEventProcessor is recycled for the events
+// that are being read from the ring buffers. Slabs whose blocks are all in the shared free list are
+// released from time to time, so the memory used follows the number of events alive at the same
+// time. Larger sizes use operator new.
+class PerfEventAllocator {
+ public:
+  [[nodiscard]] static void* Allocate(size_t size);
+  // `size` must be the same as passed to Allocate.
+  static void Deallocate(void* ptr, size_t size);
+
+  static constexpr size_t kSizeClassGranularity = 32;
+  static constexpr size_t kMaxPooledSize = 512;
+  static constexpr size_t kSlabSize = 64 * 1024;
+  static constexpr size_t kTransferBatchSize = 64;
+};
+
+}  // namespace orbit_linux_tracing
+
+#endif  // LINUX_TRACING_PERF_EVENT_ALLOCATOR_H_
@@ -0,0 +1,96 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "PerfEvent.h"
+#include "PerfEventAllocator.h"
+
+namespace orbit_linux_tracing {
+
+namespace {
+
+// Mimics how PerfEvents are used: a batch of events is allocated while reading the ring buffers,
+// and the whole batch is freed later, after PerfEventProcessor has processed it.
+template <typename AllocateFunction, typename DeallocateFunction>
+void AllocateAndDeallocateBatches(benchmark::State& state, AllocateFunction allocate,
+                                  DeallocateFunction deallocate) {
+  const size_t batch_size = state.range(0);
+  std::vector<void*> blocks(batch_size);
+  for (auto _ : state) {
+    for (void*& block : blocks) {
+      block = allocate();
+    }
+    benchmark::ClobberMemory();
+    for (void* block : blocks) {
+      deallocate(block);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+// Same, but the batch is freed on another thread, as PerfEvents are freed by the thread running
+// PerfEventProcessor and not by the threads reading the ring buffers.
+template <typename AllocateFunction, typename DeallocateFunction>
+void AllocateAndDeallocateBatchesOnOtherThread(benchmark::State& state, AllocateFunction allocate,
+                                               DeallocateFunction deallocate) {
+  const size_t batch_size = state.range(0);
+  std::vector<void*> blocks(batch_size);
+  for (auto _ : state) {
+    for (void*& block : blocks) {
+      block = allocate();
+    }
+    std::thread deallocating_thread{[&blocks, &deallocate] {
+      for (void* block : blocks) {
+        deallocate(block);
+      }
+    }};
+    deallocating_thread.join();
+  }
+  state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+template <typename PerfEventT>
+void BM_OperatorNew(benchmark::State& state) {
+  AllocateAndDeallocateBatches(
+      state, [] { return ::operator new(sizeof(PerfEventT)); },
+      [](void* block) { ::operator delete(block); });
+}
+
+template <typename PerfEventT>
+void BM_PerfEventAllocator(benchmark::State& state) {
+  AllocateAndDeallocateBatches(
+      state, [] { return PerfEventAllocator::Allocate(sizeof(PerfEventT)); },
+      [](void* block) { PerfEventAllocator::Deallocate(block, sizeof(PerfEventT)); });
+}
+
+template <typename PerfEventT>
+void BM_OperatorNewOtherThread(benchmark::State& state) {
+  AllocateAndDeallocateBatchesOnOtherThread(
+      state, [] { return ::operator new(sizeof(PerfEventT)); },
+      [](void* block) { ::operator delete(block); });
+}
+
+template <typename PerfEventT>
+void BM_PerfEventAllocatorOtherThread(benchmark::State& state) {
+  AllocateAndDeallocateBatchesOnOtherThread(
+      state, [] { return PerfEventAllocator::Allocate(sizeof(PerfEventT)); },
+      [](void* block) { PerfEventAllocator::Deallocate(block, sizeof(PerfEventT)); });
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(BM_OperatorNew, SchedSwitchPerfEvent)->Range(64, 16 * 1024);
+BENCHMARK_TEMPLATE(BM_PerfEventAllocator, SchedSwitchPerfEvent)->Range(64, 16 * 1024);
+BENCHMARK_TEMPLATE(BM_OperatorNew, UprobesWithArgumentsPerfEvent)->Range(64, 16 * 1024);
+BENCHMARK_TEMPLATE(BM_PerfEventAllocator, UprobesWithArgumentsPerfEvent)->Range(64, 16 * 1024);
+BENCHMARK_TEMPLATE(BM_OperatorNewOtherThread, StackSamplePerfEvent)->Range(64, 16 * 1024);
+BENCHMARK_TEMPLATE(BM_PerfEventAllocatorOtherThread, StackSamplePerfEvent)->Range(64, 16 * 1024);
+
+}  // namespace orbit_linux_tracing
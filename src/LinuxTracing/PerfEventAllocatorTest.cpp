@@ -0,0 +1,140 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <absl/container/flat_hash_set.h>
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "PerfEvent.h"
+#include "PerfEventAllocator.h"
+
+namespace orbit_linux_tracing {
+
+TEST(PerfEventAllocator, BlocksAreDistinctAndAligned) {
+  constexpr size_t kSize = 100;
+  constexpr size_t kCount = 3 * PerfEventAllocator::kTransferBatchSize;
+  absl::flat_hash_set<void*> blocks;
+  for (size_t i = 0; i < kCount; ++i) {
+    void* block = PerfEventAllocator::Allocate(kSize);
+    ASSERT_NE(block, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(block) % alignof(std::max_align_t), 0);
+    // Write the whole block, so that overlapping blocks are caught by sanitizers.
+    memset(block, 0xAB, kSize);
+    EXPECT_TRUE(blocks.insert(block).second);
+  }
+  for (void* block : blocks) {
+    PerfEventAllocator::Deallocate(block, kSize);
+  }
+}
+
+TEST(PerfEventAllocator, ReusesDeallocatedBlockOfSameSizeClass) {
+  void* block = PerfEventAllocator::Allocate(100);
+  PerfEventAllocator::Deallocate(block, 100);
+  void* reused_block = PerfEventAllocator::Allocate(PerfEventAllocator::kSizeClassGranularity * 4);
+  EXPECT_EQ(reused_block, block);
+  PerfEventAllocator::Deallocate(reused_block, PerfEventAllocator::kSizeClassGranularity * 4);
+}
+
+TEST(PerfEventAllocator, SupportsSizesLargerThanMaxPooledSize) {
+  constexpr size_t kSize = PerfEventAllocator::kMaxPooledSize + 1;
+  void* block = PerfEventAllocator::Allocate(kSize);
+  ASSERT_NE(block, nullptr);
+  memset(block, 0xAB, kSize);
+  PerfEventAllocator::Deallocate(block, kSize);
+}
+
+TEST(PerfEventAllocator, DeallocatesOnOtherThread) {
+  constexpr size_t kSize = 64;
+  constexpr size_t kCount = 10 * PerfEventAllocator::kTransferBatchSize;
+  std::vector<void*> blocks;
+  for (size_t i = 0; i < kCount; ++i) {
+    blocks.push_back(PerfEventAllocator::Allocate(kSize));
+  }
+
+  std::thread deallocating_thread{[&blocks] {
+    for (void* block : blocks) {
+      PerfEventAllocator::Deallocate(block, kSize);
+    }
+  }};
+  deallocating_thread.join();
+
+  // The blocks freed by the other thread have been returned to the shared free lists when it
+  // exited, so they can be allocated again on this thread.
+  absl::flat_hash_set<void*> freed_blocks{blocks.begin(), blocks.end()};
+  std::vector<void*> new_blocks;
+  bool reused_freed_block = false;
+  for (size_t i = 0; i < 2 * kCount; ++i) {
+    void* block = PerfEventAllocator::Allocate(kSize);
+    reused_freed_block |= freed_blocks.contains(block);
+    new_blocks.push_back(block);
+  }
+  EXPECT_TRUE(reused_freed_block);
+  for (void* block : new_blocks) {
+    PerfEventAllocator::Deallocate(block, kSize);
+  }
+}
+
+namespace {
+
+constexpr size_t kDeallocateOnDestructionSize = 64;
+
+struct DeallocateOnDestruction {
+  ~DeallocateOnDestruction() {
+    PerfEventAllocator::Deallocate(block, kDeallocateOnDestructionSize);
+  }
+
+  void* block = nullptr;
+};
+
+}  // namespace
+
+TEST(PerfEventAllocator, DeallocatesAfterThreadCacheIsDestroyed) {
+  std::thread thread{[] {
+    // Constructed before the ThreadCache of this thread, hence destroyed after it.
+    thread_local DeallocateOnDestruction deallocate_on_destruction;
+    deallocate_on_destruction.block = PerfEventAllocator::Allocate(kDeallocateOnDestructionSize);
+  }};
+  thread.join();
+}
+
+TEST(PerfEventAllocator, ReleasesAndReusesFreeSlabs) {
+  constexpr size_t kSize = PerfEventAllocator::kMaxPooledSize;
+  constexpr size_t kCount = 8 * PerfEventAllocator::kSlabSize / kSize;
+  for (int round = 0; round < 3; ++round) {
+    std::vector<void*> blocks;
+    for (size_t i = 0; i < kCount; ++i) {
+      void* block = PerfEventAllocator::Allocate(kSize);
+      memset(block, 0xAB, kSize);
+      blocks.push_back(block);
+    }
+    EXPECT_EQ(absl::flat_hash_set<void*>(blocks.begin(), blocks.end()).size(), kCount);
+
+    // Once the other thread exits, all these blocks are in the shared free list, which releases
+    // the slabs that are entirely free.
+    std::thread deallocating_thread{[&blocks] {
+      for (void* block : blocks) {
+        PerfEventAllocator::Deallocate(block, kSize);
+      }
+    }};
+    deallocating_thread.join();
+  }
+}
+
+TEST(PerfEventAllocator, IsUsedForPerfEvents) {
+  auto event = std::make_unique<DiscardedPerfEvent>(1, 2);
+  PerfEvent* event_address = event.get();
+  event.reset();
+
+  std::unique_ptr<PerfEvent> other_event = std::make_unique<DiscardedPerfEvent>(3, 4);
+  EXPECT_EQ(other_event.get(), event_address);
+  EXPECT_EQ(other_event->GetTimestamp(), 4);
+}
+
+}  // namespace orbit_linux_tracing
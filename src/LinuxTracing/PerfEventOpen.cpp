@@ -27,6 +27,8 @@ perf_event_attr generic_event_attr() {
   pe.sample_id_all = 1;  // Also include timestamps for lost events.
   pe.disabled = 1;
   pe.sample_type = SAMPLE_TYPE_TID_TIME_STREAMID_CPU;
+  pe.watermark = 1;
+  pe.wakeup_watermark = RING_BUFFER_WAKEUP_WATERMARK_BYTES;
 
   return pe;
 }
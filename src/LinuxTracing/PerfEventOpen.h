@@ -99,6 +99,11 @@ static constexpr uint64_t SAMPLE_REGS_USER_SP_IP_ARGUMENTS =
 static_assert(sizeof(void*) == 8);
 static constexpr uint16_t SAMPLE_STACK_USER_SIZE_8BYTES = 8;
 
+// Number of bytes after which a ring buffer signals new data to poll/epoll. This needs to be
+// smaller than the smallest ring buffer we open (64 KB), otherwise the kernel clamps it to the
+// size of the buffer and the buffer could overflow before we are woken up.
+static constexpr uint32_t RING_BUFFER_WAKEUP_WATERMARK_BYTES = 16 * 1024;
+
 // Max to pass to perf_event_open without getting an error is (1u << 16u) - 8,
 // because the kernel stores this in a short and because of alignment reasons.
 // But the size the kernel actually returns is smaller, because the maximum size
@@ -86,15 +86,17 @@ void PerfEventProcessor::ProcessAllEvents() {
   }
 }
 
-void PerfEventProcessor::ProcessOldEvents() {
+void PerfEventProcessor::ProcessOldEvents(uint64_t watermark_timestamp_ns) {
   CHECK(!visitors_.empty());
   uint64_t current_timestamp_ns = orbit_base::CaptureTimestampNs();
 
   while (event_queue_.HasEvent()) {
     PerfEvent* event = event_queue_.TopEvent();
 
-    // Do not read the most recent events as out-of-order events could (and will) arrive.
-    if (event->GetTimestamp() + kProcessingDelayMs * 1'000'000 >= current_timestamp_ns) {
+    // Do not read the most recent events as out-of-order events could (and will) arrive. Events
+    // older than the watermark are the exception, as nothing older than them can arrive anymore.
+    if (event->GetTimestamp() + kProcessingDelayMs * 1'000'000 >= current_timestamp_ns &&
+        event->GetTimestamp() >= watermark_timestamp_ns) {
       break;
     }
     // Events are guaranteed to be processed in order of timestamp
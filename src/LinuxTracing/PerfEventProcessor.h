@@ -23,6 +23,10 @@ namespace orbit_linux_tracing {
 // Its implementation builds on the assumption that we never expect events with a timestamp older
 // than kProcessingDelayMs to be added. By not processing events that are not older than this delay,
 // we will never process events out of order.
+// The caller can also pass a watermark to ProcessOldEvents: a timestamp such that all events older
+// than it are known to have been added already (e.g., because all ring buffers have been read past
+// it). Such events are processed immediately, so that kProcessingDelayMs is only an upper bound to
+// how long events are held back.
 // If events older than kProcessingDelayMs are encountered anyway, these are discarded, and
 // DiscardedPerfEvents are generated and processed in their place.
 class PerfEventProcessor {
@@ -31,7 +35,12 @@ class PerfEventProcessor {
 
   void ProcessAllEvents();
 
-  void ProcessOldEvents();
+  // Processes the events older than kProcessingDelayMs, as well as the events older than
+  // `watermark_timestamp_ns`.
+  void ProcessOldEvents(uint64_t watermark_timestamp_ns = 0);
+
+  // Whether some events have been added but not processed yet.
+  [[nodiscard]] bool HasPendingEvents() const { return event_queue_.HasEvent(); }
 
   void AddVisitor(PerfEventVisitor* visitor) { visitors_.push_back(visitor); }
 
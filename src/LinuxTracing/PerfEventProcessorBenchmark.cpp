@@ -0,0 +1,69 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "PerfEvent.h"
+#include "PerfEventProcessor.h"
+#include "PerfEventVisitor.h"
+#include "SyntheticPerfEvents.h"
+
+namespace orbit_linux_tracing {
+
+namespace {
+
+class CountingPerfEventVisitor : public PerfEventVisitor {
+ public:
+  void Visit(SchedWakeupPerfEvent* /*event*/) override { ++event_count_; }
+
+  [[nodiscard]] uint64_t event_count() const { return event_count_; }
+
+ private:
+  uint64_t event_count_ = 0;
+};
+
+// Adds the events of range(0) ring buffers, range(1) events each, to a PerfEventProcessor and has
+// it process all of them. This includes the destruction of the events after they are visited.
+void BM_PerfEventProcessorAddAndProcessAll(benchmark::State& state) {
+  const auto fd_count = static_cast<int>(state.range(0));
+  const auto events_per_fd = static_cast<uint64_t>(state.range(1));
+  constexpr uint64_t kTimestampStepNs = 1'000;
+
+  PerfEventProcessor processor;
+  CountingPerfEventVisitor visitor;
+  processor.AddVisitor(&visitor);
+
+  uint64_t first_timestamp_ns = 1'000'000;
+  for (auto _ : state) {
+    // The events of each batch must be more recent than the ones of the previous batch, otherwise
+    // PerfEventProcessor discards them as out of order.
+    state.PauseTiming();
+    std::vector<std::unique_ptr<PerfEvent>> events = MakeInterleavedPerfEvents(
+        fd_count, events_per_fd, first_timestamp_ns, kTimestampStepNs);
+    first_timestamp_ns += events_per_fd * kTimestampStepNs + fd_count;
+    state.ResumeTiming();
+
+    for (std::unique_ptr<PerfEvent>& event : events) {
+      processor.AddEvent(std::move(event));
+    }
+    processor.ProcessAllEvents();
+  }
+  benchmark::DoNotOptimize(visitor.event_count());
+  SetPerEventCounters(state, fd_count * events_per_fd);
+}
+
+}  // namespace
+
+BENCHMARK(BM_PerfEventProcessorAddAndProcessAll)
+    ->ArgNames({"fds", "events_per_fd"})
+    ->Args({1, 16 * 1024})
+    ->Args({8, 2 * 1024})
+    ->Args({64, 256})
+    ->Args({256, 64});
+
+}  // namespace orbit_linux_tracing
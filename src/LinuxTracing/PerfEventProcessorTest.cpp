@@ -96,6 +96,27 @@ TEST_F(PerfEventProcessorTest, ProcessOldEvents) {
   EXPECT_EQ(discarded_out_of_order_counter_, 0);
 }
 
+TEST_F(PerfEventProcessorTest, ProcessOldEventsWithWatermark) {
+  const uint64_t timestamp_ns = orbit_base::CaptureTimestampNs();
+  processor_.AddEvent(MakeFakePerfEvent(11, timestamp_ns));
+  processor_.AddEvent(MakeFakePerfEvent(22, timestamp_ns + 1));
+  processor_.AddEvent(MakeFakePerfEvent(11, timestamp_ns + 2));
+  processor_.AddEvent(MakeFakePerfEvent(22, timestamp_ns + 3));
+
+  // Events older than the watermark are processed without waiting for kProcessingDelayMs.
+  EXPECT_CALL(mock_visitor_, Visit(A<ForkPerfEvent*>())).Times(2);
+  processor_.ProcessOldEvents(timestamp_ns + 2);
+  Mock::VerifyAndClearExpectations(&mock_visitor_);
+  EXPECT_TRUE(processor_.HasPendingEvents());
+
+  // The watermark doesn't prevent events older than kProcessingDelayMs from being processed.
+  std::this_thread::sleep_for(std::chrono::milliseconds(kDelayBeforeProcessOldEventsMs));
+  EXPECT_CALL(mock_visitor_, Visit(A<ForkPerfEvent*>())).Times(2);
+  processor_.ProcessOldEvents(timestamp_ns + 2);
+  EXPECT_FALSE(processor_.HasPendingEvents());
+  EXPECT_EQ(discarded_out_of_order_counter_, 0);
+}
+
 TEST_F(PerfEventProcessorTest, ProcessAllEvents) {
   EXPECT_CALL(mock_visitor_, Visit(A<ForkPerfEvent*>())).Times(4);
   processor_.AddEvent(MakeFakePerfEvent(11, orbit_base::CaptureTimestampNs()));
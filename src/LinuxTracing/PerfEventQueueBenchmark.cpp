@@ -0,0 +1,59 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <vector>
+
+#include "PerfEvent.h"
+#include "PerfEventQueue.h"
+#include "SyntheticPerfEvents.h"
+
+namespace orbit_linux_tracing {
+
+namespace {
+
+// Pushes the events of range(0) ring buffers, range(1) events each, into a PerfEventQueue, then
+// pops all of them in timestamp order.
+void BM_PerfEventQueuePushAndPopAll(benchmark::State& state) {
+  const auto fd_count = static_cast<int>(state.range(0));
+  const auto events_per_fd = static_cast<uint64_t>(state.range(1));
+  std::vector<std::unique_ptr<PerfEvent>> events =
+      MakeInterleavedPerfEvents(fd_count, events_per_fd, /*first_timestamp_ns=*/1'000'000,
+                                /*timestamp_step_ns=*/1'000);
+  std::vector<PerfEvent*> events_in_push_order(events.size());
+  for (size_t i = 0; i < events.size(); ++i) {
+    events_in_push_order[i] = events[i].get();
+  }
+
+  PerfEventQueue queue;
+  for (auto _ : state) {
+    for (std::unique_ptr<PerfEvent>& event : events) {
+      queue.PushEvent(std::move(event));
+    }
+    while (queue.HasEvent()) {
+      benchmark::DoNotOptimize(queue.PopEvent().release());
+    }
+
+    // The same events are pushed again in the same order at the next iteration.
+    state.PauseTiming();
+    for (size_t i = 0; i < events.size(); ++i) {
+      events[i].reset(events_in_push_order[i]);
+    }
+    state.ResumeTiming();
+  }
+  SetPerEventCounters(state, events.size());
+}
+
+}  // namespace
+
+BENCHMARK(BM_PerfEventQueuePushAndPopAll)
+    ->ArgNames({"fds", "events_per_fd"})
+    ->Args({1, 16 * 1024})
+    ->Args({8, 2 * 1024})
+    ->Args({64, 256})
+    ->Args({256, 64});
+
+}  // namespace orbit_linux_tracing
@@ -4,6 +4,8 @@
 
 #include "PerfEventReaders.h"
 
+#include <string.h>
+
 #include <string>
 #include <utility>
 #include <vector>
@@ -24,38 +26,6 @@ void ReadPerfSampleIdAll(PerfEventRingBuffer* ring_buffer, const perf_event_head
   ring_buffer->ReadValueAtOffset(sample_id, offset);
 }
 
-uint64_t ReadSampleRecordTime(PerfEventRingBuffer* ring_buffer) {
-  uint64_t time;
-  // All PERF_RECORD_SAMPLEs start with
-  //   perf_event_header header;
-  //   perf_event_sample_id_tid_time_streamid_cpu sample_id;
-  ring_buffer->ReadValueAtOffset(
-      &time,
-      sizeof(perf_event_header) + offsetof(perf_event_sample_id_tid_time_streamid_cpu, time));
-  return time;
-}
-
-uint64_t ReadSampleRecordStreamId(PerfEventRingBuffer* ring_buffer) {
-  uint64_t stream_id;
-  // All PERF_RECORD_SAMPLEs start with
-  //   perf_event_header header;
-  //   perf_event_sample_id_tid_time_streamid_cpu sample_id;
-  ring_buffer->ReadValueAtOffset(
-      &stream_id,
-      sizeof(perf_event_header) + offsetof(perf_event_sample_id_tid_time_streamid_cpu, stream_id));
-  return stream_id;
-}
-
-pid_t ReadSampleRecordPid(PerfEventRingBuffer* ring_buffer) {
-  pid_t pid;
-  // All PERF_RECORD_SAMPLEs start with
-  //   perf_event_header header;
-  //   perf_event_sample_id_tid_time_streamid_cpu sample_id;
-  ring_buffer->ReadValueAtOffset(
-      &pid, sizeof(perf_event_header) + offsetof(perf_event_sample_id_tid_time_streamid_cpu, pid));
-  return pid;
-}
-
 uint64_t ReadThrottleUnthrottleRecordTime(PerfEventRingBuffer* ring_buffer) {
   // Note that perf_event_throttle_unthrottle::time and
   // perf_event_sample_id_tid_time_streamid_cpu::time differ a bit. Use the latter as we use that
@@ -93,11 +63,19 @@ std::unique_ptr<MmapPerfEvent> ConsumeMmapPerfEvent(PerfEventRingBuffer* ring_bu
   CHECK(header.size > (filename_offset + sizeof(perf_event_sample_id_tid_time_streamid_cpu)));
   size_t filename_size =
       header.size - filename_offset - sizeof(perf_event_sample_id_tid_time_streamid_cpu);
-  std::vector<char> filename_vector(filename_size);
-  ring_buffer->ReadRawAtOffset(&filename_vector[0], filename_offset, filename_size);
-  // This is a bit paranoid but you never know
-  filename_vector[filename_size - 1] = '\0';
-  std::string filename(filename_vector.data());
+  std::string filename;
+  const char* filename_in_place =
+      ring_buffer->GetInPlaceAtOffsetOrNull(filename_offset, filename_size);
+  if (filename_in_place != nullptr) {
+    // Build the string directly from the ring buffer, without an intermediate copy.
+    filename.assign(filename_in_place, strnlen(filename_in_place, filename_size - 1));
+  } else {
+    std::vector<char> filename_vector(filename_size);
+    ring_buffer->ReadRawAtOffset(&filename_vector[0], filename_offset, filename_size);
+    // This is a bit paranoid but you never know
+    filename_vector[filename_size - 1] = '\0';
+    filename = filename_vector.data();
+  }
 
   ring_buffer->SkipRecord(header);
 
@@ -205,12 +183,4 @@ std::unique_ptr<CallchainSamplePerfEvent> ConsumeCallchainSamplePerfEvent(
   return event;
 }
 
-std::unique_ptr<GenericTracepointPerfEvent> ConsumeGenericTracepointPerfEvent(
-    PerfEventRingBuffer* ring_buffer, const perf_event_header& header) {
-  auto event = std::make_unique<GenericTracepointPerfEvent>();
-  ring_buffer->ReadRawAtOffset(&event->ring_buffer_record, 0, sizeof(perf_event_raw_sample_fixed));
-  ring_buffer->SkipRecord(header);
-  return event;
-}
-
 }  // namespace orbit_linux_tracing
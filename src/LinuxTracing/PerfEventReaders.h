@@ -27,23 +27,29 @@ namespace orbit_linux_tracing {
 void ReadPerfSampleIdAll(PerfEventRingBuffer* ring_buffer, const perf_event_header& header,
                          perf_event_sample_id_tid_time_streamid_cpu* sample_id);
 
-uint64_t ReadSampleRecordTime(PerfEventRingBuffer* ring_buffer);
-
-uint64_t ReadSampleRecordStreamId(PerfEventRingBuffer* ring_buffer);
-
-pid_t ReadSampleRecordPid(PerfEventRingBuffer* ring_buffer);
-
 uint64_t ReadThrottleUnthrottleRecordTime(PerfEventRingBuffer* ring_buffer);
 
+// Returns a pointer to the first sizeof(T) bytes of the record at the tail of the ring buffer.
+// These are accessed in place in the ring buffer, unless they wrap around its end: only in that
+// case they are copied into `copy`, and `copy` is returned. Either way, the result must not be used
+// after the record has been consumed or skipped.
+template <typename T>
+const T* ViewRecordPrefix(PerfEventRingBuffer* ring_buffer, T* copy) {
+  static_assert(alignof(T) == 1, "Records in the ring buffer are only accessed as packed structs");
+  const char* in_place = ring_buffer->GetInPlaceAtOffsetOrNull(0, sizeof(T));
+  if (in_place != nullptr) {
+    return reinterpret_cast<const T*>(in_place);
+  }
+  ring_buffer->ReadValueAtOffset(copy, 0);
+  return copy;
+}
+
 std::unique_ptr<StackSamplePerfEvent> ConsumeStackSamplePerfEvent(PerfEventRingBuffer* ring_buffer,
                                                                   const perf_event_header& header);
 
 std::unique_ptr<CallchainSamplePerfEvent> ConsumeCallchainSamplePerfEvent(
     PerfEventRingBuffer* ring_buffer, const perf_event_header& header);
 
-std::unique_ptr<GenericTracepointPerfEvent> ConsumeGenericTracepointPerfEvent(
-    PerfEventRingBuffer* ring_buffer, const perf_event_header& header);
-
 std::unique_ptr<MmapPerfEvent> ConsumeMmapPerfEvent(PerfEventRingBuffer* ring_buffer,
                                                     const perf_event_header& header);
 
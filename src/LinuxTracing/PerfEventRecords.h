@@ -19,6 +19,12 @@ struct __attribute__((__packed__)) perf_event_sample_id_tid_time_streamid_cpu {
   uint32_t cpu, res;  /* if PERF_SAMPLE_CPU */
 };
 
+// All PERF_RECORD_SAMPLEs start with these fields.
+struct __attribute__((__packed__)) perf_event_sample_prefix {
+  perf_event_header header;
+  perf_event_sample_id_tid_time_streamid_cpu sample_id;
+};
+
 struct __attribute__((__packed__)) perf_event_context_switch {
   perf_event_header header;
   perf_event_sample_id_tid_time_streamid_cpu sample_id;
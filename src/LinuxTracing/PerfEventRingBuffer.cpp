@@ -126,6 +126,17 @@ void PerfEventRingBuffer::ConsumeRawRecord(const perf_event_header& header, void
   SkipRecord(header);
 }
 
+const char* PerfEventRingBuffer::GetInPlaceAtOffsetOrNull(uint64_t offset, uint64_t count) const {
+  DCHECK(IsOpen());
+  DCHECK(offset + count <= ReadRingBufferHead(metadata_page_) - metadata_page_->data_tail);
+
+  const uint64_t index_mod_size = (metadata_page_->data_tail + offset) & (ring_buffer_size_ - 1);
+  if (index_mod_size + count > ring_buffer_size_) {
+    return nullptr;
+  }
+  return ring_buffer_ + index_mod_size;
+}
+
 void PerfEventRingBuffer::ReadAtOffsetFromTail(void* dest, uint64_t offset_from_tail,
                                                uint64_t count) {
   DCHECK(IsOpen());
@@ -48,6 +48,12 @@ class PerfEventRingBuffer {
     ReadAtOffsetFromTail(dest, offset, count);
   }
 
+  // Returns a pointer directly into the mmap'd ring buffer to the `count` bytes at `offset` from
+  // the tail, or nullptr if these bytes wrap around the end of the ring buffer. This allows to
+  // decode a record in place instead of copying it. The pointer is only valid until the record is
+  // skipped.
+  [[nodiscard]] const char* GetInPlaceAtOffsetOrNull(uint64_t offset, uint64_t count) const;
+
  private:
   uint64_t mmap_length_ = 0;
   perf_event_mmap_page* metadata_page_ = nullptr;
@@ -0,0 +1,87 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+#include <sys/types.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "PerfEvent.h"
+#include "SwitchesStatesNamesVisitor.h"
+#include "SyntheticPerfEvents.h"
+
+namespace orbit_linux_tracing {
+
+namespace {
+
+constexpr pid_t kPid = 42;
+
+// Simulates range(0) CPUs on which the threads of a process, twice as many as the CPUs, take
+// turns: at every step, a sleeping thread is woken up and replaces the thread running on a CPU,
+// which goes to sleep. This produces a sched:sched_wakeup and a sched:sched_switch per step.
+std::vector<std::unique_ptr<PerfEvent>> MakeSchedulingEvents(uint32_t cpu_count,
+                                                             uint64_t step_count) {
+  std::vector<pid_t> tid_on_cpu(cpu_count);
+  std::deque<pid_t> sleeping_tids;
+  for (uint32_t cpu = 0; cpu < cpu_count; ++cpu) {
+    tid_on_cpu[cpu] = kPid + cpu;
+    sleeping_tids.push_back(kPid + cpu_count + cpu);
+  }
+
+  constexpr int64_t kTaskInterruptible = 1;
+  std::vector<std::unique_ptr<PerfEvent>> events;
+  uint64_t timestamp_ns = 1'000'000;
+  for (uint64_t step = 0; step < step_count; ++step) {
+    const uint32_t cpu = step % cpu_count;
+    const pid_t prev_tid = tid_on_cpu[cpu];
+    const pid_t next_tid = sleeping_tids.front();
+    sleeping_tids.pop_front();
+    events.emplace_back(MakeSchedWakeupPerfEvent(timestamp_ns++, kPid, prev_tid, next_tid));
+    events.emplace_back(MakeSchedSwitchPerfEvent(timestamp_ns++, cpu, kPid, prev_tid,
+                                                 kTaskInterruptible, next_tid));
+    tid_on_cpu[cpu] = next_tid;
+    sleeping_tids.push_back(prev_tid);
+  }
+  return events;
+}
+
+void BM_SwitchesStatesNamesVisitorSchedulingEvents(benchmark::State& state) {
+  const auto cpu_count = static_cast<uint32_t>(state.range(0));
+  constexpr uint64_t kStepCount = 8 * 1024;
+  std::vector<std::unique_ptr<PerfEvent>> events = MakeSchedulingEvents(cpu_count, kStepCount);
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    CountingTracerListener listener;
+    auto visitor = std::make_unique<SwitchesStatesNamesVisitor>(&listener);
+    visitor->SetProduceSchedulingSlices(true);
+    visitor->SetThreadStatePidFilter(kPid);
+    // The first cpu_count threads are running, the others are sleeping.
+    for (pid_t tid = kPid; tid < kPid + static_cast<pid_t>(2 * cpu_count); ++tid) {
+      visitor->ProcessInitialTidToPidAssociation(tid, kPid);
+      visitor->ProcessInitialState(/*timestamp_ns=*/0, tid,
+                                   tid < kPid + static_cast<pid_t>(cpu_count) ? 'R' : 'S');
+    }
+    state.ResumeTiming();
+
+    for (std::unique_ptr<PerfEvent>& event : events) {
+      event->Accept(visitor.get());
+    }
+
+    state.PauseTiming();
+    benchmark::DoNotOptimize(listener.event_count());
+    visitor.reset();
+    state.ResumeTiming();
+  }
+  SetPerEventCounters(state, events.size());
+}
+
+}  // namespace
+
+BENCHMARK(BM_SwitchesStatesNamesVisitorSchedulingEvents)->ArgName("cpus")->Arg(1)->Arg(8)->Arg(64);
+
+}  // namespace orbit_linux_tracing
@@ -0,0 +1,165 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "SyntheticPerfEvents.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "KernelTracepoints.h"
+#include "OrbitBase/Logging.h"
+#include "PerfEventRecords.h"
+
+namespace orbit_linux_tracing {
+
+void SetPerEventCounters(benchmark::State& state, uint64_t events_per_iteration) {
+  const auto event_count = static_cast<int64_t>(state.iterations() * events_per_iteration);
+  state.SetItemsProcessed(event_count);
+  state.counters["time_per_event"] = benchmark::Counter(
+      static_cast<double>(event_count), benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+std::vector<std::unique_ptr<PerfEvent>> MakeInterleavedPerfEvents(int fd_count,
+                                                                 uint64_t events_per_fd,
+                                                                 uint64_t first_timestamp_ns,
+                                                                 uint64_t timestamp_step_ns) {
+  constexpr uint64_t kEventsPerRead = 5;
+  std::vector<std::unique_ptr<PerfEvent>> events;
+  events.reserve(fd_count * events_per_fd);
+  for (uint64_t first_index = 0; first_index < events_per_fd; first_index += kEventsPerRead) {
+    for (int fd = 0; fd < fd_count; ++fd) {
+      for (uint64_t index = first_index;
+           index < std::min(first_index + kEventsPerRead, events_per_fd); ++index) {
+        // Offset the file descriptors from each other, so that the merge actually has to compare.
+        uint64_t timestamp_ns = first_timestamp_ns + index * timestamp_step_ns + fd;
+        auto event = MakeSchedWakeupPerfEvent(timestamp_ns, /*waker_pid=*/fd, /*waker_tid=*/fd,
+                                              /*woken_tid=*/fd + 1);
+        event->SetOrderedInFileDescriptor(fd);
+        events.emplace_back(std::move(event));
+      }
+    }
+  }
+  return events;
+}
+
+std::unique_ptr<UprobesPerfEvent> MakeUprobesPerfEvent(uint64_t timestamp_ns, pid_t pid, pid_t tid,
+                                                       uint32_t cpu, uint64_t sp,
+                                                       uint64_t return_address,
+                                                       const Function* function) {
+  auto event = std::make_unique<UprobesPerfEvent>();
+  event->ring_buffer_record.sample_id.pid = pid;
+  event->ring_buffer_record.sample_id.tid = tid;
+  event->ring_buffer_record.sample_id.time = timestamp_ns;
+  event->ring_buffer_record.sample_id.cpu = cpu;
+  event->ring_buffer_record.regs.sp = sp;
+  event->ring_buffer_record.regs.ip = function->file_offset();
+  event->ring_buffer_record.stack.top8bytes = return_address;
+  event->SetFunction(function);
+  return event;
+}
+
+std::unique_ptr<UretprobesPerfEvent> MakeUretprobesPerfEvent(uint64_t timestamp_ns, pid_t pid,
+                                                             pid_t tid, uint32_t cpu,
+                                                             const Function* function) {
+  auto event = std::make_unique<UretprobesPerfEvent>();
+  event->ring_buffer_record.sample_id.pid = pid;
+  event->ring_buffer_record.sample_id.tid = tid;
+  event->ring_buffer_record.sample_id.time = timestamp_ns;
+  event->ring_buffer_record.sample_id.cpu = cpu;
+  event->SetFunction(function);
+  return event;
+}
+
+std::unique_ptr<StackSamplePerfEvent> MakeStackSamplePerfEvent(uint64_t timestamp_ns, pid_t pid,
+                                                               pid_t tid, uint32_t cpu,
+                                                               uint64_t sp, uint64_t stack_size) {
+  auto event = std::make_unique<StackSamplePerfEvent>(stack_size);
+  event->ring_buffer_record.sample_id.pid = pid;
+  event->ring_buffer_record.sample_id.tid = tid;
+  event->ring_buffer_record.sample_id.time = timestamp_ns;
+  event->ring_buffer_record.sample_id.cpu = cpu;
+  memset(&event->ring_buffer_record.regs, 0, sizeof(event->ring_buffer_record.regs));
+  event->ring_buffer_record.regs.sp = sp;
+  memset(event->GetStackData(), 0, stack_size);
+  return event;
+}
+
+std::unique_ptr<SchedSwitchPerfEvent> MakeSchedSwitchPerfEvent(uint64_t timestamp_ns,
+                                                               uint32_t cpu, pid_t prev_pid,
+                                                               pid_t prev_tid, int64_t prev_state,
+                                                               pid_t next_tid) {
+  auto event = std::make_unique<SchedSwitchPerfEvent>();
+  event->ring_buffer_record.sample_id.pid = prev_pid;
+  event->ring_buffer_record.sample_id.tid = prev_tid;
+  event->ring_buffer_record.sample_id.time = timestamp_ns;
+  event->ring_buffer_record.sample_id.cpu = cpu;
+  strncpy(event->ring_buffer_record.data.prev_comm, "prev",
+          sizeof(event->ring_buffer_record.data.prev_comm));
+  event->ring_buffer_record.data.prev_pid = prev_tid;
+  event->ring_buffer_record.data.prev_state = prev_state;
+  strncpy(event->ring_buffer_record.data.next_comm, "next",
+          sizeof(event->ring_buffer_record.data.next_comm));
+  event->ring_buffer_record.data.next_pid = next_tid;
+  return event;
+}
+
+std::unique_ptr<SchedWakeupPerfEvent> MakeSchedWakeupPerfEvent(uint64_t timestamp_ns,
+                                                               pid_t waker_pid, pid_t waker_tid,
+                                                               pid_t woken_tid) {
+  auto event = std::make_unique<SchedWakeupPerfEvent>();
+  event->ring_buffer_record.sample_id.pid = waker_pid;
+  event->ring_buffer_record.sample_id.tid = waker_tid;
+  event->ring_buffer_record.sample_id.time = timestamp_ns;
+  event->ring_buffer_record.data.pid = woken_tid;
+  return event;
+}
+
+namespace {
+
+// Fills the tracepoint data of a GpuPerfEvent, including the timeline string referenced by the
+// __data_loc field, in the reverse of GpuPerfEvent::ExtractTimelineString.
+template <typename TracepointT, typename GpuPerfEventT>
+std::unique_ptr<GpuPerfEventT> MakeGpuPerfEvent(uint64_t timestamp_ns, pid_t pid, pid_t tid,
+                                                uint32_t context, uint32_t seqno,
+                                                const std::string& timeline) {
+  auto event = std::make_unique<GpuPerfEventT>(
+      static_cast<uint32_t>(sizeof(TracepointT) + timeline.length() + 1));
+  event->ring_buffer_record.sample_id.pid = pid;
+  event->ring_buffer_record.sample_id.tid = tid;
+  event->ring_buffer_record.sample_id.time = timestamp_ns;
+  auto* tracepoint = reinterpret_cast<TracepointT*>(event->tracepoint_data.get());
+  tracepoint->context = context;
+  tracepoint->seqno = seqno;
+  tracepoint->timeline = ((timeline.length() + 1) << 16) | sizeof(TracepointT);
+  memcpy(event->tracepoint_data.get() + sizeof(TracepointT), timeline.c_str(),
+         timeline.length() + 1);
+  CHECK(event->ExtractTimelineString() == timeline);
+  return event;
+}
+
+}  // namespace
+
+std::unique_ptr<AmdgpuCsIoctlPerfEvent> MakeAmdgpuCsIoctlPerfEvent(uint64_t timestamp_ns, pid_t pid,
+                                                                   pid_t tid, uint32_t context,
+                                                                   uint32_t seqno,
+                                                                   const std::string& timeline) {
+  return MakeGpuPerfEvent<amdgpu_cs_ioctl_tracepoint, AmdgpuCsIoctlPerfEvent>(
+      timestamp_ns, pid, tid, context, seqno, timeline);
+}
+
+std::unique_ptr<AmdgpuSchedRunJobPerfEvent> MakeAmdgpuSchedRunJobPerfEvent(
+    uint64_t timestamp_ns, uint32_t context, uint32_t seqno, const std::string& timeline) {
+  return MakeGpuPerfEvent<amdgpu_sched_run_job_tracepoint, AmdgpuSchedRunJobPerfEvent>(
+      timestamp_ns, /*pid=*/-1, /*tid=*/-1, context, seqno, timeline);
+}
+
+std::unique_ptr<DmaFenceSignaledPerfEvent> MakeDmaFenceSignaledPerfEvent(
+    uint64_t timestamp_ns, uint32_t context, uint32_t seqno, const std::string& timeline) {
+  return MakeGpuPerfEvent<dma_fence_signaled_tracepoint, DmaFenceSignaledPerfEvent>(
+      timestamp_ns, /*pid=*/-1, /*tid=*/-1, context, seqno, timeline);
+}
+
+}  // namespace orbit_linux_tracing
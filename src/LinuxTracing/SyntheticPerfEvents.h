@@ -0,0 +1,136 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LINUX_TRACING_SYNTHETIC_PERF_EVENTS_H_
+#define LINUX_TRACING_SYNTHETIC_PERF_EVENTS_H_
+
+#include <benchmark/benchmark.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Function.h"
+#include "PerfEvent.h"
+#include "TracingInterface/TracerListener.h"
+#include "capture.pb.h"
+
+// Helpers for LinuxTracingBenchmarks, to replay synthetic perf_event_open records through the
+// stages of the LinuxTracing pipeline without root, a live kernel, or a target process.
+
+namespace orbit_linux_tracing {
+
+// TracerListener that drops everything it receives, only counting the calls. This way benchmarks of
+// the visitors measure the visitors, while still paying for building the protos they produce.
+class CountingTracerListener : public orbit_tracing_interface::TracerListener {
+ public:
+  void OnSchedulingSlice(orbit_grpc_protos::SchedulingSlice /*scheduling_slice*/) override {
+    ++event_count_;
+  }
+  void OnCallstackSample(orbit_grpc_protos::FullCallstackSample /*callstack_sample*/) override {
+    ++event_count_;
+  }
+  void OnInternedCallstack(orbit_grpc_protos::InternedCallstack /*interned_callstack*/) override {
+    ++event_count_;
+  }
+  void OnInternedCallstackSample(orbit_grpc_protos::CallstackSample /*callstack_sample*/) override {
+    ++event_count_;
+  }
+  void OnFunctionCall(orbit_grpc_protos::FunctionCall /*function_call*/) override {
+    ++event_count_;
+  }
+  void OnGpuJob(orbit_grpc_protos::FullGpuJob /*gpu_job*/) override { ++event_count_; }
+  void OnThreadName(orbit_grpc_protos::ThreadName /*thread_name*/) override { ++event_count_; }
+  void OnThreadNamesSnapshot(
+      orbit_grpc_protos::ThreadNamesSnapshot /*thread_names_snapshot*/) override {
+    ++event_count_;
+  }
+  void OnThreadStateSlice(orbit_grpc_protos::ThreadStateSlice /*thread_state_slice*/) override {
+    ++event_count_;
+  }
+  void OnAddressInfo(orbit_grpc_protos::FullAddressInfo /*full_address_info*/) override {
+    ++event_count_;
+  }
+  void OnTracepointEvent(orbit_grpc_protos::FullTracepointEvent /*tracepoint_event*/) override {
+    ++event_count_;
+  }
+  void OnModulesSnapshot(orbit_grpc_protos::ModulesSnapshot /*modules_snapshot*/) override {
+    ++event_count_;
+  }
+  void OnModuleUpdate(orbit_grpc_protos::ModuleUpdateEvent /*module_update_event*/) override {
+    ++event_count_;
+  }
+  void OnErrorsWithPerfEventOpenEvent(
+      orbit_grpc_protos::ErrorsWithPerfEventOpenEvent /*errors_with_perf_event_open_event*/)
+      override {
+    ++event_count_;
+  }
+  void OnLostPerfRecordsEvent(
+      orbit_grpc_protos::LostPerfRecordsEvent /*lost_perf_records_event*/) override {
+    ++event_count_;
+  }
+  void OnOutOfOrderEventsDiscardedEvent(
+      orbit_grpc_protos::OutOfOrderEventsDiscardedEvent /*out_of_order_events_discarded_event*/)
+      override {
+    ++event_count_;
+  }
+
+  [[nodiscard]] uint64_t event_count() const { return event_count_; }
+
+ private:
+  uint64_t event_count_ = 0;
+};
+
+// Reports the number of events processed per second ("items_per_second") and the average time
+// spent on each event ("time_per_event"), given that each iteration processed
+// `events_per_iteration` events.
+void SetPerEventCounters(benchmark::State& state, uint64_t events_per_iteration);
+
+// Returns `events_per_fd` events for each of `fd_count` file descriptors. Events of the same file
+// descriptor have increasing timestamps, starting at `first_timestamp_ns` and spaced by
+// `timestamp_step_ns`, and the events of the different file descriptors are interleaved as if the
+// ring buffers had been read round-robin, in batches of five.
+std::vector<std::unique_ptr<PerfEvent>> MakeInterleavedPerfEvents(int fd_count,
+                                                                 uint64_t events_per_fd,
+                                                                 uint64_t first_timestamp_ns,
+                                                                 uint64_t timestamp_step_ns);
+
+std::unique_ptr<UprobesPerfEvent> MakeUprobesPerfEvent(uint64_t timestamp_ns, pid_t pid, pid_t tid,
+                                                       uint32_t cpu, uint64_t sp,
+                                                       uint64_t return_address,
+                                                       const Function* function);
+
+std::unique_ptr<UretprobesPerfEvent> MakeUretprobesPerfEvent(uint64_t timestamp_ns, pid_t pid,
+                                                             pid_t tid, uint32_t cpu,
+                                                             const Function* function);
+
+std::unique_ptr<StackSamplePerfEvent> MakeStackSamplePerfEvent(uint64_t timestamp_ns, pid_t pid,
+                                                               pid_t tid, uint32_t cpu,
+                                                               uint64_t sp, uint64_t stack_size);
+
+std::unique_ptr<SchedSwitchPerfEvent> MakeSchedSwitchPerfEvent(uint64_t timestamp_ns,
+                                                               uint32_t cpu, pid_t prev_pid,
+                                                               pid_t prev_tid, int64_t prev_state,
+                                                               pid_t next_tid);
+
+std::unique_ptr<SchedWakeupPerfEvent> MakeSchedWakeupPerfEvent(uint64_t timestamp_ns,
+                                                               pid_t waker_pid, pid_t waker_tid,
+                                                               pid_t woken_tid);
+
+std::unique_ptr<AmdgpuCsIoctlPerfEvent> MakeAmdgpuCsIoctlPerfEvent(uint64_t timestamp_ns, pid_t pid,
+                                                                   pid_t tid, uint32_t context,
+                                                                   uint32_t seqno,
+                                                                   const std::string& timeline);
+
+std::unique_ptr<AmdgpuSchedRunJobPerfEvent> MakeAmdgpuSchedRunJobPerfEvent(
+    uint64_t timestamp_ns, uint32_t context, uint32_t seqno, const std::string& timeline);
+
+std::unique_ptr<DmaFenceSignaledPerfEvent> MakeDmaFenceSignaledPerfEvent(
+    uint64_t timestamp_ns, uint32_t context, uint32_t seqno, const std::string& timeline);
+
+}  // namespace orbit_linux_tracing
+
+#endif  // LINUX_TRACING_SYNTHETIC_PERF_EVENTS_H_
@@ -10,11 +10,16 @@
 #include <absl/strings/str_format.h>
 #include <absl/strings/str_join.h>
 #include <pthread.h>
+#include <poll.h>
 #include <stddef.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <cerrno>
 #include <cinttypes>
+#include <limits>
 #include <string>
 #include <string_view>
 #include <thread>
@@ -31,6 +36,7 @@
 #include "OrbitBase/GetProcessIds.h"
 #include "OrbitBase/Logging.h"
 #include "OrbitBase/MakeUniqueForOverwrite.h"
+#include "OrbitBase/SafeStrerror.h"
 #include "OrbitBase/ThreadUtils.h"
 #include "PerfEventOpen.h"
 #include "PerfEventReaders.h"
@@ -54,7 +60,12 @@ TracerThread::TracerThread(const CaptureOptions& capture_options)
       target_pid_{orbit_base::ToNativeProcessId(capture_options.pid())},
       unwinding_method_{capture_options.unwinding_method()},
       trace_thread_state_{capture_options.trace_thread_state()},
-      trace_gpu_driver_{capture_options.trace_gpu_driver()} {
+      trace_gpu_driver_{capture_options.trace_gpu_driver()},
+      ring_buffer_reader_thread_count_{capture_options.ring_buffer_reader_thread_count()},
+      event_driven_ring_buffer_reads_{capture_options.event_driven_ring_buffer_reads()},
+      adaptive_event_processing_delay_{capture_options.adaptive_event_processing_delay()},
+      unwinding_thread_count_{capture_options.unwinding_thread_count()},
+      unwind_result_cache_size_{capture_options.unwind_result_cache_size()} {
   if (unwinding_method_ != CaptureOptions::kUndefined) {
     uint32_t stack_dump_size = capture_options.stack_dump_size();
     if (stack_dump_size > kMaxStackSampleUserSize || stack_dump_size == 0) {
@@ -107,7 +118,8 @@ void CloseFileDescriptors(const absl::flat_hash_map<int32_t, int>& fds_per_cpu)
 
 void TracerThread::InitUprobesEventVisitor() {
   ORBIT_SCOPE_FUNCTION;
-  maps_ = LibunwindstackMaps::ParseMaps(ReadMaps(target_pid_));
+  std::string maps_buffer = ReadMaps(target_pid_);
+  maps_ = LibunwindstackMaps::ParseMaps(maps_buffer);
   unwinder_ = LibunwindstackUnwinder::Create();
   leaf_function_call_manager_ = std::make_unique<LeafFunctionCallManager>(stack_dump_size_);
   uprobes_unwinding_visitor_ = std::make_unique<UprobesUnwindingVisitor>(
@@ -115,6 +127,32 @@ void TracerThread::InitUprobesEventVisitor() {
       leaf_function_call_manager_.get());
   uprobes_unwinding_visitor_->SetUnwindErrorsAndDiscardedSamplesCounters(
       &stats_.unwind_error_count, &stats_.samples_in_uretprobes_count);
+  auto create_unwind_result_cache = [this] {
+    return std::make_unique<UnwindResultCache>(unwind_result_cache_size_,
+                                               &stats_.unwind_cache_hit_count,
+                                               &stats_.unwind_cache_miss_count);
+  };
+  unwind_result_cache_ = create_unwind_result_cache();
+  uprobes_unwinding_visitor_->SetUnwindResultCache(unwind_result_cache_.get());
+  next_callstack_id_ = 1;
+  uprobes_unwinding_visitor_->EnableCallstackInterning(&next_callstack_id_);
+
+  // Only DWARF unwinding is expensive enough to be worth moving off the processing thread.
+  if (unwinding_thread_count_ > 0 && unwinding_method_ == CaptureOptions::kDwarf) {
+    unwinding_worker_pool_ = std::make_unique<UnwindingWorkerPool>(
+        unwinding_thread_count_,
+        [&maps_buffer] { return LibunwindstackMaps::ParseMaps(maps_buffer); },
+        &LibunwindstackUnwinder::Create,
+        [this](const UnwindingWorkerPool::StackSample& sample,
+               const LibunwindstackResult& libunwindstack_result) {
+          uprobes_unwinding_visitor_->OnStackSampleUnwound(sample.pid, sample.tid,
+                                                           sample.timestamp_ns,
+                                                           sample.maps_generation,
+                                                           libunwindstack_result);
+        },
+        create_unwind_result_cache);
+    uprobes_unwinding_visitor_->SetUnwindingWorkerPool(unwinding_worker_pool_.get());
+  }
   event_processor_.AddVisitor(uprobes_unwinding_visitor_.get());
 }
 
@@ -241,6 +279,7 @@ void TracerThread::OpenUserSpaceProbesRingBuffers(
     int ring_buffer_fd = fds[0];
     std::string buffer_name = absl::StrFormat("uprobes_uretprobes_%u", cpu);
     ring_buffers_.emplace_back(ring_buffer_fd, UPROBES_RING_BUFFER_SIZE_KB, buffer_name);
+    ring_buffer_fds_to_cpu_.insert_or_assign(ring_buffer_fd, cpu);
 
     // Redirect subsequent fds to the cpu specific ring buffer created above.
     for (size_t i = 1; i < fds.size(); ++i) {
@@ -261,6 +300,7 @@ bool TracerThread::OpenMmapTask(const std::vector<int32_t>& cpus) {
     if (mmap_task_ring_buffer.IsOpen()) {
       mmap_task_tracing_fds.push_back(mmap_task_fd);
       mmap_task_ring_buffers.push_back(std::move(mmap_task_ring_buffer));
+      ring_buffer_fds_to_cpu_.insert_or_assign(mmap_task_fd, cpu);
     } else {
       ERROR("Opening mmap, fork, and exit events for cpu %d", cpu);
       CloseFileDescriptors(mmap_task_tracing_fds);
@@ -303,6 +343,7 @@ bool TracerThread::OpenSampling(const std::vector<int32_t>& cpus) {
     if (sampling_ring_buffer.IsOpen()) {
       sampling_tracing_fds.push_back(sampling_fd);
       sampling_ring_buffers.push_back(std::move(sampling_ring_buffer));
+      ring_buffer_fds_to_cpu_.insert_or_assign(sampling_fd, cpu);
     } else {
       ERROR("Opening sampling for cpu %d", cpu);
       CloseFileDescriptors(sampling_tracing_fds);
@@ -328,7 +369,8 @@ bool TracerThread::OpenSampling(const std::vector<int32_t>& cpus) {
 static void OpenRingBuffersOrRedirectOnExisting(
     const absl::flat_hash_map<int32_t, int>& fds_per_cpu,
     absl::flat_hash_map<int32_t, int>* ring_buffer_fds_per_cpu,
-    std::vector<PerfEventRingBuffer>* ring_buffers, uint64_t ring_buffer_size_kb,
+    std::vector<PerfEventRingBuffer>* ring_buffers,
+    absl::flat_hash_map<int, int32_t>* ring_buffer_fds_to_cpu, uint64_t ring_buffer_size_kb,
     std::string_view buffer_name_prefix) {
   ORBIT_SCOPE_FUNCTION;
   // Redirect all events on the same cpu to a single ring buffer.
@@ -345,6 +387,7 @@ static void OpenRingBuffersOrRedirectOnExisting(
       std::string buffer_name = absl::StrFormat("%s_%d", buffer_name_prefix, cpu);
       ring_buffers->emplace_back(ring_buffer_fd, ring_buffer_size_kb, buffer_name);
       ring_buffer_fds_per_cpu->emplace(cpu, ring_buffer_fd);
+      ring_buffer_fds_to_cpu->insert_or_assign(ring_buffer_fd, cpu);
     }
   }
 }
@@ -369,7 +412,8 @@ static bool OpenFileDescriptorsAndRingBuffersForAllTracepoints(
     const std::vector<TracepointToOpen>& tracepoints_to_open, const std::vector<int32_t>& cpus,
     std::vector<int>* tracing_fds, uint64_t ring_buffer_size_kb,
     absl::flat_hash_map<int32_t, int>* tracepoint_ring_buffer_fds_per_cpu_for_redirection,
-    std::vector<PerfEventRingBuffer>* ring_buffers) {
+    std::vector<PerfEventRingBuffer>* ring_buffers,
+    absl::flat_hash_map<int, int32_t>* ring_buffer_fds_to_cpu) {
   ORBIT_SCOPE_FUNCTION;
   absl::flat_hash_map<size_t, absl::flat_hash_map<int32_t, int>> index_to_tracepoint_fds_per_cpu;
   bool tracepoint_event_open_errors = false;
@@ -421,7 +465,8 @@ static bool OpenFileDescriptorsAndRingBuffersForAllTracepoints(
 
     OpenRingBuffersOrRedirectOnExisting(
         tracepoint_fds_per_cpu, tracepoint_ring_buffer_fds_per_cpu_for_redirection, ring_buffers,
-        ring_buffer_size_kb, absl::StrFormat("%s:%s", tracepoint_category, tracepoint_name));
+        ring_buffer_fds_to_cpu, ring_buffer_size_kb,
+        absl::StrFormat("%s:%s", tracepoint_category, tracepoint_name));
   }
   return true;
 }
@@ -432,7 +477,7 @@ bool TracerThread::OpenThreadNameTracepoints(const std::vector<int32_t>& cpus) {
   return OpenFileDescriptorsAndRingBuffersForAllTracepoints(
       {{"task", "task_newtask", &task_newtask_ids_}, {"task", "task_rename", &task_rename_ids_}},
       cpus, &tracing_fds_, THREAD_NAMES_RING_BUFFER_SIZE_KB,
-      &thread_name_tracepoint_ring_buffer_fds_per_cpu, &ring_buffers_);
+      &thread_name_tracepoint_ring_buffer_fds_per_cpu, &ring_buffers_, &ring_buffer_fds_to_cpu_);
 }
 
 void TracerThread::InitSwitchesStatesNamesVisitor() {
@@ -464,7 +509,7 @@ bool TracerThread::OpenContextSwitchAndThreadStateTracepoints(const std::vector<
   return OpenFileDescriptorsAndRingBuffersForAllTracepoints(
       tracepoints_to_open, cpus, &tracing_fds_,
       CONTEXT_SWITCHES_AND_THREAD_STATE_RING_BUFFER_SIZE_KB,
-      &thread_state_tracepoint_ring_buffer_fds_per_cpu, &ring_buffers_);
+      &thread_state_tracepoint_ring_buffer_fds_per_cpu, &ring_buffers_, &ring_buffer_fds_to_cpu_);
 }
 
 void TracerThread::InitGpuTracepointEventVisitor() {
@@ -488,12 +533,18 @@ void TracerThread::InitGpuTracepointEventVisitor() {
 bool TracerThread::OpenGpuTracepoints(const std::vector<int32_t>& cpus) {
   ORBIT_SCOPE_FUNCTION;
   absl::flat_hash_map<int32_t, int> gpu_tracepoint_ring_buffer_fds_per_cpu;
-  return OpenFileDescriptorsAndRingBuffersForAllTracepoints(
+  const size_t ring_buffer_count_before = ring_buffers_.size();
+  bool opened = OpenFileDescriptorsAndRingBuffersForAllTracepoints(
       {{"amdgpu", "amdgpu_cs_ioctl", &amdgpu_cs_ioctl_ids_},
        {"amdgpu", "amdgpu_sched_run_job", &amdgpu_sched_run_job_ids_},
        {"dma_fence", "dma_fence_signaled", &dma_fence_signaled_ids_}},
       cpus, &tracing_fds_, GPU_TRACING_RING_BUFFER_SIZE_KB, &gpu_tracepoint_ring_buffer_fds_per_cpu,
-      &ring_buffers_);
+      &ring_buffers_, &ring_buffer_fds_to_cpu_);
+  // These ring buffers don't redirect to others, so they only contain GPU tracepoint events.
+  for (size_t i = ring_buffer_count_before; i < ring_buffers_.size(); ++i) {
+    fds_with_out_of_order_events_.insert(ring_buffers_[i].GetFileDescriptor());
+  }
+  return opened;
 }
 
 bool TracerThread::OpenInstrumentedTracepoints(const std::vector<int32_t>& cpus) {
@@ -506,7 +557,7 @@ bool TracerThread::OpenInstrumentedTracepoints(const std::vector<int32_t>& cpus)
     tracepoint_event_open_errors |= !OpenFileDescriptorsAndRingBuffersForAllTracepoints(
         {{selected_tracepoint.category().c_str(), selected_tracepoint.name().c_str(), &stream_ids}},
         cpus, &tracing_fds_, INSTRUMENTED_TRACEPOINTS_RING_BUFFER_SIZE_KB,
-        &tracepoint_ring_buffer_fds_per_cpu, &ring_buffers_);
+        &tracepoint_ring_buffer_fds_per_cpu, &ring_buffers_, &ring_buffer_fds_to_cpu_);
 
     for (const auto& stream_id : stream_ids) {
       ids_to_tracepoint_info_.emplace(stream_id, selected_tracepoint);
@@ -645,6 +696,11 @@ void TracerThread::Startup() {
     listener_->OnErrorsWithPerfEventOpenEvent(std::move(errors_with_perf_event_open_event));
   }
 
+  for (const PerfEventRingBuffer& ring_buffer : ring_buffers_) {
+    fds_to_last_timestamp_ns_.emplace(ring_buffer.GetFileDescriptor(), 0);
+    fds_to_last_emptied_timestamp_ns_.emplace(ring_buffer.GetFileDescriptor(), 0);
+  }
+
   // Start recording events.
   for (int fd : tracing_fds_) {
     perf_event_enable(fd);
@@ -762,29 +818,96 @@ void TracerThread::ProcessOneRecord(PerfEventRingBuffer* ring_buffer) {
   }
 
   if (event_timestamp_ns != 0) {
-    fds_to_last_timestamp_ns_.insert_or_assign(ring_buffer->GetFileDescriptor(),
-                                               event_timestamp_ns);
+    auto last_timestamp_it = fds_to_last_timestamp_ns_.find(ring_buffer->GetFileDescriptor());
+    CHECK(last_timestamp_it != fds_to_last_timestamp_ns_.end());
+    last_timestamp_it->second = event_timestamp_ns;
+    if (adaptive_event_processing_delay_) {
+      UpdateEmptyRingBufferWatermarkMargin(ring_buffer->GetFileDescriptor(), event_timestamp_ns);
+    }
   }
 }
 
-void TracerThread::Run(const std::shared_ptr<std::atomic<bool>>& exit_requested) {
-  FAIL_IF(listener_ == nullptr, "No listener set");
+void TracerThread::UpdateEmptyRingBufferWatermarkMargin(int fd, uint64_t event_timestamp_ns) {
+  if (fds_with_out_of_order_events_.contains(fd)) return;
+  auto emptied_timestamp_it = fds_to_last_emptied_timestamp_ns_.find(fd);
+  CHECK(emptied_timestamp_it != fds_to_last_emptied_timestamp_ns_.end());
+  const uint64_t emptied_timestamp_ns = emptied_timestamp_it->second;
+  if (event_timestamp_ns >= emptied_timestamp_ns) return;
+  const uint64_t lateness_ns = emptied_timestamp_ns - event_timestamp_ns;
+  uint64_t margin_ns = empty_ring_buffer_watermark_margin_ns_.load(std::memory_order_relaxed);
+  while (lateness_ns > margin_ns) {
+    if (empty_ring_buffer_watermark_margin_ns_.compare_exchange_weak(margin_ns, 2 * lateness_ns,
+                                                                     std::memory_order_relaxed)) {
+      LOG("Ring buffer record delivered %.3f ms late, increasing the watermark margin to %.3f ms",
+          lateness_ns / 1e6, 2 * lateness_ns / 1e6);
+      break;
+    }
+  }
+}
 
-  Startup();
+// Returns an epoll file descriptor that becomes ready when one of the ring buffers has new data, or
+// -1 in case of failure.
+static int CreateEpollForRingBuffers(const std::vector<PerfEventRingBuffer*>& ring_buffers) {
+  int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd == -1) {
+    ERROR("epoll_create1: %s", SafeStrerror(errno));
+    return -1;
+  }
+  for (PerfEventRingBuffer* ring_buffer : ring_buffers) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = ring_buffer->GetFileDescriptor();
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ring_buffer->GetFileDescriptor(), &event) == -1) {
+      ERROR("epoll_ctl on ring buffer '%s': %s", ring_buffer->GetName(), SafeStrerror(errno));
+      close(epoll_fd);
+      return -1;
+    }
+  }
+  return epoll_fd;
+}
 
+void TracerThread::PollRingBuffers(const std::vector<PerfEventRingBuffer*>& ring_buffers,
+                                   const std::shared_ptr<std::atomic<bool>>& exit_requested,
+                                   bool print_stats) {
   bool last_iteration_saw_events = false;
-  std::thread deferred_events_thread(&TracerThread::ProcessDeferredEvents, this);
+
+  // Instead of sleeping for a fixed time when all ring buffers are empty, wait until one of them
+  // reaches its wakeup watermark. Keep polling if epoll is not available.
+  int epoll_fd = -1;
+  if (event_driven_ring_buffer_reads_) {
+    epoll_fd = CreateEpollForRingBuffers(ring_buffers);
+  }
+  std::vector<epoll_event> ready_events(std::max<size_t>(ring_buffers.size(), 1));
 
   while (!(*exit_requested)) {
-    ORBIT_SCOPE("TracerThread::Run iteration");
+    ORBIT_SCOPE("TracerThread::PollRingBuffers iteration");
 
     if (!last_iteration_saw_events) {
       // Periodically print event statistics.
-      PrintStatsIfTimerElapsed();
+      if (print_stats) {
+        PrintStatsIfTimerElapsed();
+      }
 
-      // Sleep if there was no new event in the last iteration so that we are
-      // not constantly polling. Don't sleep so long that ring buffers overflow.
-      {
+      if (epoll_fd != -1) {
+        ORBIT_SCOPE("Wait");
+        int ready_count =
+            epoll_wait(epoll_fd, ready_events.data(), static_cast<int>(ready_events.size()),
+                       EPOLL_TIMEOUT_ON_EMPTY_RING_BUFFERS_MS);
+        if (ready_count == -1 && errno != EINTR) {
+          ERROR("epoll_wait: %s", SafeStrerror(errno));
+          close(epoll_fd);
+          epoll_fd = -1;
+        }
+        for (int i = 0; i < ready_count; ++i) {
+          // The event was disabled or its task exited: stop watching it, as with level-triggered
+          // epoll it would otherwise be reported again immediately.
+          if ((ready_events[i].events & EPOLLHUP) != 0) {
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, ready_events[i].data.fd, nullptr);
+          }
+        }
+      } else {
+        // Sleep if there was no new event in the last iteration so that we are
+        // not constantly polling. Don't sleep so long that ring buffers overflow.
         ORBIT_SCOPE("Sleep");
         usleep(IDLE_TIME_ON_EMPTY_RING_BUFFERS_US);
       }
@@ -795,11 +918,18 @@ void TracerThread::Run(const std::shared_ptr<std::atomic<bool>>& exit_requested)
     // Read and process events from all ring buffers. In order to ensure that no
     // buffer is read constantly while others overflow, we schedule the reading
     // using round-robin like scheduling.
-    for (PerfEventRingBuffer& ring_buffer : ring_buffers_) {
+    for (PerfEventRingBuffer* ring_buffer : ring_buffers) {
       if (*exit_requested) {
         break;
       }
 
+      // If the ring buffer is emptied in this round, every record with a timestamp older than this
+      // (up to empty_ring_buffer_watermark_margin_ns_) has been read.
+      uint64_t round_begin_timestamp_ns = 0;
+      if (adaptive_event_processing_delay_) {
+        round_begin_timestamp_ns = orbit_base::CaptureTimestampNs();
+      }
+
       // Read up to ROUND_ROBIN_POLLING_BATCH_SIZE (5) new events.
       // TODO: Some event types (e.g., stack samples) have a much longer
       //  processing time but are less frequent than others (e.g., context
@@ -809,20 +939,114 @@ void TracerThread::Run(const std::shared_ptr<std::atomic<bool>>& exit_requested)
         if (*exit_requested) {
           break;
         }
-        if (!ring_buffer.HasNewData()) {
+        if (!ring_buffer->HasNewData()) {
+          if (adaptive_event_processing_delay_) {
+            auto emptied_timestamp_it =
+                fds_to_last_emptied_timestamp_ns_.find(ring_buffer->GetFileDescriptor());
+            CHECK(emptied_timestamp_it != fds_to_last_emptied_timestamp_ns_.end());
+            emptied_timestamp_it->second = round_begin_timestamp_ns;
+          }
           break;
         }
 
         last_iteration_saw_events = true;
-        ProcessOneRecord(&ring_buffer);
+        ProcessOneRecord(ring_buffer);
       }
     }
   }
 
+  if (epoll_fd != -1) {
+    close(epoll_fd);
+  }
+}
+
+// Shards the ring buffers by cpu across ring_buffer_reader_thread_count_ threads, each pinned to
+// the cpus whose ring buffers it reads. Records are decoded and copied out of the ring buffers in
+// parallel, while the merge in timestamp order is still done by event_processor_ on the thread
+// running ProcessDeferredEvents.
+void TracerThread::RunShardedRingBufferReaders(
+    const std::shared_ptr<std::atomic<bool>>& exit_requested) {
+  std::vector<int32_t> cpus;
+  cpus.reserve(ring_buffer_fds_to_cpu_.size());
+  for (const auto& [unused_fd, cpu] : ring_buffer_fds_to_cpu_) {
+    cpus.push_back(cpu);
+  }
+  std::vector<std::vector<int32_t>> cpus_per_shard =
+      PartitionCpusIntoShards(std::move(cpus), ring_buffer_reader_thread_count_);
+
+  absl::flat_hash_map<int32_t, size_t> cpu_to_shard_index;
+  for (size_t shard_index = 0; shard_index < cpus_per_shard.size(); ++shard_index) {
+    for (int32_t cpu : cpus_per_shard[shard_index]) {
+      cpu_to_shard_index.emplace(cpu, shard_index);
+    }
+  }
+
+  std::vector<std::vector<PerfEventRingBuffer*>> ring_buffers_per_shard(cpus_per_shard.size());
+  for (PerfEventRingBuffer& ring_buffer : ring_buffers_) {
+    auto cpu_it = ring_buffer_fds_to_cpu_.find(ring_buffer.GetFileDescriptor());
+    CHECK(cpu_it != ring_buffer_fds_to_cpu_.end());
+    ring_buffers_per_shard[cpu_to_shard_index.at(cpu_it->second)].push_back(&ring_buffer);
+  }
+
+  LOG("Reading %u ring buffers with %u threads", ring_buffers_.size(),
+      ring_buffers_per_shard.size());
+  std::vector<std::thread> reader_threads;
+  reader_threads.reserve(ring_buffers_per_shard.size());
+  for (size_t shard_index = 0; shard_index < ring_buffers_per_shard.size(); ++shard_index) {
+    reader_threads.emplace_back([this, &exit_requested, &cpus_per_shard, &ring_buffers_per_shard,
+                                 shard_index] {
+      orbit_base::SetCurrentThreadName(absl::StrFormat("RingBufRead%u", shard_index).c_str());
+      // Not being able to pin the thread (e.g., because of the cpuset of the service) is not fatal.
+      SetCurrentThreadAffinity(cpus_per_shard[shard_index]);
+      PollRingBuffers(ring_buffers_per_shard[shard_index], exit_requested, /*print_stats=*/false);
+    });
+  }
+
+  while (!(*exit_requested)) {
+    PrintStatsIfTimerElapsed();
+    usleep(IDLE_TIME_ON_EMPTY_RING_BUFFERS_US);
+  }
+
+  for (std::thread& reader_thread : reader_threads) {
+    reader_thread.join();
+  }
+}
+
+void TracerThread::Run(const std::shared_ptr<std::atomic<bool>>& exit_requested) {
+  FAIL_IF(listener_ == nullptr, "No listener set");
+
+  Startup();
+
+  if (event_driven_ring_buffer_reads_) {
+    deferred_events_eventfd_ = eventfd(0, EFD_CLOEXEC);
+    if (deferred_events_eventfd_ == -1) {
+      ERROR("eventfd: %s", SafeStrerror(errno));
+    }
+  }
+  std::thread deferred_events_thread(&TracerThread::ProcessDeferredEvents, this);
+
+  if (ring_buffer_reader_thread_count_ > 1) {
+    RunShardedRingBufferReaders(exit_requested);
+  } else {
+    std::vector<PerfEventRingBuffer*> ring_buffers;
+    ring_buffers.reserve(ring_buffers_.size());
+    for (PerfEventRingBuffer& ring_buffer : ring_buffers_) {
+      ring_buffers.push_back(&ring_buffer);
+    }
+    PollRingBuffers(ring_buffers, exit_requested, /*print_stats=*/true);
+  }
+
   // Finish processing all deferred events.
   stop_deferred_thread_ = true;
+  NotifyDeferredEventsThread();
   deferred_events_thread.join();
+  if (deferred_events_eventfd_ != -1) {
+    close(deferred_events_eventfd_);
+    deferred_events_eventfd_ = -1;
+  }
   event_processor_.ProcessAllEvents();
+  // Wait for the last stack samples to be unwound and sent to the listener.
+  unwinding_worker_pool_.reset();
 
   Shutdown();
 }
@@ -884,7 +1108,16 @@ uint64_t TracerThread::ProcessMmapEventAndReturnTimestamp(const perf_event_heade
 
 uint64_t TracerThread::ProcessSampleEventAndReturnTimestamp(const perf_event_header& header,
                                                             PerfEventRingBuffer* ring_buffer) {
-  uint64_t timestamp_ns = ReadSampleRecordTime(ring_buffer);
+  // Only copy the fields needed to dispatch the record, so that records that are filtered out are
+  // never copied out of the ring buffer.
+  perf_event_sample_prefix sample_prefix_copy;
+  const perf_event_sample_prefix* sample_prefix =
+      ViewRecordPrefix(ring_buffer, &sample_prefix_copy);
+  const uint64_t timestamp_ns = sample_prefix->sample_id.time;
+  const uint64_t stream_id = sample_prefix->sample_id.stream_id;
+  const pid_t pid = static_cast<pid_t>(sample_prefix->sample_id.pid);
+  const pid_t tid = static_cast<pid_t>(sample_prefix->sample_id.tid);
+  const uint32_t cpu = sample_prefix->sample_id.cpu;
 
   if (timestamp_ns < effective_capture_start_timestamp_ns_) {
     // Don't consider events that came before all file descriptors had been enabled.
@@ -892,7 +1125,6 @@ uint64_t TracerThread::ProcessSampleEventAndReturnTimestamp(const perf_event_hea
     return timestamp_ns;
   }
 
-  uint64_t stream_id = ReadSampleRecordStreamId(ring_buffer);
   bool is_uprobe = uprobes_ids_.contains(stream_id);
   bool is_uprobe_with_args = uprobes_with_args_ids_.contains(stream_id);
   bool is_uretprobe = uretprobes_ids_.contains(stream_id);
@@ -918,22 +1150,24 @@ uint64_t TracerThread::ProcessSampleEventAndReturnTimestamp(const perf_event_hea
 
   if (is_uprobe) {
     CHECK(header.size == sizeof(UprobesPerfEvent::ring_buffer_record));
-    auto event = make_unique_for_overwrite<UprobesPerfEvent>();
-    ring_buffer->ConsumeRecord(header, &event->ring_buffer_record);
-    if (event->GetPid() != target_pid_) {
+    if (pid != target_pid_) {
+      ring_buffer->SkipRecord(header);
       return timestamp_ns;
     }
+    auto event = make_unique_for_overwrite<UprobesPerfEvent>();
+    ring_buffer->ConsumeRecord(header, &event->ring_buffer_record);
     event->SetFunction(uprobes_uretprobes_ids_to_function_.at(event->GetStreamId()));
     event->SetOrderedInFileDescriptor(fd);
     DeferEvent(std::move(event));
     ++stats_.uprobes_count;
   } else if (is_uprobe_with_args) {
     CHECK(header.size == sizeof(UprobesWithArgumentsPerfEvent::ring_buffer_record));
-    auto event = make_unique_for_overwrite<UprobesWithArgumentsPerfEvent>();
-    ring_buffer->ConsumeRecord(header, &event->ring_buffer_record);
-    if (event->GetPid() != target_pid_) {
+    if (pid != target_pid_) {
+      ring_buffer->SkipRecord(header);
       return timestamp_ns;
     }
+    auto event = make_unique_for_overwrite<UprobesWithArgumentsPerfEvent>();
+    ring_buffer->ConsumeRecord(header, &event->ring_buffer_record);
     event->SetFunction(uprobes_uretprobes_ids_to_function_.at(event->GetStreamId()));
     event->SetOrderedInFileDescriptor(fd);
     DeferEvent(std::move(event));
@@ -941,30 +1175,30 @@ uint64_t TracerThread::ProcessSampleEventAndReturnTimestamp(const perf_event_hea
 
   } else if (is_uretprobe) {
     CHECK(header.size == sizeof(UretprobesPerfEvent::ring_buffer_record));
-    auto event = make_unique_for_overwrite<UretprobesPerfEvent>();
-    ring_buffer->ConsumeRecord(header, &event->ring_buffer_record);
-    if (event->GetPid() != target_pid_) {
+    if (pid != target_pid_) {
+      ring_buffer->SkipRecord(header);
       return timestamp_ns;
     }
+    auto event = make_unique_for_overwrite<UretprobesPerfEvent>();
+    ring_buffer->ConsumeRecord(header, &event->ring_buffer_record);
     event->SetFunction(uprobes_uretprobes_ids_to_function_.at(event->GetStreamId()));
     event->SetOrderedInFileDescriptor(fd);
     DeferEvent(std::move(event));
     ++stats_.uprobes_count;
   } else if (is_uretprobe_with_retval) {
     CHECK(header.size == sizeof(UretprobesWithReturnValuePerfEvent::ring_buffer_record));
-    auto event = make_unique_for_overwrite<UretprobesWithReturnValuePerfEvent>();
-    ring_buffer->ConsumeRecord(header, &event->ring_buffer_record);
-    if (event->GetPid() != target_pid_) {
+    if (pid != target_pid_) {
+      ring_buffer->SkipRecord(header);
       return timestamp_ns;
     }
+    auto event = make_unique_for_overwrite<UretprobesWithReturnValuePerfEvent>();
+    ring_buffer->ConsumeRecord(header, &event->ring_buffer_record);
     event->SetFunction(uprobes_uretprobes_ids_to_function_.at(event->GetStreamId()));
     event->SetOrderedInFileDescriptor(fd);
     DeferEvent(std::move(event));
     ++stats_.uprobes_count;
 
   } else if (is_stack_sample) {
-    pid_t pid = ReadSampleRecordPid(ring_buffer);
-
     const size_t size_of_stack_sample = sizeof(perf_event_stack_sample_fixed) +
                                         2 * sizeof(uint64_t) /*size and dyn_size*/ +
                                         stack_dump_size_ /*data*/;
@@ -993,7 +1227,6 @@ uint64_t TracerThread::ProcessSampleEventAndReturnTimestamp(const perf_event_hea
     ++stats_.sample_count;
 
   } else if (is_callchain_sample) {
-    pid_t pid = ReadSampleRecordPid(ring_buffer);
     if (pid != target_pid_) {
       ring_buffer->SkipRecord(header);
       return timestamp_ns;
@@ -1060,13 +1293,15 @@ uint64_t TracerThread::ProcessSampleEventAndReturnTimestamp(const perf_event_hea
       return timestamp_ns;
     }
 
-    auto event = ConsumeGenericTracepointPerfEvent(ring_buffer, header);
+    // This event is sent to the listener right away, so it doesn't need to be copied into a
+    // PerfEvent: everything we need is in the sample_id we have already read.
+    ring_buffer->SkipRecord(header);
 
     orbit_grpc_protos::FullTracepointEvent tracepoint_event;
-    tracepoint_event.set_pid(event->GetPid());
-    tracepoint_event.set_tid(event->GetTid());
-    tracepoint_event.set_timestamp_ns(event->GetTimestamp());
-    tracepoint_event.set_cpu(event->GetCpu());
+    tracepoint_event.set_pid(pid);
+    tracepoint_event.set_tid(tid);
+    tracepoint_event.set_timestamp_ns(timestamp_ns);
+    tracepoint_event.set_cpu(cpu);
 
     orbit_grpc_protos::TracepointInfo* tracepoint = tracepoint_event.mutable_tracepoint_info();
     tracepoint->set_name(it->second.name());
@@ -1089,7 +1324,10 @@ uint64_t TracerThread::ProcessLostEventAndReturnTimestamp(const perf_event_heade
   uint64_t timestamp_ns = event->GetTimestamp();
 
   stats_.lost_count += event->GetNumLost();
-  stats_.lost_count_per_buffer[ring_buffer] += event->GetNumLost();
+  {
+    absl::MutexLock lock{&stats_.lost_count_per_buffer_mutex};
+    stats_.lost_count_per_buffer[ring_buffer] += event->GetNumLost();
+  }
 
   // Fetch the timestamp of the last event that preceded this PERF_RECORD_LOST in this same ring
   // buffer.
@@ -1138,7 +1376,79 @@ uint64_t TracerThread::ProcessThrottleUnthrottleEventAndReturnTimestamp(
 
 void TracerThread::DeferEvent(std::unique_ptr<PerfEvent> event) {
   absl::MutexLock lock{&deferred_events_being_buffered_mutex_};
+  // Only wake up the thread processing the deferred events on the first event of a batch.
+  bool was_empty = deferred_events_being_buffered_.empty();
   deferred_events_being_buffered_.emplace_back(std::move(event));
+  if (was_empty) {
+    NotifyDeferredEventsThread();
+  }
+}
+
+void TracerThread::NotifyDeferredEventsThread() {
+  if (deferred_events_eventfd_ == -1) {
+    return;
+  }
+  uint64_t increment = 1;
+  if (write(deferred_events_eventfd_, &increment, sizeof(increment)) == -1) {
+    ERROR("Writing to eventfd: %s", SafeStrerror(errno));
+  }
+}
+
+void TracerThread::WaitForDeferredEvents(bool has_pending_work) {
+  if (deferred_events_eventfd_ == -1) {
+    ORBIT_SCOPE("Sleep");
+    usleep(IDLE_TIME_ON_EMPTY_DEFERRED_EVENTS_US);
+    return;
+  }
+  ORBIT_SCOPE("Wait");
+  // Only block indefinitely when there is nothing left to do until new events arrive, so that an
+  // idle capture doesn't wake up this thread. Otherwise, the events already added to
+  // event_processor_ still need to be processed once they are old enough, and the samples being
+  // unwound need to be reported, even if no new events arrive. Stopping writes to the eventfd.
+  pollfd poll_fd{};
+  poll_fd.fd = deferred_events_eventfd_;
+  poll_fd.events = POLLIN;
+  int ready_count = poll(&poll_fd, 1, has_pending_work ? DEFERRED_EVENTS_WAIT_TIMEOUT_MS : -1);
+  if (ready_count == -1) {
+    if (errno != EINTR) {
+      ERROR("poll on eventfd: %s", SafeStrerror(errno));
+      usleep(IDLE_TIME_ON_EMPTY_DEFERRED_EVENTS_US);
+    }
+    return;
+  }
+  if (ready_count == 0) {
+    return;
+  }
+  // The counter is non-zero, so this doesn't block. It resets the counter.
+  uint64_t counter;
+  if (read(deferred_events_eventfd_, &counter, sizeof(counter)) == -1 && errno != EINTR) {
+    ERROR("Reading from eventfd: %s", SafeStrerror(errno));
+  }
+}
+
+// Returns a timestamp such that all records older than it have already been read from all the ring
+// buffers and deferred. For each ring buffer this is the timestamp of the last record read, or the
+// time it was last found empty if more recent. Ring buffers with out-of-order records can't provide
+// such a guarantee, so they hold back the watermark by PerfEventProcessor::kProcessingDelayMs.
+uint64_t TracerThread::ComputeRingBuffersWatermarkNs() const {
+  constexpr uint64_t kProcessingDelayNs = PerfEventProcessor::kProcessingDelayMs * 1'000'000;
+  const uint64_t margin_ns = empty_ring_buffer_watermark_margin_ns_.load(std::memory_order_relaxed);
+  uint64_t watermark_ns = std::numeric_limits<uint64_t>::max();
+  for (const auto& [fd, last_timestamp_ns] : fds_to_last_timestamp_ns_) {
+    uint64_t fd_watermark_ns = last_timestamp_ns;
+    auto emptied_timestamp_it = fds_to_last_emptied_timestamp_ns_.find(fd);
+    CHECK(emptied_timestamp_it != fds_to_last_emptied_timestamp_ns_.end());
+    uint64_t emptied_timestamp_ns = emptied_timestamp_it->second;
+    if (emptied_timestamp_ns > margin_ns) {
+      fd_watermark_ns = std::max(fd_watermark_ns, emptied_timestamp_ns - margin_ns);
+    }
+    if (fds_with_out_of_order_events_.contains(fd)) {
+      fd_watermark_ns = fd_watermark_ns > kProcessingDelayNs ? fd_watermark_ns - kProcessingDelayNs
+                                                             : 0;
+    }
+    watermark_ns = std::min(watermark_ns, fd_watermark_ns);
+  }
+  return watermark_ns == std::numeric_limits<uint64_t>::max() ? 0 : watermark_ns;
 }
 
 void TracerThread::ProcessDeferredEvents() {
@@ -1150,18 +1460,20 @@ void TracerThread::ProcessDeferredEvents() {
     // deferred events. The last iteration will consume all remaining events.
     should_exit = stop_deferred_thread_;
 
+    // The watermark needs to be computed before taking the deferred events: the ring buffer readers
+    // update it after deferring the events, so all events older than it are taken below.
+    uint64_t watermark_ns = 0;
+    if (adaptive_event_processing_delay_) {
+      watermark_ns = ComputeRingBuffersWatermarkNs();
+    }
+
     {
       absl::MutexLock lock{&deferred_events_being_buffered_mutex_};
       deferred_events_being_buffered_.swap(deferred_events_to_process_);
     }
 
-    if (deferred_events_to_process_.empty()) {
-      ORBIT_SCOPE("Sleep");
-      usleep(IDLE_TIME_ON_EMPTY_DEFERRED_EVENTS_US);
-      continue;
-    }
-
-    {
+    const bool no_new_events = deferred_events_to_process_.empty();
+    if (!no_new_events) {
       ORBIT_SCOPE("AddEvents");
       for (auto& event : deferred_events_to_process_) {
         event_processor_.AddEvent(std::move(event));
@@ -1172,8 +1484,21 @@ void TracerThread::ProcessDeferredEvents() {
     // won't have to be grown again after the swap.
     deferred_events_to_process_.clear();
     {
+      // Also when there are no new events, as events already added can have become old enough.
       ORBIT_SCOPE("ProcessOldEvents");
-      event_processor_.ProcessOldEvents();
+      event_processor_.ProcessOldEvents(watermark_ns);
+    }
+    if (unwinding_worker_pool_ != nullptr) {
+      // Stack samples unwound by the pool are sent to the listener from this thread, like all
+      // other events.
+      ORBIT_SCOPE("ReportUnwoundSamples");
+      unwinding_worker_pool_->ReportUnwoundSamples();
+    }
+
+    if (no_new_events && !should_exit) {
+      WaitForDeferredEvents(
+          event_processor_.HasPendingEvents() ||
+          (unwinding_worker_pool_ != nullptr && unwinding_worker_pool_->HasUnreportedSamples()));
     }
   }
 }
@@ -1201,7 +1526,10 @@ void TracerThread::Reset() {
   ORBIT_SCOPE_FUNCTION;
   tracing_fds_.clear();
   ring_buffers_.clear();
+  ring_buffer_fds_to_cpu_.clear();
   fds_to_last_timestamp_ns_.clear();
+  fds_to_last_emptied_timestamp_ns_.clear();
+  fds_with_out_of_order_events_.clear();
 
   uprobes_uretprobes_ids_to_function_.clear();
   uprobes_ids_.clear();
@@ -1224,7 +1552,9 @@ void TracerThread::Reset() {
   stop_deferred_thread_ = false;
   deferred_events_being_buffered_.clear();
   deferred_events_to_process_.clear();
+  unwinding_worker_pool_.reset();
   uprobes_unwinding_visitor_.reset();
+  unwind_result_cache_.reset();
   switches_states_names_visitor_.reset();
   gpu_event_visitor_.reset();
   event_processor_.ClearVisitors();
@@ -1242,20 +1572,26 @@ void TracerThread::PrintStatsIfTimerElapsed() {
   CHECK(actual_window_s > 0.0);
 
   LOG("Events per second (and total) last %.3f s:", actual_window_s);
-  LOG("  sched switches: %.0f/s (%lu)", stats_.sched_switch_count / actual_window_s,
-      stats_.sched_switch_count);
-  LOG("  samples: %.0f/s (%lu)", stats_.sample_count / actual_window_s, stats_.sample_count);
-  LOG("  u(ret)probes: %.0f/s (%lu)", stats_.uprobes_count / actual_window_s, stats_.uprobes_count);
-  LOG("  gpu events: %.0f/s (%lu)", stats_.gpu_events_count / actual_window_s,
-      stats_.gpu_events_count);
-
-  if (stats_.lost_count_per_buffer.empty()) {
-    LOG("  lost: %.0f/s (%lu)", stats_.lost_count / actual_window_s, stats_.lost_count);
-  } else {
-    LOG("  LOST: %.0f/s (%lu), of which:", stats_.lost_count / actual_window_s, stats_.lost_count);
-    for (const auto& buffer_and_lost_count : stats_.lost_count_per_buffer) {
-      LOG("    from %s: %.0f/s (%lu)", buffer_and_lost_count.first->GetName().c_str(),
-          buffer_and_lost_count.second / actual_window_s, buffer_and_lost_count.second);
+  uint64_t sched_switch_count = stats_.sched_switch_count;
+  LOG("  sched switches: %.0f/s (%lu)", sched_switch_count / actual_window_s, sched_switch_count);
+  uint64_t sample_count = stats_.sample_count;
+  LOG("  samples: %.0f/s (%lu)", sample_count / actual_window_s, sample_count);
+  uint64_t uprobes_count = stats_.uprobes_count;
+  LOG("  u(ret)probes: %.0f/s (%lu)", uprobes_count / actual_window_s, uprobes_count);
+  uint64_t gpu_events_count = stats_.gpu_events_count;
+  LOG("  gpu events: %.0f/s (%lu)", gpu_events_count / actual_window_s, gpu_events_count);
+
+  uint64_t lost_count = stats_.lost_count;
+  {
+    absl::MutexLock lock{&stats_.lost_count_per_buffer_mutex};
+    if (stats_.lost_count_per_buffer.empty()) {
+      LOG("  lost: %.0f/s (%lu)", lost_count / actual_window_s, lost_count);
+    } else {
+      LOG("  LOST: %.0f/s (%lu), of which:", lost_count / actual_window_s, lost_count);
+      for (const auto& buffer_and_lost_count : stats_.lost_count_per_buffer) {
+        LOG("    from %s: %.0f/s (%lu)", buffer_and_lost_count.first->GetName().c_str(),
+            buffer_and_lost_count.second / actual_window_s, buffer_and_lost_count.second);
+      }
     }
   }
 
@@ -1264,17 +1600,26 @@ void TracerThread::PrintStatsIfTimerElapsed() {
       discarded_out_of_order_count == 0 ? "discarded as out of order" : "DISCARDED AS OUT OF ORDER",
       discarded_out_of_order_count / actual_window_s, discarded_out_of_order_count);
 
-  // Ensure we can divide by 0.0 safely in case stats_.sample_count is zero.
+  // Ensure we can divide by 0.0 safely in case sample_count is zero.
   static_assert(std::numeric_limits<double>::is_iec559);
 
   uint64_t unwind_error_count = stats_.unwind_error_count;
   LOG("  unwind errors: %.0f/s (%lu) [%.1f%%]", unwind_error_count / actual_window_s,
-      unwind_error_count, 100.0 * unwind_error_count / stats_.sample_count);
+      unwind_error_count, 100.0 * unwind_error_count / sample_count);
   uint64_t discarded_samples_in_uretprobes_count = stats_.samples_in_uretprobes_count;
   LOG("  samples in u(ret)probes: %.0f/s (%lu) [%.1f%%]",
       discarded_samples_in_uretprobes_count / actual_window_s,
       discarded_samples_in_uretprobes_count,
-      100.0 * discarded_samples_in_uretprobes_count / stats_.sample_count);
+      100.0 * discarded_samples_in_uretprobes_count / sample_count);
+  uint64_t unwind_cache_hit_count = stats_.unwind_cache_hit_count;
+  uint64_t unwind_cache_miss_count = stats_.unwind_cache_miss_count;
+  // Both counts are zero when the cache is disabled or no sample was unwound.
+  if (unwind_cache_hit_count + unwind_cache_miss_count > 0) {
+    LOG("  unwind cache hits: %.0f/s (%lu), misses: %.0f/s (%lu) [%.1f%% hits]",
+        unwind_cache_hit_count / actual_window_s, unwind_cache_hit_count,
+        unwind_cache_miss_count / actual_window_s, unwind_cache_miss_count,
+        100.0 * unwind_cache_hit_count / (unwind_cache_hit_count + unwind_cache_miss_count));
+  }
 
   uint64_t thread_state_count = stats_.thread_state_count;
   LOG("  target's thread states: %.0f/s (%lu)", thread_state_count / actual_window_s,
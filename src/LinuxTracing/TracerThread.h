@@ -8,6 +8,7 @@
 #include <absl/base/thread_annotations.h>
 #include <absl/container/flat_hash_map.h>
 #include <absl/container/flat_hash_set.h>
+#include <absl/container/node_hash_map.h>
 #include <absl/synchronization/mutex.h>
 #include <linux/perf_event.h>
 #include <sys/types.h>
@@ -31,6 +32,8 @@
 #include "PerfEventRingBuffer.h"
 #include "SwitchesStatesNamesVisitor.h"
 #include "TracingInterface/TracerListener.h"
+#include "UnwindResultCache.h"
+#include "UnwindingWorkerPool.h"
 #include "UprobesUnwindingVisitor.h"
 #include "capture.pb.h"
 
@@ -61,7 +64,13 @@ class TracerThread {
 
   void Startup();
   void Shutdown();
+  void PollRingBuffers(const std::vector<PerfEventRingBuffer*>& ring_buffers,
+                       const std::shared_ptr<std::atomic<bool>>& exit_requested, bool print_stats);
+  void RunShardedRingBufferReaders(const std::shared_ptr<std::atomic<bool>>& exit_requested);
   void ProcessOneRecord(PerfEventRingBuffer* ring_buffer);
+  // Grows empty_ring_buffer_watermark_margin_ns_ if the record with `event_timestamp_ns` was read
+  // from ring buffer `fd` after the ring buffer had been found empty at a later time.
+  void UpdateEmptyRingBufferWatermarkMargin(int fd, uint64_t event_timestamp_ns);
   void InitUprobesEventVisitor();
   bool OpenUserSpaceProbes(const std::vector<int32_t>& cpus);
   bool OpenUprobes(const orbit_linux_tracing::Function& function, const std::vector<int32_t>& cpus,
@@ -105,7 +114,10 @@ class TracerThread {
       const perf_event_header& header, PerfEventRingBuffer* ring_buffer);
 
   void DeferEvent(std::unique_ptr<PerfEvent> event);
+  [[nodiscard]] uint64_t ComputeRingBuffersWatermarkNs() const;
   void ProcessDeferredEvents();
+  void WaitForDeferredEvents(bool has_pending_work);
+  void NotifyDeferredEventsThread();
 
   void RetrieveInitialTidToPidAssociationSystemWide();
   void RetrieveInitialThreadStatesOfTarget();
@@ -131,6 +143,19 @@ class TracerThread {
 
   static constexpr uint32_t IDLE_TIME_ON_EMPTY_RING_BUFFERS_US = 5000;
   static constexpr uint32_t IDLE_TIME_ON_EMPTY_DEFERRED_EVENTS_US = 5000;
+  // When waiting with epoll, buffers that haven't reached their wakeup watermark are still read
+  // after this timeout. It needs to stay well below PerfEventProcessor::kProcessingDelayMs, so that
+  // events from these buffers are not discarded as out of order.
+  static constexpr int EPOLL_TIMEOUT_ON_EMPTY_RING_BUFFERS_MS = 50;
+  // Without new deferred events, events already added to event_processor_ and samples still being
+  // unwound are processed after this timeout. When there are none, the thread processing the
+  // deferred events blocks until new events are deferred or the capture is stopped.
+  static constexpr int DEFERRED_EVENTS_WAIT_TIMEOUT_MS = 10;
+  // A ring buffer found empty at some time can still receive records with a slightly older
+  // timestamp, as the kernel takes the timestamp before writing the record. Only records older than
+  // a margin are assumed to have all been read. The margin starts at this value and grows to twice
+  // the largest lateness observed, see empty_ring_buffer_watermark_margin_ns_.
+  static constexpr uint64_t MIN_EMPTY_RING_BUFFER_WATERMARK_MARGIN_NS = 10'000'000;
 
   bool trace_context_switches_;
   pid_t target_pid_;
@@ -141,12 +166,31 @@ class TracerThread {
   bool trace_thread_state_;
   bool trace_gpu_driver_;
   std::vector<orbit_grpc_protos::TracepointInfo> instrumented_tracepoints_;
+  uint32_t ring_buffer_reader_thread_count_;
+  bool event_driven_ring_buffer_reads_;
+  bool adaptive_event_processing_delay_;
+  uint32_t unwinding_thread_count_;
+  uint32_t unwind_result_cache_size_;
 
   orbit_tracing_interface::TracerListener* listener_ = nullptr;
 
   std::vector<int> tracing_fds_;
   std::vector<PerfEventRingBuffer> ring_buffers_;
-  absl::flat_hash_map<int, uint64_t> fds_to_last_timestamp_ns_;
+  // Associates the file descriptor of each ring buffer with the cpu the ring buffer collects events
+  // from. Used to shard the ring buffers across reader threads.
+  absl::flat_hash_map<int, int32_t> ring_buffer_fds_to_cpu_;
+  // All entries are created in Startup. This way the structure of the maps doesn't change while the
+  // ring buffers are being read, and reader threads can update the entries of their own buffers.
+  // The entries are atomic as ComputeRingBuffersWatermarkNs reads them from another thread.
+  absl::node_hash_map<int, std::atomic<uint64_t>> fds_to_last_timestamp_ns_;
+  // The time right before a ring buffer was last read until it was empty.
+  absl::node_hash_map<int, std::atomic<uint64_t>> fds_to_last_emptied_timestamp_ns_;
+  // Ring buffers whose records are not in timestamp order (GPU tracepoints).
+  absl::flat_hash_set<int> fds_with_out_of_order_events_;
+  // Grows when a record is read with a timestamp older than the time its ring buffer was last found
+  // empty by more than the current margin, i.e., when the record was delivered late.
+  std::atomic<uint64_t> empty_ring_buffer_watermark_margin_ns_ =
+      MIN_EMPTY_RING_BUFFER_WATERMARK_MARGIN_NS;
 
   absl::flat_hash_map<uint64_t, const Function*> uprobes_uretprobes_ids_to_function_;
   absl::flat_hash_set<uint64_t> uprobes_ids_;
@@ -170,6 +214,9 @@ class TracerThread {
   std::vector<std::unique_ptr<PerfEvent>> deferred_events_being_buffered_
       ABSL_GUARDED_BY(deferred_events_being_buffered_mutex_);
   absl::Mutex deferred_events_being_buffered_mutex_;
+  // Signaled when deferred_events_being_buffered_ becomes non-empty and when stopping, so that the
+  // thread running ProcessDeferredEvents can block instead of polling. -1 if not available.
+  int deferred_events_eventfd_ = -1;
   std::vector<std::unique_ptr<PerfEvent>> deferred_events_to_process_;
 
   UprobesFunctionCallManager function_call_manager_;
@@ -177,7 +224,12 @@ class TracerThread {
   std::unique_ptr<LibunwindstackMaps> maps_;
   std::unique_ptr<LibunwindstackUnwinder> unwinder_;
   std::unique_ptr<LeafFunctionCallManager> leaf_function_call_manager_;
+  std::unique_ptr<UnwindResultCache> unwind_result_cache_;
+  // Ids of the callstacks interned by uprobes_unwinding_visitor_, shared by all its interners.
+  std::atomic<uint64_t> next_callstack_id_ = 1;
   std::unique_ptr<UprobesUnwindingVisitor> uprobes_unwinding_visitor_;
+  // Declared after uprobes_unwinding_visitor_, as it reports unwound samples to it until destroyed.
+  std::unique_ptr<UnwindingWorkerPool> unwinding_worker_pool_;
   std::unique_ptr<SwitchesStatesNamesVisitor> switches_states_names_visitor_;
   std::unique_ptr<GpuTracepointVisitor> gpu_event_visitor_;
   std::unique_ptr<LostAndDiscardedEventVisitor> lost_and_discarded_event_visitor_;
@@ -191,23 +243,33 @@ class TracerThread {
       uprobes_count = 0;
       gpu_events_count = 0;
       lost_count = 0;
-      lost_count_per_buffer.clear();
+      {
+        absl::MutexLock lock{&lost_count_per_buffer_mutex};
+        lost_count_per_buffer.clear();
+      }
       discarded_out_of_order_count = 0;
       unwind_error_count = 0;
       samples_in_uretprobes_count = 0;
+      unwind_cache_hit_count = 0;
+      unwind_cache_miss_count = 0;
       thread_state_count = 0;
     }
 
-    uint64_t event_count_begin_ns = 0;
-    uint64_t sched_switch_count = 0;
-    uint64_t sample_count = 0;
-    uint64_t uprobes_count = 0;
-    uint64_t gpu_events_count = 0;
-    uint64_t lost_count = 0;
-    absl::flat_hash_map<PerfEventRingBuffer*, uint64_t> lost_count_per_buffer{};
+    // The counters are atomic as ring buffers can be read by multiple threads.
+    std::atomic<uint64_t> event_count_begin_ns = 0;
+    std::atomic<uint64_t> sched_switch_count = 0;
+    std::atomic<uint64_t> sample_count = 0;
+    std::atomic<uint64_t> uprobes_count = 0;
+    std::atomic<uint64_t> gpu_events_count = 0;
+    std::atomic<uint64_t> lost_count = 0;
+    absl::flat_hash_map<PerfEventRingBuffer*, uint64_t> lost_count_per_buffer
+        ABSL_GUARDED_BY(lost_count_per_buffer_mutex){};
+    absl::Mutex lost_count_per_buffer_mutex;
     std::atomic<uint64_t> discarded_out_of_order_count = 0;
     std::atomic<uint64_t> unwind_error_count = 0;
     std::atomic<uint64_t> samples_in_uretprobes_count = 0;
+    std::atomic<uint64_t> unwind_cache_hit_count = 0;
+    std::atomic<uint64_t> unwind_cache_miss_count = 0;
     std::atomic<uint64_t> thread_state_count = 0;
   };
 
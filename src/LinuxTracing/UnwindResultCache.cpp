@@ -0,0 +1,85 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "UnwindResultCache.h"
+
+#include <absl/strings/match.h>
+
+#include <algorithm>
+#include <iterator>
+#include <optional>
+
+#include "OrbitBase/Logging.h"
+
+namespace orbit_linux_tracing {
+
+LibunwindstackResult UnwindResultCache::Unwind(
+    LibunwindstackUnwinder* unwinder, pid_t pid, LibunwindstackMaps* maps,
+    const std::array<uint64_t, PERF_REG_X86_64_MAX>& registers, const void* stack_dump,
+    uint64_t stack_dump_size) {
+  if (max_entry_count_ == 0) {
+    return unwinder->Unwind(pid, maps->Get(), registers, stack_dump, stack_dump_size);
+  }
+
+  // Results computed with older maps can never be reused.
+  if (maps->GetGeneration() != maps_generation_) {
+    entries_.clear();
+    entries_by_key_.clear();
+    maps_generation_ = maps->GetGeneration();
+  }
+
+  const absl::string_view stack_dump_view{static_cast<const char*>(stack_dump), stack_dump_size};
+  Key key{pid, registers};
+  if (auto key_it = entries_by_key_.find(key); key_it != entries_by_key_.end()) {
+    for (std::list<Entry>::iterator entry_it : key_it->second) {
+      if (!Matches(*entry_it, stack_dump_view)) continue;
+      if (hit_counter_ != nullptr) {
+        ++(*hit_counter_);
+      }
+      entries_.splice(entries_.begin(), entries_, entry_it);
+      return entry_it->result;
+    }
+  }
+
+  if (miss_counter_ != nullptr) {
+    ++(*miss_counter_);
+  }
+  LibunwindstackResult result =
+      unwinder->Unwind(pid, maps->Get(), registers, stack_dump, stack_dump_size);
+  if (result.read_process_memory()) {
+    return result;
+  }
+  const uint64_t stack_dump_size_read =
+      std::min(result.stack_dump_size_read().value_or(stack_dump_size), stack_dump_size);
+
+  if (entries_.size() >= max_entry_count_) {
+    EvictLeastRecentlyUsedEntry();
+  }
+  entries_.push_front(Entry{key, std::string{stack_dump_view.substr(0, stack_dump_size_read)},
+                            stack_dump_size_read == stack_dump_size, result});
+  entries_by_key_[key].push_back(entries_.begin());
+  return result;
+}
+
+bool UnwindResultCache::Matches(const Entry& entry, absl::string_view stack_dump) {
+  if (entry.requires_same_stack_dump_size) {
+    return stack_dump == entry.stack_dump_read;
+  }
+  return absl::StartsWith(stack_dump, entry.stack_dump_read);
+}
+
+void UnwindResultCache::EvictLeastRecentlyUsedEntry() {
+  CHECK(!entries_.empty());
+  auto entry_it = std::prev(entries_.end());
+  auto key_it = entries_by_key_.find(entry_it->key);
+  CHECK(key_it != entries_by_key_.end());
+  std::vector<std::list<Entry>::iterator>& entries_of_key = key_it->second;
+  entries_of_key.erase(std::find(entries_of_key.begin(), entries_of_key.end(), entry_it));
+  if (entries_of_key.empty()) {
+    entries_by_key_.erase(key_it);
+  }
+  entries_.erase(entry_it);
+}
+
+}  // namespace orbit_linux_tracing
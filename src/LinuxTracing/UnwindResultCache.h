@@ -0,0 +1,100 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LINUX_TRACING_UNWIND_RESULT_CACHE_H_
+#define LINUX_TRACING_UNWIND_RESULT_CACHE_H_
+
+#include <absl/container/flat_hash_map.h>
+#include <absl/strings/string_view.h>
+#include <asm/perf_regs.h>
+#include <sys/types.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "LibunwindstackMaps.h"
+#include "LibunwindstackUnwinder.h"
+
+namespace orbit_linux_tracing {
+
+// Memoizes LibunwindstackUnwinder::Unwind for stack samples that repeat exactly. This is common, as
+// programs like games run the same code paths over and over, and unwinding is the most expensive
+// part of processing a stack sample.
+//
+// A result is reused when the maps haven't changed (same generation), all the registers are the
+// same, as DWARF information can recover the frames from any of them, and so are the bytes of the
+// stack sample that the unwinder read to compute the result (see
+// LibunwindstackResult::stack_dump_size_read). These bytes are stored with the result and compared
+// in full, so that a hash collision can never return the callstack of a different sample. Results
+// for which the unwinder read memory of the process outside of the stack sample are not cached, as
+// that memory is not part of the sample and can't be compared.
+//
+// Each entry can hold up to a full stack sample, so a cache can take up to `max_entry_count` times
+// the size of a stack sample.
+// When `max_entry_count` results are cached, the least recently used one is evicted before adding
+// a new one.
+// Not thread-safe: each thread unwinding samples needs its own UnwindResultCache.
+class UnwindResultCache {
+ public:
+  explicit UnwindResultCache(size_t max_entry_count, std::atomic<uint64_t>* hit_counter = nullptr,
+                             std::atomic<uint64_t>* miss_counter = nullptr)
+      : max_entry_count_{max_entry_count}, hit_counter_{hit_counter}, miss_counter_{miss_counter} {}
+
+  // Returns the result of LibunwindstackUnwinder::Unwind, from the cache if possible.
+  [[nodiscard]] LibunwindstackResult Unwind(
+      LibunwindstackUnwinder* unwinder, pid_t pid, LibunwindstackMaps* maps,
+      const std::array<uint64_t, PERF_REG_X86_64_MAX>& registers, const void* stack_dump,
+      uint64_t stack_dump_size);
+
+  [[nodiscard]] size_t GetEntryCount() const { return entries_.size(); }
+
+ private:
+  struct Key {
+    pid_t pid;
+    std::array<uint64_t, PERF_REG_X86_64_MAX> registers;
+
+    friend bool operator==(const Key& lhs, const Key& rhs) {
+      return lhs.pid == rhs.pid && lhs.registers == rhs.registers;
+    }
+
+    template <typename H>
+    friend H AbslHashValue(H h, const Key& key) {
+      return H::combine(std::move(h), key.pid, key.registers);
+    }
+  };
+
+  struct Entry {
+    Key key;
+    // The bytes of the stack sample that the unwinder read.
+    std::string stack_dump_read;
+    // When the unwinder read past the end of the stack sample, the result is only valid for a stack
+    // sample of the same size.
+    bool requires_same_stack_dump_size;
+    LibunwindstackResult result;
+  };
+
+  [[nodiscard]] static bool Matches(const Entry& entry, absl::string_view stack_dump);
+  void EvictLeastRecentlyUsedEntry();
+
+  size_t max_entry_count_;
+  std::atomic<uint64_t>* hit_counter_;
+  std::atomic<uint64_t>* miss_counter_;
+
+  uint64_t maps_generation_ = 0;
+  // Ordered from the most recently used to the least recently used.
+  std::list<Entry> entries_;
+  // Samples with the same registers can have different stacks, so each key can have several
+  // entries.
+  absl::flat_hash_map<Key, std::vector<std::list<Entry>::iterator>> entries_by_key_;
+};
+
+}  // namespace orbit_linux_tracing
+
+#endif  // LINUX_TRACING_UNWIND_RESULT_CACHE_H_
@@ -0,0 +1,235 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "LibunwindstackMaps.h"
+#include "LibunwindstackUnwinder.h"
+#include "UnwindResultCache.h"
+
+namespace orbit_linux_tracing {
+
+namespace {
+
+class FakeLibunwindstackMaps : public LibunwindstackMaps {
+ public:
+  unwindstack::MapInfo* Find(uint64_t /*pc*/) override { return nullptr; }
+  unwindstack::Maps* Get() override { return nullptr; }
+  void AddAndSort(uint64_t /*start*/, uint64_t /*end*/, uint64_t /*offset*/, uint64_t /*flags*/,
+                  const std::string& /*name*/, uint64_t /*load_bias*/) override {
+    ++generation_;
+  }
+  [[nodiscard]] uint64_t GetGeneration() const override { return generation_; }
+
+ private:
+  uint64_t generation_ = 0;
+};
+
+// Returns a single frame whose pc is the number of times Unwind has been called, so that tests can
+// tell whether a result was computed again. Reports `stack_dump_size_read` as the part of the stack
+// dump that was read, if set, and whether memory of the process was read as `read_process_memory`.
+class CountingLibunwindstackUnwinder : public LibunwindstackUnwinder {
+ public:
+  LibunwindstackResult Unwind(pid_t /*pid*/, unwindstack::Maps* /*maps*/,
+                              const std::array<uint64_t, PERF_REG_X86_64_MAX>& /*perf_regs*/,
+                              const void* /*stack_dump*/, uint64_t /*stack_dump_size*/,
+                              bool /*offline_memory_only*/, size_t /*max_frames*/) override {
+    ++unwind_count_;
+    unwindstack::FrameData frame{};
+    frame.pc = unwind_count_;
+    return LibunwindstackResult{{frame}, unwindstack::ErrorCode::ERROR_NONE, stack_dump_size_read_,
+                                read_process_memory_};
+  }
+
+  [[nodiscard]] uint64_t unwind_count() const { return unwind_count_; }
+  void set_stack_dump_size_read(std::optional<uint64_t> stack_dump_size_read) {
+    stack_dump_size_read_ = stack_dump_size_read;
+  }
+  void set_read_process_memory(bool read_process_memory) {
+    read_process_memory_ = read_process_memory;
+  }
+
+ private:
+  uint64_t unwind_count_ = 0;
+  std::optional<uint64_t> stack_dump_size_read_;
+  bool read_process_memory_ = false;
+};
+
+constexpr pid_t kPid = 42;
+
+std::array<uint64_t, PERF_REG_X86_64_MAX> MakeRegisters(uint64_t ip, uint64_t sp, uint64_t bp) {
+  std::array<uint64_t, PERF_REG_X86_64_MAX> registers{};
+  registers[PERF_REG_X86_IP] = ip;
+  registers[PERF_REG_X86_SP] = sp;
+  registers[PERF_REG_X86_BP] = bp;
+  return registers;
+}
+
+class UnwindResultCacheTest : public ::testing::Test {
+ protected:
+  uint64_t UnwindAndGetPc(UnwindResultCache* cache,
+                          const std::array<uint64_t, PERF_REG_X86_64_MAX>& registers,
+                          const std::vector<char>& stack) {
+    LibunwindstackResult result =
+        cache->Unwind(&unwinder_, kPid, &maps_, registers, stack.data(), stack.size());
+    EXPECT_EQ(result.frames().size(), 1);
+    return result.frames()[0].pc;
+  }
+
+  FakeLibunwindstackMaps maps_;
+  CountingLibunwindstackUnwinder unwinder_;
+  std::atomic<uint64_t> hit_count_ = 0;
+  std::atomic<uint64_t> miss_count_ = 0;
+  const std::vector<char> stack_ = std::vector<char>(256, 'a');
+};
+
+}  // namespace
+
+TEST_F(UnwindResultCacheTest, ReusesResultOfIdenticalSample) {
+  UnwindResultCache cache{16, &hit_count_, &miss_count_};
+  const auto registers = MakeRegisters(0x1000, 0x7000, 0x7100);
+
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_), 1);
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_), 1);
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_), 1);
+
+  EXPECT_EQ(unwinder_.unwind_count(), 1);
+  EXPECT_EQ(hit_count_, 2);
+  EXPECT_EQ(miss_count_, 1);
+}
+
+TEST_F(UnwindResultCacheTest, UnwindsAgainWhenAnyOtherRegisterDiffers) {
+  UnwindResultCache cache{16};
+  auto registers = MakeRegisters(0x1000, 0x7000, 0x7100);
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_), 1);
+
+  registers[PERF_REG_X86_AX] = 0xABC;
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_), 2);
+  registers[PERF_REG_X86_R15] = 0xDEF;
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_), 3);
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_), 3);
+}
+
+TEST_F(UnwindResultCacheTest, UnwindsAgainWhenIpSpOrBpDiffer) {
+  UnwindResultCache cache{16};
+  EXPECT_EQ(UnwindAndGetPc(&cache, MakeRegisters(0x1000, 0x7000, 0x7100), stack_), 1);
+  EXPECT_EQ(UnwindAndGetPc(&cache, MakeRegisters(0x1001, 0x7000, 0x7100), stack_), 2);
+  EXPECT_EQ(UnwindAndGetPc(&cache, MakeRegisters(0x1000, 0x7008, 0x7100), stack_), 3);
+  EXPECT_EQ(UnwindAndGetPc(&cache, MakeRegisters(0x1000, 0x7000, 0x7108), stack_), 4);
+  EXPECT_EQ(UnwindAndGetPc(&cache, MakeRegisters(0x1000, 0x7000, 0x7100), stack_), 1);
+}
+
+TEST_F(UnwindResultCacheTest, UnwindsAgainWhenStackDiffers) {
+  UnwindResultCache cache{16};
+  const auto registers = MakeRegisters(0x1000, 0x7000, 0x7100);
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_), 1);
+
+  std::vector<char> other_stack = stack_;
+  other_stack.back() = 'b';
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, other_stack), 2);
+
+  std::vector<char> shorter_stack(stack_.begin(), stack_.end() - 8);
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, shorter_stack), 3);
+}
+
+TEST_F(UnwindResultCacheTest, OnlyComparesTheBytesOfTheStackThatWereRead) {
+  UnwindResultCache cache{16};
+  const auto registers = MakeRegisters(0x1000, 0x7000, 0x7100);
+  unwinder_.set_stack_dump_size_read(64);
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_), 1);
+
+  std::vector<char> stack_differing_after_read_bytes = stack_;
+  stack_differing_after_read_bytes[64] = 'b';
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_differing_after_read_bytes), 1);
+
+  std::vector<char> longer_stack = stack_;
+  longer_stack.resize(512, 'c');
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, longer_stack), 1);
+
+  std::vector<char> stack_differing_in_read_bytes = stack_;
+  stack_differing_in_read_bytes[63] = 'b';
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_differing_in_read_bytes), 2);
+
+  std::vector<char> stack_shorter_than_read_bytes(stack_.begin(), stack_.begin() + 32);
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_shorter_than_read_bytes), 3);
+
+  // Both stacks that were unwound are cached for the same registers.
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_), 1);
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_differing_in_read_bytes), 2);
+  EXPECT_EQ(unwinder_.unwind_count(), 3);
+}
+
+TEST_F(UnwindResultCacheTest, RequiresSameSizeWhenTheWholeStackWasRead) {
+  UnwindResultCache cache{16};
+  const auto registers = MakeRegisters(0x1000, 0x7000, 0x7100);
+  unwinder_.set_stack_dump_size_read(stack_.size());
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_), 1);
+
+  std::vector<char> longer_stack = stack_;
+  longer_stack.push_back('a');
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, longer_stack), 2);
+}
+
+TEST_F(UnwindResultCacheTest, DoesNotCacheResultsThatReadProcessMemory) {
+  UnwindResultCache cache{16, &hit_count_, &miss_count_};
+  const auto registers = MakeRegisters(0x1000, 0x7000, 0x7100);
+  unwinder_.set_read_process_memory(true);
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_), 1);
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_), 2);
+  EXPECT_EQ(cache.GetEntryCount(), 0);
+  EXPECT_EQ(hit_count_, 0);
+  EXPECT_EQ(miss_count_, 2);
+}
+
+TEST_F(UnwindResultCacheTest, UnwindsAgainWhenMapsChange) {
+  UnwindResultCache cache{16};
+  const auto registers = MakeRegisters(0x1000, 0x7000, 0x7100);
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_), 1);
+
+  maps_.AddAndSort(0x1000, 0x2000, 0, 0, "module", 0);
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_), 2);
+  EXPECT_EQ(cache.GetEntryCount(), 1);
+}
+
+TEST_F(UnwindResultCacheTest, IsBounded) {
+  constexpr size_t kMaxEntryCount = 4;
+  UnwindResultCache cache{kMaxEntryCount};
+  for (uint64_t ip = 0; ip < 3 * kMaxEntryCount; ++ip) {
+    EXPECT_EQ(UnwindAndGetPc(&cache, MakeRegisters(ip, 0x7000, 0x7100), stack_), ip + 1);
+    EXPECT_LE(cache.GetEntryCount(), kMaxEntryCount);
+  }
+}
+
+TEST_F(UnwindResultCacheTest, EvictsLeastRecentlyUsedEntry) {
+  UnwindResultCache cache{2};
+  EXPECT_EQ(UnwindAndGetPc(&cache, MakeRegisters(0x1000, 0x7000, 0x7100), stack_), 1);
+  EXPECT_EQ(UnwindAndGetPc(&cache, MakeRegisters(0x2000, 0x7000, 0x7100), stack_), 2);
+  // Use the first entry again, so that the second one is the least recently used.
+  EXPECT_EQ(UnwindAndGetPc(&cache, MakeRegisters(0x1000, 0x7000, 0x7100), stack_), 1);
+
+  EXPECT_EQ(UnwindAndGetPc(&cache, MakeRegisters(0x3000, 0x7000, 0x7100), stack_), 3);
+  EXPECT_EQ(cache.GetEntryCount(), 2);
+  EXPECT_EQ(UnwindAndGetPc(&cache, MakeRegisters(0x1000, 0x7000, 0x7100), stack_), 1);
+  EXPECT_EQ(UnwindAndGetPc(&cache, MakeRegisters(0x3000, 0x7000, 0x7100), stack_), 3);
+  EXPECT_EQ(UnwindAndGetPc(&cache, MakeRegisters(0x2000, 0x7000, 0x7100), stack_), 4);
+}
+
+TEST_F(UnwindResultCacheTest, ZeroMaxEntryCountDisablesCache) {
+  UnwindResultCache cache{0, &hit_count_, &miss_count_};
+  const auto registers = MakeRegisters(0x1000, 0x7000, 0x7100);
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_), 1);
+  EXPECT_EQ(UnwindAndGetPc(&cache, registers, stack_), 2);
+  EXPECT_EQ(cache.GetEntryCount(), 0);
+  EXPECT_EQ(hit_count_, 0);
+  EXPECT_EQ(miss_count_, 0);
+}
+
+}  // namespace orbit_linux_tracing
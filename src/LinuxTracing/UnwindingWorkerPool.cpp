@@ -0,0 +1,178 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "UnwindingWorkerPool.h"
+
+#include <absl/strings/str_format.h>
+
+#include <utility>
+
+#include "Introspection/Introspection.h"
+#include "OrbitBase/Logging.h"
+#include "OrbitBase/ThreadUtils.h"
+
+namespace orbit_linux_tracing {
+
+UnwindingWorkerPool::UnwindingWorkerPool(
+    size_t thread_count, const std::function<std::unique_ptr<LibunwindstackMaps>()>& maps_factory,
+    const std::function<std::unique_ptr<LibunwindstackUnwinder>()>& unwinder_factory,
+    UnwoundCallback unwound_callback,
+    const std::function<std::unique_ptr<UnwindResultCache>()>& unwind_result_cache_factory)
+    : unwound_callback_{std::move(unwound_callback)} {
+  CHECK(thread_count > 0);
+  for (size_t i = 0; i < thread_count; ++i) {
+    auto worker = std::make_unique<Worker>();
+    worker->maps = maps_factory();
+    CHECK(worker->maps != nullptr);
+    worker->unwinder = unwinder_factory();
+    CHECK(worker->unwinder != nullptr);
+    if (unwind_result_cache_factory != nullptr) {
+      worker->unwind_result_cache = unwind_result_cache_factory();
+    }
+    workers_.emplace_back(std::move(worker));
+  }
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    Worker* worker = workers_[i].get();
+    worker->thread = std::thread{[this, worker, i] {
+      orbit_base::SetCurrentThreadName(absl::StrFormat("Unwinder%u", i).c_str());
+      RunWorker(worker);
+    }};
+  }
+}
+
+UnwindingWorkerPool::~UnwindingWorkerPool() {
+  for (std::unique_ptr<Worker>& worker : workers_) {
+    absl::MutexLock lock{&worker->mutex};
+    worker->exit_requested = true;
+  }
+  // The workers only exit once their queue is empty.
+  for (std::unique_ptr<Worker>& worker : workers_) {
+    worker->thread.join();
+  }
+  ReportUnwoundSamples();
+  absl::MutexLock lock{&unwound_samples_mutex_};
+  CHECK(unwound_samples_.empty());
+  CHECK(next_sequence_number_to_report_ == next_sequence_number_);
+}
+
+void UnwindingWorkerPool::SubmitSample(StackSample sample) {
+  ReportUnwoundSamples();
+
+  Worker* worker = workers_[next_worker_index_].get();
+  next_worker_index_ = (next_worker_index_ + 1) % workers_.size();
+
+  absl::MutexLock lock{&worker->mutex};
+  worker->mutex.Await(absl::Condition(
+      +[](Worker* worker) {
+        return worker->pending_sample_count < kMaxPendingSamplesPerThread;
+      },
+      worker));
+  worker->tasks.emplace_back(SequencedStackSample{next_sequence_number_, std::move(sample)});
+  ++worker->pending_sample_count;
+  ++next_sequence_number_;
+}
+
+void UnwindingWorkerPool::AddAndSortMaps(uint64_t start, uint64_t end, uint64_t offset,
+                                         uint64_t flags, const std::string& name,
+                                         uint64_t load_bias) {
+  for (std::unique_ptr<Worker>& worker : workers_) {
+    absl::MutexLock lock{&worker->mutex};
+    worker->tasks.emplace_back(MapsUpdate{start, end, offset, flags, name, load_bias});
+  }
+}
+
+void UnwindingWorkerPool::WaitForSubmittedSamples() {
+  struct WaitState {
+    UnwindingWorkerPool* pool;
+    uint64_t submitted_sample_count;
+  } wait_state{this, next_sequence_number_};
+  {
+    absl::MutexLock lock{&unwound_samples_mutex_};
+    // Samples are only reported on this thread, so all samples have been unwound when the ones
+    // reported and the ones waiting to be reported add up to the ones submitted.
+    unwound_samples_mutex_.Await(absl::Condition(
+        +[](WaitState* wait_state) {
+          return wait_state->pool->next_sequence_number_to_report_ +
+                     wait_state->pool->unwound_samples_.size() >=
+                 wait_state->submitted_sample_count;
+        },
+        &wait_state));
+  }
+  ReportUnwoundSamples();
+}
+
+bool UnwindingWorkerPool::HasUnreportedSamples() {
+  absl::MutexLock lock{&unwound_samples_mutex_};
+  return next_sequence_number_to_report_ < next_sequence_number_;
+}
+
+void UnwindingWorkerPool::RunWorker(Worker* worker) {
+  while (true) {
+    std::variant<MapsUpdate, SequencedStackSample> task;
+    {
+      absl::MutexLock lock{&worker->mutex};
+      worker->mutex.Await(absl::Condition(
+          +[](Worker* worker) {
+            return !worker->tasks.empty() || worker->exit_requested;
+          },
+          worker));
+      if (worker->tasks.empty()) {
+        return;
+      }
+      task = std::move(worker->tasks.front());
+      worker->tasks.pop_front();
+    }
+
+    if (auto* maps_update = std::get_if<MapsUpdate>(&task); maps_update != nullptr) {
+      worker->maps->AddAndSort(maps_update->start, maps_update->end, maps_update->offset,
+                               maps_update->flags, maps_update->name, maps_update->load_bias);
+      continue;
+    }
+
+    auto& [sequence_number, sample] = std::get<SequencedStackSample>(task);
+    LibunwindstackResult result = [&] {
+      ORBIT_SCOPE("Unwind");
+      if (worker->unwind_result_cache != nullptr) {
+        return worker->unwind_result_cache->Unwind(worker->unwinder.get(), sample.pid,
+                                                   worker->maps.get(), sample.registers,
+                                                   sample.stack_data.get(), sample.stack_size);
+      }
+      return worker->unwinder->Unwind(sample.pid, worker->maps->Get(), sample.registers,
+                                      sample.stack_data.get(), sample.stack_size);
+    }();
+    // The copy of the stack is no longer needed, release it before the result waits to be reported.
+    sample.stack_data.reset();
+    {
+      absl::MutexLock lock{&worker->mutex};
+      --worker->pending_sample_count;
+    }
+    OnSampleUnwound(sequence_number, std::move(sample), std::move(result));
+  }
+}
+
+void UnwindingWorkerPool::OnSampleUnwound(uint64_t sequence_number, StackSample sample,
+                                          LibunwindstackResult result) {
+  absl::MutexLock lock{&unwound_samples_mutex_};
+  unwound_samples_.emplace(sequence_number, std::make_pair(std::move(sample), std::move(result)));
+}
+
+void UnwindingWorkerPool::ReportUnwoundSamples() {
+  std::vector<std::pair<StackSample, LibunwindstackResult>> samples_to_report;
+  {
+    absl::MutexLock lock{&unwound_samples_mutex_};
+    for (auto it = unwound_samples_.find(next_sequence_number_to_report_);
+         it != unwound_samples_.end();
+         it = unwound_samples_.find(next_sequence_number_to_report_)) {
+      samples_to_report.emplace_back(std::move(it->second));
+      unwound_samples_.erase(it);
+      ++next_sequence_number_to_report_;
+    }
+  }
+  // Don't hold the lock while calling the callback, so that the workers can keep adding results.
+  for (const auto& [sample, result] : samples_to_report) {
+    unwound_callback_(sample, result);
+  }
+}
+
+}  // namespace orbit_linux_tracing
@@ -0,0 +1,142 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LINUX_TRACING_UNWINDING_WORKER_POOL_H_
+#define LINUX_TRACING_UNWINDING_WORKER_POOL_H_
+
+#include <absl/base/thread_annotations.h>
+#include <absl/container/flat_hash_map.h>
+#include <absl/synchronization/mutex.h>
+#include <asm/perf_regs.h>
+#include <sys/types.h>
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include "LibunwindstackMaps.h"
+#include "LibunwindstackUnwinder.h"
+#include "UnwindResultCache.h"
+
+namespace orbit_linux_tracing {
+
+// Unwinds stack samples on a pool of threads, so that DWARF unwinding doesn't happen on the thread
+// processing all perf_event_open events in order.
+//
+// Each thread keeps its own copy of the maps of the target process, created with `maps_factory`,
+// and its own LibunwindstackUnwinder. Changes to the maps are submitted to all threads with
+// AddAndSortMaps, in the same order relative to the samples as they happen. This way every sample
+// is unwound against the maps as they were when the sample was taken. Also, the threads don't share
+// libunwindstack's Elf objects, whose unwinding steps are serialized by a lock. If
+// `unwind_result_cache_factory` is set, each thread also gets its own UnwindResultCache.
+//
+// `unwound_callback` is called with the result of each sample, in the same order in which the
+// samples were submitted. It is never called from the threads of the pool: the results are handed
+// back to the thread that owns the pool, which reports them from SubmitSample,
+// ReportUnwoundSamples, WaitForSubmittedSamples and the destructor. These must all be called from
+// the same thread, or at least never concurrently. This way the callback can use objects that are
+// not thread-safe, like the TracerListener, together with the code processing the other events.
+class UnwindingWorkerPool {
+ public:
+  struct StackSample {
+    pid_t pid;
+    pid_t tid;
+    uint64_t timestamp_ns;
+    std::array<uint64_t, PERF_REG_X86_64_MAX> registers;
+    std::unique_ptr<char[]> stack_data;
+    uint64_t stack_size;
+    // Opaque to the pool: passed back to `unwound_callback` with the rest of the sample.
+    uint64_t maps_generation;
+  };
+
+  using UnwoundCallback =
+      std::function<void(const StackSample& sample, const LibunwindstackResult& result)>;
+
+  UnwindingWorkerPool(
+      size_t thread_count, const std::function<std::unique_ptr<LibunwindstackMaps>()>& maps_factory,
+      const std::function<std::unique_ptr<LibunwindstackUnwinder>()>& unwinder_factory,
+      UnwoundCallback unwound_callback,
+      const std::function<std::unique_ptr<UnwindResultCache>()>& unwind_result_cache_factory =
+          nullptr);
+
+  UnwindingWorkerPool(const UnwindingWorkerPool&) = delete;
+  UnwindingWorkerPool& operator=(const UnwindingWorkerPool&) = delete;
+  UnwindingWorkerPool(UnwindingWorkerPool&&) = delete;
+  UnwindingWorkerPool& operator=(UnwindingWorkerPool&&) = delete;
+
+  // Waits for all the submitted samples to be unwound and passed to the callback.
+  ~UnwindingWorkerPool();
+
+  // Reports the samples already unwound first. Blocks if the thread the sample is assigned to
+  // already has kMaxPendingSamplesPerThread samples to unwind, as each of them holds a copy of the
+  // stack.
+  void SubmitSample(StackSample sample);
+
+  // Passes to the callback the samples that have been unwound and whose preceding samples have all
+  // been reported. Doesn't block on samples still being unwound.
+  void ReportUnwoundSamples();
+
+  void AddAndSortMaps(uint64_t start, uint64_t end, uint64_t offset, uint64_t flags,
+                      const std::string& name, uint64_t load_bias);
+
+  // Returns when all the samples submitted so far have been passed to the callback.
+  void WaitForSubmittedSamples();
+
+  // Whether some of the samples submitted so far haven't been passed to the callback yet.
+  [[nodiscard]] bool HasUnreportedSamples();
+
+  static constexpr size_t kMaxPendingSamplesPerThread = 256;
+
+ private:
+  struct MapsUpdate {
+    uint64_t start;
+    uint64_t end;
+    uint64_t offset;
+    uint64_t flags;
+    std::string name;
+    uint64_t load_bias;
+  };
+
+  struct SequencedStackSample {
+    uint64_t sequence_number;
+    StackSample sample;
+  };
+
+  struct Worker {
+    std::unique_ptr<LibunwindstackMaps> maps;
+    std::unique_ptr<LibunwindstackUnwinder> unwinder;
+    std::unique_ptr<UnwindResultCache> unwind_result_cache;
+    absl::Mutex mutex;
+    std::deque<std::variant<MapsUpdate, SequencedStackSample>> tasks ABSL_GUARDED_BY(mutex);
+    size_t pending_sample_count ABSL_GUARDED_BY(mutex) = 0;
+    bool exit_requested ABSL_GUARDED_BY(mutex) = false;
+    std::thread thread;
+  };
+
+  void RunWorker(Worker* worker);
+  void OnSampleUnwound(uint64_t sequence_number, StackSample sample, LibunwindstackResult result);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  size_t next_worker_index_ = 0;
+  uint64_t next_sequence_number_ = 0;
+
+  UnwoundCallback unwound_callback_;
+  // Unwound samples that haven't been passed to the callback yet, either because some samples
+  // submitted before them are still being unwound, or because ReportUnwoundSamples hasn't been
+  // called since.
+  absl::Mutex unwound_samples_mutex_;
+  absl::flat_hash_map<uint64_t, std::pair<StackSample, LibunwindstackResult>> unwound_samples_
+      ABSL_GUARDED_BY(unwound_samples_mutex_);
+  uint64_t next_sequence_number_to_report_ ABSL_GUARDED_BY(unwound_samples_mutex_) = 0;
+};
+
+}  // namespace orbit_linux_tracing
+
+#endif  // LINUX_TRACING_UNWINDING_WORKER_POOL_H_
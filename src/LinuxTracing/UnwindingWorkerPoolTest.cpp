@@ -0,0 +1,188 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <absl/synchronization/mutex.h>
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LibunwindstackMaps.h"
+#include "LibunwindstackUnwinder.h"
+#include "UnwindingWorkerPool.h"
+
+namespace orbit_linux_tracing {
+
+namespace {
+
+// Only counts how many maps have been added to it.
+class FakeLibunwindstackMaps : public LibunwindstackMaps {
+ public:
+  unwindstack::MapInfo* Find(uint64_t /*pc*/) override { return nullptr; }
+  unwindstack::Maps* Get() override { return nullptr; }
+  void AddAndSort(uint64_t /*start*/, uint64_t /*end*/, uint64_t /*offset*/, uint64_t /*flags*/,
+                  const std::string& /*name*/, uint64_t /*load_bias*/) override {
+    ++added_maps_count_;
+  }
+  [[nodiscard]] uint64_t GetGeneration() const override { return added_maps_count_; }
+
+  [[nodiscard]] uint64_t added_maps_count() const { return added_maps_count_; }
+
+ private:
+  uint64_t added_maps_count_ = 0;
+};
+
+// Returns a single frame, with the first eight bytes of the stack as the pc and the number of maps
+// added to `maps` when unwinding as the map_start. Samples with a smaller pc take longer to unwind,
+// so that the samples finish unwinding out of order.
+class FakeLibunwindstackUnwinder : public LibunwindstackUnwinder {
+ public:
+  explicit FakeLibunwindstackUnwinder(const FakeLibunwindstackMaps* maps) : maps_{maps} {}
+
+  LibunwindstackResult Unwind(pid_t /*pid*/, unwindstack::Maps* /*maps*/,
+                              const std::array<uint64_t, PERF_REG_X86_64_MAX>& /*perf_regs*/,
+                              const void* stack_dump, uint64_t stack_dump_size,
+                              bool /*offline_memory_only*/, size_t /*max_frames*/) override {
+    EXPECT_EQ(stack_dump_size, sizeof(uint64_t));
+    uint64_t pc;
+    memcpy(&pc, stack_dump, sizeof(pc));
+    std::this_thread::sleep_for(std::chrono::microseconds{(kSampleCount - pc) % 7 * 100});
+
+    unwindstack::FrameData frame{};
+    frame.pc = pc;
+    frame.map_start = maps_->added_maps_count();
+    return LibunwindstackResult{{frame}};
+  }
+
+  static constexpr uint64_t kSampleCount = 200;
+
+ private:
+  const FakeLibunwindstackMaps* maps_;
+};
+
+UnwindingWorkerPool::StackSample MakeStackSample(uint64_t timestamp_ns, uint64_t pc) {
+  UnwindingWorkerPool::StackSample sample{};
+  sample.pid = 1;
+  sample.tid = 2;
+  sample.timestamp_ns = timestamp_ns;
+  sample.stack_size = sizeof(pc);
+  sample.stack_data = std::make_unique<char[]>(sizeof(pc));
+  memcpy(sample.stack_data.get(), &pc, sizeof(pc));
+  return sample;
+}
+
+struct ReportedSample {
+  uint64_t timestamp_ns;
+  uint64_t pc;
+  uint64_t added_maps_count;
+  std::thread::id reporting_thread_id;
+};
+
+class UnwindingWorkerPoolTest : public ::testing::TestWithParam<size_t> {
+ protected:
+  std::unique_ptr<UnwindingWorkerPool> CreatePool() {
+    return std::make_unique<UnwindingWorkerPool>(
+        GetParam(),
+        [this] {
+          auto maps = std::make_unique<FakeLibunwindstackMaps>();
+          last_created_maps_ = maps.get();
+          return maps;
+        },
+        // The factories are called in pairs, one thread after the other.
+        [this] { return std::make_unique<FakeLibunwindstackUnwinder>(last_created_maps_); },
+        [this](const UnwindingWorkerPool::StackSample& sample,
+               const LibunwindstackResult& result) {
+          ASSERT_EQ(result.frames().size(), 1);
+          absl::MutexLock lock{&reported_samples_mutex_};
+          reported_samples_.push_back({sample.timestamp_ns, result.frames()[0].pc,
+                                       result.frames()[0].map_start, std::this_thread::get_id()});
+        });
+  }
+
+  [[nodiscard]] std::vector<ReportedSample> GetReportedSamples() {
+    absl::MutexLock lock{&reported_samples_mutex_};
+    return reported_samples_;
+  }
+
+ private:
+  FakeLibunwindstackMaps* last_created_maps_ = nullptr;
+  absl::Mutex reported_samples_mutex_;
+  std::vector<ReportedSample> reported_samples_;
+};
+
+}  // namespace
+
+TEST_P(UnwindingWorkerPoolTest, ReportsSamplesInSubmissionOrder) {
+  constexpr uint64_t kSampleCount = FakeLibunwindstackUnwinder::kSampleCount;
+  std::unique_ptr<UnwindingWorkerPool> pool = CreatePool();
+  for (uint64_t i = 0; i < kSampleCount; ++i) {
+    pool->SubmitSample(MakeStackSample(/*timestamp_ns=*/1000 + i, /*pc=*/i));
+  }
+  pool->WaitForSubmittedSamples();
+
+  std::vector<ReportedSample> reported_samples = GetReportedSamples();
+  ASSERT_EQ(reported_samples.size(), kSampleCount);
+  for (uint64_t i = 0; i < kSampleCount; ++i) {
+    EXPECT_EQ(reported_samples[i].timestamp_ns, 1000 + i);
+    EXPECT_EQ(reported_samples[i].pc, i);
+  }
+}
+
+TEST_P(UnwindingWorkerPoolTest, UnwindsSamplesWithMapsAtTheTimeOfSubmission) {
+  constexpr uint64_t kSampleCount = FakeLibunwindstackUnwinder::kSampleCount;
+  constexpr uint64_t kSamplesPerMapsUpdate = 10;
+  std::unique_ptr<UnwindingWorkerPool> pool = CreatePool();
+  for (uint64_t i = 0; i < kSampleCount; ++i) {
+    if (i % kSamplesPerMapsUpdate == 0) {
+      pool->AddAndSortMaps(0x1000 * i, 0x1000 * (i + 1), 0, 0, "module", 0);
+    }
+    pool->SubmitSample(MakeStackSample(/*timestamp_ns=*/1000 + i, /*pc=*/i));
+  }
+  // The destructor also waits for all samples.
+  pool.reset();
+
+  std::vector<ReportedSample> reported_samples = GetReportedSamples();
+  ASSERT_EQ(reported_samples.size(), kSampleCount);
+  for (uint64_t i = 0; i < kSampleCount; ++i) {
+    EXPECT_EQ(reported_samples[i].pc, i);
+    EXPECT_EQ(reported_samples[i].added_maps_count, i / kSamplesPerMapsUpdate + 1);
+  }
+}
+
+TEST_P(UnwindingWorkerPoolTest, ReportsSamplesOnlyOnTheOwningThread) {
+  constexpr uint64_t kSampleCount = FakeLibunwindstackUnwinder::kSampleCount;
+  std::unique_ptr<UnwindingWorkerPool> pool = CreatePool();
+  for (uint64_t i = 0; i < kSampleCount; ++i) {
+    pool->SubmitSample(MakeStackSample(/*timestamp_ns=*/1000 + i, /*pc=*/i));
+  }
+  // Even if the pool has unwound all samples by now, the last one is only reported on request.
+  std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  EXPECT_LT(GetReportedSamples().size(), kSampleCount);
+  EXPECT_TRUE(pool->HasUnreportedSamples());
+  pool->WaitForSubmittedSamples();
+  EXPECT_FALSE(pool->HasUnreportedSamples());
+
+  std::vector<ReportedSample> reported_samples = GetReportedSamples();
+  ASSERT_EQ(reported_samples.size(), kSampleCount);
+  for (const ReportedSample& reported_sample : reported_samples) {
+    EXPECT_EQ(reported_sample.reporting_thread_id, std::this_thread::get_id());
+  }
+}
+
+TEST_P(UnwindingWorkerPoolTest, WaitsForNoSamples) {
+  std::unique_ptr<UnwindingWorkerPool> pool = CreatePool();
+  EXPECT_FALSE(pool->HasUnreportedSamples());
+  pool->WaitForSubmittedSamples();
+  EXPECT_TRUE(GetReportedSamples().empty());
+}
+
+INSTANTIATE_TEST_SUITE_P(UnwindingWorkerPoolTests, UnwindingWorkerPoolTest,
+                         ::testing::Values(1, 2, 4));
+
+}  // namespace orbit_linux_tracing
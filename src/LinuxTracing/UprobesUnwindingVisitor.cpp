@@ -11,7 +11,9 @@
 
 #include <algorithm>
 #include <optional>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 #include "Function.h"
 #include "LeafFunctionCallManager.h"
@@ -24,23 +26,21 @@
 namespace orbit_linux_tracing {
 
 using orbit_grpc_protos::Callstack;
+using orbit_grpc_protos::CallstackSample;
 using orbit_grpc_protos::FullAddressInfo;
 using orbit_grpc_protos::FullCallstackSample;
 using orbit_grpc_protos::FunctionCall;
+using orbit_grpc_protos::InternedCallstack;
 
 using orbit_tracing_interface::TracerListener;
 
-static void SendFullAddressInfoToListener(TracerListener* listener,
-                                          const unwindstack::FrameData& libunwindstack_frame) {
-  CHECK(listener != nullptr);
-
+static FullAddressInfo CreateFullAddressInfo(const unwindstack::FrameData& libunwindstack_frame) {
   FullAddressInfo address_info;
   address_info.set_absolute_address(libunwindstack_frame.pc);
   address_info.set_function_name(libunwindstack_frame.function_name);
   address_info.set_offset_in_function(libunwindstack_frame.function_offset);
   address_info.set_module_name(libunwindstack_frame.map_name);
-
-  listener->OnAddressInfo(std::move(address_info));
+  return address_info;
 }
 
 // For addresses falling directly inside u(ret)probes code, unwindstack::FrameData has limited
@@ -49,29 +49,54 @@ static void SendFullAddressInfoToListener(TracerListener* listener,
 // observed are 0x7fffffffe000 (~1% of uprobes addresses) and 0x7fffffffe001 (~99%). This way the
 // client can show more information for such a frame, in particular when associated with the
 // corresponding unwinding error.
-static void SendUprobesFullAddressInfoToListener(
-    TracerListener* listener, const unwindstack::FrameData& libunwindstack_frame) {
-  CHECK(listener != nullptr);
-
+static FullAddressInfo CreateUprobesFullAddressInfo(
+    const unwindstack::FrameData& libunwindstack_frame) {
   FullAddressInfo address_info;
   address_info.set_absolute_address(libunwindstack_frame.pc);
   address_info.set_function_name("[uprobes]");
   address_info.set_offset_in_function(libunwindstack_frame.pc - libunwindstack_frame.map_start);
   address_info.set_module_name("[uprobes]");
-
-  listener->OnAddressInfo(std::move(address_info));
+  return address_info;
 }
 
 void UprobesUnwindingVisitor::Visit(StackSamplePerfEvent* event) {
   CHECK(listener_ != nullptr);
   CHECK(current_maps_ != nullptr);
 
+  // Patching depends on the uprobes and uretprobes processed so far, so it needs to happen here,
+  // in order, even when the unwinding itself is deferred to the UnwindingWorkerPool.
   return_address_manager_->PatchSample(event->GetTid(), event->GetRegisters()[PERF_REG_X86_SP],
                                        event->GetStackData(), event->GetStackSize());
 
+  if (unwinding_worker_pool_ != nullptr) {
+    UnwindingWorkerPool::StackSample sample;
+    sample.pid = event->GetPid();
+    sample.tid = event->GetTid();
+    sample.timestamp_ns = event->GetTimestamp();
+    sample.registers = event->GetRegisters();
+    sample.stack_size = event->GetStackSize();
+    // No other visitor uses the copy of the stack, so move it instead of copying it again.
+    sample.stack_data = std::move(event->ring_buffer_record.stack.data);
+    sample.maps_generation = maps_generation_;
+    unwinding_worker_pool_->SubmitSample(std::move(sample));
+    return;
+  }
+
   LibunwindstackResult libunwindstack_result =
-      unwinder_->Unwind(event->GetPid(), current_maps_->Get(), event->GetRegisters(),
-                        event->GetStackData(), event->GetStackSize());
+      unwind_result_cache_ != nullptr
+          ? unwind_result_cache_->Unwind(unwinder_, event->GetPid(), current_maps_,
+                                         event->GetRegisters(), event->GetStackData(),
+                                         event->GetStackSize())
+          : unwinder_->Unwind(event->GetPid(), current_maps_->Get(), event->GetRegisters(),
+                              event->GetStackData(), event->GetStackSize());
+  OnStackSampleUnwound(event->GetPid(), event->GetTid(), event->GetTimestamp(), maps_generation_,
+                       libunwindstack_result);
+}
+
+void UprobesUnwindingVisitor::OnStackSampleUnwound(
+    pid_t pid, pid_t tid, uint64_t timestamp_ns, uint64_t maps_generation,
+    const LibunwindstackResult& libunwindstack_result) {
+  CHECK(listener_ != nullptr);
 
   if (libunwindstack_result.frames().empty()) {
     // Even with unwinding errors this is not expected because we should at least get the program
@@ -81,11 +106,12 @@ void UprobesUnwindingVisitor::Visit(StackSamplePerfEvent* event) {
   }
 
   FullCallstackSample sample;
-  sample.set_pid(event->GetPid());
-  sample.set_tid(event->GetTid());
-  sample.set_timestamp_ns(event->GetTimestamp());
+  sample.set_pid(pid);
+  sample.set_tid(tid);
+  sample.set_timestamp_ns(timestamp_ns);
 
   Callstack* callstack = sample.mutable_callstack();
+  std::vector<FullAddressInfo> address_infos;
 
   if (libunwindstack_result.frames().front().map_name == "[uprobes]") {
     // Some samples can actually fall inside u(ret)probes code. They cannot be unwound by
@@ -94,7 +120,7 @@ void UprobesUnwindingVisitor::Visit(StackSamplePerfEvent* event) {
       ++(*samples_in_uretprobes_counter_);
     }
     callstack->set_type(Callstack::kInUprobes);
-    SendUprobesFullAddressInfoToListener(listener_, libunwindstack_result.frames().front());
+    address_infos.push_back(CreateUprobesFullAddressInfo(libunwindstack_result.frames().front()));
     callstack->add_pcs(libunwindstack_result.frames().front().pc);
 
   } else if (libunwindstack_result.frames().size() > 1 &&
@@ -108,7 +134,7 @@ void UprobesUnwindingVisitor::Visit(StackSamplePerfEvent* event) {
       ++(*unwind_error_counter_);
     }
     callstack->set_type(Callstack::kUprobesPatchingFailed);
-    SendFullAddressInfoToListener(listener_, libunwindstack_result.frames().front());
+    address_infos.push_back(CreateFullAddressInfo(libunwindstack_result.frames().front()));
     callstack->add_pcs(libunwindstack_result.frames().front().pc);
 
   } else if (!libunwindstack_result.IsSuccess() || libunwindstack_result.frames().size() == 1) {
@@ -122,20 +148,20 @@ void UprobesUnwindingVisitor::Visit(StackSamplePerfEvent* event) {
       ++(*unwind_error_counter_);
     }
     callstack->set_type(Callstack::kDwarfUnwindingError);
-    SendFullAddressInfoToListener(listener_, libunwindstack_result.frames().front());
+    address_infos.push_back(CreateFullAddressInfo(libunwindstack_result.frames().front()));
     callstack->add_pcs(libunwindstack_result.frames().front().pc);
 
   } else {
     callstack->set_type(Callstack::kComplete);
 
     for (const unwindstack::FrameData& libunwindstack_frame : libunwindstack_result.frames()) {
-      SendFullAddressInfoToListener(listener_, libunwindstack_frame);
+      address_infos.push_back(CreateFullAddressInfo(libunwindstack_frame));
       callstack->add_pcs(libunwindstack_frame.pc);
     }
   }
 
   CHECK(!callstack->pcs().empty());
-  listener_->OnCallstackSample(std::move(sample));
+  SendCallstackSample(std::move(sample), maps_generation, std::move(address_infos));
 }
 
 void UprobesUnwindingVisitor::Visit(CallchainSamplePerfEvent* event) {
@@ -167,7 +193,7 @@ void UprobesUnwindingVisitor::Visit(CallchainSamplePerfEvent* event) {
     }
     callstack->set_type(Callstack::kFramePointerUnwindingError);
     callstack->add_pcs(event->GetCallchain()[1]);
-    listener_->OnCallstackSample(std::move(sample));
+    SendCallstackSample(std::move(sample), maps_generation_);
     return;
   }
 
@@ -182,7 +208,7 @@ void UprobesUnwindingVisitor::Visit(CallchainSamplePerfEvent* event) {
     }
     callstack->set_type(Callstack::kInUprobes);
     callstack->add_pcs(top_ip);
-    listener_->OnCallstackSample(std::move(sample));
+    SendCallstackSample(std::move(sample), maps_generation_);
     return;
   }
 
@@ -211,7 +237,7 @@ void UprobesUnwindingVisitor::Visit(CallchainSamplePerfEvent* event) {
     }
     callstack->set_type(leaf_function_patching_status);
     callstack->add_pcs(top_ip);
-    listener_->OnCallstackSample(std::move(sample));
+    SendCallstackSample(std::move(sample), maps_generation_);
     return;
   }
 
@@ -222,7 +248,7 @@ void UprobesUnwindingVisitor::Visit(CallchainSamplePerfEvent* event) {
     }
     callstack->set_type(Callstack::kUprobesPatchingFailed);
     callstack->add_pcs(top_ip);
-    listener_->OnCallstackSample(std::move(sample));
+    SendCallstackSample(std::move(sample), maps_generation_);
     return;
   }
 
@@ -241,7 +267,7 @@ void UprobesUnwindingVisitor::Visit(CallchainSamplePerfEvent* event) {
   }
 
   CHECK(!callstack->pcs().empty());
-  listener_->OnCallstackSample(std::move(sample));
+  SendCallstackSample(std::move(sample), maps_generation_);
 }
 
 void UprobesUnwindingVisitor::OnUprobes(
@@ -322,6 +348,76 @@ void UprobesUnwindingVisitor::Visit(UretprobesWithReturnValuePerfEvent* event) {
   OnUretprobes(event->GetTimestamp(), event->GetPid(), event->GetTid(), event->GetAx());
 }
 
+void UprobesUnwindingVisitor::AddAndSortMaps(uint64_t start, uint64_t end, uint64_t offset,
+                                             uint64_t flags, const std::string& name,
+                                             uint64_t load_bias) {
+  current_maps_->AddAndSort(start, end, offset, flags, name, load_bias);
+  // A new module can be loaded where another one was unloaded, so addresses might now belong to
+  // different functions. The interned callstacks are invalidated by SendCallstackSample.
+  ++maps_generation_;
+  // The UnwindingWorkerPool receives the change in the same order relative to stack samples, so
+  // that the samples taken before the change are still unwound with the old maps.
+  if (unwinding_worker_pool_ != nullptr) {
+    unwinding_worker_pool_->AddAndSortMaps(start, end, offset, flags, name, load_bias);
+  }
+}
+
+void UprobesUnwindingVisitor::SendCallstackSample(FullCallstackSample sample,
+                                                  uint64_t maps_generation,
+                                                  std::vector<FullAddressInfo> address_infos) {
+  if (!callstack_interner_.has_value()) {
+    for (FullAddressInfo& address_info : address_infos) {
+      listener_->OnAddressInfo(std::move(address_info));
+    }
+    listener_->OnCallstackSample(std::move(sample));
+    return;
+  }
+
+  if (maps_generation > interned_maps_generation_) {
+    callstack_interner_.emplace(next_callstack_id_);
+    sent_address_infos_.clear();
+    interned_maps_generation_ = maps_generation;
+  }
+
+  uint64_t callstack_id;
+  bool is_new_callstack;
+  if (maps_generation < interned_maps_generation_) {
+    // Neither the interner nor the sent addresses hold for the maps this callstack was unwound
+    // with, so send it with all its addresses, under an id of its own.
+    callstack_id = next_callstack_id_->fetch_add(1);
+    is_new_callstack = true;
+    for (FullAddressInfo& address_info : address_infos) {
+      listener_->OnAddressInfo(std::move(address_info));
+    }
+  } else {
+    std::tie(callstack_id, is_new_callstack) =
+        callstack_interner_->GetOrAssignId(sample.callstack());
+    if (is_new_callstack) {
+      // The addresses of a callstack that was already sent have been sent with it, and a new
+      // callstack mostly consists of addresses that other callstacks have already sent.
+      for (FullAddressInfo& address_info : address_infos) {
+        if (sent_address_infos_.insert(address_info.absolute_address()).second) {
+          listener_->OnAddressInfo(std::move(address_info));
+        }
+      }
+    }
+  }
+
+  if (is_new_callstack) {
+    InternedCallstack interned_callstack;
+    interned_callstack.set_key(callstack_id);
+    *interned_callstack.mutable_intern() = std::move(*sample.mutable_callstack());
+    listener_->OnInternedCallstack(std::move(interned_callstack));
+  }
+
+  CallstackSample callstack_sample;
+  callstack_sample.set_pid(sample.pid());
+  callstack_sample.set_tid(sample.tid());
+  callstack_sample.set_timestamp_ns(sample.timestamp_ns());
+  callstack_sample.set_callstack_id(callstack_id);
+  listener_->OnInternedCallstackSample(std::move(callstack_sample));
+}
+
 void UprobesUnwindingVisitor::Visit(MmapPerfEvent* event) {
   CHECK(listener_ != nullptr);
   CHECK(current_maps_ != nullptr);
@@ -336,8 +432,8 @@ void UprobesUnwindingVisitor::Visit(MmapPerfEvent* event) {
   // if unwindstack::BufferMaps was built by passing the full content of /proc/<pid>/maps to its
   // constructor.
   if (event->filename() == "[uprobes]") {
-    current_maps_->AddAndSort(event->address(), event->address() + event->length(), 0, PROT_EXEC,
-                              event->filename(), INT64_MAX);
+    AddAndSortMaps(event->address(), event->address() + event->length(), 0, PROT_EXEC,
+                   event->filename(), INT64_MAX);
     return;
   }
 
@@ -352,9 +448,8 @@ void UprobesUnwindingVisitor::Visit(MmapPerfEvent* event) {
   auto& module_info = module_info_or_error.value();
 
   // For flags we assume PROT_READ and PROT_EXEC, MMAP event does not return flags.
-  current_maps_->AddAndSort(module_info.address_start(), module_info.address_end(),
-                            event->page_offset(), PROT_READ | PROT_EXEC, event->filename(),
-                            module_info.load_bias());
+  AddAndSortMaps(module_info.address_start(), module_info.address_end(), event->page_offset(),
+                 PROT_READ | PROT_EXEC, event->filename(), module_info.load_bias());
 
   orbit_grpc_protos::ModuleUpdateEvent module_update_event;
   module_update_event.set_pid(event->pid());
@@ -6,6 +6,7 @@
 #define LINUX_TRACING_UPROBES_UNWINDING_VISITOR_H_
 
 #include <absl/container/flat_hash_map.h>
+#include <absl/container/flat_hash_set.h>
 #include <absl/hash/hash.h>
 #include <sys/types.h>
 #include <unwindstack/Maps.h>
@@ -13,16 +14,20 @@
 #include <atomic>
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <tuple>
 #include <vector>
 
+#include "CallstackInterner.h"
 #include "LeafFunctionCallManager.h"
 #include "LibunwindstackMaps.h"
 #include "LibunwindstackUnwinder.h"
 #include "PerfEvent.h"
 #include "PerfEventVisitor.h"
 #include "TracingInterface/TracerListener.h"
+#include "UnwindResultCache.h"
+#include "UnwindingWorkerPool.h"
 #include "UprobesFunctionCallManager.h"
 #include "UprobesReturnAddressManager.h"
 
@@ -79,6 +84,40 @@ class UprobesUnwindingVisitor : public PerfEventVisitor {
     samples_in_uretprobes_counter_ = samples_in_uretprobes_counter;
   }
 
+  // When set, stack samples unwound synchronously go through `unwind_result_cache`.
+  void SetUnwindResultCache(UnwindResultCache* unwind_result_cache) {
+    unwind_result_cache_ = unwind_result_cache;
+  }
+
+  // When set, stack samples are unwound asynchronously by `unwinding_worker_pool`, which must then
+  // call OnStackSampleUnwound with the results in order. Otherwise they are unwound synchronously
+  // by Visit(StackSamplePerfEvent*).
+  void SetUnwindingWorkerPool(UnwindingWorkerPool* unwinding_worker_pool) {
+    unwinding_worker_pool_ = unwinding_worker_pool;
+  }
+
+  // When enabled, each distinct callstack is sent to the listener only once, with
+  // OnInternedCallstack, and callstack samples only refer to it by id, with
+  // OnInternedCallstackSample. Otherwise, each sample is sent with its full callstack, with
+  // OnCallstackSample. Ids are taken from `next_callstack_id`, which can be shared with other
+  // emitters of interned callstacks.
+  void EnableCallstackInterning(std::atomic<uint64_t>* next_callstack_id) {
+    CHECK(next_callstack_id != nullptr);
+    next_callstack_id_ = next_callstack_id;
+    callstack_interner_.emplace(next_callstack_id_);
+    interned_maps_generation_ = maps_generation_;
+  }
+
+  // Sends the callstack sample built from the result of unwinding a stack sample to the listener.
+  // With an UnwindingWorkerPool, this is called when the pool reports the result, on the thread
+  // processing the events, and possibly after some of the events that follow the sample.
+  // `maps_generation` is the value of GetMapsGeneration when the sample was taken.
+  void OnStackSampleUnwound(pid_t pid, pid_t tid, uint64_t timestamp_ns, uint64_t maps_generation,
+                            const LibunwindstackResult& libunwindstack_result);
+
+  // Incremented every time the maps change.
+  [[nodiscard]] uint64_t GetMapsGeneration() const { return maps_generation_; }
+
   void Visit(StackSamplePerfEvent* event) override;
   void Visit(CallchainSamplePerfEvent* event) override;
   void Visit(UprobesPerfEvent* event) override;
@@ -93,6 +132,13 @@ class UprobesUnwindingVisitor : public PerfEventVisitor {
                  std::optional<perf_event_sample_regs_user_sp_ip_arguments> registers,
                  uint64_t function_id);
   void OnUretprobes(uint64_t timestamp_ns, pid_t pid, pid_t tid, std::optional<uint64_t> ax);
+  void AddAndSortMaps(uint64_t start, uint64_t end, uint64_t offset, uint64_t flags,
+                      const std::string& name, uint64_t load_bias);
+  // Also sends `address_infos`, the FullAddressInfos of the frames of the callstack. With
+  // interning, they are only sent for new callstacks, and each address only once per
+  // `maps_generation`, the generation of the maps the callstack was unwound with.
+  void SendCallstackSample(orbit_grpc_protos::FullCallstackSample sample, uint64_t maps_generation,
+                           std::vector<orbit_grpc_protos::FullAddressInfo> address_infos = {});
 
   orbit_tracing_interface::TracerListener* listener_;
 
@@ -101,6 +147,20 @@ class UprobesUnwindingVisitor : public PerfEventVisitor {
   LibunwindstackMaps* current_maps_;
   LibunwindstackUnwinder* unwinder_;
   LeafFunctionCallManager* leaf_function_call_manager_;
+  UnwindResultCache* unwind_result_cache_ = nullptr;
+  UnwindingWorkerPool* unwinding_worker_pool_ = nullptr;
+
+  uint64_t maps_generation_ = 0;
+
+  // When interning callstacks, the interner and the absolute addresses whose FullAddressInfo was
+  // sent only hold for the maps of `interned_maps_generation_`, as after a change of the maps the
+  // same addresses can belong to different functions. Both are reset when a callstack unwound with
+  // a newer generation is sent. Callstacks unwound with an older generation, which the
+  // UnwindingWorkerPool can report after the change, are sent without going through them.
+  std::atomic<uint64_t>* next_callstack_id_ = nullptr;
+  std::optional<CallstackInterner> callstack_interner_;
+  uint64_t interned_maps_generation_ = 0;
+  absl::flat_hash_set<uint64_t> sent_address_infos_;
 
   std::atomic<uint64_t>* unwind_error_counter_ = nullptr;
   std::atomic<uint64_t>* samples_in_uretprobes_counter_ = nullptr;
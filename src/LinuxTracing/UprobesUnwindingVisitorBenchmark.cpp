@@ -0,0 +1,184 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unwindstack/MapInfo.h>
+#include <unwindstack/Unwinder.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Function.h"
+#include "LeafFunctionCallManager.h"
+#include "LibunwindstackMaps.h"
+#include "LibunwindstackUnwinder.h"
+#include "PerfEvent.h"
+#include "SyntheticPerfEvents.h"
+#include "UprobesFunctionCallManager.h"
+#include "UprobesReturnAddressManager.h"
+#include "UprobesUnwindingVisitor.h"
+
+namespace orbit_linux_tracing {
+
+namespace {
+
+constexpr pid_t kPid = 42;
+constexpr uint64_t kTargetMapStart = 0x1000;
+constexpr uint64_t kTargetMapEnd = 0x10000;
+constexpr uint64_t kStackSize = 1024;
+const std::string kTargetName = "target";
+
+// Every address is in the same executable map, and the maps are not actually used for unwinding.
+class FakeLibunwindstackMaps : public LibunwindstackMaps {
+ public:
+  unwindstack::MapInfo* Find(uint64_t /*pc*/) override { return &target_map_info_; }
+  unwindstack::Maps* Get() override { return nullptr; }
+  void AddAndSort(uint64_t /*start*/, uint64_t /*end*/, uint64_t /*offset*/, uint64_t /*flags*/,
+                  const std::string& /*name*/, uint64_t /*load_bias*/) override {}
+  [[nodiscard]] uint64_t GetGeneration() const override { return 0; }
+
+ private:
+  unwindstack::MapInfo target_map_info_{
+      nullptr, nullptr, kTargetMapStart, kTargetMapEnd, 0, PROT_EXEC | PROT_READ, kTargetName};
+};
+
+// Returns the same successful callstack for every sample, so that the benchmark measures what
+// UprobesUnwindingVisitor does around the unwinding, and not libunwindstack.
+class FakeLibunwindstackUnwinder : public LibunwindstackUnwinder {
+ public:
+  explicit FakeLibunwindstackUnwinder(size_t frame_count) {
+    for (size_t i = 0; i < frame_count; ++i) {
+      unwindstack::FrameData frame{};
+      frame.pc = kTargetMapStart + 0x10 * (i + 1);
+      frame.function_name = "function" + std::to_string(i);
+      frame.function_offset = 0x10;
+      frame.map_name = kTargetName;
+      frames_.push_back(std::move(frame));
+    }
+  }
+
+  LibunwindstackResult Unwind(pid_t /*pid*/, unwindstack::Maps* /*maps*/,
+                              const std::array<uint64_t, PERF_REG_X86_64_MAX>& /*perf_regs*/,
+                              const void* /*stack_dump*/, uint64_t /*stack_dump_size*/,
+                              bool /*offline_memory_only*/, size_t /*max_frames*/) override {
+    return LibunwindstackResult{frames_};
+  }
+
+ private:
+  std::vector<unwindstack::FrameData> frames_;
+};
+
+// The stateful collaborators of UprobesUnwindingVisitor, recreated at every iteration so that each
+// iteration starts from a clean state.
+struct UprobesUnwindingVisitorFixture {
+  explicit UprobesUnwindingVisitorFixture(size_t frame_count) : unwinder{frame_count} {}
+
+  CountingTracerListener listener;
+  UprobesFunctionCallManager function_call_manager;
+  UprobesReturnAddressManager return_address_manager;
+  FakeLibunwindstackMaps maps;
+  FakeLibunwindstackUnwinder unwinder;
+  LeafFunctionCallManager leaf_function_call_manager{kStackSize};
+  UprobesUnwindingVisitor visitor{&listener,
+                                  &function_call_manager,
+                                  &return_address_manager,
+                                  &maps,
+                                  &unwinder,
+                                  &leaf_function_call_manager};
+};
+
+// Visits range(0) function calls on each of eight threads, nested range(1) deep, each made of a
+// uprobes and a uretprobes event.
+void BM_UprobesUnwindingVisitorFunctionCalls(benchmark::State& state) {
+  constexpr pid_t kThreadCount = 8;
+  const auto call_count = static_cast<uint64_t>(state.range(0));
+  const auto depth = static_cast<uint64_t>(state.range(1));
+  constexpr uint64_t kInitialSp = 0x7fff0000;
+  constexpr uint64_t kFrameSize = 0x100;
+
+  std::vector<Function> functions;
+  for (uint64_t i = 0; i < depth; ++i) {
+    functions.emplace_back(/*function_id=*/i, "/path/to/target", /*file_offset=*/0x100 + i,
+                           /*record_arguments=*/false, /*record_return_value=*/false);
+  }
+
+  std::vector<std::unique_ptr<PerfEvent>> events;
+  uint64_t timestamp_ns = 1'000'000;
+  for (uint64_t call = 0; call < call_count; call += depth) {
+    for (pid_t tid = kPid; tid < kPid + kThreadCount; ++tid) {
+      for (uint64_t level = 0; level < depth; ++level) {
+        events.emplace_back(MakeUprobesPerfEvent(timestamp_ns++, kPid, tid, /*cpu=*/tid % 4,
+                                                 kInitialSp - level * kFrameSize,
+                                                 /*return_address=*/kTargetMapStart + level,
+                                                 &functions[level]));
+      }
+      for (uint64_t level = depth; level > 0; --level) {
+        events.emplace_back(MakeUretprobesPerfEvent(timestamp_ns++, kPid, tid, /*cpu=*/tid % 4,
+                                                    &functions[level - 1]));
+      }
+    }
+  }
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto fixture = std::make_unique<UprobesUnwindingVisitorFixture>(/*frame_count=*/1);
+    state.ResumeTiming();
+
+    for (std::unique_ptr<PerfEvent>& event : events) {
+      event->Accept(&fixture->visitor);
+    }
+
+    state.PauseTiming();
+    benchmark::DoNotOptimize(fixture->listener.event_count());
+    fixture.reset();
+    state.ResumeTiming();
+  }
+  SetPerEventCounters(state, events.size());
+}
+
+// Visits 1024 stack samples, whose (fake) unwinding produces complete callstacks of range(0)
+// frames.
+void BM_UprobesUnwindingVisitorStackSamples(benchmark::State& state) {
+  constexpr uint64_t kSampleCount = 1024;
+  const auto frame_count = static_cast<size_t>(state.range(0));
+
+  std::vector<std::unique_ptr<PerfEvent>> events;
+  for (uint64_t i = 0; i < kSampleCount; ++i) {
+    events.emplace_back(MakeStackSamplePerfEvent(/*timestamp_ns=*/1'000'000 + i, kPid,
+                                                 /*tid=*/kPid + i % 8, /*cpu=*/i % 4,
+                                                 /*sp=*/0x7fff0000, kStackSize));
+  }
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto fixture = std::make_unique<UprobesUnwindingVisitorFixture>(frame_count);
+    state.ResumeTiming();
+
+    for (std::unique_ptr<PerfEvent>& event : events) {
+      event->Accept(&fixture->visitor);
+    }
+
+    state.PauseTiming();
+    benchmark::DoNotOptimize(fixture->listener.event_count());
+    fixture.reset();
+    state.ResumeTiming();
+  }
+  SetPerEventCounters(state, events.size());
+}
+
+}  // namespace
+
+BENCHMARK(BM_UprobesUnwindingVisitorFunctionCalls)
+    ->ArgNames({"calls", "depth"})
+    ->Args({1024, 1})
+    ->Args({1024, 8})
+    ->Args({1024, 64});
+BENCHMARK(BM_UprobesUnwindingVisitorStackSamples)->ArgName("frames")->Arg(2)->Arg(16)->Arg(64);
+
+}  // namespace orbit_linux_tracing
@@ -34,6 +34,7 @@ class MockLibunwindstackMaps : public LibunwindstackMaps {
   MOCK_METHOD(unwindstack::Maps*, Get, (), (override));
   MOCK_METHOD(void, AddAndSort,
               (uint64_t, uint64_t, uint64_t, uint64_t, const std::string&, uint64_t), (override));
+  MOCK_METHOD(uint64_t, GetGeneration, (), (const, override));
 };
 
 class MockLibunwindstackUnwinder : public LibunwindstackUnwinder {
@@ -48,6 +49,8 @@ class MockTracerListener : public orbit_tracing_interface::TracerListener {
  public:
   MOCK_METHOD(void, OnSchedulingSlice, (orbit_grpc_protos::SchedulingSlice), (override));
   MOCK_METHOD(void, OnCallstackSample, (orbit_grpc_protos::FullCallstackSample), (override));
+  MOCK_METHOD(void, OnInternedCallstack, (orbit_grpc_protos::InternedCallstack), (override));
+  MOCK_METHOD(void, OnInternedCallstackSample, (orbit_grpc_protos::CallstackSample), (override));
   MOCK_METHOD(void, OnFunctionCall, (orbit_grpc_protos::FunctionCall), (override));
   MOCK_METHOD(void, OnGpuJob, (orbit_grpc_protos::FullGpuJob), (override));
   MOCK_METHOD(void, OnThreadName, (orbit_grpc_protos::ThreadName), (override));
@@ -419,6 +422,162 @@ TEST_F(UprobesUnwindingVisitorTest,
   EXPECT_EQ(discarded_samples_in_uretprobes_counter, 0);
 }
 
+TEST_F(UprobesUnwindingVisitorTest,
+       VisitStackSamplesWithInterningSendsAddressInfosOnlyForNewCallstacksAndAddresses) {
+  constexpr uint32_t kPid = 10;
+  constexpr uint64_t kStackSize = 13;
+  StackSamplePerfEvent event{kStackSize};
+  perf_event_sample_id_tid_time_streamid_cpu sample_id{
+      .pid = kPid,
+      .tid = 11,
+      .time = 15,
+      .stream_id = 12,
+      .cpu = 0,
+      .res = 0,
+  };
+  event.ring_buffer_record.sample_id = sample_id;
+
+  EXPECT_CALL(return_address_manager_, PatchSample).Times(3).WillRepeatedly(Return());
+  EXPECT_CALL(maps_, Get).Times(3).WillRepeatedly(Return(nullptr));
+
+  // The first two samples have the same callstack, the third one shares two of its addresses.
+  EXPECT_CALL(unwinder_, Unwind(kPid, nullptr, _, _, kStackSize, _, _))
+      .Times(3)
+      .WillOnce(Return(LibunwindstackResult{{kFrame1, kFrame2}}))
+      .WillOnce(Return(LibunwindstackResult{{kFrame1, kFrame2}}))
+      .WillOnce(Return(LibunwindstackResult{{kFrame1, kFrame2, kFrame3}}));
+
+  EXPECT_CALL(listener_, OnInternedCallstack).Times(2);
+  EXPECT_CALL(listener_, OnInternedCallstackSample).Times(3);
+
+  std::vector<uint64_t> actual_addresses;
+  EXPECT_CALL(listener_, OnAddressInfo)
+      .Times(3)
+      .WillRepeatedly(Invoke([&actual_addresses](orbit_grpc_protos::FullAddressInfo address_info) {
+        actual_addresses.push_back(address_info.absolute_address());
+      }));
+
+  std::atomic<uint64_t> next_callstack_id = 1;
+  visitor_->EnableCallstackInterning(&next_callstack_id);
+
+  visitor_->Visit(&event);
+  visitor_->Visit(&event);
+  visitor_->Visit(&event);
+
+  EXPECT_THAT(actual_addresses, ElementsAre(kTargetAddress1, kTargetAddress2, kTargetAddress3));
+}
+
+TEST_F(UprobesUnwindingVisitorTest,
+       VisitStackSamplesWithInterningSendsCallstackAndAddressInfosAgainAfterMapsChange) {
+  constexpr uint32_t kPid = 10;
+  constexpr uint64_t kStackSize = 13;
+  StackSamplePerfEvent event{kStackSize};
+  perf_event_sample_id_tid_time_streamid_cpu sample_id{
+      .pid = kPid,
+      .tid = 11,
+      .time = 15,
+      .stream_id = 12,
+      .cpu = 0,
+      .res = 0,
+  };
+  event.ring_buffer_record.sample_id = sample_id;
+
+  EXPECT_CALL(return_address_manager_, PatchSample).Times(2).WillRepeatedly(Return());
+  EXPECT_CALL(maps_, Get).Times(2).WillRepeatedly(Return(nullptr));
+  EXPECT_CALL(maps_, AddAndSort).Times(1);
+  EXPECT_CALL(unwinder_, Unwind(kPid, nullptr, _, _, kStackSize, _, _))
+      .Times(2)
+      .WillRepeatedly(Return(LibunwindstackResult{{kFrame1, kFrame2}}));
+
+  std::vector<uint64_t> actual_callstack_ids;
+  EXPECT_CALL(listener_, OnInternedCallstack)
+      .Times(2)
+      .WillRepeatedly(
+          Invoke([&actual_callstack_ids](orbit_grpc_protos::InternedCallstack interned_callstack) {
+            actual_callstack_ids.push_back(interned_callstack.key());
+          }));
+  EXPECT_CALL(listener_, OnInternedCallstackSample).Times(2);
+
+  std::vector<uint64_t> actual_addresses;
+  EXPECT_CALL(listener_, OnAddressInfo)
+      .Times(4)
+      .WillRepeatedly(Invoke([&actual_addresses](orbit_grpc_protos::FullAddressInfo address_info) {
+        actual_addresses.push_back(address_info.absolute_address());
+      }));
+
+  std::atomic<uint64_t> next_callstack_id = 1;
+  visitor_->EnableCallstackInterning(&next_callstack_id);
+
+  visitor_->Visit(&event);
+
+  // The module is remapped: its addresses might now belong to different functions.
+  perf_event_mmap_up_to_pgoff mmap_event{};
+  mmap_event.address = kUprobesMapsStart;
+  mmap_event.length = kUprobesMapsEnd - kUprobesMapsStart;
+  MmapPerfEvent mmap_perf_event{kPid, 16, mmap_event, "[uprobes]"};
+  visitor_->Visit(&mmap_perf_event);
+
+  visitor_->Visit(&event);
+
+  EXPECT_THAT(actual_addresses,
+              ElementsAre(kTargetAddress1, kTargetAddress2, kTargetAddress1, kTargetAddress2));
+  ASSERT_EQ(actual_callstack_ids.size(), 2);
+  EXPECT_NE(actual_callstack_ids[0], actual_callstack_ids[1]);
+}
+
+TEST_F(UprobesUnwindingVisitorTest,
+       StackSampleUnwoundWithOlderMapsIsSentWithoutAffectingInterning) {
+  EXPECT_CALL(maps_, AddAndSort).Times(1);
+
+  std::vector<uint64_t> actual_callstack_ids;
+  EXPECT_CALL(listener_, OnInternedCallstack)
+      .Times(2)
+      .WillRepeatedly(
+          Invoke([&actual_callstack_ids](orbit_grpc_protos::InternedCallstack interned_callstack) {
+            actual_callstack_ids.push_back(interned_callstack.key());
+          }));
+  std::vector<uint64_t> actual_sample_callstack_ids;
+  EXPECT_CALL(listener_, OnInternedCallstackSample)
+      .Times(3)
+      .WillRepeatedly(
+          Invoke([&actual_sample_callstack_ids](orbit_grpc_protos::CallstackSample sample) {
+            actual_sample_callstack_ids.push_back(sample.callstack_id());
+          }));
+  std::vector<uint64_t> actual_addresses;
+  EXPECT_CALL(listener_, OnAddressInfo)
+      .Times(4)
+      .WillRepeatedly(Invoke([&actual_addresses](orbit_grpc_protos::FullAddressInfo address_info) {
+        actual_addresses.push_back(address_info.absolute_address());
+      }));
+
+  std::atomic<uint64_t> next_callstack_id = 1;
+  visitor_->EnableCallstackInterning(&next_callstack_id);
+
+  const uint64_t old_maps_generation = visitor_->GetMapsGeneration();
+  perf_event_mmap_up_to_pgoff mmap_event{};
+  mmap_event.address = kUprobesMapsStart;
+  mmap_event.length = kUprobesMapsEnd - kUprobesMapsStart;
+  MmapPerfEvent mmap_perf_event{10, 14, mmap_event, "[uprobes]"};
+  visitor_->Visit(&mmap_perf_event);
+  const uint64_t new_maps_generation = visitor_->GetMapsGeneration();
+  ASSERT_GT(new_maps_generation, old_maps_generation);
+
+  // Results of an UnwindingWorkerPool can be reported after the maps have changed, and samples
+  // unwound with the old maps can follow samples unwound with the new ones.
+  const LibunwindstackResult result{{kFrame1, kFrame2}};
+  visitor_->OnStackSampleUnwound(10, 11, 15, new_maps_generation, result);
+  visitor_->OnStackSampleUnwound(10, 11, 16, old_maps_generation, result);
+  visitor_->OnStackSampleUnwound(10, 11, 17, new_maps_generation, result);
+
+  EXPECT_THAT(actual_addresses,
+              ElementsAre(kTargetAddress1, kTargetAddress2, kTargetAddress1, kTargetAddress2));
+  ASSERT_EQ(actual_callstack_ids.size(), 2);
+  EXPECT_NE(actual_callstack_ids[0], actual_callstack_ids[1]);
+  EXPECT_THAT(actual_sample_callstack_ids,
+              ElementsAre(actual_callstack_ids[0], actual_callstack_ids[1],
+                          actual_callstack_ids[0]));
+}
+
 TEST_F(UprobesUnwindingVisitorTest, VisitEmptyStackSampleWithoutUprobesDoesNothing) {
   constexpr uint32_t kPid = 10;
   constexpr uint64_t kStackSize = 13;
@@ -687,6 +846,75 @@ TEST_F(UprobesUnwindingVisitorTest, VisitValidCallchainSampleWithoutUprobesSends
   EXPECT_EQ(discarded_samples_in_uretprobes_counter, 0);
 }
 
+TEST_F(UprobesUnwindingVisitorTest,
+       VisitRepeatedCallchainSamplesWithInterningSendsCallstackOnlyOnce) {
+  constexpr uint32_t kPid = 10;
+  constexpr uint64_t kStackSize = 13;
+
+  std::vector<uint64_t> callchain;
+  callchain.push_back(kKernelAddress);
+  callchain.push_back(kTargetAddress1);
+  // Increment by one as the return address is the next address.
+  callchain.push_back(kTargetAddress2 + 1);
+  callchain.push_back(kTargetAddress3 + 1);
+
+  CallchainSamplePerfEvent event{callchain.size(), kStackSize};
+  perf_event_sample_id_tid_time_streamid_cpu sample_id{
+      .pid = kPid,
+      .tid = 11,
+      .time = 15,
+      .stream_id = 12,
+      .cpu = 0,
+      .res = 0,
+  };
+  event.ring_buffer_record.sample_id = sample_id;
+  event.ips = callchain;
+
+  EXPECT_CALL(maps_, Find).WillRepeatedly(Return(&kTargetMapInfo));
+  EXPECT_CALL(return_address_manager_, PatchCallchain).Times(2).WillRepeatedly(Return(true));
+  EXPECT_CALL(leaf_function_call_manager_, PatchCallerOfLeafFunction)
+      .Times(2)
+      .WillRepeatedly(Return(Callstack::kComplete));
+
+  EXPECT_CALL(listener_, OnCallstackSample).Times(0);
+  orbit_grpc_protos::InternedCallstack actual_interned_callstack;
+  EXPECT_CALL(listener_, OnInternedCallstack)
+      .Times(1)
+      .WillOnce(SaveArg<0>(&actual_interned_callstack));
+  std::vector<orbit_grpc_protos::CallstackSample> actual_callstack_samples;
+  EXPECT_CALL(listener_, OnInternedCallstackSample)
+      .Times(2)
+      .WillRepeatedly(Invoke([&actual_callstack_samples](
+                                 orbit_grpc_protos::CallstackSample callstack_sample) {
+        actual_callstack_samples.emplace_back(std::move(callstack_sample));
+      }));
+
+  std::atomic<uint64_t> unwinding_errors = 0;
+  std::atomic<uint64_t> discarded_samples_in_uretprobes_counter = 0;
+  visitor_->SetUnwindErrorsAndDiscardedSamplesCounters(&unwinding_errors,
+                                                       &discarded_samples_in_uretprobes_counter);
+  std::atomic<uint64_t> next_callstack_id = 1;
+  visitor_->EnableCallstackInterning(&next_callstack_id);
+
+  visitor_->Visit(&event);
+  visitor_->Visit(&event);
+
+  EXPECT_EQ(actual_interned_callstack.key(), 1);
+  EXPECT_EQ(actual_interned_callstack.intern().type(), Callstack::kComplete);
+  EXPECT_THAT(actual_interned_callstack.intern().pcs(),
+              ElementsAre(kTargetAddress1, kTargetAddress2, kTargetAddress3));
+  ASSERT_EQ(actual_callstack_samples.size(), 2);
+  for (const orbit_grpc_protos::CallstackSample& callstack_sample : actual_callstack_samples) {
+    EXPECT_EQ(callstack_sample.pid(), kPid);
+    EXPECT_EQ(callstack_sample.tid(), 11);
+    EXPECT_EQ(callstack_sample.timestamp_ns(), 15);
+    EXPECT_EQ(callstack_sample.callstack_id(), actual_interned_callstack.key());
+  }
+
+  EXPECT_EQ(unwinding_errors, 0);
+  EXPECT_EQ(discarded_samples_in_uretprobes_counter, 0);
+}
+
 TEST_F(UprobesUnwindingVisitorTest, VisitSingleFrameCallchainSampleDoesNothing) {
   constexpr uint32_t kPid = 10;
   constexpr uint64_t kStackSize = 13;
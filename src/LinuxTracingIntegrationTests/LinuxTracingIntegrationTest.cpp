@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <absl/container/flat_hash_map.h>
 #include <absl/container/flat_hash_set.h>
 #include <absl/strings/match.h>
 #include <absl/strings/numbers.h>
@@ -186,6 +187,31 @@ class BufferTracerListener : public orbit_tracing_interface::TracerListener {
     }
   }
 
+  // Interned callstacks are turned back into FullCallstackSamples, so that the tests can verify
+  // callstack samples in the same way independently of how they were sent.
+  void OnInternedCallstack(orbit_grpc_protos::InternedCallstack interned_callstack) override {
+    absl::MutexLock lock{&events_mutex_};
+    CHECK(!interned_callstacks_.contains(interned_callstack.key()));
+    interned_callstacks_.emplace(interned_callstack.key(),
+                                 std::move(*interned_callstack.mutable_intern()));
+  }
+
+  void OnInternedCallstackSample(orbit_grpc_protos::CallstackSample callstack_sample) override {
+    orbit_grpc_protos::ProducerCaptureEvent event;
+    orbit_grpc_protos::FullCallstackSample* full_callstack_sample =
+        event.mutable_full_callstack_sample();
+    full_callstack_sample->set_pid(callstack_sample.pid());
+    full_callstack_sample->set_tid(callstack_sample.tid());
+    full_callstack_sample->set_timestamp_ns(callstack_sample.timestamp_ns());
+    {
+      absl::MutexLock lock{&events_mutex_};
+      auto interned_callstack_it = interned_callstacks_.find(callstack_sample.callstack_id());
+      CHECK(interned_callstack_it != interned_callstacks_.end());
+      *full_callstack_sample->mutable_callstack() = interned_callstack_it->second;
+      events_.emplace_back(std::move(event));
+    }
+  }
+
   void OnFunctionCall(orbit_grpc_protos::FunctionCall function_call) override {
     orbit_grpc_protos::ProducerCaptureEvent event;
     *event.mutable_function_call() = std::move(function_call);
@@ -317,6 +343,7 @@ class BufferTracerListener : public orbit_tracing_interface::TracerListener {
  private:
   std::vector<orbit_grpc_protos::ProducerCaptureEvent> events_;
   absl::Mutex events_mutex_;
+  absl::flat_hash_map<uint64_t, orbit_grpc_protos::Callstack> interned_callstacks_;
 
   bool one_scheduling_slice_received_ = false;
   absl::Mutex one_scheduling_slice_received_mutex_;
@@ -475,6 +502,8 @@ void VerifyOrderOfAllEvents(const std::vector<orbit_grpc_protos::ProducerCapture
         EXPECT_GE(event.function_call().end_timestamp_ns(), previous_event_timestamp_ns);
         previous_event_timestamp_ns = event.function_call().end_timestamp_ns();
         break;
+      case orbit_grpc_protos::ProducerCaptureEvent::kFunctionCallStats:
+        UNREACHABLE();
       case orbit_grpc_protos::ProducerCaptureEvent::kInternedString:
         UNREACHABLE();
       case orbit_grpc_protos::ProducerCaptureEvent::kModulesSnapshot:
@@ -533,6 +562,8 @@ void VerifyOrderOfAllEvents(const std::vector<orbit_grpc_protos::ProducerCapture
         UNREACHABLE();
       case orbit_grpc_protos::ProducerCaptureEvent::kApiTrackUint64:
         UNREACHABLE();
+      case orbit_grpc_protos::ProducerCaptureEvent::kApiTrackSummary:
+        UNREACHABLE();
       case orbit_grpc_protos::ProducerCaptureEvent::kWarningEvent:
         UNREACHABLE();
       case orbit_grpc_protos::ProducerCaptureEvent::kClockResolutionEvent:
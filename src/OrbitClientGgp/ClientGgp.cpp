@@ -130,7 +130,8 @@ ErrorMessageOr<void> ClientGgp::RequestStartCapture(orbit_base::ThreadPool* thre
       /*record_arguments=*/false, /*record_return_values=*/false, selected_tracepoints,
       options_.samples_per_second, options_.stack_dump_size, unwinding_method,
       collect_scheduling_info, collect_thread_state, collect_gpu_jobs, enable_api,
-      enable_introspection, enable_user_space_instrumentation,
+      /*api_track_aggregation_window_ns=*/0, enable_introspection,
+      enable_user_space_instrumentation, /*user_space_instrumentation_statistics_only=*/false,
       max_local_marker_depth_per_command_buffer, /*collect_memory_info=*/false, 0,
       std::move(event_processor));
 
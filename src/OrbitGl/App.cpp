@@ -405,6 +405,10 @@ void OrbitApp::OnTimer(const TimerInfo& timer_info) {
   frame_track_online_processor_.ProcessTimer(timer_info, func);
 }
 
+void OrbitApp::OnFunctionCallStats(const orbit_grpc_protos::FunctionCallStats& stats) {
+  GetMutableCaptureData().UpdateFunctionStats(stats);
+}
+
 void OrbitApp::OnApiStringEvent(const orbit_client_protos::ApiStringEvent& api_string_event) {
   GetMutableTimeGraph()->ProcessApiStringEvent(api_string_event);
 }
@@ -1314,9 +1318,12 @@ void OrbitApp::StartCapture() {
   bool collect_thread_states = data_manager_->collect_thread_states();
   bool collect_gpu_jobs = true;
   bool enable_api = data_manager_->get_enable_api();
+  uint64_t api_track_aggregation_window_ns = data_manager_->api_track_aggregation_window_ns();
   bool enable_introspection = IsDevMode() && data_manager_->get_enable_introspection();
   bool enable_user_space_instrumentation =
       IsDevMode() && data_manager_->enable_user_space_instrumentation();
+  bool user_space_instrumentation_statistics_only =
+      data_manager_->user_space_instrumentation_statistics_only();
   double samples_per_second = data_manager_->samples_per_second();
   uint16_t stack_dump_size = data_manager_->stack_dump_size();
   UnwindingMethod unwinding_method = data_manager_->unwinding_method();
@@ -1370,9 +1377,9 @@ void OrbitApp::StartCapture() {
       /*record_arguments=*/false, absl::GetFlag(FLAGS_show_return_values),
       std::move(selected_tracepoints), samples_per_second, stack_dump_size, unwinding_method,
       collect_scheduling_info, collect_thread_states, collect_gpu_jobs, enable_api,
-      enable_introspection, enable_user_space_instrumentation,
-      max_local_marker_depth_per_command_buffer, collect_memory_info, memory_sampling_period_ms,
-      std::move(capture_event_processor));
+      api_track_aggregation_window_ns, enable_introspection, enable_user_space_instrumentation,
+      user_space_instrumentation_statistics_only, max_local_marker_depth_per_command_buffer,
+      collect_memory_info, memory_sampling_period_ms, std::move(capture_event_processor));
 
   // TODO(b/187250643): Refactor this to be more readable and maybe remove parts that are not needed
   // here (capture cancelled)
@@ -2136,6 +2143,10 @@ void OrbitApp::SetCollectThreadStates(bool collect_thread_states) {
 
 void OrbitApp::SetEnableApi(bool enable_api) { data_manager_->set_enable_api(enable_api); }
 
+void OrbitApp::SetApiTrackAggregationWindowNs(uint64_t api_track_aggregation_window_ns) {
+  data_manager_->set_api_track_aggregation_window_ns(api_track_aggregation_window_ns);
+}
+
 void OrbitApp::SetEnableIntrospection(bool enable_introspection) {
   data_manager_->set_enable_introspection(enable_introspection);
 }
@@ -2144,6 +2155,10 @@ void OrbitApp::SetEnableUserSpaceInstrumentation(bool enable) {
   data_manager_->set_enable_user_space_instrumentation(enable);
 }
 
+void OrbitApp::SetUserSpaceInstrumentationStatisticsOnly(bool statistics_only) {
+  data_manager_->set_user_space_instrumentation_statistics_only(statistics_only);
+}
+
 void OrbitApp::SetSamplesPerSecond(double samples_per_second) {
   data_manager_->set_samples_per_second(samples_per_second);
 }
@@ -142,6 +142,7 @@ class OrbitApp final : public DataViewFactory,
                         absl::flat_hash_set<uint64_t> frame_track_function_ids) override;
   void OnCaptureFinished(const orbit_grpc_protos::CaptureFinished& capture_finished) override;
   void OnTimer(const orbit_client_protos::TimerInfo& timer_info) override;
+  void OnFunctionCallStats(const orbit_grpc_protos::FunctionCallStats& stats) override;
   void OnKeyAndString(uint64_t key, std::string str) override;
   void OnUniqueCallstack(uint64_t callstack_id,
                          orbit_client_protos::CallstackInfo callstack) override;
@@ -388,8 +389,10 @@ class OrbitApp final : public DataViewFactory,
 
   void SetCollectThreadStates(bool collect_thread_states);
   void SetEnableApi(bool enable_api);
+  void SetApiTrackAggregationWindowNs(uint64_t api_track_aggregation_window_ns);
   void SetEnableIntrospection(bool enable_introspection);
   void SetEnableUserSpaceInstrumentation(bool enable);
+  void SetUserSpaceInstrumentationStatisticsOnly(bool statistics_only);
   void SetSamplesPerSecond(double samples_per_second);
   void SetStackDumpSize(uint16_t stack_dump_size);
   void SetUnwindingMethod(orbit_grpc_protos::UnwindingMethod unwinding_method);
@@ -150,10 +150,12 @@ void CallstackThreadBar::UpdatePrimitives(Batcher* batcher, uint64_t min_tick, u
       Vec2 pos(time_graph_->GetWorldFromTick(time) - kPickingBoxOffset,
                GetPos()[1] + track_height - 1);
       Vec2 size(kPickingBoxWidth, track_height);
+      // The CallstackEvent passed by CallstackData is only valid during this call, so the tooltip
+      // keeps the callstack id instead.
       auto user_data = std::make_unique<PickingUserData>(
-          nullptr,
-          [this, batcher](PickingId id) -> std::string { return GetSampleTooltip(*batcher, id); });
-      user_data->custom_data_ = &event;
+          nullptr, [this, callstack_id = event.callstack_id()](PickingId /*id*/) -> std::string {
+            return GetSampleTooltip(callstack_id);
+          });
       batcher->AddShadedBox(pos, size, z, kGreenSelection, std::move(user_data));
     };
     if (GetThreadId() == orbit_base::kAllProcessThreadsTid) {
@@ -241,19 +243,11 @@ std::string CallstackThreadBar::FormatCallstackForTooltip(const CallstackInfo& c
   return result;
 }
 
-std::string CallstackThreadBar::GetSampleTooltip(const Batcher& batcher, PickingId id) const {
+std::string CallstackThreadBar::GetSampleTooltip(uint64_t callstack_id) const {
   static const std::string unknown_return_text = "Function call information missing";
 
-  const PickingUserData* user_data = batcher.GetUserData(id);
-  if (user_data == nullptr || user_data->custom_data_ == nullptr) {
-    return unknown_return_text;
-  }
-
   CHECK(capture_data_ != nullptr);
   const CallstackData& callstack_data = capture_data_->GetCallstackData();
-  const auto* callstack_event = static_cast<const CallstackEvent*>(user_data->custom_data_);
-
-  uint64_t callstack_id = callstack_event->callstack_id();
   const CallstackInfo* callstack = callstack_data.GetCallstack(callstack_id);
   if (callstack == nullptr) {
     return unknown_return_text;
@@ -91,6 +91,19 @@ void HandleCaptureEvent(const orbit_api::ApiTrackUint64& track_uint64,
   api_event_processor->ProcessApiTrackUint64(api_event);
 }
 
+void HandleCaptureEvent(const orbit_api::ApiTrackSummary& track_summary,
+                        orbit_capture_client::ApiEventProcessor* api_event_processor) {
+  orbit_grpc_protos::ApiTrackSummary api_event;
+  track_summary.CopyToGrpcProto(&api_event);
+  api_event_processor->ProcessApiTrackSummary(api_event);
+}
+
+// Introspection doesn't intern the names of its events.
+void HandleCaptureEvent(const orbit_api::ApiInternedString& /*unused*/,
+                        orbit_capture_client::ApiEventProcessor* /*unused*/) {
+  UNREACHABLE();
+}
+
 // The variant type `ApiEventVariant` requires to contain `std::monostate` in order to be default-
 // constructable. However, that state is never expected to be called in the visitor.
 void HandleCaptureEvent(const std::monostate& /*unused*/,
@@ -126,6 +139,9 @@ class IntrospectionCaptureListener : public orbit_capture_client::CaptureListene
   void OnCaptureFinished(const orbit_grpc_protos::CaptureFinished& /*capture_finished*/) override {
     UNREACHABLE();
   }
+  void OnFunctionCallStats(const orbit_grpc_protos::FunctionCallStats& /*stats*/) override {
+    UNREACHABLE();
+  }
   void OnKeyAndString(uint64_t /*key*/, std::string /*str*/) override { UNREACHABLE(); }
   void OnUniqueCallstack(uint64_t /*callstack_id*/,
                          orbit_client_protos::CallstackInfo /*callstack*/) override {
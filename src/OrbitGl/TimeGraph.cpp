@@ -327,6 +327,10 @@ void TimeGraph::ProcessApiTrackValueEvent(const orbit_client_protos::ApiTrackVal
   VariableTrack* track = track_manager_->GetOrCreateVariableTrack(track_event.name());
 
   uint64_t time = track_event.timestamp_ns();
+  if (track_event.has_range()) {
+    const orbit_client_protos::ApiTrackValueRange& range = track_event.range();
+    track->AddValueRange(range.first_timestamp_ns(), time, range.min(), range.max());
+  }
 
   switch (track_event.data_case()) {
     case ApiTrackValue::kDataDouble:
@@ -552,15 +556,22 @@ void TimeGraph::SelectCallstacks(float world_start, float world_end, uint32_t th
   uint64_t t1 = GetTickFromWorld(world_end);
 
   CHECK(capture_data_);
-  std::vector<CallstackEvent> selected_callstack_events =
-      (thread_id == orbit_base::kAllProcessThreadsTid)
-          ? capture_data_->GetCallstackData().GetCallstackEventsInTimeRange(t0, t1)
-          : capture_data_->GetCallstackData().GetCallstackEventsOfTidInTimeRange(thread_id, t0, t1);
-
+  std::vector<CallstackEvent> selected_callstack_events;
   selected_callstack_events_per_thread_.clear();
-  for (CallstackEvent& event : selected_callstack_events) {
-    selected_callstack_events_per_thread_[event.thread_id()].emplace_back(event);
-    selected_callstack_events_per_thread_[orbit_base::kAllProcessThreadsTid].emplace_back(event);
+  auto select_callstack_event = [this, &selected_callstack_events](const CallstackEvent& event) {
+    selected_callstack_events.push_back(event);
+    selected_callstack_events_per_thread_[event.thread_id()].push_back(event);
+    selected_callstack_events_per_thread_[orbit_base::kAllProcessThreadsTid].push_back(event);
+  };
+  // The selection excludes t1.
+  if (t0 < t1) {
+    if (thread_id == orbit_base::kAllProcessThreadsTid) {
+      capture_data_->GetCallstackData().ForEachCallstackEventInTimeRange(t0, t1 - 1,
+                                                                         select_callstack_event);
+    } else {
+      capture_data_->GetCallstackData().ForEachCallstackEventOfTidInTimeRange(
+          thread_id, t0, t1 - 1, select_callstack_event);
+    }
   }
 
   app_->SelectCallstackEvents(selected_callstack_events, thread_id);
@@ -0,0 +1,62 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "VariableTrack.h"
+
+#include <GteVector.h>
+
+#include "Geometry.h"
+#include "TimeGraph.h"
+
+namespace orbit_gl {
+
+void VariableTrack::AddValueRange(uint64_t start_time, uint64_t end_time, double min, double max) {
+  absl::MutexLock lock(&ranges_mutex_);
+  start_time_to_ranges_.emplace(start_time, ValueRange{end_time, min, max});
+  max_range_duration_ = std::max(max_range_duration_, end_time - start_time);
+  ranges_min_ = std::min(ranges_min_, min);
+  ranges_max_ = std::max(ranges_max_, max);
+}
+
+double VariableTrack::GetGraphMaxValue() const {
+  absl::MutexLock lock(&ranges_mutex_);
+  return std::max(series_.GetMax(), ranges_max_);
+}
+
+double VariableTrack::GetGraphMinValue() const {
+  absl::MutexLock lock(&ranges_mutex_);
+  return std::min(series_.GetMin(), ranges_min_);
+}
+
+void VariableTrack::DrawSeries(Batcher* batcher, uint64_t min_tick, uint64_t max_tick, float z) {
+  double min = GetGraphMinValue();
+  double inverse_value_range = GetInverseOfGraphValueRange();
+  float content_height = GetGraphContentHeight();
+  float base_y = GetGraphContentBottomY();
+  Color range_color = GetColor(0);
+  range_color[3] /= 2;
+
+  {
+    absl::MutexLock lock(&ranges_mutex_);
+    // Ranges are sorted by start time, so the first range that can overlap [min_tick, max_tick]
+    // starts at most `max_range_duration_` before `min_tick`.
+    uint64_t first_start_tick = min_tick > max_range_duration_ ? min_tick - max_range_duration_ : 0;
+    auto end = start_time_to_ranges_.upper_bound(max_tick);
+    for (auto it = start_time_to_ranges_.lower_bound(first_start_tick); it != end; ++it) {
+      const auto& [start_time, range] = *it;
+      if (range.end_time < min_tick) continue;
+      float x0 = time_graph_->GetWorldFromTick(start_time);
+      float x1 = time_graph_->GetWorldFromTick(range.end_time);
+      float y_min =
+          base_y - static_cast<float>((range.min - min) * inverse_value_range) * content_height;
+      float y_max =
+          base_y - static_cast<float>((range.max - min) * inverse_value_range) * content_height;
+      batcher->AddBox(Box(Vec2(x0, y_max), Vec2(x1 - x0, y_min - y_max), z), range_color);
+    }
+  }
+
+  LineGraphTrack<kVariableTrackDimension>::DrawSeries(batcher, min_tick, max_tick, z);
+}
+
+}  // namespace orbit_gl
@@ -5,6 +5,11 @@
 #ifndef ORBIT_GL_VARIABLE_TRACK_H_
 #define ORBIT_GL_VARIABLE_TRACK_H_
 
+#include <absl/synchronization/mutex.h>
+
+#include <algorithm>
+#include <limits>
+#include <map>
 #include <string>
 #include <utility>
 
@@ -37,10 +42,30 @@ class VariableTrack final : public LineGraphTrack<kVariableTrackDimension> {
   [[nodiscard]] std::string GetName() const override { return name_; }
   [[nodiscard]] Track::Type GetType() const override { return Track::Type::kVariableTrack; }
   void AddValue(uint64_t time, double value) { AddValues(time, {value}); }
+  // Adds the range of values that a summarized track took between `start_time` and `end_time`. The
+  // range is drawn as a box behind the line of the values.
+  void AddValueRange(uint64_t start_time, uint64_t end_time, double min, double max);
+
+ protected:
+  [[nodiscard]] double GetGraphMaxValue() const override;
+  [[nodiscard]] double GetGraphMinValue() const override;
+  void DrawSeries(Batcher* batcher, uint64_t min_tick, uint64_t max_tick, float z) override;
 
  private:
+  struct ValueRange {
+    uint64_t end_time;
+    double min;
+    double max;
+  };
+
   std::string name_;
 
+  mutable absl::Mutex ranges_mutex_;
+  std::multimap<uint64_t, ValueRange> start_time_to_ranges_ GUARDED_BY(ranges_mutex_);
+  uint64_t max_range_duration_ GUARDED_BY(ranges_mutex_) = 0;
+  double ranges_min_ GUARDED_BY(ranges_mutex_) = std::numeric_limits<double>::max();
+  double ranges_max_ GUARDED_BY(ranges_mutex_) = std::numeric_limits<double>::lowest();
+
   std::string GetLegendTooltips(size_t /*legend_index*/) const override { return ""; }
 };
 
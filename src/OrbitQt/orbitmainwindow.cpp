@@ -178,6 +178,10 @@ OrbitMainWindow::OrbitMainWindow(TargetConfiguration target_configuration,
   uint16_t stack_dump_size = absl::GetFlag(FLAGS_stack_dump_size);
   CHECK(stack_dump_size <= 65000 && stack_dump_size > 0);
   app_->SetStackDumpSize(stack_dump_size);
+  app_->SetApiTrackAggregationWindowNs(
+      uint64_t{absl::GetFlag(FLAGS_api_track_aggregation_window_us)} * 1000);
+  app_->SetUserSpaceInstrumentationStatisticsOnly(
+      absl::GetFlag(FLAGS_user_space_instrumentation_statistics_only));
   app_->SetUnwindingMethod(absl::GetFlag(FLAGS_frame_pointer_unwinding)
                                ? orbit_grpc_protos::UnwindingMethod::kFramePointerUnwinding
                                : orbit_grpc_protos::UnwindingMethod::kDwarfUnwinding);
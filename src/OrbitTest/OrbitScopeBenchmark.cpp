@@ -0,0 +1,236 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <absl/base/casts.h>
+#include <absl/strings/str_format.h>
+#include <absl/synchronization/mutex.h>
+#include <absl/time/time.h>
+#include <benchmark/benchmark.h>
+#include <grpcpp/grpcpp.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "ApiInterface/Orbit.h"
+#include "ProducerSideChannel/ProducerSideChannel.h"
+#include "capture.pb.h"
+#include "producer_side_services.grpc.pb.h"
+
+ORBIT_API_INSTANTIATE;
+
+// Defined in liborbit.so, and called remotely by OrbitService on a capture start.
+extern "C" void orbit_api_set_enabled(uint64_t address, uint64_t api_version, bool enabled);
+
+// Measures the overhead of ORBIT_SCOPE as seen by the instrumented code while the process is
+// captured, depending on the number of threads using it concurrently. The benchmark plays the
+// role of OrbitService itself: it listens on the socket of ProducerSideService, enables the Orbit
+// API in its own process and starts a capture, so that the events go all the way through
+// LockFreeApiEventProducer to the socket.
+namespace {
+
+// Counts the CaptureEvents the producer sends, and lets the benchmark send commands to it.
+class FakeProducerSideService final : public orbit_grpc_protos::ProducerSideService::Service {
+ public:
+  grpc::Status ReceiveCommandsAndSendEvents(
+      grpc::ServerContext* /*context*/,
+      grpc::ServerReaderWriter<orbit_grpc_protos::ReceiveCommandsAndSendEventsResponse,
+                               orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest>* stream)
+      override {
+    {
+      absl::MutexLock lock{&mutex_};
+      stream_ = stream;
+    }
+
+    orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest request;
+    while (stream->Read(&request)) {
+      absl::MutexLock lock{&mutex_};
+      switch (request.event_case()) {
+        case orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::kBufferedCaptureEvents:
+          received_event_count_ += request.buffered_capture_events().capture_events_size();
+          break;
+        case orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::kAllEventsSent:
+          all_events_sent_received_ = true;
+          break;
+        default:
+          break;
+      }
+    }
+
+    absl::MutexLock lock{&mutex_};
+    stream_ = nullptr;
+    return grpc::Status::OK;
+  }
+
+  [[nodiscard]] bool WaitForProducerToConnect(absl::Duration timeout) {
+    absl::MutexLock lock{&mutex_};
+    return mutex_.AwaitWithTimeout(
+        absl::Condition(
+            +[](grpc::ServerReaderWriter<orbit_grpc_protos::ReceiveCommandsAndSendEventsResponse,
+                                         orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest>**
+                    stream) { return *stream != nullptr; },
+            &stream_),
+        timeout);
+  }
+
+  [[nodiscard]] bool WaitForEvents(absl::Duration timeout) {
+    absl::MutexLock lock{&mutex_};
+    return mutex_.AwaitWithTimeout(
+        absl::Condition(
+            +[](uint64_t* received_event_count) { return *received_event_count > 0; },
+            &received_event_count_),
+        timeout);
+  }
+
+  [[nodiscard]] bool WaitForAllEventsSent(absl::Duration timeout) {
+    absl::MutexLock lock{&mutex_};
+    return mutex_.AwaitWithTimeout(absl::Condition(&all_events_sent_received_), timeout);
+  }
+
+  [[nodiscard]] uint64_t GetReceivedEventCount() {
+    absl::MutexLock lock{&mutex_};
+    return received_event_count_;
+  }
+
+  void SendStartCaptureCommand(orbit_grpc_protos::CaptureOptions capture_options) {
+    orbit_grpc_protos::ReceiveCommandsAndSendEventsResponse command;
+    *command.mutable_start_capture_command()->mutable_capture_options() =
+        std::move(capture_options);
+    SendCommand(command);
+  }
+
+  void SendStopCaptureCommand() {
+    orbit_grpc_protos::ReceiveCommandsAndSendEventsResponse command;
+    command.mutable_stop_capture_command();
+    SendCommand(command);
+  }
+
+  void SendCaptureFinishedCommand() {
+    orbit_grpc_protos::ReceiveCommandsAndSendEventsResponse command;
+    command.mutable_capture_finished_command();
+    SendCommand(command);
+  }
+
+ private:
+  void SendCommand(const orbit_grpc_protos::ReceiveCommandsAndSendEventsResponse& command) {
+    absl::MutexLock lock{&mutex_};
+    if (stream_ == nullptr || !stream_->Write(command)) {
+      fprintf(stderr, "Sending command to the producer failed.\n");
+    }
+  }
+
+  absl::Mutex mutex_;
+  grpc::ServerReaderWriter<orbit_grpc_protos::ReceiveCommandsAndSendEventsResponse,
+                           orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest>* stream_
+      ABSL_GUARDED_BY(mutex_) = nullptr;
+  uint64_t received_event_count_ ABSL_GUARDED_BY(mutex_) = 0;
+  bool all_events_sent_received_ ABSL_GUARDED_BY(mutex_) = false;
+};
+
+void BM_OrbitScope(benchmark::State& state) {
+  for (auto _ : state) {
+    ORBIT_SCOPE("BM_OrbitScope");
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void BM_OrbitScopeNested(benchmark::State& state) {
+  for (auto _ : state) {
+    ORBIT_SCOPE("BM_OrbitScopeNested outer");
+    {
+      ORBIT_SCOPE("BM_OrbitScopeNested inner");
+    }
+  }
+  state.SetItemsProcessed(2 * state.iterations());
+}
+
+void SetOrbitApiEnabled(bool enabled) {
+  orbit_api_set_enabled(absl::bit_cast<uint64_t>(orbit_api_get_function_table_address_v1()),
+                        kOrbitApiVersion, enabled);
+}
+
+// Returns the exit code of the process.
+int RunBenchmarksWhileCapturing(FakeProducerSideService* fake_service) {
+  SetOrbitApiEnabled(true);
+  // The producer is created, and connects, on the first use of the API.
+  { ORBIT_SCOPE("Connect"); }
+  constexpr absl::Duration kTimeout = absl::Seconds(10);
+  if (!fake_service->WaitForProducerToConnect(kTimeout)) {
+    fprintf(stderr, "The producer did not connect.\n");
+    return 1;
+  }
+
+  // Bound the memory used by the producer, as the events can be produced faster than they are sent
+  // over the socket. The events dropped when the buffer is full still cost their enqueue attempt.
+  constexpr uint64_t kMaxBufferedEvents = 1'000'000;
+  orbit_grpc_protos::CaptureOptions capture_options;
+  capture_options.set_enable_api(true);
+  capture_options.set_producer_side_max_buffered_events(kMaxBufferedEvents);
+  fake_service->SendStartCaptureCommand(capture_options);
+  // The capture has started in the producer once its events arrive.
+  const absl::Time capture_start_deadline = absl::Now() + kTimeout;
+  while (!fake_service->WaitForEvents(absl::Milliseconds(10))) {
+    if (absl::Now() > capture_start_deadline) {
+      fprintf(stderr, "The producer did not start capturing.\n");
+      return 1;
+    }
+    ORBIT_SCOPE("Start capture");
+  }
+
+  benchmark::RunSpecifiedBenchmarks();
+
+  fake_service->SendStopCaptureCommand();
+  const bool all_events_sent = fake_service->WaitForAllEventsSent(kTimeout);
+  fake_service->SendCaptureFinishedCommand();
+  SetOrbitApiEnabled(false);
+  if (!all_events_sent) {
+    fprintf(stderr, "The producer did not send all its events.\n");
+    return 1;
+  }
+  printf("The producer sent %lu events.\n", fake_service->GetReceivedEventCount());
+  return 0;
+}
+
+}  // namespace
+
+BENCHMARK(BM_OrbitScope)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK(BM_OrbitScopeNested)->ThreadRange(1, 64)->UseRealTime();
+
+int main(int argc, char* argv[]) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+  // The producer in liborbit.so always connects to the default socket, which OrbitService listens
+  // on when it is running.
+  const std::string socket_path{orbit_producer_side_channel::kProducerSideUnixDomainSocketPath};
+  if (std::filesystem::exists(socket_path)) {
+    fprintf(stderr, "%s already exists: stop OrbitService, or remove the file, and try again.\n",
+            socket_path.c_str());
+    return 1;
+  }
+
+  FakeProducerSideService fake_service;
+  grpc::ServerBuilder builder;
+  builder.AddListeningPort(absl::StrFormat("unix:%s", socket_path),
+                           grpc::InsecureServerCredentials());
+  builder.RegisterService(&fake_service);
+  std::unique_ptr<grpc::Server> server = builder.BuildAndStart();
+  if (server == nullptr) {
+    fprintf(stderr, "Listening on %s failed.\n", socket_path.c_str());
+    return 1;
+  }
+
+  const int exit_code = RunBenchmarksWhileCapturing(&fake_service);
+
+  // The producer keeps its stream open, so it needs to be cancelled.
+  server->Shutdown(std::chrono::system_clock::now() + std::chrono::seconds(1));
+  server->Wait();
+  std::filesystem::remove(socket_path);
+  return exit_code;
+}
+
@@ -17,6 +17,11 @@ namespace orbit_producer_side_channel {
 // between producers of CaptureEvents and OrbitService.
 constexpr std::string_view kProducerSideUnixDomainSocketPath = "/tmp/orbit-producer-side-socket";
 
+// This is the path of the Unix domain socket on which producers pass the file descriptors of their
+// shared memory ring buffers to OrbitService.
+constexpr std::string_view kProducerSideSharedMemoryFdSocketPath =
+    "/tmp/orbit-producer-side-shared-memory-socket";
+
 // This function returns a gRPC channel that uses a Unix domain socket,
 // by default the one specified by kProducerSideUnixDomainSocketPath.
 inline std::shared_ptr<grpc::Channel> CreateProducerSideChannel(
@@ -0,0 +1,30 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "AdaptiveBatchingController.h"
+
+#include <algorithm>
+
+namespace orbit_service {
+
+void AdaptiveBatchingController::OnBatchSent(uint64_t event_count, absl::Duration send_duration) {
+  // Nothing was sent, so there is nothing to learn about the connection.
+  if (event_count == 0) {
+    return;
+  }
+
+  // The thresholds leave a gap in between, so that the interval doesn't oscillate.
+  if (send_duration > send_interval_ / 2) {
+    send_interval_ = std::min(send_interval_ * 2, kMaxSendInterval);
+  } else if (send_duration < send_interval_ / 8) {
+    send_interval_ = std::max(send_interval_ * 3 / 4, kMinSendInterval);
+  }
+}
+
+uint64_t AdaptiveBatchingController::GetSendEventCount() const {
+  const auto interval_ms = static_cast<uint64_t>(absl::ToInt64Milliseconds(send_interval_));
+  return std::max(interval_ms * kSendEventCountPerMillisecond, kMinSendEventCount);
+}
+
+}  // namespace orbit_service
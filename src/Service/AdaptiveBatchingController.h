@@ -0,0 +1,39 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SERVICE_ADAPTIVE_BATCHING_CONTROLLER_H_
+#define SERVICE_ADAPTIVE_BATCHING_CONTROLLER_H_
+
+#include <absl/time/time.h>
+#include <stdint.h>
+
+namespace orbit_service {
+
+// Decides how often the buffered CaptureEvents are sent to the client, based on how long sending
+// the previous batches took. As the writes to the gRPC stream block on flow control, this duration
+// reflects the round-trip time and the bandwidth of the connection.
+// On a fast connection, batches are sent often, for a smooth live view of the capture. When sending
+// takes a significant part of the interval, the batches are made larger, so that the per-message
+// overhead is amortized and the sender keeps up.
+class AdaptiveBatchingController {
+ public:
+  static constexpr absl::Duration kMinSendInterval = absl::Milliseconds(5);
+  static constexpr absl::Duration kMaxSendInterval = absl::Milliseconds(200);
+  static constexpr absl::Duration kInitialSendInterval = absl::Milliseconds(20);
+  // A batch is also sent when this many events per millisecond of the interval have been buffered.
+  static constexpr uint64_t kSendEventCountPerMillisecond = 250;
+  static constexpr uint64_t kMinSendEventCount = 1'000;
+
+  void OnBatchSent(uint64_t event_count, absl::Duration send_duration);
+
+  [[nodiscard]] absl::Duration GetSendInterval() const { return send_interval_; }
+  [[nodiscard]] uint64_t GetSendEventCount() const;
+
+ private:
+  absl::Duration send_interval_ = kInitialSendInterval;
+};
+
+}  // namespace orbit_service
+
+#endif  // SERVICE_ADAPTIVE_BATCHING_CONTROLLER_H_
@@ -0,0 +1,46 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "AdaptiveBatchingController.h"
+
+namespace orbit_service {
+
+TEST(AdaptiveBatchingController, StartsWithInitialInterval) {
+  AdaptiveBatchingController controller;
+  EXPECT_EQ(controller.GetSendInterval(), AdaptiveBatchingController::kInitialSendInterval);
+  EXPECT_EQ(controller.GetSendEventCount(), 5'000);
+}
+
+TEST(AdaptiveBatchingController, FastSendsShrinkTheInterval) {
+  AdaptiveBatchingController controller;
+  for (int i = 0; i < 100; ++i) {
+    controller.OnBatchSent(100, absl::Microseconds(100));
+  }
+  EXPECT_EQ(controller.GetSendInterval(), AdaptiveBatchingController::kMinSendInterval);
+  EXPECT_EQ(controller.GetSendEventCount(), 1'250);
+}
+
+TEST(AdaptiveBatchingController, SlowSendsGrowTheInterval) {
+  AdaptiveBatchingController controller;
+  controller.OnBatchSent(5'000, absl::Milliseconds(15));
+  EXPECT_EQ(controller.GetSendInterval(), absl::Milliseconds(40));
+  EXPECT_EQ(controller.GetSendEventCount(), 10'000);
+
+  for (int i = 0; i < 100; ++i) {
+    controller.OnBatchSent(10'000, absl::Seconds(1));
+  }
+  EXPECT_EQ(controller.GetSendInterval(), AdaptiveBatchingController::kMaxSendInterval);
+}
+
+TEST(AdaptiveBatchingController, ModerateSendsAndEmptyBatchesKeepTheInterval) {
+  AdaptiveBatchingController controller;
+  controller.OnBatchSent(5'000, absl::Milliseconds(5));
+  EXPECT_EQ(controller.GetSendInterval(), AdaptiveBatchingController::kInitialSendInterval);
+  controller.OnBatchSent(0, absl::ZeroDuration());
+  EXPECT_EQ(controller.GetSendInterval(), AdaptiveBatchingController::kInitialSendInterval);
+}
+
+}  // namespace orbit_service
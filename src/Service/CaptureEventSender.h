@@ -5,6 +5,10 @@
 #ifndef ORBIT_SERVICE_CAPTURE_EVENT_SENDER_H_
 #define ORBIT_SERVICE_CAPTURE_EVENT_SENDER_H_
 
+#include <stdint.h>
+
+#include <vector>
+
 #include "capture.pb.h"
 
 namespace orbit_service {
@@ -14,6 +18,9 @@ namespace orbit_service {
 class CaptureEventSender {
  public:
   virtual ~CaptureEventSender() = default;
+  // Called before SendEvents with the number of events the caller normally accumulates before
+  // sending them, so that implementations can tell a backlog from a regular batch.
+  virtual void SetRegularBatchEventCount(uint64_t /*regular_batch_event_count*/) {}
   virtual void SendEvents(std::vector<orbit_grpc_protos::ClientCaptureEvent>* events) = 0;
 };
 
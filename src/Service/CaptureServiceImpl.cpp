@@ -6,20 +6,28 @@
 
 #include <absl/base/thread_annotations.h>
 #include <absl/container/flat_hash_set.h>
+#include <absl/flags/declare.h>
+#include <absl/flags/flag.h>
+#include <absl/strings/str_format.h>
 #include <absl/synchronization/mutex.h>
 #include <absl/time/time.h>
 #include <pthread.h>
 #include <stdint.h>
+#include <time.h>
+#include <zlib.h>
 
 #include <algorithm>
 #include <limits>
+#include <string>
 #include <thread>
 #include <utility>
 #include <vector>
 
+#include "AdaptiveBatchingController.h"
 #include "ApiLoader/EnableInTracee.h"
 #include "CaptureEventBuffer.h"
 #include "CaptureEventSender.h"
+#include "CompactCaptureEventEncoder.h"
 #include "GrpcProtos/Constants.h"
 #include "Introspection/Introspection.h"
 #include "MemoryInfoHandler.h"
@@ -29,9 +37,21 @@
 #include "OrbitBase/Profiling.h"
 #include "OrbitVersion/OrbitVersion.h"
 #include "ProducerEventProcessor.h"
+#include "SenderThreadCaptureEventBuffer.h"
 #include "TracingHandler.h"
 #include "capture.pb.h"
 
+ABSL_DECLARE_FLAG(uint32_t, ring_buffer_reader_threads);
+ABSL_DECLARE_FLAG(bool, event_driven_ring_buffer_reads);
+ABSL_DECLARE_FLAG(bool, adaptive_event_processing_delay);
+ABSL_DECLARE_FLAG(uint32_t, unwinding_threads);
+ABSL_DECLARE_FLAG(uint32_t, unwind_result_cache_size);
+ABSL_DECLARE_FLAG(bool, producer_side_shared_memory);
+ABSL_DECLARE_FLAG(uint64_t, producer_side_max_buffered_events);
+ABSL_DECLARE_FLAG(bool, capture_stream_compression);
+ABSL_DECLARE_FLAG(bool, user_space_instrumentation_fast_path);
+ABSL_DECLARE_FLAG(bool, user_space_instrumentation_persistent);
+
 namespace orbit_service {
 
 using orbit_grpc_protos::CaptureFinished;
@@ -45,81 +65,34 @@ namespace {
 
 using orbit_grpc_protos::ClientCaptureEvent;
 
-class SenderThreadCaptureEventBuffer final : public CaptureEventBuffer {
- public:
-  explicit SenderThreadCaptureEventBuffer(CaptureEventSender* event_sender)
-      : capture_event_sender_{event_sender} {
-    CHECK(capture_event_sender_ != nullptr);
-    sender_thread_ = std::thread{[this] { SenderThread(); }};
-  }
-
-  void AddEvent(ClientCaptureEvent&& event) override {
-    absl::MutexLock lock{&events_being_buffered_mutex_};
-    if (stop_requested_) {
-      return;
-    }
-    events_being_buffered_.emplace_back(std::move(event));
-  }
-
-  void StopAndWait() {
-    CHECK(sender_thread_.joinable());
-    {
-      // Protect stop_requested_ with event_buffer_mutex_ so that we can use stop_requested_
-      // in Conditions for Await/LockWhen (specifically, in SenderThread).
-      absl::MutexLock lock{&events_being_buffered_mutex_};
-      stop_requested_ = true;
-    }
-    sender_thread_.join();
-  }
-
-  ~SenderThreadCaptureEventBuffer() override { CHECK(!sender_thread_.joinable()); }
-
- private:
-  void SenderThread() {
-    orbit_base::SetCurrentThreadName("SenderThread");
-    constexpr absl::Duration kSendTimeInterval = absl::Milliseconds(20);
-    // This should be lower than kMaxEventsPerResponse in GrpcCaptureEventSender::SendEvents
-    // as a few more events are likely to arrive after the condition becomes true.
-    constexpr uint64_t kSendEventCountInterval = 5000;
-
-    bool stopped = false;
-    while (!stopped) {
-      ORBIT_SCOPE("SenderThread iteration");
-
-      events_being_buffered_mutex_.LockWhenWithTimeout(
-          absl::Condition(
-              +[](SenderThreadCaptureEventBuffer* self) {
-                return self->events_being_buffered_.size() >= kSendEventCountInterval ||
-                       self->stop_requested_;
-              },
-              this),
-          kSendTimeInterval);
-      if (stop_requested_) {
-        stopped = true;
-      }
-      events_being_buffered_.swap(events_to_send_);
-      events_being_buffered_mutex_.Unlock();
+// CPU time consumed by the calling thread. For the sender thread, this includes the time gRPC spends
+// serializing and compressing the messages it writes.
+uint64_t GetThreadCpuTimeNs() {
+  timespec ts{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
 
-      capture_event_sender_->SendEvents(&events_to_send_);
-      // std::vector::clear() "Leaves the capacity() of the vector unchanged", which is desired.
-      events_to_send_.clear();
-    }
+// gRPC doesn't expose the size of the messages it compresses, so the size of a message compressed
+// with gzip is estimated by compressing it with zlib, which gRPC itself uses for gzip.
+uint64_t GetDeflatedSize(const std::string& data) {
+  uLongf deflated_size = compressBound(data.size());
+  std::vector<Bytef> deflated(deflated_size);
+  if (compress(deflated.data(), &deflated_size, reinterpret_cast<const Bytef*>(data.data()),
+               data.size()) != Z_OK) {
+    return data.size();
   }
-
-  std::vector<ClientCaptureEvent> events_being_buffered_
-      ABSL_GUARDED_BY(events_being_buffered_mutex_);
-  absl::Mutex events_being_buffered_mutex_;
-  std::vector<ClientCaptureEvent> events_to_send_;
-  CaptureEventSender* capture_event_sender_;
-  std::thread sender_thread_;
-  bool stop_requested_ ABSL_GUARDED_BY(events_being_buffered_mutex_) = false;
-};
+  return deflated_size;
+}
 
 class GrpcCaptureEventSender final : public CaptureEventSender {
  public:
   explicit GrpcCaptureEventSender(
-      grpc::ServerReaderWriter<CaptureResponse, CaptureRequest>* reader_writer)
-      : reader_writer_{reader_writer} {
+      grpc::ServerReaderWriter<CaptureResponse, CaptureRequest>* reader_writer,
+      bool compact_encoding, bool compression)
+      : reader_writer_{reader_writer},
+        compact_encoding_{compact_encoding},
+        compression_{compression} {
     CHECK(reader_writer_ != nullptr);
   }
 
@@ -133,6 +106,20 @@ class GrpcCaptureEventSender final : public CaptureEventSender {
         static_cast<float>(total_number_of_bytes_sent_) / total_number_of_events_sent_;
 
     LOG("Average number of bytes per event: %.2f", average_bytes);
+    LOG("CPU time spent writing responses: %.3f ms", total_write_cpu_time_ns_ / 1'000'000.0);
+    if (compression_) {
+      LOG("Number of responses compressed: %lu out of %lu", total_number_of_compressed_responses_,
+          total_number_of_responses_);
+      // No response was sampled if none was compressed.
+      if (sampled_compressed_bytes_ > 0) {
+        LOG("Estimated compression ratio: %.2f",
+            static_cast<float>(sampled_uncompressed_bytes_) / sampled_compressed_bytes_);
+      }
+    }
+  }
+
+  void SetRegularBatchEventCount(uint64_t regular_batch_event_count) override {
+    regular_batch_event_count_ = regular_batch_event_count;
   }
 
   void SendEvents(std::vector<ClientCaptureEvent>* events) override {
@@ -142,23 +129,42 @@ class GrpcCaptureEventSender final : public CaptureEventSender {
     if (events->empty()) {
       return;
     }
+    if (compression_) {
+      UpdateCompressionSuspended(events->size());
+    }
 
-    constexpr uint64_t kMaxEventsPerResponse = 10'000;
+    constexpr int kMaxEventsPerResponse = 10'000;
     uint64_t number_of_bytes_sent = 0;
     CaptureResponse response;
+    CompactCaptureEventEncoder compact_encoder{&response};
+    auto write_response = [this, &response, &compact_encoder, &number_of_bytes_sent] {
+      number_of_bytes_sent += response.ByteSizeLong();
+      WriteResponse(response);
+      response.clear_capture_events();
+      compact_encoder.Reset();
+    };
+
     for (ClientCaptureEvent& event : *events) {
       // We buffer to avoid sending countless tiny messages, but we also want to
       // avoid huge messages, which would cause the capture on the client to jump
       // forward in time in few big steps and not look live anymore.
-      if (response.capture_events_size() == kMaxEventsPerResponse) {
-        number_of_bytes_sent += response.ByteSizeLong();
-        reader_writer_->Write(response);
-        response.clear_capture_events();
+      const int event_count_in_response =
+          response.capture_events_size() + compact_encoder.GetEncodedEventCount();
+      if (event_count_in_response == kMaxEventsPerResponse) {
+        write_response();
+      }
+      // The client processes the compact columns after capture_events, so CaptureFinished needs
+      // to be in a response of its own for it to remain the last event.
+      if (event.event_case() == ClientCaptureEvent::kCaptureFinished &&
+          compact_encoder.GetEncodedEventCount() > 0) {
+        write_response();
+      }
+      if (compact_encoding_ && compact_encoder.TryEncode(event)) {
+        continue;
       }
       response.mutable_capture_events()->Add(std::move(event));
     }
-    number_of_bytes_sent += response.ByteSizeLong();
-    reader_writer_->Write(response);
+    write_response();
 
     // Ensure we can divide by 0.f safely.
     static_assert(std::numeric_limits<float>::is_iec559);
@@ -170,10 +176,69 @@ class GrpcCaptureEventSender final : public CaptureEventSender {
   }
 
  private:
+  // Compression costs CPU time on the sender thread. When the sender falls behind, i.e., when it
+  // is handed a backlog several times larger than the batches it is normally handed, responses are
+  // sent uncompressed until it has caught up again. The size of a regular batch grows with the send
+  // interval, so the thresholds are relative to it rather than absolute.
+  void UpdateCompressionSuspended(size_t buffered_event_count) {
+    constexpr uint64_t kSuspendCompressionBatchCount = 4;
+    const uint64_t suspend_compression_event_count =
+        kSuspendCompressionBatchCount * regular_batch_event_count_;
+    const uint64_t resume_compression_event_count = regular_batch_event_count_;
+    if (!compression_suspended_ && buffered_event_count >= suspend_compression_event_count) {
+      compression_suspended_ = true;
+      LOG("Suspending compression of the capture stream: %u events buffered",
+          buffered_event_count);
+    } else if (compression_suspended_ && buffered_event_count <= resume_compression_event_count) {
+      compression_suspended_ = false;
+      LOG("Resuming compression of the capture stream");
+    }
+  }
+
+  void WriteResponse(const CaptureResponse& response) {
+    const bool compress = compression_ && !compression_suspended_;
+    grpc::WriteOptions write_options;
+    if (!compress) {
+      write_options.set_no_compression();
+    }
+
+    // Estimating the compression ratio requires compressing the response a second time, so only
+    // do it for a sample of the responses.
+    constexpr uint64_t kCompressionRatioSamplingPeriod = 32;
+    if (compress && total_number_of_compressed_responses_ % kCompressionRatioSamplingPeriod == 0) {
+      std::string serialized_response = response.SerializeAsString();
+      const uint64_t compressed_size = GetDeflatedSize(serialized_response);
+      ORBIT_FLOAT("Estimated CaptureResponse compression ratio",
+                  static_cast<float>(serialized_response.size()) / compressed_size);
+      sampled_uncompressed_bytes_ += serialized_response.size();
+      sampled_compressed_bytes_ += compressed_size;
+    }
+
+    const uint64_t cpu_time_before_ns = GetThreadCpuTimeNs();
+    reader_writer_->Write(response, write_options);
+    const uint64_t write_cpu_time_ns = GetThreadCpuTimeNs() - cpu_time_before_ns;
+    ORBIT_UINT64("CPU time writing CaptureResponse (ns)", write_cpu_time_ns);
+
+    total_write_cpu_time_ns_ += write_cpu_time_ns;
+    ++total_number_of_responses_;
+    if (compress) {
+      ++total_number_of_compressed_responses_;
+    }
+  }
+
   grpc::ServerReaderWriter<CaptureResponse, CaptureRequest>* reader_writer_;
+  const bool compact_encoding_;
+  const bool compression_;
+  bool compression_suspended_ = false;
+  uint64_t regular_batch_event_count_ = AdaptiveBatchingController{}.GetSendEventCount();
 
   uint64_t total_number_of_events_sent_ = 0;
   uint64_t total_number_of_bytes_sent_ = 0;
+  uint64_t total_number_of_responses_ = 0;
+  uint64_t total_number_of_compressed_responses_ = 0;
+  uint64_t total_write_cpu_time_ns_ = 0;
+  uint64_t sampled_uncompressed_bytes_ = 0;
+  uint64_t sampled_compressed_bytes_ = 0;
 };
 
 // Remove the functions with ids in `filter_function_ids` from instrumented_functions in
@@ -312,7 +377,7 @@ static ClientCaptureEvent CreateCaptureFinishedEvent() {
 }
 
 grpc::Status CaptureServiceImpl::Capture(
-    grpc::ServerContext* /*context*/,
+    grpc::ServerContext* context,
     grpc::ServerReaderWriter<CaptureResponse, CaptureRequest>* reader_writer) {
   orbit_base::SetCurrentThreadName("CSImpl::Capture");
   if (is_capturing) {
@@ -322,19 +387,28 @@ grpc::Status CaptureServiceImpl::Capture(
   }
   is_capturing = true;
 
-  GrpcCaptureEventSender capture_event_sender{reader_writer};
-  SenderThreadCaptureEventBuffer capture_event_buffer{&capture_event_sender};
-  std::unique_ptr<ProducerEventProcessor> producer_event_processor =
-      ProducerEventProcessor::Create(&capture_event_buffer);
-  TracingHandler tracing_handler{producer_event_processor.get()};
-  MemoryInfoHandler memory_info_handler{producer_event_processor.get()};
-
   CaptureRequest request;
   reader_writer->Read(&request);
   LOG("Read CaptureRequest from Capture's gRPC stream: starting capture");
 
   const CaptureOptions& capture_options = request.capture_options();
 
+  // gRPC only compresses the messages if the client accepts gzip, which gRPC clients do by default.
+  // This needs to be set before the first CaptureResponse is written.
+  const bool compression = absl::GetFlag(FLAGS_capture_stream_compression);
+  if (compression) {
+    context->set_compression_algorithm(GRPC_COMPRESS_GZIP);
+  }
+
+  // The encoding of the CaptureResponses depends on what the client supports.
+  GrpcCaptureEventSender capture_event_sender{
+      reader_writer, capture_options.compact_capture_event_encoding(), compression};
+  SenderThreadCaptureEventBuffer capture_event_buffer{&capture_event_sender};
+  std::unique_ptr<ProducerEventProcessor> producer_event_processor =
+      ProducerEventProcessor::Create(&capture_event_buffer);
+  TracingHandler tracing_handler{producer_event_processor.get()};
+  MemoryInfoHandler memory_info_handler{producer_event_processor.get()};
+
   // Enable Orbit API in tracee.
   std::optional<std::string> error_enabling_orbit_api;
   if (capture_options.enable_api()) {
@@ -349,11 +423,26 @@ grpc::Status CaptureServiceImpl::Capture(
   // We need to filter out the functions instrumented by user space instrumentation.
   CaptureOptions linux_tracing_capture_options;
   linux_tracing_capture_options.CopyFrom(capture_options);
+  linux_tracing_capture_options.set_ring_buffer_reader_thread_count(
+      absl::GetFlag(FLAGS_ring_buffer_reader_threads));
+  linux_tracing_capture_options.set_event_driven_ring_buffer_reads(
+      absl::GetFlag(FLAGS_event_driven_ring_buffer_reads));
+  linux_tracing_capture_options.set_adaptive_event_processing_delay(
+      absl::GetFlag(FLAGS_adaptive_event_processing_delay));
+  linux_tracing_capture_options.set_unwinding_thread_count(absl::GetFlag(FLAGS_unwinding_threads));
+  linux_tracing_capture_options.set_unwind_result_cache_size(
+      absl::GetFlag(FLAGS_unwind_result_cache_size));
 
   // Enable user space instrumentation.
   std::optional<std::string> error_enabling_user_space_instrumentation;
   if (capture_options.enable_user_space_instrumentation()) {
-    auto result = instrumentation_manager_->InstrumentProcess(capture_options);
+    CaptureOptions instrumentation_capture_options;
+    instrumentation_capture_options.CopyFrom(capture_options);
+    instrumentation_capture_options.set_user_space_instrumentation_fast_path(
+        absl::GetFlag(FLAGS_user_space_instrumentation_fast_path));
+    instrumentation_capture_options.set_user_space_instrumentation_persistent(
+        absl::GetFlag(FLAGS_user_space_instrumentation_persistent));
+    auto result = instrumentation_manager_->InstrumentProcess(instrumentation_capture_options);
     if (result.has_error()) {
       error_enabling_user_space_instrumentation = absl::StrFormat(
           "Could not enable user space instrumentation: %s", result.error().message());
@@ -396,8 +485,14 @@ grpc::Status CaptureServiceImpl::Capture(
   tracing_handler.Start(linux_tracing_capture_options);
 
   memory_info_handler.Start(request.capture_options());
+  CaptureOptions producer_capture_options;
+  producer_capture_options.CopyFrom(capture_options);
+  producer_capture_options.set_producer_side_shared_memory(
+      absl::GetFlag(FLAGS_producer_side_shared_memory));
+  producer_capture_options.set_producer_side_max_buffered_events(
+      absl::GetFlag(FLAGS_producer_side_max_buffered_events));
   for (CaptureStartStopListener* listener : capture_start_stop_listeners_) {
-    listener->OnCaptureStartRequested(request.capture_options(), producer_event_processor.get());
+    listener->OnCaptureStartRequested(producer_capture_options, producer_event_processor.get());
   }
 
   // The client asks for the capture to be stopped by calling WritesDone.
@@ -0,0 +1,99 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "CompactCaptureEventEncoder.h"
+
+#include "OrbitBase/Logging.h"
+
+namespace orbit_service {
+
+using orbit_grpc_protos::CaptureResponse;
+using orbit_grpc_protos::ClientCaptureEvent;
+using orbit_grpc_protos::CompactFunctionCalls;
+using orbit_grpc_protos::CompactSchedulingSlices;
+using orbit_grpc_protos::FunctionCall;
+using orbit_grpc_protos::SchedulingSlice;
+
+namespace {
+
+// The differences are computed on 64 bits so that they can't overflow.
+int64_t Delta(uint64_t value, uint64_t previous_value) {
+  return static_cast<int64_t>(value - previous_value);
+}
+
+}  // namespace
+
+CompactCaptureEventEncoder::CompactCaptureEventEncoder(CaptureResponse* response)
+    : response_{response} {
+  CHECK(response_ != nullptr);
+}
+
+bool CompactCaptureEventEncoder::TryEncode(const ClientCaptureEvent& event) {
+  switch (event.event_case()) {
+    case ClientCaptureEvent::kSchedulingSlice:
+      EncodeSchedulingSlice(event.scheduling_slice());
+      break;
+    case ClientCaptureEvent::kFunctionCall:
+      if (event.function_call().registers_size() > 0) {
+        return false;
+      }
+      EncodeFunctionCall(event.function_call());
+      break;
+    default:
+      return false;
+  }
+  ++encoded_event_count_;
+  return true;
+}
+
+void CompactCaptureEventEncoder::Reset() {
+  response_->clear_compact_scheduling_slices();
+  response_->clear_compact_function_calls();
+  encoded_event_count_ = 0;
+  previous_scheduling_slice_pid_ = 0;
+  previous_scheduling_slice_tid_ = 0;
+  previous_scheduling_slice_out_timestamp_ns_ = 0;
+  previous_function_call_pid_ = 0;
+  previous_function_call_tid_ = 0;
+  previous_function_call_end_timestamp_ns_ = 0;
+}
+
+void CompactCaptureEventEncoder::EncodeSchedulingSlice(const SchedulingSlice& scheduling_slice) {
+  CompactSchedulingSlices* columns = response_->mutable_compact_scheduling_slices();
+  columns->add_pid_deltas(Delta(scheduling_slice.pid(), previous_scheduling_slice_pid_));
+  columns->add_tid_deltas(Delta(scheduling_slice.tid(), previous_scheduling_slice_tid_));
+  columns->add_cores(scheduling_slice.core());
+  columns->add_durations_ns(scheduling_slice.duration_ns());
+  columns->add_out_timestamp_ns_deltas(
+      Delta(scheduling_slice.out_timestamp_ns(), previous_scheduling_slice_out_timestamp_ns_));
+
+  previous_scheduling_slice_pid_ = scheduling_slice.pid();
+  previous_scheduling_slice_tid_ = scheduling_slice.tid();
+  previous_scheduling_slice_out_timestamp_ns_ = scheduling_slice.out_timestamp_ns();
+}
+
+void CompactCaptureEventEncoder::EncodeFunctionCall(const FunctionCall& function_call) {
+  CompactFunctionCalls* columns = response_->mutable_compact_function_calls();
+  const int previous_count = columns->function_ids_size();
+  columns->add_pid_deltas(Delta(function_call.pid(), previous_function_call_pid_));
+  columns->add_tid_deltas(Delta(function_call.tid(), previous_function_call_tid_));
+  columns->add_function_ids(function_call.function_id());
+  columns->add_durations_ns(function_call.duration_ns());
+  columns->add_end_timestamp_ns_deltas(
+      Delta(function_call.end_timestamp_ns(), previous_function_call_end_timestamp_ns_));
+  columns->add_depths(function_call.depth());
+  // The return values are only stored once one of them is not zero.
+  if (function_call.return_value() != 0 && columns->return_values_size() == 0) {
+    columns->mutable_return_values()->Resize(previous_count, 0);
+  }
+  if (columns->return_values_size() > 0) {
+    columns->add_return_values(function_call.return_value());
+  }
+
+  previous_function_call_pid_ = function_call.pid();
+  previous_function_call_tid_ = function_call.tid();
+  previous_function_call_end_timestamp_ns_ = function_call.end_timestamp_ns();
+}
+
+}  // namespace orbit_service
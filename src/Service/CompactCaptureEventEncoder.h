@@ -0,0 +1,51 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SERVICE_COMPACT_CAPTURE_EVENT_ENCODER_H_
+#define SERVICE_COMPACT_CAPTURE_EVENT_ENCODER_H_
+
+#include <stdint.h>
+
+#include "capture.pb.h"
+#include "services.pb.h"
+
+namespace orbit_service {
+
+// Appends SchedulingSlices and FunctionCalls to the compact columns of a CaptureResponse (see
+// CompactSchedulingSlices and CompactFunctionCalls in services.proto). As the deltas are relative
+// to the previous event in the same response, Reset needs to be called whenever the response is
+// cleared.
+class CompactCaptureEventEncoder {
+ public:
+  explicit CompactCaptureEventEncoder(orbit_grpc_protos::CaptureResponse* response);
+
+  // Returns false if the event can't be encoded in the compact columns, in which case it needs to
+  // be added to the capture_events of the response instead.
+  [[nodiscard]] bool TryEncode(const orbit_grpc_protos::ClientCaptureEvent& event);
+
+  // Returns the number of events encoded in the compact columns since the last Reset.
+  [[nodiscard]] int GetEncodedEventCount() const { return encoded_event_count_; }
+
+  // Clears the compact columns of the response.
+  void Reset();
+
+ private:
+  void EncodeSchedulingSlice(const orbit_grpc_protos::SchedulingSlice& scheduling_slice);
+  void EncodeFunctionCall(const orbit_grpc_protos::FunctionCall& function_call);
+
+  orbit_grpc_protos::CaptureResponse* response_;
+  int encoded_event_count_ = 0;
+
+  uint32_t previous_scheduling_slice_pid_ = 0;
+  uint32_t previous_scheduling_slice_tid_ = 0;
+  uint64_t previous_scheduling_slice_out_timestamp_ns_ = 0;
+
+  uint32_t previous_function_call_pid_ = 0;
+  uint32_t previous_function_call_tid_ = 0;
+  uint64_t previous_function_call_end_timestamp_ns_ = 0;
+};
+
+}  // namespace orbit_service
+
+#endif  // SERVICE_COMPACT_CAPTURE_EVENT_ENCODER_H_
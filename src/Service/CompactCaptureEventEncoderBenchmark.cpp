@@ -0,0 +1,83 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CompactCaptureEventEncoder.h"
+#include "capture.pb.h"
+#include "services.pb.h"
+
+namespace orbit_service {
+
+namespace {
+
+using orbit_grpc_protos::CaptureResponse;
+using orbit_grpc_protos::ClientCaptureEvent;
+
+constexpr int kEventCount = 10'000;
+
+// Events similar to the ones of a real capture: a few threads, increasing timestamps about one
+// microsecond apart.
+std::vector<ClientCaptureEvent> MakeEvents(bool function_calls) {
+  std::vector<ClientCaptureEvent> events(kEventCount);
+  uint64_t timestamp_ns = 1'000'000'000'000;
+  for (int i = 0; i < kEventCount; ++i) {
+    timestamp_ns += 1'000 + i % 7;
+    const uint32_t tid = 10'000 + i % 8;
+    if (function_calls) {
+      orbit_grpc_protos::FunctionCall* function_call = events[i].mutable_function_call();
+      function_call->set_pid(10'000);
+      function_call->set_tid(tid);
+      function_call->set_function_id(1 + i % 32);
+      function_call->set_duration_ns(300 + i % 100);
+      function_call->set_end_timestamp_ns(timestamp_ns);
+      function_call->set_depth(i % 4);
+    } else {
+      orbit_grpc_protos::SchedulingSlice* scheduling_slice = events[i].mutable_scheduling_slice();
+      scheduling_slice->set_pid(10'000 + i % 3);
+      scheduling_slice->set_tid(tid);
+      scheduling_slice->set_core(i % 16);
+      scheduling_slice->set_duration_ns(20'000 + i % 1'000);
+      scheduling_slice->set_out_timestamp_ns(timestamp_ns);
+    }
+  }
+  return events;
+}
+
+// Serializes one CaptureResponse with all the events, in capture_events if range(1) is zero or in
+// the compact columns otherwise. range(0) selects FunctionCalls instead of SchedulingSlices.
+void BM_SerializeCaptureResponse(benchmark::State& state) {
+  const std::vector<ClientCaptureEvent> events = MakeEvents(state.range(0) != 0);
+  const bool compact = state.range(1) != 0;
+  uint64_t serialized_size = 0;
+  for (auto _ : state) {
+    CaptureResponse response;
+    CompactCaptureEventEncoder encoder{&response};
+    for (const ClientCaptureEvent& event : events) {
+      if (!compact || !encoder.TryEncode(event)) {
+        *response.add_capture_events() = event;
+      }
+    }
+    std::string serialized = response.SerializeAsString();
+    serialized_size = serialized.size();
+    benchmark::DoNotOptimize(serialized.data());
+  }
+  state.counters["bytes_per_event"] = static_cast<double>(serialized_size) / kEventCount;
+  state.SetItemsProcessed(state.iterations() * kEventCount);
+}
+
+}  // namespace
+
+BENCHMARK(BM_SerializeCaptureResponse)
+    ->ArgNames({"function_calls", "compact"})
+    ->Args({0, 0})
+    ->Args({0, 1})
+    ->Args({1, 0})
+    ->Args({1, 1});
+
+}  // namespace orbit_service
@@ -0,0 +1,105 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "CompactCaptureEventEncoder.h"
+#include "capture.pb.h"
+#include "services.pb.h"
+
+namespace orbit_service {
+
+using orbit_grpc_protos::CaptureResponse;
+using orbit_grpc_protos::ClientCaptureEvent;
+
+namespace {
+
+ClientCaptureEvent MakeSchedulingSlice(uint32_t pid, uint32_t tid, uint64_t out_timestamp_ns) {
+  ClientCaptureEvent event;
+  orbit_grpc_protos::SchedulingSlice* scheduling_slice = event.mutable_scheduling_slice();
+  scheduling_slice->set_pid(pid);
+  scheduling_slice->set_tid(tid);
+  scheduling_slice->set_core(3);
+  scheduling_slice->set_duration_ns(100);
+  scheduling_slice->set_out_timestamp_ns(out_timestamp_ns);
+  return event;
+}
+
+ClientCaptureEvent MakeFunctionCall(uint32_t tid, uint64_t end_timestamp_ns,
+                                    uint64_t return_value) {
+  ClientCaptureEvent event;
+  orbit_grpc_protos::FunctionCall* function_call = event.mutable_function_call();
+  function_call->set_pid(10);
+  function_call->set_tid(tid);
+  function_call->set_function_id(5);
+  function_call->set_duration_ns(50);
+  function_call->set_end_timestamp_ns(end_timestamp_ns);
+  function_call->set_depth(1);
+  function_call->set_return_value(return_value);
+  return event;
+}
+
+}  // namespace
+
+TEST(CompactCaptureEventEncoder, EncodesSchedulingSlicesAsDeltas) {
+  CaptureResponse response;
+  CompactCaptureEventEncoder encoder{&response};
+  EXPECT_TRUE(encoder.TryEncode(MakeSchedulingSlice(10, 11, 1000)));
+  EXPECT_TRUE(encoder.TryEncode(MakeSchedulingSlice(10, 9, 1500)));
+  EXPECT_EQ(encoder.GetEncodedEventCount(), 2);
+
+  const orbit_grpc_protos::CompactSchedulingSlices& columns = response.compact_scheduling_slices();
+  EXPECT_THAT(columns.pid_deltas(), testing::ElementsAre(10, 0));
+  EXPECT_THAT(columns.tid_deltas(), testing::ElementsAre(11, -2));
+  EXPECT_THAT(columns.cores(), testing::ElementsAre(3, 3));
+  EXPECT_THAT(columns.durations_ns(), testing::ElementsAre(100, 100));
+  EXPECT_THAT(columns.out_timestamp_ns_deltas(), testing::ElementsAre(1000, 500));
+  EXPECT_EQ(response.capture_events_size(), 0);
+}
+
+TEST(CompactCaptureEventEncoder, StoresReturnValuesOnlyOnceOneIsNotZero) {
+  CaptureResponse response;
+  CompactCaptureEventEncoder encoder{&response};
+  EXPECT_TRUE(encoder.TryEncode(MakeFunctionCall(11, 1000, 0)));
+  EXPECT_TRUE(encoder.TryEncode(MakeFunctionCall(11, 2000, 0)));
+  EXPECT_EQ(response.compact_function_calls().return_values_size(), 0);
+
+  EXPECT_TRUE(encoder.TryEncode(MakeFunctionCall(12, 1500, 42)));
+  const orbit_grpc_protos::CompactFunctionCalls& columns = response.compact_function_calls();
+  EXPECT_THAT(columns.return_values(), testing::ElementsAre(0, 0, 42));
+  EXPECT_THAT(columns.end_timestamp_ns_deltas(), testing::ElementsAre(1000, 1000, -500));
+  EXPECT_THAT(columns.tid_deltas(), testing::ElementsAre(11, 0, 1));
+}
+
+TEST(CompactCaptureEventEncoder, LeavesOtherEventsToTheCaller) {
+  CaptureResponse response;
+  CompactCaptureEventEncoder encoder{&response};
+
+  ClientCaptureEvent function_call_with_registers = MakeFunctionCall(11, 1000, 0);
+  function_call_with_registers.mutable_function_call()->add_registers(1);
+  EXPECT_FALSE(encoder.TryEncode(function_call_with_registers));
+
+  ClientCaptureEvent thread_name;
+  thread_name.mutable_thread_name()->set_tid(11);
+  EXPECT_FALSE(encoder.TryEncode(thread_name));
+
+  EXPECT_EQ(encoder.GetEncodedEventCount(), 0);
+  EXPECT_FALSE(response.has_compact_function_calls());
+}
+
+TEST(CompactCaptureEventEncoder, ResetRestartsDeltasFromZero) {
+  CaptureResponse response;
+  CompactCaptureEventEncoder encoder{&response};
+  EXPECT_TRUE(encoder.TryEncode(MakeSchedulingSlice(10, 11, 1000)));
+  encoder.Reset();
+  EXPECT_EQ(encoder.GetEncodedEventCount(), 0);
+  EXPECT_FALSE(response.has_compact_scheduling_slices());
+
+  EXPECT_TRUE(encoder.TryEncode(MakeSchedulingSlice(10, 11, 2000)));
+  EXPECT_THAT(response.compact_scheduling_slices().out_timestamp_ns_deltas(),
+              testing::ElementsAre(2000));
+}
+
+}  // namespace orbit_service
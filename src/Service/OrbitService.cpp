@@ -133,7 +133,8 @@ static std::unique_ptr<ProducerSideServer> BuildAndStartProducerSideServer() {
   LOG("Starting producer-side server at %s",
       orbit_producer_side_channel::kProducerSideUnixDomainSocketPath);
   if (!producer_side_server->BuildAndStart(
-          orbit_producer_side_channel::kProducerSideUnixDomainSocketPath)) {
+          orbit_producer_side_channel::kProducerSideUnixDomainSocketPath,
+          orbit_producer_side_channel::kProducerSideSharedMemoryFdSocketPath)) {
     ERROR("Unable to start producer-side server");
     return nullptr;
   }
@@ -5,6 +5,12 @@
 #include "ProducerEventProcessor.h"
 
 #include <absl/container/flat_hash_map.h>
+#include <absl/hash/hash.h>
+#include <absl/synchronization/mutex.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
 
 #include "OrbitBase/Logging.h"
 #include "capture.pb.h"
@@ -24,6 +30,7 @@ using orbit_grpc_protos::ApiTrackDouble;
 using orbit_grpc_protos::ApiTrackFloat;
 using orbit_grpc_protos::ApiTrackInt;
 using orbit_grpc_protos::ApiTrackInt64;
+using orbit_grpc_protos::ApiTrackSummary;
 using orbit_grpc_protos::ApiTrackUint;
 using orbit_grpc_protos::ApiTrackUint64;
 using orbit_grpc_protos::Callstack;
@@ -39,6 +46,7 @@ using orbit_grpc_protos::FullCallstackSample;
 using orbit_grpc_protos::FullGpuJob;
 using orbit_grpc_protos::FullTracepointEvent;
 using orbit_grpc_protos::FunctionCall;
+using orbit_grpc_protos::FunctionCallStats;
 using orbit_grpc_protos::GpuDebugMarker;
 using orbit_grpc_protos::GpuJob;
 using orbit_grpc_protos::GpuQueueSubmission;
@@ -58,30 +66,42 @@ using orbit_grpc_protos::ThreadStateSlice;
 using orbit_grpc_protos::TracepointEvent;
 using orbit_grpc_protos::WarningEvent;
 
+// The entries are split into shards by hash, each with its own mutex, so that producers interning
+// different entries at the same time don't contend on the same lock.
 template <typename T>
 class InternPool final {
  public:
   InternPool() = default;
 
-  // Return pair of <id, assigned>, where assigned is true if the entry was assigned a new id
-  // and false if returning id for already existing entry.
-  std::pair<uint64_t, bool> GetOrAssignId(const T& entry) {
-    absl::MutexLock lock(&entry_to_id_mutex_);
-    auto it = entry_to_id_.find(entry);
-    if (it != entry_to_id_.end()) {
-      return std::make_pair(it->second, false);
+  // Returns the id of the entry, assigning a new one if this is the first time the entry is seen.
+  // In that case, on_id_assigned(new_id) is called while the entry's shard is still locked: other
+  // threads interning the same entry wait for it to return before they get the id. This is used to
+  // add the interned entry to the CaptureEventBuffer before any event referring to its id.
+  template <typename OnIdAssigned>
+  uint64_t GetOrAssignId(const T& entry, OnIdAssigned&& on_id_assigned) {
+    // The lower bits of the hash are also used by flat_hash_map, use the upper ones for the shard.
+    Shard& shard = shards_[(absl::Hash<T>{}(entry) >> 32) % kShardCount];
+    absl::MutexLock lock(&shard.mutex);
+    auto it = shard.entry_to_id.find(entry);
+    if (it != shard.entry_to_id.end()) {
+      return it->second;
     }
 
-    uint64_t new_id = id_counter_++;
-    auto [unused_it, inserted] = entry_to_id_.insert_or_assign(entry, new_id);
+    uint64_t new_id = id_counter_.fetch_add(1, std::memory_order_relaxed);
+    auto [unused_it, inserted] = shard.entry_to_id.insert_or_assign(entry, new_id);
     CHECK(inserted);
-    return std::make_pair(new_id, true);
+    on_id_assigned(new_id);
+    return new_id;
   }
 
  private:
-  uint64_t id_counter_ = 1;  // 0 is reserved for invalid_id
-  absl::flat_hash_map<T, uint64_t> entry_to_id_;
-  absl::Mutex entry_to_id_mutex_;
+  static constexpr size_t kShardCount = 16;
+  struct Shard {
+    absl::flat_hash_map<T, uint64_t> entry_to_id ABSL_GUARDED_BY(mutex);
+    absl::Mutex mutex;
+  };
+  std::array<Shard, kShardCount> shards_;
+  std::atomic<uint64_t> id_counter_ = 1;  // 0 is reserved for invalid_id
 };
 
 class ProducerEventProcessorImpl : public ProducerEventProcessor {
@@ -97,16 +117,20 @@ class ProducerEventProcessorImpl : public ProducerEventProcessor {
   void ProcessFullAddressInfo(FullAddressInfo* full_address_info);
   void ProcessFullCallstackSample(FullCallstackSample* full_callstack_sample);
   void ProcessFunctionCallAndTransferOwnership(FunctionCall* function_call);
+  void ProcessFunctionCallStatsAndTransferOwnership(FunctionCallStats* function_call_stats);
   void ProcessFullGpuJob(FullGpuJob* full_gpu_job_event);
   void ProcessGpuQueueSubmissionAndTransferOwnership(uint64_t producer_id,
                                                      GpuQueueSubmission* gpu_queue_submission);
   // ProcessInterned* functions remap producer intern_ids to the id space used in the client.
-  // They keep track of these mappings in producer_interned_callstack_id_to_client_callstack_id_
-  // and producer_interned_string_id_to_client_string_id_.
+  // They keep track of these mappings in the ProducerInternedIds of each producer.
   void ProcessInternedCallstack(uint64_t producer_id, InternedCallstack* interned_callstack);
   void ProcessCallstackSampleAndTransferOwnership(uint64_t producer_id,
                                                   CallstackSample* callstack_sample);
   void ProcessInternedString(uint64_t producer_id, InternedString* interned_string);
+  // Replaces the producer's key in the `name_key` of an event of the Orbit API with the client's
+  // key of the same InternedString.
+  template <typename ApiEventT>
+  void TranslateApiNameKey(uint64_t producer_id, ApiEventT* api_event);
   void ProcessModuleUpdateEventAndTransferOwnership(ModuleUpdateEvent* module_update_event);
   void ProcessModulesSnapshotAndTransferOwnership(ModulesSnapshot* modules_snapshot);
   void ProcessSchedulingSliceAndTransferOwnership(SchedulingSlice* scheduling_slice);
@@ -116,17 +140,26 @@ class ProducerEventProcessorImpl : public ProducerEventProcessor {
   void ProcessFullTracepointEvent(FullTracepointEvent* full_tracepoint_event);
   void ProcessMemoryUsageEventAndTransferOwnership(MemoryUsageEvent* memory_usage_event);
   void ProcessApiEventAndTransferOwnership(ApiEvent* api_event);
-  void ProcessApiScopeStartAndTransferOwnership(ApiScopeStart* api_scope_start);
-  void ProcessApiScopeStartAsyncAndTransferOwnership(ApiScopeStartAsync* api_scope_start_async);
+  void ProcessApiScopeStartAndTransferOwnership(uint64_t producer_id,
+                                                ApiScopeStart* api_scope_start);
+  void ProcessApiScopeStartAsyncAndTransferOwnership(uint64_t producer_id,
+                                                     ApiScopeStartAsync* api_scope_start_async);
   void ProcessApiScopeStopAndTransferOwnership(ApiScopeStop* api_scope_stop);
   void ProcessApiScopeStopAsyncAndTransferOwnership(ApiScopeStopAsync* api_scope_stop_async);
-  void ProcessApiStringEventAndTransferOwnership(ApiStringEvent* api_string_event);
-  void ProcessApiTrackDoubleAndTransferOwnership(ApiTrackDouble* api_track_double);
-  void ProcessApiTrackFloatAndTransferOwnership(ApiTrackFloat* api_track_float);
-  void ProcessApiTrackIntAndTransferOwnership(ApiTrackInt* api_track_int);
-  void ProcessApiTrackInt64AndTransferOwnership(ApiTrackInt64* api_track_int64);
-  void ProcessApiTrackUintAndTransferOwnership(ApiTrackUint* api_track_uint);
-  void ProcessApiTrackUint64AndTransferOwnership(ApiTrackUint64* api_track_uint64);
+  void ProcessApiStringEventAndTransferOwnership(uint64_t producer_id,
+                                                 ApiStringEvent* api_string_event);
+  void ProcessApiTrackDoubleAndTransferOwnership(uint64_t producer_id,
+                                                 ApiTrackDouble* api_track_double);
+  void ProcessApiTrackFloatAndTransferOwnership(uint64_t producer_id,
+                                                ApiTrackFloat* api_track_float);
+  void ProcessApiTrackIntAndTransferOwnership(uint64_t producer_id, ApiTrackInt* api_track_int);
+  void ProcessApiTrackInt64AndTransferOwnership(uint64_t producer_id,
+                                                ApiTrackInt64* api_track_int64);
+  void ProcessApiTrackUintAndTransferOwnership(uint64_t producer_id, ApiTrackUint* api_track_uint);
+  void ProcessApiTrackUint64AndTransferOwnership(uint64_t producer_id,
+                                                 ApiTrackUint64* api_track_uint64);
+  void ProcessApiTrackSummaryAndTransferOwnership(uint64_t producer_id,
+                                                  ApiTrackSummary* api_track_summary);
   void ProcessWarningEventAndTransferOwnership(WarningEvent* warning_event);
   void ProcessClockResolutionEventAndTransferOwnership(
       ClockResolutionEvent* clock_resolution_event);
@@ -142,6 +175,19 @@ class ProducerEventProcessorImpl : public ProducerEventProcessor {
       OutOfOrderEventsDiscardedEvent* out_of_order_events_discarded_event);
 
   void SendInternedStringEvent(uint64_t key, std::string value);
+  uint64_t GetOrAssignStringId(const std::string& value);
+
+  // Maps the ids of InternedStrings and InternedCallstacks of a producer to client ids. Each
+  // producer has its own maps and mutex, so that producers don't contend with each other. The
+  // mutex is still needed as LinuxTracing sends events from several threads.
+  struct ProducerInternedIds {
+    // producer_callstack_id -> client_callstack_id
+    absl::flat_hash_map<uint64_t, uint64_t> callstack_ids ABSL_GUARDED_BY(mutex);
+    // producer_string_id -> client_string_id
+    absl::flat_hash_map<uint64_t, uint64_t> string_ids ABSL_GUARDED_BY(mutex);
+    absl::Mutex mutex;
+  };
+  ProducerInternedIds* GetProducerInternedIds(uint64_t producer_id);
 
   CaptureEventBuffer* capture_event_buffer_;
 
@@ -149,28 +195,39 @@ class ProducerEventProcessorImpl : public ProducerEventProcessor {
   InternPool<std::string> string_pool_;
   InternPool<std::pair<std::string, std::string>> tracepoint_pool_;
 
-  // These are mapping InternStrings and InternedCallstacks from producer ids
-  // to client ids:
-  // <producer_id, producer_callstack_id> -> client_callstack_id
-  absl::flat_hash_map<std::pair<uint64_t, uint64_t>, uint64_t>
-      producer_interned_callstack_id_to_client_callstack_id_;
-  // <producer_id, producer_string_id> -> client_string_id
-  absl::flat_hash_map<std::pair<uint64_t, uint64_t>, uint64_t>
-      producer_interned_string_id_to_client_string_id_;
+  // The ProducerInternedIds are never removed, so pointers to them stay valid once this mutex is
+  // released.
+  absl::flat_hash_map<uint64_t, std::unique_ptr<ProducerInternedIds>> producer_interned_ids_
+      ABSL_GUARDED_BY(producer_interned_ids_mutex_);
+  absl::Mutex producer_interned_ids_mutex_;
 };
 
-void ProducerEventProcessorImpl::ProcessFullAddressInfo(FullAddressInfo* full_address_info) {
-  auto [function_name_key, function_key_assigned] =
-      string_pool_.GetOrAssignId(full_address_info->function_name());
-  if (function_key_assigned) {
-    SendInternedStringEvent(function_name_key, full_address_info->function_name());
+ProducerEventProcessorImpl::ProducerInternedIds* ProducerEventProcessorImpl::GetProducerInternedIds(
+    uint64_t producer_id) {
+  {
+    absl::ReaderMutexLock lock{&producer_interned_ids_mutex_};
+    auto it = producer_interned_ids_.find(producer_id);
+    if (it != producer_interned_ids_.end()) {
+      return it->second.get();
+    }
   }
-
-  auto [module_name_key, module_key_assigned] =
-      string_pool_.GetOrAssignId(full_address_info->module_name());
-  if (module_key_assigned) {
-    SendInternedStringEvent(module_name_key, full_address_info->module_name());
+  absl::WriterMutexLock lock{&producer_interned_ids_mutex_};
+  std::unique_ptr<ProducerInternedIds>& producer_interned_ids =
+      producer_interned_ids_[producer_id];
+  if (producer_interned_ids == nullptr) {
+    producer_interned_ids = std::make_unique<ProducerInternedIds>();
   }
+  return producer_interned_ids.get();
+}
+
+uint64_t ProducerEventProcessorImpl::GetOrAssignStringId(const std::string& value) {
+  return string_pool_.GetOrAssignId(
+      value, [this, &value](uint64_t key) { SendInternedStringEvent(key, value); });
+}
+
+void ProducerEventProcessorImpl::ProcessFullAddressInfo(FullAddressInfo* full_address_info) {
+  uint64_t function_name_key = GetOrAssignStringId(full_address_info->function_name());
+  uint64_t module_name_key = GetOrAssignStringId(full_address_info->module_name());
 
   ClientCaptureEvent event;
   AddressInfo* interned_address_info = event.mutable_address_info();
@@ -189,11 +246,15 @@ void ProducerEventProcessorImpl::ProcessFunctionCallAndTransferOwnership(
   capture_event_buffer_->AddEvent(std::move(event));
 }
 
+void ProducerEventProcessorImpl::ProcessFunctionCallStatsAndTransferOwnership(
+    FunctionCallStats* function_call_stats) {
+  ClientCaptureEvent event;
+  event.set_allocated_function_call_stats(function_call_stats);
+  capture_event_buffer_->AddEvent(std::move(event));
+}
+
 void ProducerEventProcessorImpl::ProcessFullGpuJob(FullGpuJob* full_gpu_job_event) {
-  auto [timeline_key, assigned] = string_pool_.GetOrAssignId(full_gpu_job_event->timeline());
-  if (assigned) {
-    SendInternedStringEvent(timeline_key, full_gpu_job_event->timeline());
-  }
+  uint64_t timeline_key = GetOrAssignStringId(full_gpu_job_event->timeline());
 
   ClientCaptureEvent event;
   GpuJob* gpu_job_event = event.mutable_gpu_job();
@@ -214,11 +275,14 @@ void ProducerEventProcessorImpl::ProcessFullGpuJob(FullGpuJob* full_gpu_job_even
 void ProducerEventProcessorImpl::ProcessGpuQueueSubmissionAndTransferOwnership(
     uint64_t producer_id, GpuQueueSubmission* gpu_queue_submission) {
   // Translate debug marker keys
-  for (GpuDebugMarker& mutable_marker : *gpu_queue_submission->mutable_completed_markers()) {
-    auto it = producer_interned_string_id_to_client_string_id_.find(
-        {producer_id, mutable_marker.text_key()});
-    CHECK(it != producer_interned_string_id_to_client_string_id_.end());
-    mutable_marker.set_text_key(it->second);
+  if (gpu_queue_submission->completed_markers_size() > 0) {
+    ProducerInternedIds* producer_interned_ids = GetProducerInternedIds(producer_id);
+    absl::MutexLock lock{&producer_interned_ids->mutex};
+    for (GpuDebugMarker& mutable_marker : *gpu_queue_submission->mutable_completed_markers()) {
+      auto it = producer_interned_ids->string_ids.find(mutable_marker.text_key());
+      CHECK(it != producer_interned_ids->string_ids.end());
+      mutable_marker.set_text_key(it->second);
+    }
   }
 
   ClientCaptureEvent event;
@@ -231,15 +295,14 @@ void ProducerEventProcessorImpl::ProcessFullCallstackSample(
   const Callstack& callstack = full_callstack_sample->callstack();
   std::pair<std::vector<uint64_t>, Callstack::CallstackType> callstack_data{
       {callstack.pcs().begin(), callstack.pcs().end()}, callstack.type()};
-  auto [callstack_id, assigned] = callstack_pool_.GetOrAssignId(callstack_data);
-
-  if (assigned) {
-    ClientCaptureEvent interned_callstack_event;
-    interned_callstack_event.mutable_interned_callstack()->set_key(callstack_id);
-    interned_callstack_event.mutable_interned_callstack()->set_allocated_intern(
-        full_callstack_sample->release_callstack());
-    capture_event_buffer_->AddEvent(std::move(interned_callstack_event));
-  }
+  uint64_t callstack_id = callstack_pool_.GetOrAssignId(
+      callstack_data, [this, full_callstack_sample](uint64_t new_callstack_id) {
+        ClientCaptureEvent interned_callstack_event;
+        interned_callstack_event.mutable_interned_callstack()->set_key(new_callstack_id);
+        interned_callstack_event.mutable_interned_callstack()->set_allocated_intern(
+            full_callstack_sample->release_callstack());
+        capture_event_buffer_->AddEvent(std::move(interned_callstack_event));
+      });
 
   ClientCaptureEvent callstack_sample_event;
   CallstackSample* callstack_sample = callstack_sample_event.mutable_callstack_sample();
@@ -252,37 +315,38 @@ void ProducerEventProcessorImpl::ProcessFullCallstackSample(
 
 void ProducerEventProcessorImpl::ProcessInternedCallstack(uint64_t producer_id,
                                                           InternedCallstack* interned_callstack) {
-  // TODO(b/180235290): replace with error message
-  CHECK(!producer_interned_callstack_id_to_client_callstack_id_.contains(
-      {producer_id, interned_callstack->key()}));
-
   std::pair<std::vector<uint64_t>, Callstack::CallstackType> callstack_data{
       {interned_callstack->intern().pcs().begin(), interned_callstack->intern().pcs().end()},
       interned_callstack->intern().type()};
-  auto [interned_callstack_id, assigned] = callstack_pool_.GetOrAssignId(callstack_data);
-
-  producer_interned_callstack_id_to_client_callstack_id_.insert_or_assign(
-      {producer_id, interned_callstack->key()}, interned_callstack_id);
-
-  if (!assigned) {
-    return;
-  }
-
-  // If this is first time we see it -> send it over with client_id
-  interned_callstack->set_key(interned_callstack_id);
-  ClientCaptureEvent event;
-  *event.mutable_interned_callstack() = std::move(*interned_callstack);
-  capture_event_buffer_->AddEvent(std::move(event));
+  const uint64_t producer_callstack_id = interned_callstack->key();
+  uint64_t interned_callstack_id = callstack_pool_.GetOrAssignId(
+      callstack_data, [this, interned_callstack](uint64_t new_callstack_id) {
+        // If this is first time we see it -> send it over with client_id
+        interned_callstack->set_key(new_callstack_id);
+        ClientCaptureEvent event;
+        *event.mutable_interned_callstack() = std::move(*interned_callstack);
+        capture_event_buffer_->AddEvent(std::move(event));
+      });
+
+  ProducerInternedIds* producer_interned_ids = GetProducerInternedIds(producer_id);
+  absl::MutexLock lock{&producer_interned_ids->mutex};
+  // TODO(b/180235290): replace with error message
+  CHECK(!producer_interned_ids->callstack_ids.contains(producer_callstack_id));
+  producer_interned_ids->callstack_ids.insert_or_assign(producer_callstack_id,
+                                                        interned_callstack_id);
 }
 
 void ProducerEventProcessorImpl::ProcessCallstackSampleAndTransferOwnership(
     uint64_t producer_id, CallstackSample* callstack_sample) {
   // translate producer id to client id
-  auto it = producer_interned_callstack_id_to_client_callstack_id_.find(
-      {producer_id, callstack_sample->callstack_id()});
-  // TODO(b/180235290): replace with error message
-  CHECK(it != producer_interned_callstack_id_to_client_callstack_id_.end());
-  callstack_sample->set_callstack_id(it->second);
+  {
+    ProducerInternedIds* producer_interned_ids = GetProducerInternedIds(producer_id);
+    absl::MutexLock lock{&producer_interned_ids->mutex};
+    auto it = producer_interned_ids->callstack_ids.find(callstack_sample->callstack_id());
+    // TODO(b/180235290): replace with error message
+    CHECK(it != producer_interned_ids->callstack_ids.end());
+    callstack_sample->set_callstack_id(it->second);
+  }
 
   ClientCaptureEvent event;
   event.set_allocated_callstack_sample(callstack_sample);
@@ -291,23 +355,42 @@ void ProducerEventProcessorImpl::ProcessCallstackSampleAndTransferOwnership(
 
 void ProducerEventProcessorImpl::ProcessInternedString(uint64_t producer_id,
                                                        InternedString* interned_string) {
-  // TODO(b/180235290): replace with error message
-  CHECK(!producer_interned_string_id_to_client_string_id_.contains(
-      {producer_id, interned_string->key()}));
+  const uint64_t producer_string_id = interned_string->key();
+  ProducerInternedIds* producer_interned_ids = GetProducerInternedIds(producer_id);
+  {
+    absl::MutexLock lock{&producer_interned_ids->mutex};
+    // TODO(b/180235290): replace with error message
+    CHECK(!producer_interned_ids->string_ids.contains(producer_string_id));
+  }
+
+  uint64_t client_string_id = string_pool_.GetOrAssignId(
+      interned_string->intern(), [this, interned_string](uint64_t new_string_id) {
+        interned_string->set_key(new_string_id);
+        ClientCaptureEvent event;
+        *event.mutable_interned_string() = std::move(*interned_string);
+        capture_event_buffer_->AddEvent(std::move(event));
+      });
 
-  auto [client_string_id, assigned] = string_pool_.GetOrAssignId(interned_string->intern());
-  producer_interned_string_id_to_client_string_id_.insert_or_assign(
-      {producer_id, interned_string->key()}, client_string_id);
+  absl::MutexLock lock{&producer_interned_ids->mutex};
+  producer_interned_ids->string_ids.insert_or_assign(producer_string_id, client_string_id);
+}
 
-  if (!assigned) {
+template <typename ApiEventT>
+void ProducerEventProcessorImpl::TranslateApiNameKey(uint64_t producer_id, ApiEventT* api_event) {
+  if (api_event->name_key() == 0) {
     return;
   }
-
-  interned_string->set_key(client_string_id);
-
-  ClientCaptureEvent event;
-  *event.mutable_interned_string() = std::move(*interned_string);
-  capture_event_buffer_->AddEvent(std::move(event));
+  ProducerInternedIds* producer_interned_ids = GetProducerInternedIds(producer_id);
+  absl::MutexLock lock{&producer_interned_ids->mutex};
+  auto it = producer_interned_ids->string_ids.find(api_event->name_key());
+  if (it == producer_interned_ids->string_ids.end()) {
+    // This can happen for events that straddle the start of the capture.
+    ERROR("Unknown key %u for the name of an Orbit API event from producer %u",
+          api_event->name_key(), producer_id);
+    api_event->set_name_key(0);
+    return;
+  }
+  api_event->set_name_key(it->second);
 }
 
 void ProducerEventProcessorImpl::ProcessModuleUpdateEventAndTransferOwnership(
@@ -360,17 +443,18 @@ void ProducerEventProcessorImpl::ProcessThreadStateSliceAndTransferOwnership(
 
 void ProducerEventProcessorImpl::ProcessFullTracepointEvent(
     FullTracepointEvent* full_tracepoint_event) {
-  auto [tracepoint_key, assigned] =
-      tracepoint_pool_.GetOrAssignId({full_tracepoint_event->tracepoint_info().category(),
-                                      full_tracepoint_event->tracepoint_info().name()});
-  if (assigned) {
-    ClientCaptureEvent event;
-    InternedTracepointInfo* interned_tracepoint_info = event.mutable_interned_tracepoint_info();
-    interned_tracepoint_info->set_key(tracepoint_key);
-    interned_tracepoint_info->set_allocated_intern(
-        full_tracepoint_event->release_tracepoint_info());
-    capture_event_buffer_->AddEvent(std::move(event));
-  }
+  uint64_t tracepoint_key = tracepoint_pool_.GetOrAssignId(
+      {full_tracepoint_event->tracepoint_info().category(),
+       full_tracepoint_event->tracepoint_info().name()},
+      [this, full_tracepoint_event](uint64_t new_tracepoint_key) {
+        ClientCaptureEvent event;
+        InternedTracepointInfo* interned_tracepoint_info =
+            event.mutable_interned_tracepoint_info();
+        interned_tracepoint_info->set_key(new_tracepoint_key);
+        interned_tracepoint_info->set_allocated_intern(
+            full_tracepoint_event->release_tracepoint_info());
+        capture_event_buffer_->AddEvent(std::move(event));
+      });
 
   ClientCaptureEvent event;
   TracepointEvent* tracepoint_event = event.mutable_tracepoint_event();
@@ -396,14 +480,16 @@ void ProducerEventProcessorImpl::ProcessApiEventAndTransferOwnership(ApiEvent* a
 }
 
 void orbit_service::ProducerEventProcessorImpl::ProcessApiScopeStartAndTransferOwnership(
-    ApiScopeStart* api_scope_start) {
+    uint64_t producer_id, ApiScopeStart* api_scope_start) {
+  TranslateApiNameKey(producer_id, api_scope_start);
   ClientCaptureEvent event;
   event.set_allocated_api_scope_start(api_scope_start);
   capture_event_buffer_->AddEvent(std::move(event));
 }
 
 void orbit_service::ProducerEventProcessorImpl::ProcessApiScopeStartAsyncAndTransferOwnership(
-    ApiScopeStartAsync* api_scope_start_async) {
+    uint64_t producer_id, ApiScopeStartAsync* api_scope_start_async) {
+  TranslateApiNameKey(producer_id, api_scope_start_async);
   ClientCaptureEvent event;
   event.set_allocated_api_scope_start_async(api_scope_start_async);
   capture_event_buffer_->AddEvent(std::move(event));
@@ -424,54 +510,69 @@ void orbit_service::ProducerEventProcessorImpl::ProcessApiScopeStopAsyncAndTrans
 }
 
 void orbit_service::ProducerEventProcessorImpl::ProcessApiStringEventAndTransferOwnership(
-    ApiStringEvent* api_string_event) {
+    uint64_t producer_id, ApiStringEvent* api_string_event) {
+  TranslateApiNameKey(producer_id, api_string_event);
   ClientCaptureEvent event;
   event.set_allocated_api_string_event(api_string_event);
   capture_event_buffer_->AddEvent(std::move(event));
 }
 
 void orbit_service::ProducerEventProcessorImpl::ProcessApiTrackDoubleAndTransferOwnership(
-    ApiTrackDouble* api_track_double) {
+    uint64_t producer_id, ApiTrackDouble* api_track_double) {
+  TranslateApiNameKey(producer_id, api_track_double);
   ClientCaptureEvent event;
   event.set_allocated_api_track_double(api_track_double);
   capture_event_buffer_->AddEvent(std::move(event));
 }
 
 void orbit_service::ProducerEventProcessorImpl::ProcessApiTrackFloatAndTransferOwnership(
-    ApiTrackFloat* api_track_float) {
+    uint64_t producer_id, ApiTrackFloat* api_track_float) {
+  TranslateApiNameKey(producer_id, api_track_float);
   ClientCaptureEvent event;
   event.set_allocated_api_track_float(api_track_float);
   capture_event_buffer_->AddEvent(std::move(event));
 }
 
 void orbit_service::ProducerEventProcessorImpl::ProcessApiTrackIntAndTransferOwnership(
-    ApiTrackInt* api_track_int) {
+    uint64_t producer_id, ApiTrackInt* api_track_int) {
+  TranslateApiNameKey(producer_id, api_track_int);
   ClientCaptureEvent event;
   event.set_allocated_api_track_int(api_track_int);
   capture_event_buffer_->AddEvent(std::move(event));
 }
 
 void orbit_service::ProducerEventProcessorImpl::ProcessApiTrackInt64AndTransferOwnership(
-    ApiTrackInt64* api_track_int64) {
+    uint64_t producer_id, ApiTrackInt64* api_track_int64) {
+  TranslateApiNameKey(producer_id, api_track_int64);
   ClientCaptureEvent event;
   event.set_allocated_api_track_int64(api_track_int64);
   capture_event_buffer_->AddEvent(std::move(event));
 }
 
 void orbit_service::ProducerEventProcessorImpl::ProcessApiTrackUintAndTransferOwnership(
-    ApiTrackUint* api_track_uint) {
+    uint64_t producer_id, ApiTrackUint* api_track_uint) {
+  TranslateApiNameKey(producer_id, api_track_uint);
   ClientCaptureEvent event;
   event.set_allocated_api_track_uint(api_track_uint);
   capture_event_buffer_->AddEvent(std::move(event));
 }
 
 void orbit_service::ProducerEventProcessorImpl::ProcessApiTrackUint64AndTransferOwnership(
-    ApiTrackUint64* api_track_uint64) {
+    uint64_t producer_id, ApiTrackUint64* api_track_uint64) {
+  TranslateApiNameKey(producer_id, api_track_uint64);
   ClientCaptureEvent event;
   event.set_allocated_api_track_uint64(api_track_uint64);
   capture_event_buffer_->AddEvent(std::move(event));
 }
 
+void orbit_service::ProducerEventProcessorImpl::ProcessApiTrackSummaryAndTransferOwnership(
+    uint64_t producer_id, ApiTrackSummary* api_track_summary) {
+  TranslateApiNameKey(producer_id, api_track_summary);
+  ClientCaptureEvent event;
+  event.set_allocated_api_track_summary(api_track_summary);
+  capture_event_buffer_->AddEvent(std::move(event));
+}
+
 void ProducerEventProcessorImpl::ProcessWarningEventAndTransferOwnership(
     WarningEvent* warning_event) {
   ClientCaptureEvent event;
@@ -545,6 +646,9 @@ void ProducerEventProcessorImpl::ProcessEvent(uint64_t producer_id, ProducerCapt
     case ProducerCaptureEvent::kFunctionCall:
       ProcessFunctionCallAndTransferOwnership(event.release_function_call());
       break;
+    case ProducerCaptureEvent::kFunctionCallStats:
+      ProcessFunctionCallStatsAndTransferOwnership(event.release_function_call_stats());
+      break;
     case ProducerCaptureEvent::kInternedString:
       ProcessInternedString(producer_id, event.mutable_interned_string());
       break;
@@ -580,10 +684,11 @@ void ProducerEventProcessorImpl::ProcessEvent(uint64_t producer_id, ProducerCapt
       ProcessApiEventAndTransferOwnership(event.release_api_event());
       break;
     case orbit_grpc_protos::ProducerCaptureEvent::kApiScopeStart:
-      ProcessApiScopeStartAndTransferOwnership(event.release_api_scope_start());
+      ProcessApiScopeStartAndTransferOwnership(producer_id, event.release_api_scope_start());
       break;
     case orbit_grpc_protos::ProducerCaptureEvent::kApiScopeStartAsync:
-      ProcessApiScopeStartAsyncAndTransferOwnership(event.release_api_scope_start_async());
+      ProcessApiScopeStartAsyncAndTransferOwnership(producer_id,
+                                                    event.release_api_scope_start_async());
       break;
     case orbit_grpc_protos::ProducerCaptureEvent::kApiScopeStop:
       ProcessApiScopeStopAndTransferOwnership(event.release_api_scope_stop());
@@ -592,25 +697,28 @@ void ProducerEventProcessorImpl::ProcessEvent(uint64_t producer_id, ProducerCapt
       ProcessApiScopeStopAsyncAndTransferOwnership(event.release_api_scope_stop_async());
       break;
     case orbit_grpc_protos::ProducerCaptureEvent::kApiStringEvent:
-      ProcessApiStringEventAndTransferOwnership(event.release_api_string_event());
+      ProcessApiStringEventAndTransferOwnership(producer_id, event.release_api_string_event());
       break;
     case orbit_grpc_protos::ProducerCaptureEvent::kApiTrackDouble:
-      ProcessApiTrackDoubleAndTransferOwnership(event.release_api_track_double());
+      ProcessApiTrackDoubleAndTransferOwnership(producer_id, event.release_api_track_double());
       break;
     case orbit_grpc_protos::ProducerCaptureEvent::kApiTrackFloat:
-      ProcessApiTrackFloatAndTransferOwnership(event.release_api_track_float());
+      ProcessApiTrackFloatAndTransferOwnership(producer_id, event.release_api_track_float());
       break;
     case orbit_grpc_protos::ProducerCaptureEvent::kApiTrackInt:
-      ProcessApiTrackIntAndTransferOwnership(event.release_api_track_int());
+      ProcessApiTrackIntAndTransferOwnership(producer_id, event.release_api_track_int());
       break;
     case orbit_grpc_protos::ProducerCaptureEvent::kApiTrackInt64:
-      ProcessApiTrackInt64AndTransferOwnership(event.release_api_track_int64());
+      ProcessApiTrackInt64AndTransferOwnership(producer_id, event.release_api_track_int64());
       break;
     case orbit_grpc_protos::ProducerCaptureEvent::kApiTrackUint:
-      ProcessApiTrackUintAndTransferOwnership(event.release_api_track_uint());
+      ProcessApiTrackUintAndTransferOwnership(producer_id, event.release_api_track_uint());
       break;
     case orbit_grpc_protos::ProducerCaptureEvent::kApiTrackUint64:
-      ProcessApiTrackUint64AndTransferOwnership(event.release_api_track_uint64());
+      ProcessApiTrackUint64AndTransferOwnership(producer_id, event.release_api_track_uint64());
+      break;
+    case orbit_grpc_protos::ProducerCaptureEvent::kApiTrackSummary:
+      ProcessApiTrackSummaryAndTransferOwnership(producer_id, event.release_api_track_summary());
       break;
     case ProducerCaptureEvent::kWarningEvent:
       ProcessWarningEventAndTransferOwnership(event.release_warning_event());
@@ -3,11 +3,18 @@
 // found in the LICENSE file.
 
 #include <GrpcProtos/Constants.h>
+#include <absl/container/flat_hash_map.h>
+#include <absl/strings/str_format.h>
+#include <absl/synchronization/mutex.h>
 #include <gmock/gmock.h>
 #include <google/protobuf/util/message_differencer.h>
 #include <gtest/gtest.h>
 #include <stdint.h>
 
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "ProducerEventProcessor.h"
 #include "capture.pb.h"
 
@@ -1135,6 +1142,63 @@ TEST(ProducerEventProcessor, FullGpuJobSameTimeline) {
   }
 }
 
+class RecordingCaptureEventBuffer : public CaptureEventBuffer {
+ public:
+  void AddEvent(orbit_grpc_protos::ClientCaptureEvent&& event) override {
+    absl::MutexLock lock{&mutex_};
+    events_.emplace_back(std::move(event));
+  }
+
+  std::vector<ClientCaptureEvent> GetEvents() {
+    absl::MutexLock lock{&mutex_};
+    return events_;
+  }
+
+ private:
+  std::vector<ClientCaptureEvent> events_ ABSL_GUARDED_BY(mutex_);
+  absl::Mutex mutex_;
+};
+
+TEST(ProducerEventProcessor, ConcurrentProducersInternEachStringOnceBeforeItIsReferenced) {
+  RecordingCaptureEventBuffer buffer;
+  auto producer_event_processor = ProducerEventProcessor::Create(&buffer);
+
+  constexpr uint64_t kProducerCount = 4;
+  constexpr uint64_t kTimelineCount = 50;
+  constexpr uint64_t kRepetitions = 20;
+  std::vector<std::thread> producer_threads;
+  for (uint64_t producer_id = 1; producer_id <= kProducerCount; ++producer_id) {
+    producer_threads.emplace_back([&producer_event_processor, producer_id] {
+      for (uint64_t repetition = 0; repetition < kRepetitions; ++repetition) {
+        for (uint64_t timeline = 0; timeline < kTimelineCount; ++timeline) {
+          ProducerCaptureEvent event;
+          event.mutable_full_gpu_job()->set_timeline(absl::StrFormat("timeline%u", timeline));
+          producer_event_processor->ProcessEvent(producer_id, std::move(event));
+        }
+      }
+    });
+  }
+  for (std::thread& producer_thread : producer_threads) {
+    producer_thread.join();
+  }
+
+  absl::flat_hash_map<uint64_t, std::string> interned_strings;
+  uint64_t gpu_job_count = 0;
+  for (const ClientCaptureEvent& event : buffer.GetEvents()) {
+    if (event.event_case() == ClientCaptureEvent::kInternedString) {
+      EXPECT_TRUE(
+          interned_strings.emplace(event.interned_string().key(), event.interned_string().intern())
+              .second);
+    } else {
+      ASSERT_EQ(event.event_case(), ClientCaptureEvent::kGpuJob);
+      EXPECT_TRUE(interned_strings.contains(event.gpu_job().timeline_key()));
+      ++gpu_job_count;
+    }
+  }
+  EXPECT_EQ(interned_strings.size(), kTimelineCount);
+  EXPECT_EQ(gpu_job_count, kProducerCount * kRepetitions * kTimelineCount);
+}
+
 TEST(ProducerEventProcessor, GpuQueueSubmissionSmoke) {
   MockCaptureEventBuffer buffer;
   auto producer_event_processor = ProducerEventProcessor::Create(&buffer);
@@ -1932,6 +1996,42 @@ TEST(ProducerEventProcessor, ApiTrackDouble) {
   EXPECT_TRUE(MessageDifferencer::Equivalent(api_track_double_copy, actual_event));
 }
 
+TEST(ProducerEventProcessor, ApiEventsWithInternedNames) {
+  MockCaptureEventBuffer buffer;
+  auto producer_event_processor = ProducerEventProcessor::Create(&buffer);
+
+  ClientCaptureEvent client_interned_string_event;
+  EXPECT_CALL(buffer, AddEvent).Times(1).WillOnce(SaveArg<0>(&client_interned_string_event));
+  producer_event_processor->ProcessEvent(kDefaultProducerId,
+                                         CreateInternedStringEvent(kKey1, "name"));
+  ASSERT_EQ(client_interned_string_event.event_case(), ClientCaptureEvent::kInternedString);
+  const uint64_t client_key = client_interned_string_event.interned_string().key();
+
+  ProducerCaptureEvent scope_start_event;
+  scope_start_event.mutable_api_scope_start()->set_name_key(kKey1);
+  ProducerCaptureEvent track_event;
+  track_event.mutable_api_track_double()->set_name_key(kKey1);
+  // Not interned by this producer.
+  ProducerCaptureEvent unknown_key_event;
+  unknown_key_event.mutable_api_track_int()->set_name_key(kKey2);
+
+  ClientCaptureEvent client_capture_event1;
+  ClientCaptureEvent client_capture_event2;
+  ClientCaptureEvent client_capture_event3;
+  EXPECT_CALL(buffer, AddEvent)
+      .Times(3)
+      .WillOnce(SaveArg<0>(&client_capture_event1))
+      .WillOnce(SaveArg<0>(&client_capture_event2))
+      .WillOnce(SaveArg<0>(&client_capture_event3));
+  producer_event_processor->ProcessEvent(kDefaultProducerId, scope_start_event);
+  producer_event_processor->ProcessEvent(kDefaultProducerId, track_event);
+  producer_event_processor->ProcessEvent(kDefaultProducerId, unknown_key_event);
+
+  EXPECT_EQ(client_capture_event1.api_scope_start().name_key(), client_key);
+  EXPECT_EQ(client_capture_event2.api_track_double().name_key(), client_key);
+  EXPECT_EQ(client_capture_event3.api_track_int().name_key(), 0);
+}
+
 TEST(ProducerEventProcessor, WarningEvent) {
   MockCaptureEventBuffer buffer;
   auto producer_event_processor = ProducerEventProcessor::Create(&buffer);
@@ -11,6 +11,7 @@
 #include <sys/stat.h>
 
 #include <string>
+#include <utility>
 
 #include "OrbitBase/Logging.h"
 #include "OrbitBase/SafeStrerror.h"
@@ -18,9 +19,20 @@
 
 namespace orbit_service {
 
-bool ProducerSideServer::BuildAndStart(std::string_view unix_domain_socket_path) {
+bool ProducerSideServer::BuildAndStart(std::string_view unix_domain_socket_path,
+                                       std::string_view shared_memory_fd_socket_path) {
   CHECK(server_ == nullptr);
 
+  auto shared_memory_fd_receiver_or_error =
+      SharedMemoryFdReceiver::Create(shared_memory_fd_socket_path);
+  if (shared_memory_fd_receiver_or_error.has_error()) {
+    ERROR("Unable to receive shared memory ring buffers of producers: %s",
+          shared_memory_fd_receiver_or_error.error().message());
+  } else {
+    shared_memory_fd_receiver_ = std::move(shared_memory_fd_receiver_or_error.value());
+    producer_side_service_.SetSharedMemoryFdReceiver(shared_memory_fd_receiver_.get());
+  }
+
   grpc::ServerBuilder builder;
   builder.AddListeningPort(absl::StrFormat("unix:%s", unix_domain_socket_path),
                            grpc::InsecureServerCredentials());
@@ -49,6 +61,8 @@ void ProducerSideServer::ShutdownAndWait() {
   producer_side_service_.OnExitRequest();
   server_->Shutdown();
   server_->Wait();
+  producer_side_service_.SetSharedMemoryFdReceiver(nullptr);
+  shared_memory_fd_receiver_.reset();
 }
 
 void ProducerSideServer::OnCaptureStartRequested(orbit_grpc_protos::CaptureOptions capture_options,
@@ -14,6 +14,7 @@
 #include "CaptureStartStopListener.h"
 #include "OrbitBase/Logging.h"
 #include "ProducerSideServiceImpl.h"
+#include "SharedMemoryFdReceiver.h"
 #include "capture.pb.h"
 
 namespace orbit_service {
@@ -22,7 +23,11 @@ namespace orbit_service {
 // and listens on a Unix domain socket.
 class ProducerSideServer final : public CaptureStartStopListener {
  public:
-  bool BuildAndStart(std::string_view unix_domain_socket_path);
+  // Producers pass the file descriptors of their shared memory ring buffers on a separate Unix
+  // domain socket at `shared_memory_fd_socket_path`. Failing to listen on it only disables shared
+  // memory ring buffers.
+  bool BuildAndStart(std::string_view unix_domain_socket_path,
+                     std::string_view shared_memory_fd_socket_path);
   void ShutdownAndWait();
 
   void OnCaptureStartRequested(orbit_grpc_protos::CaptureOptions capture_options,
@@ -32,6 +37,7 @@ class ProducerSideServer final : public CaptureStartStopListener {
  private:
   ProducerSideServiceImpl producer_side_service_;
   std::unique_ptr<grpc::Server> server_;
+  std::unique_ptr<SharedMemoryFdReceiver> shared_memory_fd_receiver_;
 };
 
 }  // namespace orbit_service
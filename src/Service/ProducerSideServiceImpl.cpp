@@ -7,11 +7,16 @@
 #include <absl/synchronization/mutex.h>
 #include <absl/time/time.h>
 
+#include <memory>
 #include <thread>
 #include <utility>
 
+#include "OrbitBase/File.h"
 #include "OrbitBase/Logging.h"
+#include "OrbitBase/Result.h"
 #include "OrbitBase/ThreadUtils.h"
+#include "SharedMemoryEventReader.h"
+#include "SharedMemoryTransport/SharedMemoryRingBuffer.h"
 #include "capture.pb.h"
 
 namespace orbit_service {
@@ -356,6 +361,10 @@ void ProducerSideServiceImpl::ReceiveEventsThread(
     uint64_t producer_id, bool* all_events_sent_received) {
   orbit_base::SetCurrentThreadName("PSSI::RcvEvents");
 
+  // Set when the producer announces that it writes its events to a shared memory ring buffer
+  // instead of sending them on the stream.
+  std::unique_ptr<SharedMemoryEventReader> shared_memory_event_reader;
+
   orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest request;
   while (stream->Read(&request)) {
     {
@@ -381,8 +390,51 @@ void ProducerSideServiceImpl::ReceiveEventsThread(
         }
       } break;
 
+      case orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::kSharedMemoryRingBufferCreated: {
+        const orbit_grpc_protos::SharedMemoryRingBufferCreated& ring_buffer_created =
+            request.shared_memory_ring_buffer_created();
+        LOG("CaptureEventProducer created a shared memory ring buffer (pid %d)",
+            ring_buffer_created.pid());
+        // Destroying the previous reader, if any, first reads its remaining records.
+        shared_memory_event_reader.reset();
+        if (shared_memory_fd_receiver_ == nullptr) {
+          ERROR("Cannot receive shared memory ring buffer of CaptureEventProducer");
+          break;
+        }
+        // The producer passed the memfd itself, so this never opens a file that the producer
+        // couldn't access.
+        static constexpr absl::Duration kTakeFdTimeout = absl::Seconds(1);
+        ErrorMessageOr<orbit_base::unique_fd> fd_or_error = shared_memory_fd_receiver_->TakeFd(
+            ring_buffer_created.fd_token(), ring_buffer_created.pid(), kTakeFdTimeout);
+        if (fd_or_error.has_error()) {
+          ERROR("Receiving shared memory ring buffer of CaptureEventProducer: %s",
+                fd_or_error.error().message());
+          break;
+        }
+        auto ring_buffer_or_error = orbit_shared_memory_transport::SharedMemoryRingBuffer::Open(
+            std::move(fd_or_error.value()));
+        if (ring_buffer_or_error.has_error()) {
+          ERROR("Opening shared memory ring buffer of CaptureEventProducer: %s",
+                ring_buffer_or_error.error().message());
+          break;
+        }
+        shared_memory_event_reader = std::make_unique<SharedMemoryEventReader>(
+            std::move(ring_buffer_or_error.value()),
+            [this, producer_id](ProducerCaptureEvent event) {
+              absl::ReaderMutexLock lock{&producer_event_processor_mutex_};
+              if (producer_event_processor_ != nullptr) {
+                producer_event_processor_->ProcessEvent(producer_id, std::move(event));
+              }
+            });
+      } break;
+
       case orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::kAllEventsSent: {
         LOG("Received AllEventsSent from CaptureEventProducer");
+        // The events in the shared memory ring buffer must be processed before the capture is
+        // allowed to finish.
+        if (shared_memory_event_reader != nullptr) {
+          shared_memory_event_reader->ReadAvailableRecords();
+        }
         absl::MutexLock lock{&service_state_mutex_};
         switch (service_state_.capture_status) {
           case CaptureStatus::kCaptureStarted: {
@@ -416,6 +468,7 @@ void ProducerSideServiceImpl::ReceiveEventsThread(
   }
 
   ERROR("Receiving ReceiveCommandsAndSendEventsRequest from CaptureEventProducer");
+  shared_memory_event_reader.reset();
   {
     absl::MutexLock lock{&service_state_mutex_};
     // Producer has disconnected: treat this as if it had sent all its CaptureEvents.
@@ -16,6 +16,7 @@
 #include "CaptureStartStopListener.h"
 #include "GrpcProtos/Constants.h"
 #include "ProducerEventProcessor.h"
+#include "SharedMemoryFdReceiver.h"
 #include "capture.pb.h"
 #include "producer_side_services.grpc.pb.h"
 #include "producer_side_services.pb.h"
@@ -46,6 +47,12 @@ class ProducerSideServiceImpl final : public orbit_grpc_protos::ProducerSideServ
   // for a maximum time that can be specified with SetMaxWaitForAllCaptureEventsMs (default 10 s).
   void OnCaptureStopRequested() override;
 
+  // Producers that write their events to a shared memory ring buffer pass its file descriptor
+  // through `shared_memory_fd_receiver`. Without it, such ring buffers are ignored.
+  void SetSharedMemoryFdReceiver(SharedMemoryFdReceiver* shared_memory_fd_receiver) {
+    shared_memory_fd_receiver_ = shared_memory_fd_receiver;
+  }
+
   // This methods allows to specify a timeout for OnCaptureStopRequested, which blocks
   // until all CaptureEvents have been sent by the producers. The default is 10 seconds.
   void SetMaxWaitForAllCaptureEventsMs(uint64_t ms) { max_wait_for_all_events_sent_ms_ = ms; }
@@ -94,6 +101,8 @@ class ProducerSideServiceImpl final : public orbit_grpc_protos::ProducerSideServ
   std::atomic<uint64_t> producer_id_counter_ = orbit_grpc_protos::kExternalProducerStartingId;
 
   uint64_t max_wait_for_all_events_sent_ms_ = 10'000;
+
+  SharedMemoryFdReceiver* shared_memory_fd_receiver_ = nullptr;
 };
 
 }  // namespace orbit_service
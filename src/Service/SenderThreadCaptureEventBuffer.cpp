@@ -0,0 +1,148 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "SenderThreadCaptureEventBuffer.h"
+
+#include <absl/strings/str_format.h>
+#include <absl/time/time.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "Introspection/Introspection.h"
+#include "OrbitBase/Logging.h"
+#include "OrbitBase/Profiling.h"
+#include "OrbitBase/ThreadUtils.h"
+
+namespace orbit_service {
+
+using orbit_grpc_protos::ClientCaptureEvent;
+
+SenderThreadCaptureEventBuffer::SenderThreadCaptureEventBuffer(CaptureEventSender* event_sender,
+                                                               size_t max_buffered_event_count)
+    : max_buffered_event_count_limit_{max_buffered_event_count},
+      capture_event_sender_{event_sender} {
+  CHECK(capture_event_sender_ != nullptr);
+  sender_thread_ = std::thread{[this] { SenderThread(); }};
+}
+
+SenderThreadCaptureEventBuffer::~SenderThreadCaptureEventBuffer() {
+  CHECK(!sender_thread_.joinable());
+}
+
+void SenderThreadCaptureEventBuffer::AddEvent(ClientCaptureEvent&& event) {
+  absl::MutexLock lock{&events_being_buffered_mutex_};
+  if (stop_requested_) {
+    return;
+  }
+  if (events_being_buffered_.size() >= max_buffered_event_count_limit_ &&
+      IsDroppableWhenBufferIsFull(event)) {
+    ++dropped_event_count_;
+    return;
+  }
+  events_being_buffered_.emplace_back(std::move(event));
+}
+
+void SenderThreadCaptureEventBuffer::StopAndWait() {
+  CHECK(sender_thread_.joinable());
+  {
+    // Protect stop_requested_ with event_buffer_mutex_ so that we can use stop_requested_
+    // in Conditions for Await/LockWhen (specifically, in SenderThread).
+    absl::MutexLock lock{&events_being_buffered_mutex_};
+    stop_requested_ = true;
+  }
+  sender_thread_.join();
+
+  absl::MutexLock lock{&events_being_buffered_mutex_};
+  LOG("Maximum number of buffered events: %u", max_buffered_event_count_);
+  LOG("Number of events dropped as the event buffer was full: %u", dropped_event_count_);
+}
+
+bool SenderThreadCaptureEventBuffer::IsDroppableWhenBufferIsFull(
+    const ClientCaptureEvent& event) {
+  switch (event.event_case()) {
+    case ClientCaptureEvent::kApiEvent:
+    case ClientCaptureEvent::kApiScopeStart:
+    case ClientCaptureEvent::kApiScopeStartAsync:
+    case ClientCaptureEvent::kApiScopeStop:
+    case ClientCaptureEvent::kApiScopeStopAsync:
+    case ClientCaptureEvent::kApiTrackDouble:
+    case ClientCaptureEvent::kApiTrackFloat:
+    case ClientCaptureEvent::kApiTrackInt:
+    case ClientCaptureEvent::kApiTrackInt64:
+    case ClientCaptureEvent::kApiTrackSummary:
+    case ClientCaptureEvent::kApiTrackUint:
+    case ClientCaptureEvent::kApiTrackUint64:
+    case ClientCaptureEvent::kCallstackSample:
+    case ClientCaptureEvent::kFunctionCall:
+    case ClientCaptureEvent::kSchedulingSlice:
+    case ClientCaptureEvent::kThreadStateSlice:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void SenderThreadCaptureEventBuffer::SenderThread() {
+  orbit_base::SetCurrentThreadName("SenderThread");
+
+  bool stopped = false;
+  while (!stopped) {
+    ORBIT_SCOPE("SenderThread iteration");
+
+    events_being_buffered_mutex_.LockWhenWithTimeout(
+        absl::Condition(
+            +[](SenderThreadCaptureEventBuffer* self) {
+              return self->events_being_buffered_.size() >= self->send_event_count_ ||
+                     self->stop_requested_;
+            },
+            this),
+        batching_controller_.GetSendInterval());
+    if (stop_requested_) {
+      stopped = true;
+    }
+    events_being_buffered_.swap(events_to_send_);
+    max_buffered_event_count_ = std::max(max_buffered_event_count_, events_to_send_.size());
+    // The warning is added at the start of the next batch, as the CaptureFinished event at the
+    // end of the last batch needs to remain the last event.
+    const bool capture_finished =
+        !events_to_send_.empty() &&
+        events_to_send_.back().event_case() == ClientCaptureEvent::kCaptureFinished;
+    if (dropped_event_count_ > reported_dropped_event_count_ && !stopped && !capture_finished) {
+      events_being_buffered_.emplace_back(
+          CreateDroppedEventsWarningEvent(dropped_event_count_ - reported_dropped_event_count_));
+      reported_dropped_event_count_ = dropped_event_count_;
+    }
+    const uint64_t send_event_count = send_event_count_;
+    events_being_buffered_mutex_.Unlock();
+
+    ORBIT_UINT64("Buffered CaptureEvents", events_to_send_.size());
+    ORBIT_UINT64("CaptureEvents send interval (ms)",
+                 absl::ToInt64Milliseconds(batching_controller_.GetSendInterval()));
+    const uint64_t send_start_timestamp_ns = orbit_base::CaptureTimestampNs();
+    capture_event_sender_->SetRegularBatchEventCount(send_event_count);
+    capture_event_sender_->SendEvents(&events_to_send_);
+    batching_controller_.OnBatchSent(
+        events_to_send_.size(),
+        absl::Nanoseconds(orbit_base::CaptureTimestampNs() - send_start_timestamp_ns));
+    // std::vector::clear() "Leaves the capacity() of the vector unchanged", which is desired.
+    events_to_send_.clear();
+
+    absl::MutexLock lock{&events_being_buffered_mutex_};
+    send_event_count_ = batching_controller_.GetSendEventCount();
+  }
+}
+
+ClientCaptureEvent SenderThreadCaptureEventBuffer::CreateDroppedEventsWarningEvent(
+    uint64_t dropped_event_count) const {
+  ClientCaptureEvent event;
+  orbit_grpc_protos::WarningEvent* warning_event = event.mutable_warning_event();
+  warning_event->set_timestamp_ns(orbit_base::CaptureTimestampNs());
+  warning_event->set_message(absl::StrFormat(
+      "OrbitService dropped %u events as its buffer of %u events to send was full.",
+      dropped_event_count, max_buffered_event_count_limit_));
+  return event;
+}
+
+}  // namespace orbit_service
@@ -0,0 +1,80 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SERVICE_SENDER_THREAD_CAPTURE_EVENT_BUFFER_H_
+#define SERVICE_SENDER_THREAD_CAPTURE_EVENT_BUFFER_H_
+
+#include <absl/base/thread_annotations.h>
+#include <absl/synchronization/mutex.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <thread>
+#include <vector>
+
+#include "AdaptiveBatchingController.h"
+#include "CaptureEventBuffer.h"
+#include "CaptureEventSender.h"
+#include "capture.pb.h"
+
+namespace orbit_service {
+
+// Buffers the ClientCaptureEvents and sends them in batches with the CaptureEventSender from a
+// dedicated thread. The size of the batches is decided by an AdaptiveBatchingController.
+class SenderThreadCaptureEventBuffer final : public CaptureEventBuffer {
+ public:
+  // A few hundred MB, depending on the events.
+  static constexpr size_t kDefaultMaxBufferedEventCount = 1'000'000;
+
+  explicit SenderThreadCaptureEventBuffer(
+      CaptureEventSender* event_sender,
+      size_t max_buffered_event_count = kDefaultMaxBufferedEventCount);
+
+  // Drops the event while `max_buffered_event_count` events are buffered, if it is an event that
+  // nothing else refers to (see `IsDroppableWhenBufferIsFull`), which bounds the memory used by the
+  // buffer. Blocking instead would stall the callers, which include the gRPC threads of the
+  // producers, the processing thread of LinuxTracing and threads holding locks of their own. The
+  // client is warned of the dropped events with the next batch.
+  void AddEvent(orbit_grpc_protos::ClientCaptureEvent&& event) override;
+
+  void StopAndWait();
+
+  ~SenderThreadCaptureEventBuffer() override;
+
+  // Interned definitions (strings, callstacks, tracepoint infos, address infos), module and thread
+  // name updates, and the capture started and finished events are never dropped: the producers
+  // never send a definition twice, and the client can't do without them. Only events that are not
+  // referred to by other events are dropped, i.e., samples, scheduling slices, function calls and
+  // API events.
+  [[nodiscard]] static bool IsDroppableWhenBufferIsFull(
+      const orbit_grpc_protos::ClientCaptureEvent& event);
+
+ private:
+  void SenderThread();
+
+  [[nodiscard]] orbit_grpc_protos::ClientCaptureEvent CreateDroppedEventsWarningEvent(
+      uint64_t dropped_event_count) const;
+
+  const size_t max_buffered_event_count_limit_;
+  std::vector<orbit_grpc_protos::ClientCaptureEvent> events_being_buffered_
+      ABSL_GUARDED_BY(events_being_buffered_mutex_);
+  absl::Mutex events_being_buffered_mutex_;
+  std::vector<orbit_grpc_protos::ClientCaptureEvent> events_to_send_;
+  CaptureEventSender* capture_event_sender_;
+  std::thread sender_thread_;
+  bool stop_requested_ ABSL_GUARDED_BY(events_being_buffered_mutex_) = false;
+
+  // Only accessed by the sender thread. The number of buffered events that triggers a send is
+  // copied to send_event_count_, as it is also read by the threads that evaluate the Condition.
+  AdaptiveBatchingController batching_controller_;
+  uint64_t send_event_count_ ABSL_GUARDED_BY(events_being_buffered_mutex_) =
+      batching_controller_.GetSendEventCount();
+  size_t max_buffered_event_count_ ABSL_GUARDED_BY(events_being_buffered_mutex_) = 0;
+  uint64_t dropped_event_count_ ABSL_GUARDED_BY(events_being_buffered_mutex_) = 0;
+  uint64_t reported_dropped_event_count_ ABSL_GUARDED_BY(events_being_buffered_mutex_) = 0;
+};
+
+}  // namespace orbit_service
+
+#endif  // SERVICE_SENDER_THREAD_CAPTURE_EVENT_BUFFER_H_
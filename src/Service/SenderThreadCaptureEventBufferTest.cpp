@@ -0,0 +1,144 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <absl/synchronization/mutex.h>
+#include <absl/synchronization/notification.h>
+#include <gtest/gtest.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "CaptureEventSender.h"
+#include "SenderThreadCaptureEventBuffer.h"
+#include "capture.pb.h"
+
+namespace orbit_service {
+
+namespace {
+
+using orbit_grpc_protos::ClientCaptureEvent;
+
+// Blocks in SendEvents until `Unblock` is called, so that the events added in the meantime pile up
+// in the buffer.
+class BlockingCaptureEventSender : public CaptureEventSender {
+ public:
+  void SendEvents(std::vector<ClientCaptureEvent>* events) override {
+    if (!blocked_.HasBeenNotified()) blocked_.Notify();
+    unblocked_.WaitForNotification();
+    absl::MutexLock lock{&mutex_};
+    sent_events_.insert(sent_events_.end(), events->begin(), events->end());
+  }
+
+  void WaitUntilBlocked() { blocked_.WaitForNotification(); }
+  void Unblock() { unblocked_.Notify(); }
+
+  [[nodiscard]] std::vector<ClientCaptureEvent> GetSentEvents() {
+    absl::MutexLock lock{&mutex_};
+    return sent_events_;
+  }
+
+ private:
+  absl::Notification blocked_;
+  absl::Notification unblocked_;
+  absl::Mutex mutex_;
+  std::vector<ClientCaptureEvent> sent_events_ ABSL_GUARDED_BY(mutex_);
+};
+
+ClientCaptureEvent CreateCallstackSample(uint64_t callstack_id) {
+  ClientCaptureEvent event;
+  event.mutable_callstack_sample()->set_callstack_id(callstack_id);
+  return event;
+}
+
+ClientCaptureEvent CreateInternedString(uint64_t key) {
+  ClientCaptureEvent event;
+  event.mutable_interned_string()->set_key(key);
+  event.mutable_interned_string()->set_intern("string");
+  return event;
+}
+
+ClientCaptureEvent CreateInternedCallstack(uint64_t key) {
+  ClientCaptureEvent event;
+  event.mutable_interned_callstack()->set_key(key);
+  return event;
+}
+
+ClientCaptureEvent CreateAddressInfo(uint64_t function_name_key) {
+  ClientCaptureEvent event;
+  event.mutable_address_info()->set_function_name_key(function_name_key);
+  return event;
+}
+
+ClientCaptureEvent CreateCaptureFinished() {
+  ClientCaptureEvent event;
+  event.mutable_capture_finished()->set_status(orbit_grpc_protos::CaptureFinished::kSuccessful);
+  return event;
+}
+
+}  // namespace
+
+TEST(SenderThreadCaptureEventBuffer, DropsOnlyLeafEventsWhenFull) {
+  constexpr size_t kMaxBufferedEventCount = 10;
+  BlockingCaptureEventSender sender;
+  SenderThreadCaptureEventBuffer buffer{&sender, kMaxBufferedEventCount};
+  // The first batch is sent, and is empty, when the first send interval expires.
+  sender.WaitUntilBlocked();
+
+  for (uint64_t i = 0; i < 2 * kMaxBufferedEventCount; ++i) {
+    buffer.AddEvent(CreateCallstackSample(i));
+  }
+  buffer.AddEvent(CreateInternedString(1));
+  buffer.AddEvent(CreateInternedCallstack(2));
+  buffer.AddEvent(CreateAddressInfo(1));
+  buffer.AddEvent(CreateCallstackSample(2));
+  buffer.AddEvent(CreateCaptureFinished());
+
+  sender.Unblock();
+  buffer.StopAndWait();
+
+  uint64_t callstack_sample_count = 0;
+  uint64_t interned_string_count = 0;
+  uint64_t interned_callstack_count = 0;
+  uint64_t address_info_count = 0;
+  std::vector<ClientCaptureEvent> sent_events = sender.GetSentEvents();
+  for (const ClientCaptureEvent& event : sent_events) {
+    switch (event.event_case()) {
+      case ClientCaptureEvent::kCallstackSample:
+        ++callstack_sample_count;
+        break;
+      case ClientCaptureEvent::kInternedString:
+        ++interned_string_count;
+        break;
+      case ClientCaptureEvent::kInternedCallstack:
+        ++interned_callstack_count;
+        break;
+      case ClientCaptureEvent::kAddressInfo:
+        ++address_info_count;
+        break;
+      default:
+        break;
+    }
+  }
+
+  EXPECT_EQ(callstack_sample_count, kMaxBufferedEventCount);
+  EXPECT_EQ(interned_string_count, 1);
+  EXPECT_EQ(interned_callstack_count, 1);
+  EXPECT_EQ(address_info_count, 1);
+  ASSERT_FALSE(sent_events.empty());
+  EXPECT_EQ(sent_events.back().event_case(), ClientCaptureEvent::kCaptureFinished);
+}
+
+TEST(SenderThreadCaptureEventBuffer, IsDroppableWhenBufferIsFull) {
+  EXPECT_TRUE(
+      SenderThreadCaptureEventBuffer::IsDroppableWhenBufferIsFull(CreateCallstackSample(1)));
+  EXPECT_FALSE(
+      SenderThreadCaptureEventBuffer::IsDroppableWhenBufferIsFull(CreateInternedString(1)));
+  EXPECT_FALSE(
+      SenderThreadCaptureEventBuffer::IsDroppableWhenBufferIsFull(CreateInternedCallstack(1)));
+  EXPECT_FALSE(SenderThreadCaptureEventBuffer::IsDroppableWhenBufferIsFull(CreateAddressInfo(1)));
+  EXPECT_FALSE(
+      SenderThreadCaptureEventBuffer::IsDroppableWhenBufferIsFull(CreateCaptureFinished()));
+}
+
+}  // namespace orbit_service
@@ -0,0 +1,78 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "SharedMemoryEventReader.h"
+
+#include <absl/time/time.h>
+#include <absl/types/span.h>
+
+#include <utility>
+
+#include "OrbitBase/Logging.h"
+#include "OrbitBase/ThreadUtils.h"
+#include "SharedMemoryTransport/ProducerEventRecords.h"
+
+namespace orbit_service {
+
+using orbit_grpc_protos::ProducerCaptureEvent;
+using orbit_shared_memory_transport::DecodeProducerEventRecord;
+using orbit_shared_memory_transport::SharedMemoryRingBuffer;
+
+SharedMemoryEventReader::SharedMemoryEventReader(
+    std::unique_ptr<SharedMemoryRingBuffer> ring_buffer,
+    std::function<void(ProducerCaptureEvent)> event_callback)
+    : ring_buffer_{std::move(ring_buffer)}, event_callback_{std::move(event_callback)} {
+  CHECK(ring_buffer_ != nullptr);
+  CHECK(event_callback_ != nullptr);
+  reader_thread_ = std::thread{&SharedMemoryEventReader::ReaderThread, this};
+}
+
+SharedMemoryEventReader::~SharedMemoryEventReader() {
+  exit_requested_ = true;
+  ring_buffer_->InterruptWaitForRecords();
+  reader_thread_.join();
+  ReadAvailableRecords();
+}
+
+void SharedMemoryEventReader::ReadAvailableRecords() {
+  absl::MutexLock lock{&read_mutex_};
+  if (stopped_reading_) {
+    return;
+  }
+
+  bool decoding_failed = false;
+  auto record_count_or_error = ring_buffer_->ReadRecords(
+      [this, &decoding_failed](uint32_t type, absl::Span<const char> payload) {
+        if (decoding_failed) {
+          return;
+        }
+        ProducerCaptureEvent event;
+        if (!DecodeProducerEventRecord(type, payload, &event)) {
+          decoding_failed = true;
+          return;
+        }
+        event_callback_(std::move(event));
+      });
+  if (record_count_or_error.has_error()) {
+    ERROR("Reading shared memory ring buffer of CaptureEventProducer: %s",
+          record_count_or_error.error().message());
+    stopped_reading_ = true;
+  } else if (decoding_failed) {
+    ERROR("CaptureEventProducer wrote an invalid record to its shared memory ring buffer");
+    stopped_reading_ = true;
+  }
+}
+
+void SharedMemoryEventReader::ReaderThread() {
+  orbit_base::SetCurrentThreadName("PSSI::ShmReader");
+
+  // The producer wakes this thread up when it commits new records, and the destructor interrupts
+  // the wait, so there is no need to wake up periodically while the producer is idle.
+  while (!exit_requested_) {
+    ReadAvailableRecords();
+    ring_buffer_->WaitForRecords(absl::InfiniteDuration());
+  }
+}
+
+}  // namespace orbit_service
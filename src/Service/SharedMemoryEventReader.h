@@ -0,0 +1,59 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_SERVICE_SHARED_MEMORY_EVENT_READER_H_
+#define ORBIT_SERVICE_SHARED_MEMORY_EVENT_READER_H_
+
+#include <absl/base/thread_annotations.h>
+#include <absl/synchronization/mutex.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "SharedMemoryTransport/SharedMemoryRingBuffer.h"
+#include "capture.pb.h"
+
+namespace orbit_service {
+
+// Reads the records that an in-process producer writes to a SharedMemoryRingBuffer on a dedicated
+// thread, and passes them to `event_callback` as ProducerCaptureEvents. The callback is only ever
+// called by one thread at a time.
+// The destructor reads the records that were still left in the ring buffer before returning.
+class SharedMemoryEventReader {
+ public:
+  SharedMemoryEventReader(
+      std::unique_ptr<orbit_shared_memory_transport::SharedMemoryRingBuffer> ring_buffer,
+      std::function<void(orbit_grpc_protos::ProducerCaptureEvent)> event_callback);
+  ~SharedMemoryEventReader();
+
+  SharedMemoryEventReader(const SharedMemoryEventReader&) = delete;
+  SharedMemoryEventReader& operator=(const SharedMemoryEventReader&) = delete;
+  SharedMemoryEventReader(SharedMemoryEventReader&&) = delete;
+  SharedMemoryEventReader& operator=(SharedMemoryEventReader&&) = delete;
+
+  // Synchronously reads all the records committed so far. As the producer commits its events before
+  // sending AllEventsSent, this guarantees that all events of a capture have been processed.
+  void ReadAvailableRecords();
+
+ private:
+  void ReaderThread();
+
+  // Calls to ReadRecords are serialized by read_mutex_, WaitForRecords only happens on
+  // reader_thread_.
+  const std::unique_ptr<orbit_shared_memory_transport::SharedMemoryRingBuffer> ring_buffer_;
+  std::function<void(orbit_grpc_protos::ProducerCaptureEvent)> event_callback_;
+  // Set when a record couldn't be decoded: the producer is not trusted anymore and the ring buffer
+  // is no longer read.
+  bool stopped_reading_ ABSL_GUARDED_BY(read_mutex_) = false;
+  absl::Mutex read_mutex_;
+
+  std::atomic<bool> exit_requested_ = false;
+  std::thread reader_thread_;
+};
+
+}  // namespace orbit_service
+
+#endif  // ORBIT_SERVICE_SHARED_MEMORY_EVENT_READER_H_
@@ -0,0 +1,111 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <absl/synchronization/mutex.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "OrbitBase/File.h"
+#include "SharedMemoryEventReader.h"
+#include "SharedMemoryTransport/ProducerEventRecords.h"
+#include "SharedMemoryTransport/SharedMemoryRingBuffer.h"
+#include "capture.pb.h"
+
+namespace orbit_service {
+
+using orbit_grpc_protos::ProducerCaptureEvent;
+using orbit_shared_memory_transport::FunctionCallRecord;
+using orbit_shared_memory_transport::ProducerEventRecordType;
+using orbit_shared_memory_transport::SharedMemoryRingBuffer;
+
+namespace {
+
+class SharedMemoryEventReaderTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    auto writer_or_error = SharedMemoryRingBuffer::Create(4096);
+    ASSERT_FALSE(writer_or_error.has_error());
+    writer_ = std::move(writer_or_error.value());
+
+    auto reader_ring_buffer_or_error =
+        SharedMemoryRingBuffer::Open(orbit_base::unique_fd{dup(writer_->GetFd())});
+    ASSERT_FALSE(reader_ring_buffer_or_error.has_error());
+    reader_ = std::make_unique<SharedMemoryEventReader>(
+        std::move(reader_ring_buffer_or_error.value()), [this](ProducerCaptureEvent event) {
+          absl::MutexLock lock{&events_mutex_};
+          events_.push_back(std::move(event));
+        });
+  }
+
+  void WriteFunctionCallRecord(uint64_t function_id) {
+    FunctionCallRecord record{1, 2, function_id, 3, 4};
+    char* payload = writer_->TryReserveRecord(
+        static_cast<uint32_t>(ProducerEventRecordType::kFunctionCall), sizeof(record));
+    ASSERT_NE(payload, nullptr);
+    memcpy(payload, &record, sizeof(record));
+    writer_->CommitRecord();
+  }
+
+  std::vector<ProducerCaptureEvent> GetEvents() {
+    absl::MutexLock lock{&events_mutex_};
+    return events_;
+  }
+
+  std::unique_ptr<SharedMemoryRingBuffer> writer_;
+  std::unique_ptr<SharedMemoryEventReader> reader_;
+  std::vector<ProducerCaptureEvent> events_;
+  absl::Mutex events_mutex_;
+};
+
+}  // namespace
+
+TEST_F(SharedMemoryEventReaderTest, ReadAvailableRecordsProcessesAllCommittedRecords) {
+  WriteFunctionCallRecord(10);
+  WriteFunctionCallRecord(11);
+  reader_->ReadAvailableRecords();
+
+  std::vector<ProducerCaptureEvent> events = GetEvents();
+  ASSERT_EQ(events.size(), 2);
+  EXPECT_EQ(events[0].function_call().function_id(), 10);
+  EXPECT_EQ(events[1].function_call().function_id(), 11);
+}
+
+TEST_F(SharedMemoryEventReaderTest, ReaderThreadProcessesRecordsWhenNotified) {
+  WriteFunctionCallRecord(10);
+  writer_->NotifyReader();
+
+  absl::MutexLock lock{&events_mutex_};
+  EXPECT_TRUE(events_mutex_.AwaitWithTimeout(
+      absl::Condition(
+          +[](std::vector<ProducerCaptureEvent>* events) { return !events->empty(); }, &events_),
+      absl::Seconds(10)));
+}
+
+TEST_F(SharedMemoryEventReaderTest, DestructorProcessesRemainingRecords) {
+  WriteFunctionCallRecord(10);
+  reader_.reset();
+
+  std::vector<ProducerCaptureEvent> events = GetEvents();
+  ASSERT_EQ(events.size(), 1);
+  EXPECT_EQ(events[0].function_call().function_id(), 10);
+}
+
+TEST_F(SharedMemoryEventReaderTest, StopsReadingAfterInvalidRecord) {
+  char* payload = writer_->TryReserveRecord(1000, 8);
+  ASSERT_NE(payload, nullptr);
+  memset(payload, 0, 8);
+  writer_->CommitRecord();
+  reader_->ReadAvailableRecords();
+
+  WriteFunctionCallRecord(10);
+  reader_->ReadAvailableRecords();
+  EXPECT_TRUE(GetEvents().empty());
+}
+
+}  // namespace orbit_service
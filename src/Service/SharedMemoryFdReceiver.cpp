@@ -0,0 +1,144 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "SharedMemoryFdReceiver.h"
+
+#include <absl/strings/str_format.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <utility>
+
+#include "OrbitBase/Logging.h"
+#include "OrbitBase/SafeStrerror.h"
+#include "OrbitBase/ThreadUtils.h"
+
+namespace orbit_service {
+
+using orbit_shared_memory_transport::ReceivedFd;
+
+namespace {
+// Producers only send one file descriptor per capture, so this is only reached if file descriptors
+// are sent but never taken, e.g., by a misbehaving process.
+constexpr size_t kMaxReceivedFdCount = 64;
+// A connected process that doesn't send anything must not block the other producers.
+constexpr timeval kReceiveTimeout{1, 0};
+}  // namespace
+
+ErrorMessageOr<std::unique_ptr<SharedMemoryFdReceiver>> SharedMemoryFdReceiver::Create(
+    std::string_view socket_path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    return ErrorMessage{absl::StrFormat("Socket path \"%s\" is too long", socket_path)};
+  }
+  memcpy(address.sun_path, socket_path.data(), socket_path.size());
+
+  orbit_base::unique_fd listening_socket{socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+  if (!listening_socket.valid()) {
+    return ErrorMessage{absl::StrFormat("socket: %s", SafeStrerror(errno))};
+  }
+  // Remove the socket left behind by a previous instance, if any.
+  std::string socket_path_string{socket_path};
+  unlink(socket_path_string.c_str());
+  if (bind(listening_socket.get(), reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1) {
+    return ErrorMessage{
+        absl::StrFormat("Binding to \"%s\": %s", socket_path, SafeStrerror(errno))};
+  }
+  // When OrbitService runs as root, also allow non-root producers (e.g., the game) to connect.
+  if (chmod(socket_path_string.c_str(), 0777) != 0) {
+    return ErrorMessage{absl::StrFormat("Changing mode bits to 777 of \"%s\": %s", socket_path,
+                                        SafeStrerror(errno))};
+  }
+  if (listen(listening_socket.get(), SOMAXCONN) == -1) {
+    return ErrorMessage{absl::StrFormat("listen: %s", SafeStrerror(errno))};
+  }
+
+  return std::unique_ptr<SharedMemoryFdReceiver>{
+      new SharedMemoryFdReceiver{std::move(socket_path_string), std::move(listening_socket)}};
+}
+
+SharedMemoryFdReceiver::SharedMemoryFdReceiver(std::string socket_path,
+                                               orbit_base::unique_fd listening_socket)
+    : socket_path_{std::move(socket_path)}, listening_socket_{std::move(listening_socket)} {
+  accept_thread_ = std::thread{&SharedMemoryFdReceiver::AcceptThread, this};
+}
+
+SharedMemoryFdReceiver::~SharedMemoryFdReceiver() {
+  exit_requested_ = true;
+  // Makes the blocking accept return.
+  shutdown(listening_socket_.get(), SHUT_RDWR);
+  accept_thread_.join();
+  unlink(socket_path_.c_str());
+}
+
+ErrorMessageOr<orbit_base::unique_fd> SharedMemoryFdReceiver::TakeFd(uint64_t token, pid_t pid,
+                                                                     absl::Duration timeout) {
+  absl::MutexLock lock{&mutex_};
+  auto fd_received = [this, token]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return received_fds_.contains(token);
+  };
+  if (!mutex_.AwaitWithTimeout(absl::Condition(&fd_received), timeout)) {
+    return ErrorMessage{"No file descriptor was received for the shared memory ring buffer"};
+  }
+
+  auto received_fd_node = received_fds_.extract(token);
+  ReceivedFd& received_fd = received_fd_node.mapped();
+  if (received_fd.sender_pid != pid) {
+    return ErrorMessage{
+        absl::StrFormat("File descriptor for the shared memory ring buffer of process %d was sent "
+                        "by process %d",
+                        pid, received_fd.sender_pid)};
+  }
+  return std::move(received_fd.fd);
+}
+
+void SharedMemoryFdReceiver::AcceptThread() {
+  orbit_base::SetCurrentThreadName("PSSI::FdRecv");
+
+  while (!exit_requested_) {
+    orbit_base::unique_fd connection{
+        accept4(listening_socket_.get(), nullptr, nullptr, SOCK_CLOEXEC)};
+    if (!connection.valid()) {
+      if (!exit_requested_ && errno != EINTR && errno != ECONNABORTED) {
+        ERROR("Accepting connection for shared memory ring buffer: %s", SafeStrerror(errno));
+        return;
+      }
+      continue;
+    }
+
+    if (setsockopt(connection.get(), SOL_SOCKET, SO_RCVTIMEO, &kReceiveTimeout,
+                   sizeof(kReceiveTimeout)) == -1) {
+      ERROR("setsockopt(SO_RCVTIMEO): %s", SafeStrerror(errno));
+      continue;
+    }
+    ErrorMessageOr<ReceivedFd> received_fd_or_error =
+        orbit_shared_memory_transport::ReceiveFd(connection.get());
+    if (received_fd_or_error.has_error()) {
+      ERROR("Receiving file descriptor for shared memory ring buffer: %s",
+            received_fd_or_error.error().message());
+      continue;
+    }
+
+    ReceivedFd& received_fd = received_fd_or_error.value();
+    absl::MutexLock lock{&mutex_};
+    if (received_fds_.size() >= kMaxReceivedFdCount) {
+      ERROR("Discarding file descriptor for shared memory ring buffer from process %d",
+            received_fd.sender_pid);
+      continue;
+    }
+    const uint64_t token = received_fd.token;
+    const pid_t sender_pid = received_fd.sender_pid;
+    if (!received_fds_.try_emplace(token, std::move(received_fd)).second) {
+      ERROR("Discarding file descriptor for shared memory ring buffer from process %d with a token "
+            "already in use",
+            sender_pid);
+    }
+  }
+}
+
+}  // namespace orbit_service
@@ -0,0 +1,64 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_SERVICE_SHARED_MEMORY_FD_RECEIVER_H_
+#define ORBIT_SERVICE_SHARED_MEMORY_FD_RECEIVER_H_
+
+#include <absl/base/thread_annotations.h>
+#include <absl/container/flat_hash_map.h>
+#include <absl/synchronization/mutex.h>
+#include <absl/time/time.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "OrbitBase/File.h"
+#include "OrbitBase/Result.h"
+#include "SharedMemoryTransport/FdPassing.h"
+
+namespace orbit_service {
+
+// Listens on a Unix domain socket for the memfds of the SharedMemoryRingBuffers of
+// CaptureEventProducers, which they send with orbit_shared_memory_transport::ConnectAndSendFd, and
+// keeps them until ProducerSideServiceImpl takes them, when the producer announces the ring buffer
+// on its gRPC stream. This way OrbitService never opens a file of another process by itself.
+class SharedMemoryFdReceiver {
+ public:
+  [[nodiscard]] static ErrorMessageOr<std::unique_ptr<SharedMemoryFdReceiver>> Create(
+      std::string_view socket_path);
+  ~SharedMemoryFdReceiver();
+
+  SharedMemoryFdReceiver(const SharedMemoryFdReceiver&) = delete;
+  SharedMemoryFdReceiver& operator=(const SharedMemoryFdReceiver&) = delete;
+  SharedMemoryFdReceiver(SharedMemoryFdReceiver&&) = delete;
+  SharedMemoryFdReceiver& operator=(SharedMemoryFdReceiver&&) = delete;
+
+  // Returns the file descriptor sent with `token`, waiting for up to `timeout` for it to arrive, as
+  // the producer's gRPC message can be processed before it. Fails if the file descriptor was sent
+  // by a process other than `pid`.
+  [[nodiscard]] ErrorMessageOr<orbit_base::unique_fd> TakeFd(uint64_t token, pid_t pid,
+                                                             absl::Duration timeout);
+
+ private:
+  SharedMemoryFdReceiver(std::string socket_path, orbit_base::unique_fd listening_socket);
+  void AcceptThread();
+
+  const std::string socket_path_;
+  const orbit_base::unique_fd listening_socket_;
+  std::atomic<bool> exit_requested_ = false;
+  std::thread accept_thread_;
+
+  absl::Mutex mutex_;
+  absl::flat_hash_map<uint64_t, orbit_shared_memory_transport::ReceivedFd> received_fds_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace orbit_service
+
+#endif  // ORBIT_SERVICE_SHARED_MEMORY_FD_RECEIVER_H_
@@ -0,0 +1,82 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <absl/strings/str_format.h>
+#include <absl/time/time.h>
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "OrbitBase/File.h"
+#include "SharedMemoryFdReceiver.h"
+#include "SharedMemoryTransport/FdPassing.h"
+
+namespace orbit_service {
+
+using orbit_shared_memory_transport::ConnectAndSendFd;
+
+namespace {
+
+class SharedMemoryFdReceiverTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    auto receiver_or_error = SharedMemoryFdReceiver::Create(socket_path_);
+    ASSERT_FALSE(receiver_or_error.has_error()) << receiver_or_error.error().message();
+    receiver_ = std::move(receiver_or_error.value());
+  }
+
+  const std::string socket_path_ =
+      absl::StrFormat("/tmp/orbit-shared-memory-fd-receiver-test-%d", getpid());
+  std::unique_ptr<SharedMemoryFdReceiver> receiver_;
+};
+
+orbit_base::unique_fd CreateMemfdOfSize(off_t size) {
+  orbit_base::unique_fd fd{memfd_create("shared-memory-fd-receiver-test", MFD_CLOEXEC)};
+  EXPECT_TRUE(fd.valid());
+  EXPECT_EQ(ftruncate(fd.get(), size), 0);
+  return fd;
+}
+
+off_t GetFileSize(const orbit_base::unique_fd& fd) {
+  struct stat stat_buf {};
+  EXPECT_EQ(fstat(fd.get(), &stat_buf), 0);
+  return stat_buf.st_size;
+}
+
+}  // namespace
+
+TEST_F(SharedMemoryFdReceiverTest, TakeFdReturnsFdSentWithToken) {
+  orbit_base::unique_fd first_memfd = CreateMemfdOfSize(4096);
+  orbit_base::unique_fd second_memfd = CreateMemfdOfSize(8192);
+  ASSERT_FALSE(ConnectAndSendFd(socket_path_, 1, first_memfd.get()).has_error());
+  ASSERT_FALSE(ConnectAndSendFd(socket_path_, 2, second_memfd.get()).has_error());
+
+  auto second_fd_or_error = receiver_->TakeFd(2, getpid(), absl::Seconds(10));
+  ASSERT_FALSE(second_fd_or_error.has_error()) << second_fd_or_error.error().message();
+  EXPECT_EQ(GetFileSize(second_fd_or_error.value()), 8192);
+
+  auto first_fd_or_error = receiver_->TakeFd(1, getpid(), absl::Seconds(10));
+  ASSERT_FALSE(first_fd_or_error.has_error()) << first_fd_or_error.error().message();
+  EXPECT_EQ(GetFileSize(first_fd_or_error.value()), 4096);
+
+  // Each file descriptor can only be taken once.
+  EXPECT_TRUE(receiver_->TakeFd(1, getpid(), absl::Milliseconds(10)).has_error());
+}
+
+TEST_F(SharedMemoryFdReceiverTest, TakeFdFailsForOtherPid) {
+  orbit_base::unique_fd memfd = CreateMemfdOfSize(4096);
+  ASSERT_FALSE(ConnectAndSendFd(socket_path_, 1, memfd.get()).has_error());
+  EXPECT_TRUE(receiver_->TakeFd(1, getpid() + 1, absl::Seconds(10)).has_error());
+}
+
+TEST_F(SharedMemoryFdReceiverTest, TakeFdTimesOutWithoutFd) {
+  EXPECT_TRUE(receiver_->TakeFd(1, getpid(), absl::Milliseconds(10)).has_error());
+}
+
+}  // namespace orbit_service
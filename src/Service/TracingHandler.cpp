@@ -14,11 +14,13 @@
 
 namespace orbit_service {
 
+using orbit_grpc_protos::CallstackSample;
 using orbit_grpc_protos::CaptureOptions;
 using orbit_grpc_protos::FullAddressInfo;
 using orbit_grpc_protos::FullCallstackSample;
 using orbit_grpc_protos::FullGpuJob;
 using orbit_grpc_protos::FunctionCall;
+using orbit_grpc_protos::InternedCallstack;
 using orbit_grpc_protos::ProducerCaptureEvent;
 using orbit_grpc_protos::SchedulingSlice;
 using orbit_grpc_protos::ThreadName;
@@ -105,6 +107,17 @@ void CreateCaptureEvent(const orbit_api::ApiTrackUint64& track_uint64,
   track_uint64.CopyToGrpcProto(api_event);
 }
 
+void CreateCaptureEvent(const orbit_api::ApiTrackSummary& track_summary,
+                        orbit_grpc_protos::ProducerCaptureEvent* capture_event) {
+  auto* api_event = capture_event->mutable_api_track_summary();
+  track_summary.CopyToGrpcProto(api_event);
+}
+
+void CreateCaptureEvent(const orbit_api::ApiInternedString& interned_string,
+                        orbit_grpc_protos::ProducerCaptureEvent* capture_event) {
+  interned_string.CopyToGrpcProto(capture_event->mutable_interned_string());
+}
+
 // The variant type `ApiEventVariant` requires to contain `std::monostate` in order to be default-
 // constructable. However, that state is never expected to be called in the visitor.
 void CreateCaptureEvent(const std::monostate& /*unused*/, ProducerCaptureEvent* /*unused*/) {
@@ -141,6 +154,18 @@ void TracingHandler::OnCallstackSample(FullCallstackSample callstack_sample) {
   producer_event_processor_->ProcessEvent(kLinuxTracingProducerId, std::move(event));
 }
 
+void TracingHandler::OnInternedCallstack(InternedCallstack interned_callstack) {
+  ProducerCaptureEvent event;
+  *event.mutable_interned_callstack() = std::move(interned_callstack);
+  producer_event_processor_->ProcessEvent(kLinuxTracingProducerId, std::move(event));
+}
+
+void TracingHandler::OnInternedCallstackSample(CallstackSample callstack_sample) {
+  ProducerCaptureEvent event;
+  *event.mutable_callstack_sample() = std::move(callstack_sample);
+  producer_event_processor_->ProcessEvent(kLinuxTracingProducerId, std::move(event));
+}
+
 void TracingHandler::OnFunctionCall(FunctionCall function_call) {
   ProducerCaptureEvent event;
   *event.mutable_function_call() = std::move(function_call);
@@ -38,6 +38,8 @@ class TracingHandler : public orbit_tracing_interface::TracerListener {
 
   void OnSchedulingSlice(orbit_grpc_protos::SchedulingSlice scheduling_slice) override;
   void OnCallstackSample(orbit_grpc_protos::FullCallstackSample callstack_sample) override;
+  void OnInternedCallstack(orbit_grpc_protos::InternedCallstack interned_callstack) override;
+  void OnInternedCallstackSample(orbit_grpc_protos::CallstackSample callstack_sample) override;
   void OnFunctionCall(orbit_grpc_protos::FunctionCall function_call) override;
   void OnGpuJob(orbit_grpc_protos::FullGpuJob gpu_job) override;
   void OnThreadName(orbit_grpc_protos::ThreadName thread_name) override;
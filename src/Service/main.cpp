@@ -21,6 +21,45 @@ ABSL_FLAG(uint64_t, grpc_port, 44765, "gRPC server port");
 
 ABSL_FLAG(bool, devmode, false, "Enable developer mode");
 
+ABSL_FLAG(uint32_t, ring_buffer_reader_threads, 1,
+          "Number of threads reading perf_event_open ring buffers, sharded by cpu");
+
+ABSL_FLAG(bool, event_driven_ring_buffer_reads, true,
+          "Wait for new data in perf_event_open ring buffers with epoll instead of polling them");
+
+ABSL_FLAG(bool, adaptive_event_processing_delay, false,
+          "Process perf_event_open events once all ring buffers have been read past them, instead "
+          "of after a fixed delay");
+
+ABSL_FLAG(uint32_t, unwinding_threads, 0,
+          "Number of threads unwinding stack samples with DWARF information (0 means unwinding on "
+          "the thread that processes all perf_event_open events)");
+
+ABSL_FLAG(uint32_t, unwind_result_cache_size, 0,
+          "Maximum number of DWARF unwinding results cached by each unwinding thread, to skip "
+          "unwinding identical stack samples again (0 disables the cache). Each result can keep a "
+          "copy of its stack sample");
+
+ABSL_FLAG(bool, producer_side_shared_memory, false,
+          "Ask in-process producers (Orbit API, user space instrumentation) to write their events "
+          "to a shared memory ring buffer instead of sending them over gRPC");
+
+ABSL_FLAG(uint64_t, producer_side_max_buffered_events, 0,
+          "Maximum number of events that each in-process producer buffers before forwarding them, "
+          "dropping the events that exceed it (0 means unbounded)");
+
+ABSL_FLAG(bool, user_space_instrumentation_fast_path, false,
+          "Let the trampolines of user space instrumentation record the entry of a function inline "
+          "instead of calling into the injected library, when the cpu has an invariant TSC");
+
+ABSL_FLAG(bool, user_space_instrumentation_persistent, false,
+          "Keep functions instrumented with user space instrumentation between captures, such that "
+          "a new capture of the same process with the same functions starts almost immediately");
+
+ABSL_FLAG(bool, capture_stream_compression, false,
+          "Compress the capture data sent to the client with gzip, except while the sender falls "
+          "behind. Saves bandwidth on slow connections at the cost of CPU time");
+
 namespace {
 std::atomic<bool> exit_requested;
 
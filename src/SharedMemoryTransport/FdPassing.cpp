@@ -0,0 +1,106 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "SharedMemoryTransport/FdPassing.h"
+
+#include <absl/strings/str_format.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+
+#include "OrbitBase/SafeStrerror.h"
+
+namespace orbit_shared_memory_transport {
+
+ErrorMessageOr<void> SendFd(int socket_fd, uint64_t token, int fd) {
+  iovec iov{&token, sizeof(token)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+  msghdr message{};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  cmsghdr* control_message = CMSG_FIRSTHDR(&message);
+  control_message->cmsg_level = SOL_SOCKET;
+  control_message->cmsg_type = SCM_RIGHTS;
+  control_message->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(control_message), &fd, sizeof(int));
+
+  ssize_t sent_size = TEMP_FAILURE_RETRY(sendmsg(socket_fd, &message, MSG_NOSIGNAL));
+  if (sent_size == -1) {
+    return ErrorMessage{absl::StrFormat("sendmsg: %s", SafeStrerror(errno))};
+  }
+  if (sent_size != sizeof(token)) {
+    return ErrorMessage{"sendmsg: token was not sent completely"};
+  }
+  return outcome::success();
+}
+
+ErrorMessageOr<void> ConnectAndSendFd(std::string_view socket_path, uint64_t token, int fd) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    return ErrorMessage{absl::StrFormat("Socket path \"%s\" is too long", socket_path)};
+  }
+  memcpy(address.sun_path, socket_path.data(), socket_path.size());
+
+  orbit_base::unique_fd socket_fd{socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+  if (!socket_fd.valid()) {
+    return ErrorMessage{absl::StrFormat("socket: %s", SafeStrerror(errno))};
+  }
+  if (TEMP_FAILURE_RETRY(connect(socket_fd.get(), reinterpret_cast<sockaddr*>(&address),
+                                 sizeof(address))) == -1) {
+    return ErrorMessage{
+        absl::StrFormat("Connecting to \"%s\": %s", socket_path, SafeStrerror(errno))};
+  }
+  return SendFd(socket_fd.get(), token, fd);
+}
+
+ErrorMessageOr<ReceivedFd> ReceiveFd(int socket_fd) {
+  uint64_t token = 0;
+  iovec iov{&token, sizeof(token)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+  msghdr message{};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  ssize_t received_size = TEMP_FAILURE_RETRY(recvmsg(socket_fd, &message, MSG_CMSG_CLOEXEC));
+  if (received_size == -1) {
+    return ErrorMessage{absl::StrFormat("recvmsg: %s", SafeStrerror(errno))};
+  }
+
+  // Take ownership of the file descriptor first, so that it is closed on every error below.
+  orbit_base::unique_fd fd;
+  cmsghdr* control_message = CMSG_FIRSTHDR(&message);
+  if (control_message != nullptr && control_message->cmsg_level == SOL_SOCKET &&
+      control_message->cmsg_type == SCM_RIGHTS &&
+      control_message->cmsg_len == CMSG_LEN(sizeof(int))) {
+    int received_fd;
+    memcpy(&received_fd, CMSG_DATA(control_message), sizeof(int));
+    fd = orbit_base::unique_fd{received_fd};
+  }
+
+  if (received_size != sizeof(token)) {
+    return ErrorMessage{"recvmsg: token was not received completely"};
+  }
+  if ((message.msg_flags & MSG_CTRUNC) != 0 || !fd.valid()) {
+    return ErrorMessage{"recvmsg: no file descriptor was received"};
+  }
+
+  ucred credentials{};
+  socklen_t credentials_size = sizeof(credentials);
+  if (getsockopt(socket_fd, SOL_SOCKET, SO_PEERCRED, &credentials, &credentials_size) == -1) {
+    return ErrorMessage{absl::StrFormat("getsockopt(SO_PEERCRED): %s", SafeStrerror(errno))};
+  }
+
+  return ReceivedFd{token, credentials.pid, std::move(fd)};
+}
+
+}  // namespace orbit_shared_memory_transport
@@ -0,0 +1,69 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "OrbitBase/File.h"
+#include "SharedMemoryTransport/FdPassing.h"
+
+namespace orbit_shared_memory_transport {
+
+namespace {
+
+std::pair<orbit_base::unique_fd, orbit_base::unique_fd> CreateSocketPair() {
+  std::array<int, 2> socket_fds{};
+  EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, socket_fds.data()), 0);
+  return {orbit_base::unique_fd{socket_fds[0]}, orbit_base::unique_fd{socket_fds[1]}};
+}
+
+}  // namespace
+
+TEST(FdPassing, ReceivesSentFdTokenAndSenderPid) {
+  auto [sender_socket, receiver_socket] = CreateSocketPair();
+
+  orbit_base::unique_fd memfd{memfd_create("fd-passing-test", MFD_CLOEXEC)};
+  ASSERT_TRUE(memfd.valid());
+  const std::string kContent = "content";
+  ASSERT_EQ(write(memfd.get(), kContent.data(), kContent.size()), kContent.size());
+
+  constexpr uint64_t kToken = 0x0123456789ABCDEF;
+  ASSERT_FALSE(SendFd(sender_socket.get(), kToken, memfd.get()).has_error());
+
+  ErrorMessageOr<ReceivedFd> received_fd_or_error = ReceiveFd(receiver_socket.get());
+  ASSERT_FALSE(received_fd_or_error.has_error()) << received_fd_or_error.error().message();
+  ReceivedFd& received_fd = received_fd_or_error.value();
+  EXPECT_EQ(received_fd.token, kToken);
+  EXPECT_EQ(received_fd.sender_pid, getpid());
+  ASSERT_TRUE(received_fd.fd.valid());
+  EXPECT_NE(received_fd.fd.get(), memfd.get());
+
+  // The received file descriptor refers to the same file.
+  std::string read_content(kContent.size(), '\0');
+  ASSERT_EQ(pread(received_fd.fd.get(), read_content.data(), read_content.size(), 0),
+            kContent.size());
+  EXPECT_EQ(read_content, kContent);
+}
+
+TEST(FdPassing, ReceiveFdFailsWithoutFd) {
+  auto [sender_socket, receiver_socket] = CreateSocketPair();
+
+  constexpr uint64_t kToken = 42;
+  ASSERT_EQ(write(sender_socket.get(), &kToken, sizeof(kToken)), sizeof(kToken));
+  EXPECT_TRUE(ReceiveFd(receiver_socket.get()).has_error());
+}
+
+TEST(FdPassing, ConnectAndSendFdFailsWithoutListener) {
+  EXPECT_TRUE(ConnectAndSendFd("/nonexistent/orbit-fd-passing-test-socket", 42, STDIN_FILENO)
+                  .has_error());
+}
+
+}  // namespace orbit_shared_memory_transport
@@ -0,0 +1,209 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "SharedMemoryTransport/ProducerEventRecords.h"
+
+#include <absl/base/casts.h>
+
+#include <cstring>
+
+namespace orbit_shared_memory_transport {
+
+using orbit_grpc_protos::ProducerCaptureEvent;
+
+namespace {
+
+bool DecodeFunctionCallRecord(absl::Span<const char> payload, ProducerCaptureEvent* event) {
+  if (payload.size() != sizeof(FunctionCallRecord)) {
+    return false;
+  }
+  FunctionCallRecord record;
+  memcpy(&record, payload.data(), sizeof(FunctionCallRecord));
+
+  orbit_grpc_protos::FunctionCall* function_call = event->mutable_function_call();
+  function_call->set_pid(record.pid);
+  function_call->set_tid(record.tid);
+  function_call->set_function_id(record.function_id);
+  function_call->set_duration_ns(record.duration_ns);
+  function_call->set_end_timestamp_ns(record.end_timestamp_ns);
+  return true;
+}
+
+bool DecodeInternedStringRecord(absl::Span<const char> payload, ProducerCaptureEvent* event) {
+  uint64_t key;
+  if (payload.size() < sizeof(key)) {
+    return false;
+  }
+  memcpy(&key, payload.data(), sizeof(key));
+
+  orbit_grpc_protos::InternedString* interned_string = event->mutable_interned_string();
+  interned_string->set_key(key);
+  interned_string->set_intern(payload.data() + sizeof(key), payload.size() - sizeof(key));
+  return true;
+}
+
+template <typename ApiProtoT>
+void SetMetaData(const ApiEventRecord& record, ApiProtoT* api_event) {
+  api_event->set_pid(record.pid);
+  api_event->set_tid(record.tid);
+  api_event->set_timestamp_ns(record.timestamp_ns);
+}
+
+template <typename ApiProtoT>
+void SetEncodedName(const ApiEventRecord& record, const char* encoded_name_additional,
+                    ApiProtoT* api_event) {
+  api_event->set_encoded_name_1(record.encoded_name[0]);
+  api_event->set_encoded_name_2(record.encoded_name[1]);
+  api_event->set_encoded_name_3(record.encoded_name[2]);
+  api_event->set_encoded_name_4(record.encoded_name[3]);
+  api_event->set_encoded_name_5(record.encoded_name[4]);
+  api_event->set_encoded_name_6(record.encoded_name[5]);
+  api_event->set_encoded_name_7(record.encoded_name[6]);
+  api_event->set_encoded_name_8(record.encoded_name[7]);
+  api_event->set_name_key(record.name_key);
+  if (record.encoded_name_additional_count == 0) {
+    return;
+  }
+  auto* additional = api_event->mutable_encoded_name_additional();
+  additional->Resize(static_cast<int>(record.encoded_name_additional_count), 0);
+  memcpy(additional->mutable_data(), encoded_name_additional,
+         record.encoded_name_additional_count * sizeof(uint64_t));
+}
+
+bool DecodeApiEventRecord(ProducerEventRecordType type, absl::Span<const char> payload,
+                          ProducerCaptureEvent* event) {
+  if (payload.size() < sizeof(ApiEventRecord)) {
+    return false;
+  }
+  ApiEventRecord record;
+  memcpy(&record, payload.data(), sizeof(ApiEventRecord));
+  if (payload.size() !=
+      sizeof(ApiEventRecord) + uint64_t{record.encoded_name_additional_count} * sizeof(uint64_t)) {
+    return false;
+  }
+  const char* encoded_name_additional = payload.data() + sizeof(ApiEventRecord);
+
+  switch (type) {
+    case ProducerEventRecordType::kApiScopeStart: {
+      auto* api_event = event->mutable_api_scope_start();
+      SetMetaData(record, api_event);
+      SetEncodedName(record, encoded_name_additional, api_event);
+      api_event->set_color_rgba(record.color_rgba);
+      api_event->set_group_id(record.id);
+      api_event->set_address_in_function(record.address_in_function);
+    } break;
+    case ProducerEventRecordType::kApiScopeStop: {
+      SetMetaData(record, event->mutable_api_scope_stop());
+    } break;
+    case ProducerEventRecordType::kApiScopeStartAsync: {
+      auto* api_event = event->mutable_api_scope_start_async();
+      SetMetaData(record, api_event);
+      SetEncodedName(record, encoded_name_additional, api_event);
+      api_event->set_color_rgba(record.color_rgba);
+      api_event->set_id(record.id);
+      api_event->set_address_in_function(record.address_in_function);
+    } break;
+    case ProducerEventRecordType::kApiScopeStopAsync: {
+      auto* api_event = event->mutable_api_scope_stop_async();
+      SetMetaData(record, api_event);
+      api_event->set_id(record.id);
+    } break;
+    case ProducerEventRecordType::kApiStringEvent: {
+      auto* api_event = event->mutable_api_string_event();
+      SetMetaData(record, api_event);
+      SetEncodedName(record, encoded_name_additional, api_event);
+      api_event->set_id(record.id);
+      api_event->set_color_rgba(record.color_rgba);
+    } break;
+    case ProducerEventRecordType::kApiTrackDouble: {
+      auto* api_event = event->mutable_api_track_double();
+      SetMetaData(record, api_event);
+      SetEncodedName(record, encoded_name_additional, api_event);
+      api_event->set_data(absl::bit_cast<double>(record.data));
+      api_event->set_color_rgba(record.color_rgba);
+    } break;
+    case ProducerEventRecordType::kApiTrackFloat: {
+      auto* api_event = event->mutable_api_track_float();
+      SetMetaData(record, api_event);
+      SetEncodedName(record, encoded_name_additional, api_event);
+      api_event->set_data(absl::bit_cast<float>(static_cast<uint32_t>(record.data)));
+      api_event->set_color_rgba(record.color_rgba);
+    } break;
+    case ProducerEventRecordType::kApiTrackInt: {
+      auto* api_event = event->mutable_api_track_int();
+      SetMetaData(record, api_event);
+      SetEncodedName(record, encoded_name_additional, api_event);
+      api_event->set_data(static_cast<int32_t>(record.data));
+      api_event->set_color_rgba(record.color_rgba);
+    } break;
+    case ProducerEventRecordType::kApiTrackInt64: {
+      auto* api_event = event->mutable_api_track_int64();
+      SetMetaData(record, api_event);
+      SetEncodedName(record, encoded_name_additional, api_event);
+      api_event->set_data(static_cast<int64_t>(record.data));
+      api_event->set_color_rgba(record.color_rgba);
+    } break;
+    case ProducerEventRecordType::kApiTrackUint: {
+      auto* api_event = event->mutable_api_track_uint();
+      SetMetaData(record, api_event);
+      SetEncodedName(record, encoded_name_additional, api_event);
+      api_event->set_data(static_cast<uint32_t>(record.data));
+      api_event->set_color_rgba(record.color_rgba);
+    } break;
+    case ProducerEventRecordType::kApiTrackUint64: {
+      auto* api_event = event->mutable_api_track_uint64();
+      SetMetaData(record, api_event);
+      SetEncodedName(record, encoded_name_additional, api_event);
+      api_event->set_data(record.data);
+      api_event->set_color_rgba(record.color_rgba);
+    } break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+bool DecodeApiTrackSummaryRecord(absl::Span<const char> payload, ProducerCaptureEvent* event) {
+  if (payload.size() < sizeof(ApiTrackSummaryRecord)) {
+    return false;
+  }
+  ApiTrackSummaryRecord record;
+  memcpy(&record, payload.data(), sizeof(ApiTrackSummaryRecord));
+  const uint64_t encoded_name_additional_count = record.event.encoded_name_additional_count;
+  if (payload.size() !=
+      sizeof(ApiTrackSummaryRecord) + encoded_name_additional_count * sizeof(uint64_t)) {
+    return false;
+  }
+
+  auto* api_event = event->mutable_api_track_summary();
+  SetMetaData(record.event, api_event);
+  SetEncodedName(record.event, payload.data() + sizeof(ApiTrackSummaryRecord), api_event);
+  api_event->set_color_rgba(record.event.color_rgba);
+  api_event->set_first_timestamp_ns(record.first_timestamp_ns);
+  api_event->set_min(record.min);
+  api_event->set_max(record.max);
+  api_event->set_last(record.last);
+  api_event->set_sum(record.sum);
+  api_event->set_count(record.count);
+  return true;
+}
+
+}  // namespace
+
+bool DecodeProducerEventRecord(uint32_t type, absl::Span<const char> payload,
+                               ProducerCaptureEvent* event) {
+  auto record_type = static_cast<ProducerEventRecordType>(type);
+  if (record_type == ProducerEventRecordType::kFunctionCall) {
+    return DecodeFunctionCallRecord(payload, event);
+  }
+  if (record_type == ProducerEventRecordType::kInternedString) {
+    return DecodeInternedStringRecord(payload, event);
+  }
+  if (record_type == ProducerEventRecordType::kApiTrackSummary) {
+    return DecodeApiTrackSummaryRecord(payload, event);
+  }
+  return DecodeApiEventRecord(record_type, payload, event);
+}
+
+}  // namespace orbit_shared_memory_transport
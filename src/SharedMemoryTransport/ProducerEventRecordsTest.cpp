@@ -0,0 +1,205 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <absl/base/casts.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "SharedMemoryTransport/ProducerEventRecords.h"
+#include "capture.pb.h"
+
+namespace orbit_shared_memory_transport {
+
+using orbit_grpc_protos::ProducerCaptureEvent;
+
+namespace {
+
+std::vector<char> ToPayload(const ApiEventRecord& record,
+                            const std::vector<uint64_t>& encoded_name_additional) {
+  std::vector<char> payload(sizeof(ApiEventRecord) +
+                            encoded_name_additional.size() * sizeof(uint64_t));
+  memcpy(payload.data(), &record, sizeof(ApiEventRecord));
+  memcpy(payload.data() + sizeof(ApiEventRecord), encoded_name_additional.data(),
+         encoded_name_additional.size() * sizeof(uint64_t));
+  return payload;
+}
+
+ApiEventRecord MakeApiEventRecord() {
+  ApiEventRecord record{};
+  record.pid = 1;
+  record.tid = 2;
+  record.timestamp_ns = 3;
+  for (uint64_t i = 0; i < 8; ++i) {
+    record.encoded_name[i] = 10 + i;
+  }
+  record.id = 4;
+  record.address_in_function = 5;
+  record.color_rgba = 6;
+  return record;
+}
+
+}  // namespace
+
+TEST(ProducerEventRecords, DecodeFunctionCallRecord) {
+  FunctionCallRecord record{1, 2, 3, 4, 5};
+  ProducerCaptureEvent event;
+  ASSERT_TRUE(DecodeProducerEventRecord(
+      static_cast<uint32_t>(ProducerEventRecordType::kFunctionCall),
+      absl::MakeConstSpan(reinterpret_cast<const char*>(&record), sizeof(record)), &event));
+
+  ASSERT_EQ(event.event_case(), ProducerCaptureEvent::kFunctionCall);
+  EXPECT_EQ(event.function_call().pid(), 1);
+  EXPECT_EQ(event.function_call().tid(), 2);
+  EXPECT_EQ(event.function_call().function_id(), 3);
+  EXPECT_EQ(event.function_call().duration_ns(), 4);
+  EXPECT_EQ(event.function_call().end_timestamp_ns(), 5);
+}
+
+TEST(ProducerEventRecords, DecodeApiScopeStartRecordWithAdditionalName) {
+  ApiEventRecord record = MakeApiEventRecord();
+  record.encoded_name_additional_count = 2;
+  std::vector<char> payload = ToPayload(record, {18, 19});
+
+  ProducerCaptureEvent event;
+  ASSERT_TRUE(DecodeProducerEventRecord(
+      static_cast<uint32_t>(ProducerEventRecordType::kApiScopeStart), payload, &event));
+
+  ASSERT_EQ(event.event_case(), ProducerCaptureEvent::kApiScopeStart);
+  const orbit_grpc_protos::ApiScopeStart& api_event = event.api_scope_start();
+  EXPECT_EQ(api_event.pid(), 1);
+  EXPECT_EQ(api_event.tid(), 2);
+  EXPECT_EQ(api_event.timestamp_ns(), 3);
+  EXPECT_EQ(api_event.encoded_name_1(), 10);
+  EXPECT_EQ(api_event.encoded_name_8(), 17);
+  EXPECT_THAT(api_event.encoded_name_additional(), testing::ElementsAre(18, 19));
+  EXPECT_EQ(api_event.group_id(), 4);
+  EXPECT_EQ(api_event.address_in_function(), 5);
+  EXPECT_EQ(api_event.color_rgba(), 6);
+}
+
+TEST(ProducerEventRecords, DecodeApiTrackRecordWithInternedName) {
+  ApiEventRecord record = MakeApiEventRecord();
+  record.name_key = 7;
+  record.data = 42;
+
+  ProducerCaptureEvent event;
+  ASSERT_TRUE(DecodeProducerEventRecord(
+      static_cast<uint32_t>(ProducerEventRecordType::kApiTrackUint64), ToPayload(record, {}),
+      &event));
+  ASSERT_EQ(event.event_case(), ProducerCaptureEvent::kApiTrackUint64);
+  EXPECT_EQ(event.api_track_uint64().name_key(), 7);
+  EXPECT_EQ(event.api_track_uint64().data(), 42);
+}
+
+TEST(ProducerEventRecords, DecodeInternedStringRecord) {
+  constexpr uint64_t kKey = 7;
+  const std::string name = "Some name";
+  std::vector<char> payload(sizeof(kKey) + name.size());
+  memcpy(payload.data(), &kKey, sizeof(kKey));
+  memcpy(payload.data() + sizeof(kKey), name.data(), name.size());
+
+  ProducerCaptureEvent event;
+  ASSERT_TRUE(DecodeProducerEventRecord(
+      static_cast<uint32_t>(ProducerEventRecordType::kInternedString), payload, &event));
+  ASSERT_EQ(event.event_case(), ProducerCaptureEvent::kInternedString);
+  EXPECT_EQ(event.interned_string().key(), kKey);
+  EXPECT_EQ(event.interned_string().intern(), name);
+
+  // Too short for the key.
+  payload.resize(sizeof(kKey) - 1);
+  EXPECT_FALSE(DecodeProducerEventRecord(
+      static_cast<uint32_t>(ProducerEventRecordType::kInternedString), payload, &event));
+}
+
+TEST(ProducerEventRecords, DecodeApiTrackRecords) {
+  ApiEventRecord record = MakeApiEventRecord();
+
+  record.data = absl::bit_cast<uint64_t>(1.5);
+  ProducerCaptureEvent double_event;
+  ASSERT_TRUE(DecodeProducerEventRecord(
+      static_cast<uint32_t>(ProducerEventRecordType::kApiTrackDouble), ToPayload(record, {}),
+      &double_event));
+  EXPECT_EQ(double_event.api_track_double().data(), 1.5);
+  EXPECT_EQ(double_event.api_track_double().color_rgba(), 6);
+
+  record.data = absl::bit_cast<uint32_t>(2.5f);
+  ProducerCaptureEvent float_event;
+  ASSERT_TRUE(DecodeProducerEventRecord(
+      static_cast<uint32_t>(ProducerEventRecordType::kApiTrackFloat), ToPayload(record, {}),
+      &float_event));
+  EXPECT_EQ(float_event.api_track_float().data(), 2.5f);
+
+  record.data = static_cast<uint64_t>(int64_t{-7});
+  ProducerCaptureEvent int_event;
+  ASSERT_TRUE(DecodeProducerEventRecord(static_cast<uint32_t>(ProducerEventRecordType::kApiTrackInt),
+                                        ToPayload(record, {}), &int_event));
+  EXPECT_EQ(int_event.api_track_int().data(), -7);
+}
+
+TEST(ProducerEventRecords, DecodeApiTrackSummaryRecord) {
+  ApiTrackSummaryRecord record{};
+  record.event = MakeApiEventRecord();
+  record.event.name_key = 7;
+  record.event.encoded_name_additional_count = 1;
+  record.first_timestamp_ns = 2;
+  record.min = -1.5;
+  record.max = 4.5;
+  record.last = 3.;
+  record.sum = 6.;
+  record.count = 3;
+  constexpr uint64_t kEncodedNameAdditional = 18;
+  std::vector<char> payload(sizeof(record) + sizeof(kEncodedNameAdditional));
+  memcpy(payload.data(), &record, sizeof(record));
+  memcpy(payload.data() + sizeof(record), &kEncodedNameAdditional, sizeof(kEncodedNameAdditional));
+
+  ProducerCaptureEvent event;
+  ASSERT_TRUE(DecodeProducerEventRecord(
+      static_cast<uint32_t>(ProducerEventRecordType::kApiTrackSummary), payload, &event));
+  ASSERT_EQ(event.event_case(), ProducerCaptureEvent::kApiTrackSummary);
+  const orbit_grpc_protos::ApiTrackSummary& summary = event.api_track_summary();
+  EXPECT_EQ(summary.pid(), 1);
+  EXPECT_EQ(summary.tid(), 2);
+  EXPECT_EQ(summary.timestamp_ns(), 3);
+  EXPECT_EQ(summary.encoded_name_1(), 10);
+  EXPECT_THAT(summary.encoded_name_additional(), testing::ElementsAre(18));
+  EXPECT_EQ(summary.name_key(), 7);
+  EXPECT_EQ(summary.color_rgba(), 6);
+  EXPECT_EQ(summary.first_timestamp_ns(), 2);
+  EXPECT_EQ(summary.min(), -1.5);
+  EXPECT_EQ(summary.max(), 4.5);
+  EXPECT_EQ(summary.last(), 3.);
+  EXPECT_EQ(summary.sum(), 6.);
+  EXPECT_EQ(summary.count(), 3);
+
+  // The additional name value is missing.
+  payload.resize(sizeof(record));
+  EXPECT_FALSE(DecodeProducerEventRecord(
+      static_cast<uint32_t>(ProducerEventRecordType::kApiTrackSummary), payload, &event));
+}
+
+TEST(ProducerEventRecords, DecodeFailsOnInvalidRecords) {
+  ApiEventRecord record = MakeApiEventRecord();
+  ProducerCaptureEvent event;
+
+  // Unknown type.
+  EXPECT_FALSE(DecodeProducerEventRecord(1000, ToPayload(record, {}), &event));
+
+  // Payload too short for the record.
+  std::vector<char> payload = ToPayload(record, {});
+  payload.pop_back();
+  EXPECT_FALSE(DecodeProducerEventRecord(
+      static_cast<uint32_t>(ProducerEventRecordType::kApiScopeStop), payload, &event));
+
+  // More additional name values announced than present.
+  record.encoded_name_additional_count = 3;
+  EXPECT_FALSE(DecodeProducerEventRecord(
+      static_cast<uint32_t>(ProducerEventRecordType::kApiScopeStart), ToPayload(record, {18}),
+      &event));
+}
+
+}  // namespace orbit_shared_memory_transport
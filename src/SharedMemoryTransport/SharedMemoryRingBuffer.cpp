@@ -0,0 +1,230 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "SharedMemoryTransport/SharedMemoryRingBuffer.h"
+
+#include <absl/strings/str_format.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <new>
+#include <utility>
+
+#include "OrbitBase/SafeStrerror.h"
+
+namespace orbit_shared_memory_transport {
+
+namespace {
+constexpr uint64_t kMagic = 0x4f52424954524232;  // "ORBITRB2"
+
+// Wakes up the process blocked on `futex_word`, if any. The futex word is non-zero while the other
+// process is (about to be) blocked.
+void WakeUpWaiter(std::atomic<uint32_t>* futex_word) {
+  if (futex_word->load(std::memory_order_seq_cst) == 0) {
+    return;
+  }
+  futex_word->store(0, std::memory_order_seq_cst);
+  // Not FUTEX_PRIVATE_FLAG, as the futex is shared with another process.
+  syscall(SYS_futex, futex_word, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+// Blocks on `futex_word`, which the caller has set to 1, until WakeUpWaiter resets it or `timeout`
+// expires.
+void Wait(std::atomic<uint32_t>* futex_word, absl::Duration timeout) {
+  timespec timeout_timespec{};
+  timespec* timeout_timespec_ptr = nullptr;
+  if (timeout != absl::InfiniteDuration()) {
+    timeout_timespec = absl::ToTimespec(timeout);
+    timeout_timespec_ptr = &timeout_timespec;
+  }
+  // Returns immediately if the other process has already reset the futex word to zero.
+  syscall(SYS_futex, futex_word, FUTEX_WAIT, 1, timeout_timespec_ptr, nullptr, 0);
+  futex_word->store(0, std::memory_order_seq_cst);
+}
+}  // namespace
+
+// Lives at the start of the shared memory. The positions only ever increase, the offset in the data
+// is the position modulo the capacity. The positions are on separate cache lines, as they are
+// written by different processes.
+struct SharedMemoryRingBuffer::Header {
+  uint64_t magic;
+  uint64_t capacity;
+  alignas(64) std::atomic<uint64_t> write_position;
+  alignas(64) std::atomic<uint64_t> read_position;
+  // Futex word: non-zero while the reader is (about to be) blocked in WaitForRecords.
+  alignas(64) std::atomic<uint32_t> reader_waiting;
+  // Futex word: non-zero while the writer is (about to be) blocked in WaitForFreeSpace.
+  alignas(64) std::atomic<uint32_t> writer_waiting;
+};
+
+// The atomics are accessed from two processes, so they must not be implemented with a lock.
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+
+ErrorMessageOr<std::unique_ptr<SharedMemoryRingBuffer>> SharedMemoryRingBuffer::Create(
+    uint64_t capacity) {
+  CHECK(capacity > 0 && (capacity & (capacity - 1)) == 0);
+  CHECK(capacity % kDataOffset == 0);
+
+  int fd = memfd_create("orbit-shared-memory-ring-buffer", MFD_CLOEXEC);
+  if (fd == -1) {
+    return ErrorMessage{absl::StrFormat("memfd_create: %s", SafeStrerror(errno))};
+  }
+  orbit_base::unique_fd unique_fd{fd};
+
+  const uint64_t mapping_size = kDataOffset + capacity;
+  if (ftruncate(fd, static_cast<off_t>(mapping_size)) == -1) {
+    return ErrorMessage{absl::StrFormat("ftruncate: %s", SafeStrerror(errno))};
+  }
+  void* mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    return ErrorMessage{absl::StrFormat("mmap: %s", SafeStrerror(errno))};
+  }
+
+  auto* header = new (mapping) Header{};
+  header->magic = kMagic;
+  header->capacity = capacity;
+  return std::unique_ptr<SharedMemoryRingBuffer>{
+      new SharedMemoryRingBuffer{std::move(unique_fd), mapping, capacity}};
+}
+
+ErrorMessageOr<std::unique_ptr<SharedMemoryRingBuffer>> SharedMemoryRingBuffer::Open(
+    orbit_base::unique_fd fd) {
+  if (!fd.valid()) {
+    return ErrorMessage{"Invalid file descriptor for shared memory ring buffer"};
+  }
+
+  // Don't trust the capacity in the header: it must match the actual size of the memfd, or
+  // accessing the data could fault.
+  struct stat stat_buf {};
+  if (fstat(fd.get(), &stat_buf) == -1) {
+    return ErrorMessage{absl::StrFormat("fstat: %s", SafeStrerror(errno))};
+  }
+  const auto mapping_size = static_cast<uint64_t>(stat_buf.st_size);
+  if (mapping_size <= kDataOffset) {
+    return ErrorMessage{"File is too small to be a shared memory ring buffer"};
+  }
+  const uint64_t capacity = mapping_size - kDataOffset;
+  if ((capacity & (capacity - 1)) != 0) {
+    return ErrorMessage{"File has an invalid shared memory ring buffer capacity"};
+  }
+
+  void* mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+  if (mapping == MAP_FAILED) {
+    return ErrorMessage{absl::StrFormat("mmap: %s", SafeStrerror(errno))};
+  }
+
+  auto* header = static_cast<Header*>(mapping);
+  if (header->magic != kMagic || header->capacity != capacity) {
+    munmap(mapping, mapping_size);
+    return ErrorMessage{"File is not a shared memory ring buffer"};
+  }
+  return std::unique_ptr<SharedMemoryRingBuffer>{
+      new SharedMemoryRingBuffer{std::move(fd), mapping, capacity}};
+}
+
+SharedMemoryRingBuffer::SharedMemoryRingBuffer(orbit_base::unique_fd fd, void* mapping,
+                                               uint64_t capacity)
+    : fd_{std::move(fd)}, mapping_{mapping}, capacity_{capacity} {
+  reserved_write_position_ = GetWritePosition();
+}
+
+SharedMemoryRingBuffer::~SharedMemoryRingBuffer() {
+  if (munmap(mapping_, kDataOffset + capacity_) != 0) {
+    ERROR("munmap: %s", SafeStrerror(errno));
+  }
+}
+
+SharedMemoryRingBuffer::Header* SharedMemoryRingBuffer::GetHeader() const {
+  return static_cast<Header*>(mapping_);
+}
+
+uint64_t SharedMemoryRingBuffer::GetWritePosition() const {
+  return GetHeader()->write_position.load(std::memory_order_acquire);
+}
+
+uint64_t SharedMemoryRingBuffer::GetReadPosition() const {
+  return GetHeader()->read_position.load(std::memory_order_acquire);
+}
+
+void SharedMemoryRingBuffer::SetReadPosition(uint64_t position) {
+  // Sequentially consistent, so that it can't be reordered with the load of writer_waiting in
+  // NotifyWriter, which would miss wake-ups.
+  GetHeader()->read_position.store(position, std::memory_order_seq_cst);
+}
+
+char* SharedMemoryRingBuffer::TryReserveRecord(uint32_t type, uint32_t size) {
+  CHECK(type != kPaddingRecordType);
+  const uint64_t write_position = GetWritePosition();
+  CHECK(reserved_write_position_ == write_position);
+  const uint64_t read_position = GetReadPosition();
+  const uint64_t free_space = capacity_ - (write_position - read_position);
+  const uint64_t record_size = orbit_base::AlignUp<8>(sizeof(RecordHeader) + size);
+  const uint64_t offset = write_position & (capacity_ - 1);
+
+  uint64_t padding_size = 0;
+  if (offset + record_size > capacity_) {
+    padding_size = capacity_ - offset;
+  }
+  if (padding_size + record_size > free_space) {
+    read_position_when_full_ = read_position;
+    return nullptr;
+  }
+
+  if (padding_size > 0) {
+    RecordHeader padding_header{static_cast<uint32_t>(padding_size - sizeof(RecordHeader)),
+                                kPaddingRecordType};
+    memcpy(GetData() + offset, &padding_header, sizeof(RecordHeader));
+  }
+  const uint64_t record_offset = (write_position + padding_size) & (capacity_ - 1);
+  RecordHeader record_header{size, type};
+  memcpy(GetData() + record_offset, &record_header, sizeof(RecordHeader));
+  reserved_write_position_ = write_position + padding_size + record_size;
+  return GetData() + record_offset + sizeof(RecordHeader);
+}
+
+void SharedMemoryRingBuffer::CommitRecord() {
+  // Sequentially consistent, so that it can't be reordered with the load of reader_waiting in
+  // NotifyReader, which would miss wake-ups.
+  GetHeader()->write_position.store(reserved_write_position_, std::memory_order_seq_cst);
+}
+
+void SharedMemoryRingBuffer::NotifyReader() { WakeUpWaiter(&GetHeader()->reader_waiting); }
+
+void SharedMemoryRingBuffer::NotifyWriter() { WakeUpWaiter(&GetHeader()->writer_waiting); }
+
+bool SharedMemoryRingBuffer::WaitForFreeSpace(absl::Duration timeout) {
+  Header* header = GetHeader();
+  header->writer_waiting.store(1, std::memory_order_seq_cst);
+  if (header->read_position.load(std::memory_order_seq_cst) == read_position_when_full_) {
+    Wait(&header->writer_waiting, timeout);
+  } else {
+    header->writer_waiting.store(0, std::memory_order_seq_cst);
+  }
+  return header->read_position.load(std::memory_order_seq_cst) != read_position_when_full_;
+}
+
+void SharedMemoryRingBuffer::WaitForRecords(absl::Duration timeout) {
+  Header* header = GetHeader();
+  header->reader_waiting.store(1, std::memory_order_seq_cst);
+  if (wait_for_records_interrupted_.load(std::memory_order_seq_cst) ||
+      header->write_position.load(std::memory_order_seq_cst) !=
+          header->read_position.load(std::memory_order_seq_cst)) {
+    header->reader_waiting.store(0, std::memory_order_seq_cst);
+    return;
+  }
+  Wait(&header->reader_waiting, timeout);
+}
+
+void SharedMemoryRingBuffer::InterruptWaitForRecords() {
+  wait_for_records_interrupted_.store(true, std::memory_order_seq_cst);
+  NotifyReader();
+}
+
+}  // namespace orbit_shared_memory_transport
@@ -0,0 +1,210 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <absl/time/time.h>
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "OrbitBase/File.h"
+#include "SharedMemoryTransport/SharedMemoryRingBuffer.h"
+
+namespace orbit_shared_memory_transport {
+
+namespace {
+
+constexpr uint64_t kCapacity = 4096;
+
+std::unique_ptr<SharedMemoryRingBuffer> CreateRingBuffer() {
+  auto ring_buffer_or_error = SharedMemoryRingBuffer::Create(kCapacity);
+  EXPECT_FALSE(ring_buffer_or_error.has_error()) << ring_buffer_or_error.error().message();
+  return std::move(ring_buffer_or_error.value());
+}
+
+std::unique_ptr<SharedMemoryRingBuffer> OpenRingBuffer(const SharedMemoryRingBuffer& writer) {
+  auto ring_buffer_or_error =
+      SharedMemoryRingBuffer::Open(orbit_base::unique_fd{dup(writer.GetFd())});
+  EXPECT_FALSE(ring_buffer_or_error.has_error()) << ring_buffer_or_error.error().message();
+  return std::move(ring_buffer_or_error.value());
+}
+
+bool TryWriteUint64Record(SharedMemoryRingBuffer* ring_buffer, uint32_t type, uint64_t value) {
+  char* payload = ring_buffer->TryReserveRecord(type, sizeof(value));
+  if (payload == nullptr) {
+    return false;
+  }
+  memcpy(payload, &value, sizeof(value));
+  ring_buffer->CommitRecord();
+  return true;
+}
+
+std::vector<std::pair<uint32_t, uint64_t>> ReadUint64Records(SharedMemoryRingBuffer* ring_buffer) {
+  std::vector<std::pair<uint32_t, uint64_t>> records;
+  auto record_count_or_error =
+      ring_buffer->ReadRecords([&records](uint32_t type, absl::Span<const char> payload) {
+        EXPECT_EQ(payload.size(), sizeof(uint64_t));
+        uint64_t value;
+        memcpy(&value, payload.data(), sizeof(value));
+        records.emplace_back(type, value);
+      });
+  EXPECT_FALSE(record_count_or_error.has_error());
+  EXPECT_EQ(record_count_or_error.value(), records.size());
+  return records;
+}
+
+}  // namespace
+
+TEST(SharedMemoryRingBuffer, RecordsAreReadInOrderThroughAnotherMapping) {
+  std::unique_ptr<SharedMemoryRingBuffer> writer = CreateRingBuffer();
+  std::unique_ptr<SharedMemoryRingBuffer> reader = OpenRingBuffer(*writer);
+  EXPECT_EQ(reader->GetCapacity(), kCapacity);
+
+  EXPECT_TRUE(ReadUint64Records(reader.get()).empty());
+
+  ASSERT_TRUE(TryWriteUint64Record(writer.get(), 1, 42));
+  ASSERT_TRUE(TryWriteUint64Record(writer.get(), 2, 43));
+  EXPECT_EQ(ReadUint64Records(reader.get()),
+            (std::vector<std::pair<uint32_t, uint64_t>>{{1, 42}, {2, 43}}));
+  EXPECT_TRUE(ReadUint64Records(reader.get()).empty());
+}
+
+TEST(SharedMemoryRingBuffer, ReservedRecordIsOnlyVisibleAfterCommit) {
+  std::unique_ptr<SharedMemoryRingBuffer> writer = CreateRingBuffer();
+  std::unique_ptr<SharedMemoryRingBuffer> reader = OpenRingBuffer(*writer);
+
+  char* payload = writer->TryReserveRecord(1, sizeof(uint64_t));
+  ASSERT_NE(payload, nullptr);
+  uint64_t value = 42;
+  memcpy(payload, &value, sizeof(value));
+  EXPECT_TRUE(ReadUint64Records(reader.get()).empty());
+
+  writer->CommitRecord();
+  EXPECT_EQ(ReadUint64Records(reader.get()),
+            (std::vector<std::pair<uint32_t, uint64_t>>{{1, 42}}));
+}
+
+TEST(SharedMemoryRingBuffer, FullRingBufferRejectsRecordsUntilRead) {
+  std::unique_ptr<SharedMemoryRingBuffer> writer = CreateRingBuffer();
+  std::unique_ptr<SharedMemoryRingBuffer> reader = OpenRingBuffer(*writer);
+
+  // Each record takes 16 bytes, with its header.
+  constexpr uint64_t kRecordCount = kCapacity / 16;
+  for (uint64_t i = 0; i < kRecordCount; ++i) {
+    ASSERT_TRUE(TryWriteUint64Record(writer.get(), 1, i));
+  }
+  EXPECT_FALSE(TryWriteUint64Record(writer.get(), 1, kRecordCount));
+
+  EXPECT_EQ(ReadUint64Records(reader.get()).size(), kRecordCount);
+  EXPECT_TRUE(TryWriteUint64Record(writer.get(), 1, kRecordCount));
+}
+
+TEST(SharedMemoryRingBuffer, RecordsThatDontFitAtTheEndWrapAround) {
+  std::unique_ptr<SharedMemoryRingBuffer> writer = CreateRingBuffer();
+  std::unique_ptr<SharedMemoryRingBuffer> reader = OpenRingBuffer(*writer);
+
+  // Leave 24 bytes at the end of the buffer, not enough for a 32-byte record.
+  static constexpr uint32_t kFirstPayloadSize = kCapacity - 24 - 8;
+  ASSERT_NE(writer->TryReserveRecord(1, kFirstPayloadSize), nullptr);
+  writer->CommitRecord();
+  // The padding and the record can't fit before the first record is read.
+  EXPECT_EQ(writer->TryReserveRecord(2, 24), nullptr);
+
+  uint64_t record_count = 0;
+  ASSERT_FALSE(reader->ReadRecords([&record_count](uint32_t type, absl::Span<const char> payload) {
+                       EXPECT_EQ(type, 1);
+                       EXPECT_EQ(payload.size(), kFirstPayloadSize);
+                       ++record_count;
+                     })
+                   .has_error());
+  EXPECT_EQ(record_count, 1);
+
+  char* payload = writer->TryReserveRecord(2, 24);
+  ASSERT_NE(payload, nullptr);
+  memset(payload, 0xAB, 24);
+  writer->CommitRecord();
+
+  std::vector<uint32_t> types;
+  ASSERT_FALSE(reader->ReadRecords([&types](uint32_t type, absl::Span<const char> payload) {
+                       types.push_back(type);
+                       EXPECT_EQ(payload.size(), 24);
+                       EXPECT_EQ(static_cast<uint8_t>(payload[23]), 0xAB);
+                     })
+                   .has_error());
+  // The padding record is skipped.
+  EXPECT_EQ(types, std::vector<uint32_t>{2});
+}
+
+TEST(SharedMemoryRingBuffer, OpenFailsOnNonRingBuffer) {
+  EXPECT_TRUE(SharedMemoryRingBuffer::Open(orbit_base::unique_fd{}).has_error());
+
+  orbit_base::unique_fd fd{memfd_create("not-a-ring-buffer", MFD_CLOEXEC)};
+  ASSERT_TRUE(fd.valid());
+  EXPECT_TRUE(SharedMemoryRingBuffer::Open(std::move(fd)).has_error());
+}
+
+TEST(SharedMemoryRingBuffer, NotifyReaderWakesUpWaitForRecords) {
+  std::unique_ptr<SharedMemoryRingBuffer> writer = CreateRingBuffer();
+  std::unique_ptr<SharedMemoryRingBuffer> reader = OpenRingBuffer(*writer);
+
+  std::thread writer_thread{[&writer] {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    ASSERT_TRUE(TryWriteUint64Record(writer.get(), 1, 42));
+    writer->NotifyReader();
+  }};
+
+  std::vector<std::pair<uint32_t, uint64_t>> records;
+  absl::Time deadline = absl::Now() + absl::Seconds(10);
+  while (records.empty() && absl::Now() < deadline) {
+    reader->WaitForRecords(absl::Seconds(1));
+    records = ReadUint64Records(reader.get());
+  }
+  writer_thread.join();
+  EXPECT_EQ(records, (std::vector<std::pair<uint32_t, uint64_t>>{{1, 42}}));
+}
+
+TEST(SharedMemoryRingBuffer, InterruptWaitForRecordsWakesUpAndDisablesWaiting) {
+  std::unique_ptr<SharedMemoryRingBuffer> writer = CreateRingBuffer();
+  std::unique_ptr<SharedMemoryRingBuffer> reader = OpenRingBuffer(*writer);
+
+  std::thread interrupting_thread{[&reader] {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    reader->InterruptWaitForRecords();
+  }};
+  reader->WaitForRecords(absl::InfiniteDuration());
+  interrupting_thread.join();
+
+  // Following calls return right away.
+  reader->WaitForRecords(absl::InfiniteDuration());
+}
+
+TEST(SharedMemoryRingBuffer, WaitForFreeSpaceReturnsWhenReaderFreesSpace) {
+  std::unique_ptr<SharedMemoryRingBuffer> writer = CreateRingBuffer();
+  std::unique_ptr<SharedMemoryRingBuffer> reader = OpenRingBuffer(*writer);
+
+  static constexpr uint64_t kRecordCount = kCapacity / 16;
+  for (uint64_t i = 0; i < kRecordCount; ++i) {
+    ASSERT_TRUE(TryWriteUint64Record(writer.get(), 1, i));
+  }
+  ASSERT_FALSE(TryWriteUint64Record(writer.get(), 1, kRecordCount));
+  // Nothing is read, so no space is freed.
+  EXPECT_FALSE(writer->WaitForFreeSpace(absl::Milliseconds(1)));
+
+  std::thread reader_thread{[&reader] {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    EXPECT_EQ(ReadUint64Records(reader.get()).size(), kRecordCount);
+  }};
+  EXPECT_TRUE(writer->WaitForFreeSpace(absl::Seconds(10)));
+  reader_thread.join();
+  EXPECT_TRUE(TryWriteUint64Record(writer.get(), 1, kRecordCount));
+}
+
+}  // namespace orbit_shared_memory_transport
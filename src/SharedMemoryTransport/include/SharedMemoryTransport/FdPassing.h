@@ -0,0 +1,46 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SHARED_MEMORY_TRANSPORT_FD_PASSING_H_
+#define SHARED_MEMORY_TRANSPORT_FD_PASSING_H_
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <string_view>
+
+#include "OrbitBase/File.h"
+#include "OrbitBase/Result.h"
+
+namespace orbit_shared_memory_transport {
+
+// These functions pass a file descriptor from one process to another over a Unix domain socket,
+// with SCM_RIGHTS. Unlike reopening /proc/<pid>/fd/<fd>, this gives the receiver exactly the file
+// that the sender chose to share, and the pid of the sender is reported by the kernel, so a
+// privileged receiver can't be tricked into opening the file of another process.
+//
+// Each file descriptor is sent together with a `token`, which the sender also transmits on its
+// other channel to the receiver (e.g., the gRPC stream of a CaptureEventProducer), so that the
+// receiver can tell which file descriptor belongs to which message.
+
+struct ReceivedFd {
+  uint64_t token;
+  pid_t sender_pid;
+  orbit_base::unique_fd fd;
+};
+
+// Sends `fd` and `token` over the connected Unix domain socket `socket_fd`.
+[[nodiscard]] ErrorMessageOr<void> SendFd(int socket_fd, uint64_t token, int fd);
+
+// Connects to the Unix domain socket at `socket_path`, sends `fd` and `token`, and disconnects.
+[[nodiscard]] ErrorMessageOr<void> ConnectAndSendFd(std::string_view socket_path, uint64_t token,
+                                                    int fd);
+
+// Receives a file descriptor and its token sent with SendFd over the connected Unix domain socket
+// `socket_fd`, and the pid of the sender from the credentials of the socket.
+[[nodiscard]] ErrorMessageOr<ReceivedFd> ReceiveFd(int socket_fd);
+
+}  // namespace orbit_shared_memory_transport
+
+#endif  // SHARED_MEMORY_TRANSPORT_FD_PASSING_H_
@@ -0,0 +1,94 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SHARED_MEMORY_TRANSPORT_PRODUCER_EVENT_RECORDS_H_
+#define SHARED_MEMORY_TRANSPORT_PRODUCER_EVENT_RECORDS_H_
+
+#include <absl/types/span.h>
+
+#include <cstdint>
+#include <type_traits>
+
+#include "capture.pb.h"
+
+// Layout of the events that in-process producers write to a SharedMemoryRingBuffer, and their
+// conversion to ProducerCaptureEvents by OrbitService. The records are plain structs, so that the
+// producers only need to copy their own event structs into the ring buffer.
+namespace orbit_shared_memory_transport {
+
+// Type of each record in the ring buffer. Zero is reserved for padding records.
+enum class ProducerEventRecordType : uint32_t {
+  kFunctionCall = 1,
+  kApiScopeStart,
+  kApiScopeStop,
+  kApiScopeStartAsync,
+  kApiScopeStopAsync,
+  kApiStringEvent,
+  kApiTrackDouble,
+  kApiTrackFloat,
+  kApiTrackInt,
+  kApiTrackInt64,
+  kApiTrackUint,
+  kApiTrackUint64,
+  // A uint64_t key followed by the characters of the string, without terminator.
+  kInternedString,
+  // An ApiTrackSummaryRecord.
+  kApiTrackSummary,
+};
+
+// Same layout as the FunctionCallEvents of user space instrumentation.
+struct FunctionCallRecord {
+  int32_t pid;
+  int32_t tid;
+  uint64_t function_id;
+  uint64_t duration_ns;
+  uint64_t end_timestamp_ns;
+};
+static_assert(sizeof(FunctionCallRecord) == 32);
+
+// Shared by all the events of the Orbit API, each only uses the fields it has. The record is
+// followed by `encoded_name_additional_count` uint64_t values, for names longer than 64 characters.
+struct ApiEventRecord {
+  uint32_t pid;
+  uint32_t tid;
+  uint64_t timestamp_ns;
+  uint64_t encoded_name[8];
+  // `id` for asynchronous scopes and string events, `group_id` for synchronous scopes.
+  uint64_t id;
+  uint64_t address_in_function;
+  // The value of track events: integers are extended to 64 bits, doubles and floats are stored as
+  // the bits of their representation (for floats, in the lower 32 bits).
+  uint64_t data;
+  // If not zero, the key of the kInternedString record with the name, instead of `encoded_name`.
+  uint64_t name_key;
+  uint32_t color_rgba;
+  uint32_t encoded_name_additional_count;
+};
+static_assert(sizeof(ApiEventRecord) == 120);
+
+// Like ApiEventRecord, this is followed by `event.encoded_name_additional_count` uint64_t values.
+// `event.timestamp_ns` is the timestamp of the last value, and `event.data` is unused.
+struct ApiTrackSummaryRecord {
+  ApiEventRecord event;
+  uint64_t first_timestamp_ns;
+  double min;
+  double max;
+  double last;
+  double sum;
+  uint64_t count;
+};
+static_assert(sizeof(ApiTrackSummaryRecord) == 168);
+
+static_assert(std::is_trivially_copyable_v<FunctionCallRecord>);
+static_assert(std::is_trivially_copyable_v<ApiEventRecord>);
+static_assert(std::is_trivially_copyable_v<ApiTrackSummaryRecord>);
+
+// Converts a record read from a SharedMemoryRingBuffer to the equivalent ProducerCaptureEvent.
+// Returns false if the type or size of the record are invalid.
+[[nodiscard]] bool DecodeProducerEventRecord(uint32_t type, absl::Span<const char> payload,
+                                             orbit_grpc_protos::ProducerCaptureEvent* event);
+
+}  // namespace orbit_shared_memory_transport
+
+#endif  // SHARED_MEMORY_TRANSPORT_PRODUCER_EVENT_RECORDS_H_
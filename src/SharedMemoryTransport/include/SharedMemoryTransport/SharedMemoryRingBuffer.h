@@ -0,0 +1,162 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SHARED_MEMORY_TRANSPORT_SHARED_MEMORY_RING_BUFFER_H_
+#define SHARED_MEMORY_TRANSPORT_SHARED_MEMORY_RING_BUFFER_H_
+
+#include <absl/time/time.h>
+#include <absl/types/span.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "OrbitBase/Align.h"
+#include "OrbitBase/File.h"
+#include "OrbitBase/Logging.h"
+#include "OrbitBase/Result.h"
+
+namespace orbit_shared_memory_transport {
+
+// Single-producer single-consumer ring buffer of variable-size records, in memory shared between
+// two processes. It lets an in-process producer (e.g., the Orbit API in the target) pass its events
+// to OrbitService as plain structs, without building and serializing protobufs, and without going
+// through gRPC.
+//
+// The writer creates the ring buffer on a memfd with Create. The reader maps the same memory with
+// Open, on the memfd that the writer passed to it (see FdPassing.h). Both sides only synchronize
+// through atomics in the shared memory, and each side can block on a futex until the other one
+// makes progress: the reader until records are committed, the writer until space is freed.
+//
+// Each record consists of an 8-byte header (payload size and type) followed by the payload, padded
+// to 8 bytes. A record never wraps around the end of the buffer: when it wouldn't fit, the rest of
+// the buffer is skipped with a padding record.
+class SharedMemoryRingBuffer {
+ public:
+  // Record type reserved for the padding records, never passed to the reader's callback.
+  static constexpr uint32_t kPaddingRecordType = 0;
+
+  // `capacity` must be a power of 2 and a multiple of the page size.
+  [[nodiscard]] static ErrorMessageOr<std::unique_ptr<SharedMemoryRingBuffer>> Create(
+      uint64_t capacity);
+  // Maps the ring buffer created by another process, whose memfd is `fd`.
+  [[nodiscard]] static ErrorMessageOr<std::unique_ptr<SharedMemoryRingBuffer>> Open(
+      orbit_base::unique_fd fd);
+
+  SharedMemoryRingBuffer(const SharedMemoryRingBuffer&) = delete;
+  SharedMemoryRingBuffer& operator=(const SharedMemoryRingBuffer&) = delete;
+  SharedMemoryRingBuffer(SharedMemoryRingBuffer&&) = delete;
+  SharedMemoryRingBuffer& operator=(SharedMemoryRingBuffer&&) = delete;
+  ~SharedMemoryRingBuffer();
+
+  [[nodiscard]] int GetFd() const { return fd_.get(); }
+  [[nodiscard]] uint64_t GetCapacity() const { return capacity_; }
+
+  // Writer side. Reserves space for a record with a payload of `size` bytes, and returns where the
+  // payload needs to be written, or nullptr if the ring buffer doesn't have enough free space. The
+  // record only becomes visible to the reader with CommitRecord.
+  [[nodiscard]] char* TryReserveRecord(uint32_t type, uint32_t size);
+  void CommitRecord();
+  // Wakes up the reader if it is blocked in WaitForRecords. Call it after committing a batch of
+  // records, rather than after each of them, as it can result in a system call.
+  void NotifyReader();
+  // Blocks until the reader frees some space after the last TryReserveRecord that returned nullptr,
+  // or `timeout` expires. Returns whether space was freed.
+  [[nodiscard]] bool WaitForFreeSpace(absl::Duration timeout);
+
+  // Reader side. Calls `callback(uint32_t type, absl::Span<const char> payload)` for each committed
+  // record, then frees their space. Returns the number of records read, or an error if the content
+  // of the ring buffer is inconsistent, as the memory is writable by the other process.
+  template <typename Callback>
+  [[nodiscard]] ErrorMessageOr<uint64_t> ReadRecords(Callback&& callback);
+  // Blocks until there are committed records to read, NotifyReader is called, or `timeout` expires,
+  // which can be absl::InfiniteDuration(). Returns immediately after InterruptWaitForRecords.
+  void WaitForRecords(absl::Duration timeout);
+  // Makes the current and all following calls to WaitForRecords return immediately, e.g., so that
+  // a thread that waits for records without a timeout can exit.
+  void InterruptWaitForRecords();
+
+ private:
+  struct Header;
+  struct RecordHeader {
+    uint32_t size;
+    uint32_t type;
+  };
+  static_assert(sizeof(RecordHeader) == 8);
+
+  SharedMemoryRingBuffer(orbit_base::unique_fd fd, void* mapping, uint64_t capacity);
+
+  [[nodiscard]] Header* GetHeader() const;
+  [[nodiscard]] char* GetData() const { return static_cast<char*>(mapping_) + kDataOffset; }
+  [[nodiscard]] uint64_t GetWritePosition() const;
+  [[nodiscard]] uint64_t GetReadPosition() const;
+  void SetReadPosition(uint64_t position);
+  // Wakes up the writer if it is blocked in WaitForFreeSpace.
+  void NotifyWriter();
+
+  // The header occupies the first page of the mapping, the data starts right after it.
+  static constexpr uint64_t kDataOffset = 4096;
+
+  orbit_base::unique_fd fd_;
+  void* mapping_;
+  uint64_t capacity_;
+  // Only used by the writer: end of the record reserved but not yet committed.
+  uint64_t reserved_write_position_ = 0;
+  // Only used by the writer: read position when TryReserveRecord last found the buffer full.
+  uint64_t read_position_when_full_ = 0;
+  // Only used by the reader. Local to this process, unlike the header.
+  std::atomic<bool> wait_for_records_interrupted_ = false;
+};
+
+template <typename Callback>
+ErrorMessageOr<uint64_t> SharedMemoryRingBuffer::ReadRecords(Callback&& callback) {
+  const uint64_t write_position = GetWritePosition();
+  uint64_t read_position = GetReadPosition();
+  if (write_position < read_position || write_position - read_position > capacity_) {
+    return ErrorMessage{"Inconsistent positions in shared memory ring buffer"};
+  }
+
+  uint64_t record_count = 0;
+  // The writer might be waiting for space while a long sequence of records is processed, so wake
+  // it up every time a part of the buffer is freed, not only at the end.
+  const uint64_t notify_writer_interval = capacity_ / 8;
+  uint64_t last_notified_read_position = read_position;
+  while (read_position < write_position) {
+    const uint64_t offset = read_position & (capacity_ - 1);
+    if (offset + sizeof(RecordHeader) > capacity_ ||
+        write_position - read_position < sizeof(RecordHeader)) {
+      return ErrorMessage{"Truncated record header in shared memory ring buffer"};
+    }
+    RecordHeader record_header;
+    memcpy(&record_header, GetData() + offset, sizeof(RecordHeader));
+    const uint64_t record_size = orbit_base::AlignUp<8>(sizeof(RecordHeader) + record_header.size);
+    if (offset + record_size > capacity_ || record_size > write_position - read_position) {
+      return ErrorMessage{"Truncated record in shared memory ring buffer"};
+    }
+
+    if (record_header.type != kPaddingRecordType) {
+      callback(record_header.type,
+               absl::MakeConstSpan(GetData() + offset + sizeof(RecordHeader), record_header.size));
+      ++record_count;
+    }
+    read_position += record_size;
+    // Free the space of each record right away, so that the writer can reuse it while the
+    // following records are processed.
+    SetReadPosition(read_position);
+    if (read_position - last_notified_read_position >= notify_writer_interval) {
+      NotifyWriter();
+      last_notified_read_position = read_position;
+    }
+  }
+  if (read_position != last_notified_read_position) {
+    NotifyWriter();
+  }
+  return record_count;
+}
+
+}  // namespace orbit_shared_memory_transport
+
+#endif  // SHARED_MEMORY_TRANSPORT_SHARED_MEMORY_RING_BUFFER_H_
@@ -14,6 +14,9 @@ class TracerListener {
   virtual ~TracerListener() = default;
   virtual void OnSchedulingSlice(orbit_grpc_protos::SchedulingSlice scheduling_slice) = 0;
   virtual void OnCallstackSample(orbit_grpc_protos::FullCallstackSample callstack_sample) = 0;
+  // Callstacks can also be sent only once each, followed by samples that refer to them by key.
+  virtual void OnInternedCallstack(orbit_grpc_protos::InternedCallstack interned_callstack) = 0;
+  virtual void OnInternedCallstackSample(orbit_grpc_protos::CallstackSample callstack_sample) = 0;
   virtual void OnFunctionCall(orbit_grpc_protos::FunctionCall function_call) = 0;
   virtual void OnGpuJob(orbit_grpc_protos::FullGpuJob gpu_job) = 0;
   virtual void OnThreadName(orbit_grpc_protos::ThreadName thread_name) = 0;
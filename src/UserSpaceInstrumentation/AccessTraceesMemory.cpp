@@ -8,8 +8,11 @@
 #include <absl/strings/numbers.h>
 #include <absl/strings/str_format.h>
 #include <absl/strings/str_split.h>
+#include <limits.h>
 #include <sys/ptrace.h>
+#include <sys/uio.h>
 
+#include <algorithm>
 #include <cerrno>
 #include <cstring>
 #include <string>
@@ -53,6 +56,83 @@ using orbit_base::ReadFileToString;
   return outcome::success();
 }
 
+[[nodiscard]] ErrorMessageOr<std::vector<std::vector<uint8_t>>> ReadTraceesMemoryBatch(
+    pid_t pid, const std::vector<AddressRange>& ranges) {
+  std::vector<std::vector<uint8_t>> result(ranges.size());
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    CHECK(ranges[i].end > ranges[i].start);
+    result[i].resize(ranges[i].end - ranges[i].start);
+  }
+
+  size_t next_range = 0;
+  while (next_range < ranges.size()) {
+    const size_t batch_size = std::min<size_t>(IOV_MAX, ranges.size() - next_range);
+    std::vector<iovec> local_iov(batch_size);
+    std::vector<iovec> remote_iov(batch_size);
+    for (size_t i = 0; i < batch_size; ++i) {
+      std::vector<uint8_t>& bytes = result[next_range + i];
+      local_iov[i] = {bytes.data(), bytes.size()};
+      remote_iov[i] = {absl::bit_cast<void*>(ranges[next_range + i].start), bytes.size()};
+    }
+    const ssize_t bytes_read = process_vm_readv(pid, local_iov.data(), batch_size,
+                                                remote_iov.data(), batch_size, /*flags=*/0);
+
+    // process_vm_readv stops at the first range it can't read. Skip the ranges read completely.
+    size_t remaining_bytes = bytes_read > 0 ? static_cast<size_t>(bytes_read) : 0;
+    size_t ranges_read = 0;
+    while (ranges_read < batch_size && remaining_bytes >= local_iov[ranges_read].iov_len) {
+      remaining_bytes -= local_iov[ranges_read].iov_len;
+      ++ranges_read;
+    }
+    next_range += ranges_read;
+    if (ranges_read == batch_size) continue;
+
+    // Read the range that failed through the memory file. This either succeeds (e.g. when
+    // process_vm_readv is not permitted) or gives us a meaningful error message.
+    const AddressRange& range = ranges[next_range];
+    OUTCOME_TRY(auto&& bytes, ReadTraceesMemory(pid, range.start, range.end - range.start));
+    result[next_range] = std::move(bytes);
+    ++next_range;
+  }
+
+  return result;
+}
+
+[[nodiscard]] ErrorMessageOr<void> WriteTraceesMemoryBatch(pid_t pid,
+                                                           std::vector<TraceesMemoryWrite> writes) {
+  if (writes.empty()) return outcome::success();
+
+  std::sort(writes.begin(), writes.end(),
+            [](const TraceesMemoryWrite& lhs, const TraceesMemoryWrite& rhs) {
+              return lhs.start_address < rhs.start_address;
+            });
+  // Merge writes to adjacent addresses.
+  std::vector<TraceesMemoryWrite> merged_writes;
+  for (TraceesMemoryWrite& write : writes) {
+    CHECK(!write.bytes.empty());
+    if (!merged_writes.empty()) {
+      TraceesMemoryWrite& previous = merged_writes.back();
+      if (previous.start_address + previous.bytes.size() > write.start_address) {
+        return ErrorMessage(absl::StrFormat("Overlapping writes to memory of process %d at %#x.",
+                                            pid, write.start_address));
+      }
+      if (previous.start_address + previous.bytes.size() == write.start_address) {
+        previous.bytes.insert(previous.bytes.end(), write.bytes.begin(), write.bytes.end());
+        continue;
+      }
+    }
+    merged_writes.push_back(std::move(write));
+  }
+
+  OUTCOME_TRY(auto&& fd, orbit_base::OpenFileForWriting(absl::StrFormat("/proc/%d/mem", pid)));
+  for (const TraceesMemoryWrite& write : merged_writes) {
+    OUTCOME_TRY(
+        WriteFullyAtOffset(fd, write.bytes.data(), write.bytes.size(), write.start_address));
+  }
+
+  return outcome::success();
+}
+
 [[nodiscard]] ErrorMessageOr<AddressRange> GetFirstExecutableMemoryRegion(
     pid_t pid, uint64_t exclude_address) {
   OUTCOME_TRY(auto&& maps, ReadFileToString(absl::StrFormat("/proc/%d/maps", pid)));
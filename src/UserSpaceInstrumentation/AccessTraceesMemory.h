@@ -26,6 +26,29 @@ namespace orbit_user_space_instrumentation {
 [[nodiscard]] ErrorMessageOr<void> WriteTraceesMemory(pid_t pid, uint64_t start_address,
                                                       const std::vector<uint8_t>& bytes);
 
+// Read the memory of all `ranges` from process `pid`. The result contains the bytes of each range
+// in the order of `ranges`. Uses `process_vm_readv` to read many ranges with a single syscall and
+// falls back to `ReadTraceesMemory` for ranges that it can't read completely.
+// Assumes we are already attached to the tracee `pid` e.g. using `AttachAndStopProcess`.
+[[nodiscard]] ErrorMessageOr<std::vector<std::vector<uint8_t>>> ReadTraceesMemoryBatch(
+    pid_t pid, const std::vector<AddressRange>& ranges);
+
+struct TraceesMemoryWrite {
+  uint64_t start_address;
+  std::vector<uint8_t> bytes;
+};
+
+// Write all of `writes` into memory of process `pid`. The memory file of the process is only
+// opened once and writes to adjacent addresses are merged into a single write. Returns an error if
+// `writes` overlap. The writes are done in the order of their addresses, not in the order of
+// `writes`, and an error can occur after some of them have been done: writes that depend on each
+// other need to go in separate batches.
+// Note that, unlike `process_vm_writev`, writing through the memory file ignores the protection of
+// the pages. This is needed to patch the code of the tracee.
+// Assumes we are already attached to the tracee `pid` e.g. using `AttachAndStopProcess`.
+[[nodiscard]] ErrorMessageOr<void> WriteTraceesMemoryBatch(pid_t pid,
+                                                           std::vector<TraceesMemoryWrite> writes);
+
 // Returns the address range of the first executable memory region. In every case I encountered this
 // was the second line in the `maps` file corresponding to the code of the process we look at.
 // However we don't really care. So keeping it general and just searching for an executable region
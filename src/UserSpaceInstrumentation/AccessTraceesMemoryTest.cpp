@@ -204,4 +204,68 @@ TEST(AccessTraceesMemoryTest, ReadWriteRestore) {
   waitpid(pid, NULL, 0);
 }
 
-}  // namespace orbit_user_space_instrumentation
\ No newline at end of file
+TEST(AccessTraceesMemoryTest, BatchReadWriteRestore) {
+  pid_t pid = fork();
+  CHECK(pid != -1);
+  if (pid == 0) {
+    // Child just runs an endless loop.
+    while (true) {
+    }
+  }
+
+  // Stop the child process using our tooling.
+  CHECK(!AttachAndStopProcess(pid).has_error());
+
+  auto memory_region_or_error = GetFirstExecutableMemoryRegion(pid);
+  CHECK(memory_region_or_error.has_value());
+  const uint64_t address = memory_region_or_error.value().start;
+
+  constexpr uint64_t kMemorySize = 4 * 1024;
+  auto backup = ReadTraceesMemory(pid, address, kMemorySize);
+  ASSERT_TRUE(backup.has_value());
+
+  // Read some ranges, including adjacent ones, in one batch.
+  const std::vector<AddressRange> ranges = {
+      {address + 100, address + 120}, {address, address + 10}, {address + 10, address + 30}};
+  auto batch_or_error = ReadTraceesMemoryBatch(pid, ranges);
+  ASSERT_TRUE(batch_or_error.has_value());
+  ASSERT_EQ(batch_or_error.value().size(), ranges.size());
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    const auto begin = backup.value().begin() + (ranges[i].start - address);
+    EXPECT_EQ(batch_or_error.value()[i],
+              std::vector<uint8_t>(begin, begin + (ranges[i].end - ranges[i].start)));
+  }
+
+  // Reading a bad address fails.
+  EXPECT_THAT(ReadTraceesMemoryBatch(pid, {{address, address + 10}, {0, 10}}),
+              HasError("Input/output error"));
+
+  // Write adjacent and separate chunks to the (non-writable) code.
+  std::vector<TraceesMemoryWrite> writes = {{address + 100, std::vector<uint8_t>(20, 0x01)},
+                                            {address, std::vector<uint8_t>(10, 0x02)},
+                                            {address + 10, std::vector<uint8_t>(20, 0x03)}};
+  ASSERT_FALSE(WriteTraceesMemoryBatch(pid, writes).has_error());
+  auto read_back_or_error = ReadTraceesMemory(pid, address, kMemorySize);
+  ASSERT_TRUE(read_back_or_error.has_value());
+  std::vector<uint8_t> expected = backup.value();
+  std::fill(expected.begin() + 100, expected.begin() + 120, 0x01);
+  std::fill(expected.begin(), expected.begin() + 10, 0x02);
+  std::fill(expected.begin() + 10, expected.begin() + 30, 0x03);
+  EXPECT_EQ(expected, read_back_or_error.value());
+
+  // Overlapping writes are rejected before anything is written.
+  writes = {{address, std::vector<uint8_t>(10, 0x04)},
+            {address + 5, std::vector<uint8_t>(10, 0x05)}};
+  EXPECT_THAT(WriteTraceesMemoryBatch(pid, writes), HasError("Overlapping writes"));
+  read_back_or_error = ReadTraceesMemory(pid, address, kMemorySize);
+  ASSERT_TRUE(read_back_or_error.has_value());
+  EXPECT_EQ(expected, read_back_or_error.value());
+
+  // Restore, detach and end child.
+  CHECK(WriteTraceesMemory(pid, address, backup.value()).has_value());
+  CHECK(!DetachAndContinueProcess(pid).has_error());
+  kill(pid, SIGKILL);
+  waitpid(pid, NULL, 0);
+}
+
+}  // namespace orbit_user_space_instrumentation
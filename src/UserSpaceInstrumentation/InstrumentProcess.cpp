@@ -5,11 +5,21 @@
 #include "UserSpaceInstrumentation/InstrumentProcess.h"
 
 #include <absl/base/casts.h>
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
 #include <dlfcn.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <filesystem>
+#include <limits>
 #include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 #include "AccessTraceesMemory.h"
@@ -33,19 +43,47 @@ namespace {
 using orbit_grpc_protos::CaptureOptions;
 using orbit_grpc_protos::ModuleInfo;
 
-ErrorMessageOr<std::filesystem::path> GetLibraryPath() {
-  // When packaged, liborbituserspaceinstrumentation.so is found alongside OrbitService. In
-  // development, it is found in "../lib", relative to OrbitService.
-  constexpr const char* kLibName = "liborbituserspaceinstrumentation.so";
+constexpr const char* kLibName = "liborbituserspaceinstrumentation.so";
+constexpr const char* kFastPathLibName = "liborbituserspaceinstrumentationfastpath.so";
+
+ErrorMessageOr<std::filesystem::path> GetLibraryPath(std::string_view lib_name) {
+  // When packaged, the libraries are found alongside OrbitService. In development, they are found
+  // in "../lib", relative to OrbitService.
   const std::filesystem::path exe_dir = orbit_base::GetExecutableDir();
-  std::vector<std::filesystem::path> potential_paths = {exe_dir / kLibName,
-                                                        exe_dir / ".." / "lib" / kLibName};
+  std::vector<std::filesystem::path> potential_paths = {exe_dir / lib_name,
+                                                        exe_dir / ".." / "lib" / lib_name};
   for (const auto& path : potential_paths) {
     if (std::filesystem::exists(path)) {
       return path;
     }
   }
-  return ErrorMessage(absl::StrFormat("%s not found on system.", kLibName));
+  return ErrorMessage(absl::StrFormat("%s not found on system.", lib_name));
+}
+
+// Loads the library holding the stack pointers the fast path of the trampolines accesses, and
+// makes the payloads in the library at `library_handle` use them. Returns their offset from the
+// thread pointer. Loading the library can fail when the process has little static TLS left, in
+// which case the trampolines need to always call the entry payload.
+ErrorMessageOr<int32_t> EnableFastPathInTracee(pid_t pid, void* library_handle) {
+  OUTCOME_TRY(auto&& fast_path_library_path, GetLibraryPath(kFastPathLibName));
+  OUTCOME_TRY(auto&& fast_path_library_handle,
+              DlopenInTracee(pid, fast_path_library_path, RTLD_NOW));
+  OUTCOME_TRY(auto&& tls_offset, ExecuteInProcess(pid, fast_path_library_handle,
+                                                  "GetOpenFunctionCallStackTlsOffset"));
+  const auto signed_tls_offset = absl::bit_cast<int64_t>(tls_offset);
+  if (tls_offset == 0 || signed_tls_offset < std::numeric_limits<int32_t>::min() ||
+      signed_tls_offset > std::numeric_limits<int32_t>::max()) {
+    return ErrorMessage(absl::StrFormat("Unexpected TLS offset %#x.", tls_offset));
+  }
+  OUTCOME_TRY(auto&& get_open_function_call_stack_function,
+              DlsymInTracee(pid, fast_path_library_handle, "GetOpenFunctionCallStack"));
+  OUTCOME_TRY(auto&& enabled,
+              ExecuteInProcess(pid, library_handle, "EnableFastPath",
+                               absl::bit_cast<uint64_t>(get_open_function_call_stack_function)));
+  if (enabled == 0) {
+    return ErrorMessage("The timestamp counter of the cpu is not invariant.");
+  }
+  return static_cast<int32_t>(signed_tls_offset);
 }
 
 bool ProcessWithPidExists(pid_t pid) {
@@ -55,6 +93,85 @@ bool ProcessWithPidExists(pid_t pid) {
   return result.value();
 }
 
+ErrorMessageOr<csh> OpenCapstone() {
+  csh capstone_handle = 0;
+  cs_err error_code = cs_open(CS_ARCH_X86, CS_MODE_64, &capstone_handle);
+  if (error_code != CS_ERR_OK) {
+    return ErrorMessage("Failed to open Capstone disassembler.");
+  }
+  error_code = cs_option(capstone_handle, CS_OPT_DETAIL, CS_OPT_ON);
+  if (error_code != CS_ERR_OK) {
+    cs_close(&capstone_handle);
+    return ErrorMessage("Failed to configure Capstone disassembler.");
+  }
+  return capstone_handle;
+}
+
+// A trampoline to be created for the function at `function_address` in the current call to
+// `InstrumentFunctions`.
+struct NewTrampoline {
+  uint64_t function_address = 0;
+  std::string module_file_path;
+  uint64_t trampoline_address = 0;
+  uint64_t backup_size = 0;
+  // Filled in by `ReadTraceesMemoryBatch`.
+  std::vector<uint8_t> function_data;
+  // Filled in by `AssembleTrampolines`.
+  std::optional<ErrorMessage> error;
+  uint64_t address_after_prologue = 0;
+  std::vector<uint8_t> code;
+  absl::flat_hash_map<uint64_t, uint64_t> relocation_map;
+};
+
+// Assembles `new_trampolines` in parallel. Assembling does not access the tracee; it is only
+// disassembling and relocating the prologues. Each thread uses its own Capstone handle.
+ErrorMessageOr<void> AssembleTrampolines(
+    std::vector<NewTrampoline>& new_trampolines, uint64_t entry_payload_function_address,
+    uint64_t return_trampoline_address,
+    std::optional<int32_t> open_function_call_stack_tls_offset) {
+  // Below this number of trampolines per thread, starting the thread costs more than it saves.
+  constexpr size_t kMinTrampolinesPerThread = 256;
+  const size_t max_num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+  const size_t num_threads =
+      std::clamp<size_t>(new_trampolines.size() / kMinTrampolinesPerThread, 1, max_num_threads);
+
+  std::vector<csh> capstone_handles;
+  orbit_base::unique_resource close_on_exit{&capstone_handles, [](std::vector<csh>* handles) {
+                                              for (csh& handle : *handles) cs_close(&handle);
+                                            }};
+  for (size_t i = 0; i < num_threads; ++i) {
+    OUTCOME_TRY(auto&& capstone_handle, OpenCapstone());
+    capstone_handles.push_back(capstone_handle);
+  }
+
+  std::atomic<size_t> next_index = 0;
+  auto assemble = [&](csh capstone_handle) {
+    for (size_t i = next_index++; i < new_trampolines.size(); i = next_index++) {
+      NewTrampoline& new_trampoline = new_trampolines[i];
+      auto address_after_prologue_or_error = AssembleTrampoline(
+          new_trampoline.function_address, new_trampoline.function_data,
+          new_trampoline.trampoline_address, entry_payload_function_address,
+          return_trampoline_address, open_function_call_stack_tls_offset, capstone_handle,
+          new_trampoline.relocation_map, new_trampoline.code);
+      if (address_after_prologue_or_error.has_error()) {
+        new_trampoline.error = address_after_prologue_or_error.error();
+      } else {
+        new_trampoline.address_after_prologue = address_after_prologue_or_error.value();
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_threads; ++i) {
+    threads.emplace_back(assemble, capstone_handles[i]);
+  }
+  assemble(capstone_handles[0]);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return outcome::success();
+}
+
 }  // namespace
 
 // Holds all the data necessary to keep track of a process we instrument.
@@ -82,9 +199,16 @@ class InstrumentedProcess {
   // have been instrumented previously.
   [[nodiscard]] ErrorMessageOr<void> UninstrumentFunctions();
 
+  // Makes the payloads stop producing events, while the functions stay instrumented.
+  [[nodiscard]] ErrorMessageOr<void> StopCapture();
+
   // Returns the pid of the process.
   [[nodiscard]] pid_t GetPid() const { return pid_; }
 
+  // True if the last call to `InstrumentFunctions` asked to keep the functions instrumented after
+  // the capture (see `CaptureOptions::user_space_instrumentation_persistent`).
+  [[nodiscard]] bool IsPersistent() const { return persistent_; }
+
  private:
   InstrumentedProcess() = default;
 
@@ -92,24 +216,33 @@ class InstrumentedProcess {
   // identified by `address_range`. Handles the allocation in the tracee and the tracks the
   // allocated memory in `trampolines_for_modules_` below.
   [[nodiscard]] ErrorMessageOr<uint64_t> GetTrampolineMemory(AddressRange address_range);
-  // Releases the address previously obtained by `GetTrampolineMemory` such that it can be reused.
-  // Note that this must only be called once for each call to `GetTrampolineMemory`.
-  [[nodiscard]] ErrorMessageOr<void> ReleaseMostRecentlyAllocatedTrampolineMemory(
-      AddressRange address_range);
+
+  // Returns the original bytes of the function at `function_address` that the jump into its
+  // trampoline overwrites.
+  [[nodiscard]] std::vector<uint8_t> GetOverwrittenPrologue(uint64_t function_address) const;
+
+  // Forgets the trampolines, and the instrumentation, of the functions in modules that were
+  // unloaded since they were instrumented: their addresses could now belong to other code, which we
+  // must not overwrite with the original prologues. `modules` are the modules currently loaded.
+  void RemoveFunctionsOfUnloadedModules(const std::vector<ModuleInfo>& modules);
 
   [[nodiscard]] ErrorMessageOr<void> EnsureTrampolinesWritable();
   [[nodiscard]] ErrorMessageOr<void> EnsureTrampolinesExecutable();
 
-  [[nodiscard]] ErrorMessageOr<std::vector<ModuleInfo>> ModulesFromModulePath(std::string path);
-
   pid_t pid_ = -1;
+  bool persistent_ = false;
 
   uint64_t start_new_capture_function_address_ = 0;
+  uint64_t stop_capture_function_address_ = 0;
   uint64_t entry_payload_function_address_ = 0;
   uint64_t exit_payload_function_address_ = 0;
 
   uint64_t return_trampoline_address_ = 0;
 
+  // Offset of the stack of open function calls of the injected library from the thread pointer. Set
+  // if the trampolines of this process have the fast path (see `CreateTrampoline`).
+  std::optional<int32_t> open_function_call_stack_tls_offset_;
+
   // Keep track of each relocated instruction that has been moved into a trampoline. Used to move
   // the instruction pointers out of overwritten memory areas after the instrumentation has been
   // done.
@@ -117,6 +250,7 @@ class InstrumentedProcess {
 
   // Keep track of all trampolines we created for this process.
   struct TrampolineData {
+    std::string module_file_path;
     uint64_t trampoline_address;
     uint64_t address_after_prologue;
     // The first few bytes of the function. Guaranteed to contain everything that was overwritten.
@@ -142,13 +276,10 @@ class InstrumentedProcess {
   using TrampolineMemoryChunks = std::vector<TrampolineMemoryChunk>;
   absl::flat_hash_map<AddressRange, TrampolineMemoryChunks> trampolines_for_modules_;
 
-  // Map path of a module in the process to all loaded instances of that module (usually there will
-  // only be one, but a module can be loaded more than once).
-  absl::flat_hash_map<std::string, std::vector<ModuleInfo>> modules_from_path_;
-
-  // When instrumenting a function we record the address here. This is used when we uninstrument: we
-  // look up the original bytes in `trampoline_map_` above.
-  absl::flat_hash_set<uint64_t> addresses_of_instrumented_functions_;
+  // Maps the address of each function whose prologue is currently overwritten with the jump into
+  // its trampoline to the function id in that trampoline. When we uninstrument, we look up the
+  // original bytes in `trampoline_map_` above.
+  absl::flat_hash_map<uint64_t, uint64_t> function_id_from_instrumented_address_;
 };
 
 ErrorMessageOr<std::unique_ptr<InstrumentedProcess>> InstrumentedProcess::Create(
@@ -164,7 +295,7 @@ ErrorMessageOr<std::unique_ptr<InstrumentedProcess>> InstrumentedProcess::Create
                                              }};
 
   // Inject library into target process.
-  auto library_path_or_error = GetLibraryPath();
+  auto library_path_or_error = GetLibraryPath(kLibName);
   if (library_path_or_error.has_error()) {
     return ErrorMessage(absl::StrFormat("Unable to get path to library: %s",
                                         library_path_or_error.error().message()));
@@ -180,12 +311,17 @@ ErrorMessageOr<std::unique_ptr<InstrumentedProcess>> InstrumentedProcess::Create
 
   // Get function pointers into the injected library.
   constexpr const char* kStartNewCaptureFunctionName = "StartNewCapture";
+  constexpr const char* kStopCaptureFunctionName = "StopCapture";
   constexpr const char* kEntryPayloadFunctionName = "EntryPayload";
   constexpr const char* kExitPayloadFunctionName = "ExitPayload";
   OUTCOME_TRY(auto&& start_new_capture_function_address,
               DlsymInTracee(pid, library_handle, kStartNewCaptureFunctionName));
   process->start_new_capture_function_address_ =
       absl::bit_cast<uint64_t>(start_new_capture_function_address);
+  OUTCOME_TRY(auto&& stop_capture_function_address,
+              DlsymInTracee(pid, library_handle, kStopCaptureFunctionName));
+  process->stop_capture_function_address_ =
+      absl::bit_cast<uint64_t>(stop_capture_function_address);
   OUTCOME_TRY(auto&& entry_payload_function_address,
               DlsymInTracee(pid, library_handle, kEntryPayloadFunctionName));
   process->entry_payload_function_address_ =
@@ -202,37 +338,52 @@ ErrorMessageOr<std::unique_ptr<InstrumentedProcess>> InstrumentedProcess::Create
                                        process->return_trampoline_address_);
   OUTCOME_TRY(return_trampoline_memory->EnsureMemoryExecutable());
 
+  // The fast path is decided once per process: all trampolines of a process share the layout.
+  if (capture_options.user_space_instrumentation_fast_path()) {
+    auto tls_offset_or_error = EnableFastPathInTracee(pid, library_handle);
+    if (tls_offset_or_error.has_value()) {
+      process->open_function_call_stack_tls_offset_ = tls_offset_or_error.value();
+    } else {
+      LOG("Fast path of user space instrumentation is not available in process %d: %s", pid,
+          tls_offset_or_error.error().message());
+    }
+  }
+
   return process;
 }
 
 ErrorMessageOr<absl::flat_hash_set<uint64_t>> InstrumentedProcess::InstrumentFunctions(
     const CaptureOptions& capture_options) {
+  // The process is stopped from here on. Instrumenting is done in phases such that each phase
+  // accesses the tracee only a few times, and we log how long each of the phases takes.
+  const absl::Time stop_time = absl::Now();
   OUTCOME_TRY(AttachAndStopProcess(pid_));
   orbit_base::unique_resource detach_on_exit{pid_, [](int32_t pid) {
                                                if (DetachAndContinueProcess(pid).has_error()) {
                                                  ERROR("Detaching from %i", pid);
                                                }
                                              }};
-  // Init Capstone disassembler.
-  csh capstone_handle = 0;
-  cs_err error_code = cs_open(CS_ARCH_X86, CS_MODE_64, &capstone_handle);
-  if (error_code != CS_ERR_OK) {
-    return ErrorMessage("Failed to open Capstone disassembler.");
-  }
-  error_code = cs_option(capstone_handle, CS_OPT_DETAIL, CS_OPT_ON);
-  if (error_code != CS_ERR_OK) {
-    return ErrorMessage("Failed to configure Capstone disassembler.");
-  }
-  orbit_base::unique_resource close_on_exit{
-      &capstone_handle, [](csh* capstone_handle) { cs_close(capstone_handle); }};
 
   OUTCOME_TRY(ExecuteInProcess(pid_, absl::bit_cast<void*>(start_new_capture_function_address_)));
+  persistent_ = capture_options.user_space_instrumentation_persistent();
+
+  // Read the modules of the process once. Map the path of a module to all loaded instances of that
+  // module (usually there will only be one, but a module can be loaded more than once).
+  OUTCOME_TRY(auto&& modules, orbit_object_utils::ReadModules(pid_));
+  RemoveFunctionsOfUnloadedModules(modules);
+  absl::flat_hash_map<std::string, std::vector<ModuleInfo>> modules_from_path;
+  for (ModuleInfo& module : modules) {
+    modules_from_path[module.file_path()].push_back(std::move(module));
+  }
 
-  OUTCOME_TRY(EnsureTrampolinesWritable());
-
-  absl::flat_hash_set<uint64_t> instrumented_function_ids;
+  // Compute the address of each instance of each function and allocate trampolines for the
+  // functions we did not instrument before. If a function is instrumented more than once, the last
+  // function id wins.
+  absl::flat_hash_map<uint64_t, uint64_t> function_id_from_address;
+  absl::flat_hash_map<uint64_t, std::string> function_name_from_address;
+  std::vector<NewTrampoline> new_trampolines;
+  absl::flat_hash_map<uint64_t, size_t> new_trampoline_index_from_address;
   for (const auto& function : capture_options.instrumented_functions()) {
-    const uint64_t function_id = function.function_id();
     constexpr uint64_t kMaxFunctionPrologueBackupSize = 20;
     const uint64_t backup_size = std::min(kMaxFunctionPrologueBackupSize, function.function_size());
     if (backup_size == 0) {
@@ -240,13 +391,16 @@ ErrorMessageOr<absl::flat_hash_set<uint64_t>> InstrumentedProcess::InstrumentFun
       ERROR("Can't instrument function \"%s\" since it has size zero.", function.function_name());
       continue;
     }
-    // Get all modules with the right path (usually one, but might be more) and get a function
-    // address to instrument for each of them.
-    OUTCOME_TRY(auto&& modules, ModulesFromModulePath(function.file_path()));
-    for (const auto& module : modules) {
+    auto modules_it = modules_from_path.find(function.file_path());
+    if (modules_it == modules_from_path.end()) {
+      return ErrorMessage(
+          absl::StrFormat("Unable to find module for path \"%s\"", function.file_path()));
+    }
+    for (const auto& module : modules_it->second) {
       const uint64_t function_address = orbit_object_utils::SymbolOffsetToAbsoluteAddress(
           function.file_offset(), module.address_start(), module.executable_segment_offset());
-      if (!trampoline_map_.contains(function_address)) {
+      if (!trampoline_map_.contains(function_address) &&
+          !new_trampoline_index_from_address.contains(function_address)) {
         const AddressRange module_address_range(module.address_start(), module.address_end());
         auto trampoline_address_or_error = GetTrampolineMemory(module_address_range);
         if (trampoline_address_or_error.has_error()) {
@@ -254,47 +408,189 @@ ErrorMessageOr<absl::flat_hash_set<uint64_t>> InstrumentedProcess::InstrumentFun
                 trampoline_address_or_error.error().message());
           continue;
         }
-        const uint64_t trampoline_address = trampoline_address_or_error.value();
-        TrampolineData trampoline_data;
-        trampoline_data.trampoline_address = trampoline_address;
-        OUTCOME_TRY(auto&& function_data, ReadTraceesMemory(pid_, function_address, backup_size));
-        trampoline_data.function_data = function_data;
-        auto address_after_prologue_or_error =
-            CreateTrampoline(pid_, function_address, function_data, trampoline_address,
-                             entry_payload_function_address_, return_trampoline_address_,
-                             capstone_handle, relocation_map_);
-        if (address_after_prologue_or_error.has_error()) {
-          ERROR("Failed to create trampoline: %s",
-                address_after_prologue_or_error.error().message());
-          OUTCOME_TRY(ReleaseMostRecentlyAllocatedTrampolineMemory(module_address_range));
-          continue;
-        }
-        trampoline_data.address_after_prologue = address_after_prologue_or_error.value();
-        trampoline_map_.emplace(function_address, trampoline_data);
+        new_trampoline_index_from_address.emplace(function_address, new_trampolines.size());
+        NewTrampoline& new_trampoline = new_trampolines.emplace_back();
+        new_trampoline.function_address = function_address;
+        new_trampoline.module_file_path = module.file_path();
+        new_trampoline.trampoline_address = trampoline_address_or_error.value();
+        new_trampoline.backup_size = backup_size;
+      }
+      function_id_from_address.insert_or_assign(function_address, function.function_id());
+      function_name_from_address.insert_or_assign(function_address, function.function_name());
+    }
+  }
+  const absl::Time prepare_done_time = absl::Now();
+
+  // Read all the prologues we need to relocate.
+  std::vector<AddressRange> prologue_ranges;
+  prologue_ranges.reserve(new_trampolines.size());
+  for (const NewTrampoline& new_trampoline : new_trampolines) {
+    prologue_ranges.emplace_back(new_trampoline.function_address,
+                                 new_trampoline.function_address + new_trampoline.backup_size);
+  }
+  OUTCOME_TRY(auto&& prologues, ReadTraceesMemoryBatch(pid_, prologue_ranges));
+  for (size_t i = 0; i < new_trampolines.size(); ++i) {
+    new_trampolines[i].function_data = std::move(prologues[i]);
+  }
+  const absl::Time read_done_time = absl::Now();
+
+  OUTCOME_TRY(AssembleTrampolines(new_trampolines, entry_payload_function_address_,
+                                  return_trampoline_address_,
+                                  open_function_call_stack_tls_offset_));
+  const absl::Time assemble_done_time = absl::Now();
+
+  // Collect the trampolines, the jumps into the trampolines and the prologues to restore, and write
+  // them in two batches: first the trampolines, then the functions. WriteTraceesMemoryBatch writes
+  // in address order and can fail halfway, so this ensures that no jump leads to a trampoline that
+  // wasn't written. New trampolines are padded to their full size such that neighboring trampolines
+  // are merged into one write. Functions that are still instrumented from a previous capture (see
+  // `CaptureOptions::user_space_instrumentation_persistent`) keep their jump, and their trampoline
+  // is only patched if the function id changed.
+  std::vector<TraceesMemoryWrite> trampoline_writes;
+  std::vector<TraceesMemoryWrite> function_writes;
+  std::vector<uint64_t> newly_instrumented_function_addresses;
+  bool writes_to_trampolines = !new_trampolines.empty();
+  uint64_t num_jumps_written = 0;
+  for (NewTrampoline& new_trampoline : new_trampolines) {
+    if (new_trampoline.error.has_value()) {
+      // The memory of the trampoline stays unused.
+      ERROR("Failed to create trampoline: %s", new_trampoline.error.value().message());
+      continue;
+    }
+    CHECK(new_trampoline.code.size() <= GetMaxTrampolineSize());
+    // Pad with 'int3's.
+    new_trampoline.code.resize(GetMaxTrampolineSize(), 0xcc);
+  }
+  absl::flat_hash_set<uint64_t> instrumented_function_ids;
+  absl::flat_hash_map<uint64_t, uint64_t> function_id_from_instrumented_address;
+  for (const auto& [function_address, function_id] : function_id_from_address) {
+    const uint64_t offset =
+        GetOffsetOfFunctionIdInTrampoline(open_function_call_stack_tls_offset_.has_value());
+    if (auto it = function_id_from_instrumented_address_.find(function_address);
+        it != function_id_from_instrumented_address_.end()) {
+      if (it->second != function_id) {
+        std::vector<uint8_t> function_id_as_bytes(sizeof(function_id));
+        std::memcpy(function_id_as_bytes.data(), &function_id, sizeof(function_id));
+        trampoline_writes.push_back(
+            {trampoline_map_.at(function_address).trampoline_address + offset,
+             std::move(function_id_as_bytes)});
+        writes_to_trampolines = true;
       }
-      auto it = trampoline_map_.find(function_address);
-      if (it == trampoline_map_.end()) {
-        continue;
+      function_id_from_instrumented_address.emplace(function_address, function_id);
+      instrumented_function_ids.insert(function_id);
+      continue;
+    }
+
+    uint64_t trampoline_address = 0;
+    uint64_t address_after_prologue = 0;
+    NewTrampoline* new_trampoline = nullptr;
+    if (auto it = trampoline_map_.find(function_address); it != trampoline_map_.end()) {
+      trampoline_address = it->second.trampoline_address;
+      address_after_prologue = it->second.address_after_prologue;
+    } else if (auto index_it = new_trampoline_index_from_address.find(function_address);
+               index_it != new_trampoline_index_from_address.end() &&
+               !new_trampolines[index_it->second].error.has_value()) {
+      new_trampoline = &new_trampolines[index_it->second];
+      trampoline_address = new_trampoline->trampoline_address;
+      address_after_prologue = new_trampoline->address_after_prologue;
+    } else {
+      continue;
+    }
+
+    auto jump_or_error =
+        AssembleJumpToTrampoline(function_address, address_after_prologue, trampoline_address);
+    if (jump_or_error.has_error()) {
+      ERROR("Unable to instrument \"%s\": %s", function_name_from_address[function_address],
+            jump_or_error.error().message());
+      continue;
+    }
+    function_writes.push_back({function_address, std::move(jump_or_error.value())});
+    newly_instrumented_function_addresses.push_back(function_address);
+    ++num_jumps_written;
+
+    // Patch the trampoline to hand over the current function_id to the entry payload.
+    if (new_trampoline != nullptr) {
+      std::memcpy(new_trampoline->code.data() + offset, &function_id, sizeof(function_id));
+    } else {
+      std::vector<uint8_t> function_id_as_bytes(sizeof(function_id));
+      std::memcpy(function_id_as_bytes.data(), &function_id, sizeof(function_id));
+      trampoline_writes.push_back({trampoline_address + offset, std::move(function_id_as_bytes)});
+      writes_to_trampolines = true;
+    }
+    function_id_from_instrumented_address.emplace(function_address, function_id);
+    instrumented_function_ids.insert(function_id);
+  }
+  for (NewTrampoline& new_trampoline : new_trampolines) {
+    if (new_trampoline.error.has_value()) continue;
+    trampoline_writes.push_back(
+        {new_trampoline.trampoline_address, std::move(new_trampoline.code)});
+  }
+  uint64_t num_prologues_restored = 0;
+  for (const auto& [function_address, unused_function_id] :
+       function_id_from_instrumented_address_) {
+    if (function_id_from_instrumented_address.contains(function_address)) continue;
+    function_writes.push_back({function_address, GetOverwrittenPrologue(function_address)});
+    ++num_prologues_restored;
+  }
+  if (writes_to_trampolines) {
+    OUTCOME_TRY(EnsureTrampolinesWritable());
+  }
+  if (!trampoline_writes.empty()) {
+    OUTCOME_TRY(WriteTraceesMemoryBatch(pid_, std::move(trampoline_writes)));
+  }
+
+  // Only now that the trampolines exist in the tracee we keep track of them.
+  for (NewTrampoline& new_trampoline : new_trampolines) {
+    if (new_trampoline.error.has_value()) continue;
+    relocation_map_.insert(new_trampoline.relocation_map.begin(),
+                           new_trampoline.relocation_map.end());
+    TrampolineData trampoline_data;
+    trampoline_data.module_file_path = std::move(new_trampoline.module_file_path);
+    trampoline_data.trampoline_address = new_trampoline.trampoline_address;
+    trampoline_data.address_after_prologue = new_trampoline.address_after_prologue;
+    trampoline_data.function_data = std::move(new_trampoline.function_data);
+    trampoline_map_.emplace(new_trampoline.function_address, std::move(trampoline_data));
+  }
+
+  if (!function_writes.empty()) {
+    auto function_writes_result = WriteTraceesMemoryBatch(pid_, std::move(function_writes));
+    if (function_writes_result.has_error()) {
+      // Some of the jumps could have been written. Try to restore the prologues of the functions
+      // that were not instrumented before, as we don't keep track of them.
+      std::vector<TraceesMemoryWrite> rollback_writes;
+      rollback_writes.reserve(newly_instrumented_function_addresses.size());
+      for (uint64_t function_address : newly_instrumented_function_addresses) {
+        rollback_writes.push_back({function_address, GetOverwrittenPrologue(function_address)});
       }
-      const TrampolineData& trampoline_data = it->second;
-
-      auto result = InstrumentFunction(pid_, function_address, function_id,
-                                       trampoline_data.address_after_prologue,
-                                       trampoline_data.trampoline_address);
-      if (result.has_error()) {
-        ERROR("Unable to instrument \"%s\": %s", function.function_name(),
-              result.error().message());
-      } else {
-        addresses_of_instrumented_functions_.insert(function_address);
-        instrumented_function_ids.insert(function_id);
+      auto rollback_result = WriteTraceesMemoryBatch(pid_, std::move(rollback_writes));
+      if (rollback_result.has_error()) {
+        ERROR("Restoring prologues after failing to instrument functions: %s",
+              rollback_result.error().message());
       }
+      return function_writes_result.error();
     }
   }
+  function_id_from_instrumented_address_ = std::move(function_id_from_instrumented_address);
+  const absl::Time write_done_time = absl::Now();
 
-  MoveInstructionPointersOutOfOverwrittenCode(pid_, relocation_map_);
+  if (num_jumps_written > 0) {
+    MoveInstructionPointersOutOfOverwrittenCode(pid_, relocation_map_);
+  }
 
   OUTCOME_TRY(EnsureTrampolinesExecutable());
 
+  const absl::Time done_time = absl::Now();
+  LOG("Instrumented %u functions (%u new trampolines, %u new jumps, %u prologues restored) in "
+      "process %d, which was stopped for %.3f ms: preparing %.3f ms, reading %.3f ms, assembling "
+      "%.3f ms, writing %.3f ms, finishing %.3f ms",
+      function_id_from_instrumented_address_.size(), new_trampolines.size(), num_jumps_written,
+      num_prologues_restored, pid_, absl::ToDoubleMilliseconds(done_time - stop_time),
+      absl::ToDoubleMilliseconds(prepare_done_time - stop_time),
+      absl::ToDoubleMilliseconds(read_done_time - prepare_done_time),
+      absl::ToDoubleMilliseconds(assemble_done_time - read_done_time),
+      absl::ToDoubleMilliseconds(write_done_time - assemble_done_time),
+      absl::ToDoubleMilliseconds(done_time - write_done_time));
+
   return instrumented_function_ids;
 }
 
@@ -305,20 +601,67 @@ ErrorMessageOr<void> InstrumentedProcess::UninstrumentFunctions() {
                                                  ERROR("Detaching from %i", pid);
                                                }
                                              }};
-  for (uint64_t function_address : addresses_of_instrumented_functions_) {
-    auto it = trampoline_map_.find(function_address);
-    // Skip if this function was not instrumented.
-    if (it == trampoline_map_.end()) continue;
-    const TrampolineData& trampoline_data = it->second;
-    std::vector<uint8_t> code(trampoline_data.function_data.begin(),
-                              trampoline_data.function_data.begin() +
-                                  (trampoline_data.address_after_prologue - function_address));
-    auto write_result_or_error = WriteTraceesMemory(pid_, function_address, code);
-    FAIL_IF(write_result_or_error.has_error(), "%s", write_result_or_error.error().message());
+  OUTCOME_TRY(auto&& modules, orbit_object_utils::ReadModules(pid_));
+  RemoveFunctionsOfUnloadedModules(modules);
+  std::vector<TraceesMemoryWrite> writes;
+  writes.reserve(function_id_from_instrumented_address_.size());
+  for (const auto& [function_address, unused_function_id] :
+       function_id_from_instrumented_address_) {
+    writes.push_back({function_address, GetOverwrittenPrologue(function_address)});
   }
+  auto write_result_or_error = WriteTraceesMemoryBatch(pid_, std::move(writes));
+  FAIL_IF(write_result_or_error.has_error(), "%s", write_result_or_error.error().message());
+  function_id_from_instrumented_address_.clear();
+  // Calls that were already in a trampoline still reach the payloads.
+  OUTCOME_TRY(ExecuteInProcess(pid_, absl::bit_cast<void*>(stop_capture_function_address_)));
+  return outcome::success();
+}
+
+ErrorMessageOr<void> InstrumentedProcess::StopCapture() {
+  OUTCOME_TRY(AttachAndStopProcess(pid_));
+  orbit_base::unique_resource detach_on_exit{pid_, [](int32_t pid) {
+                                               if (DetachAndContinueProcess(pid).has_error()) {
+                                                 ERROR("Detaching from %i", pid);
+                                               }
+                                             }};
+  OUTCOME_TRY(ExecuteInProcess(pid_, absl::bit_cast<void*>(stop_capture_function_address_)));
   return outcome::success();
 }
 
+std::vector<uint8_t> InstrumentedProcess::GetOverwrittenPrologue(uint64_t function_address) const {
+  const TrampolineData& trampoline_data = trampoline_map_.at(function_address);
+  return {trampoline_data.function_data.begin(),
+          trampoline_data.function_data.begin() +
+              (trampoline_data.address_after_prologue - function_address)};
+}
+
+void InstrumentedProcess::RemoveFunctionsOfUnloadedModules(const std::vector<ModuleInfo>& modules) {
+  std::vector<uint64_t> unloaded_function_addresses;
+  for (const auto& [function_address, trampoline_data] : trampoline_map_) {
+    const uint64_t prologue_end = trampoline_data.address_after_prologue;
+    const bool is_loaded =
+        std::any_of(modules.begin(), modules.end(), [&](const ModuleInfo& module) {
+          return module.file_path() == trampoline_data.module_file_path &&
+                 module.address_start() <= function_address &&
+                 prologue_end <= module.address_end();
+        });
+    if (!is_loaded) unloaded_function_addresses.push_back(function_address);
+  }
+  for (uint64_t function_address : unloaded_function_addresses) {
+    // The memory of the trampoline stays unused.
+    const uint64_t prologue_end = trampoline_map_.at(function_address).address_after_prologue;
+    for (uint64_t address = function_address; address < prologue_end; ++address) {
+      relocation_map_.erase(address);
+    }
+    trampoline_map_.erase(function_address);
+    function_id_from_instrumented_address_.erase(function_address);
+  }
+  if (!unloaded_function_addresses.empty()) {
+    LOG("Forgot the instrumentation of %u functions in unloaded modules of process %d",
+        unloaded_function_addresses.size(), pid_);
+  }
+}
+
 ErrorMessageOr<uint64_t> InstrumentedProcess::GetTrampolineMemory(AddressRange address_range) {
   if (!trampolines_for_modules_.contains(address_range)) {
     trampolines_for_modules_.emplace(address_range, TrampolineMemoryChunks());
@@ -339,33 +682,6 @@ ErrorMessageOr<uint64_t> InstrumentedProcess::GetTrampolineMemory(AddressRange a
   return result;
 }
 
-ErrorMessageOr<void> InstrumentedProcess::ReleaseMostRecentlyAllocatedTrampolineMemory(
-    AddressRange address_range) {
-  if (!trampolines_for_modules_.contains(address_range)) {
-    return ErrorMessage("Tried to release trampoline memory for a non existent address range");
-  }
-  trampolines_for_modules_.find(address_range)->second.back().first_available--;
-  return outcome::success();
-}
-
-ErrorMessageOr<std::vector<ModuleInfo>> InstrumentedProcess::ModulesFromModulePath(
-    std::string path) {
-  if (!modules_from_path_.contains(path)) {
-    std::vector<ModuleInfo> result;
-    OUTCOME_TRY(auto&& modules, orbit_object_utils::ReadModules(pid_));
-    for (const ModuleInfo& module : modules) {
-      if (module.file_path() == path) {
-        result.push_back(module);
-      }
-    }
-    if (result.empty()) {
-      return ErrorMessage(absl::StrFormat("Unable to find module for path \"%s\"", path));
-    }
-    modules_from_path_.emplace(path, result);
-  }
-  return modules_from_path_.find(path)->second;
-}
-
 ErrorMessageOr<void> InstrumentedProcess::EnsureTrampolinesWritable() {
   for (auto& trampoline_for_module : trampolines_for_modules_) {
     for (auto& memory_chunk : trampoline_for_module.second) {
@@ -393,7 +709,16 @@ std::unique_ptr<InstrumentationManager> InstrumentationManager::Create() {
   return std::unique_ptr<InstrumentationManager>(new InstrumentationManager());
 }
 
-InstrumentationManager::~InstrumentationManager() {}
+InstrumentationManager::~InstrumentationManager() {
+  // Don't leave the functions of persistently instrumented processes patched when we go away.
+  for (auto& [pid, process] : process_map_) {
+    if (!process->IsPersistent() || !ProcessWithPidExists(pid)) continue;
+    auto result = process->UninstrumentFunctions();
+    if (result.has_error()) {
+      ERROR("Uninstrumenting process %d: %s", pid, result.error().message());
+    }
+  }
+}
 
 ErrorMessageOr<absl::flat_hash_set<uint64_t>> InstrumentationManager::InstrumentProcess(
     const CaptureOptions& capture_options) {
@@ -437,8 +762,14 @@ ErrorMessageOr<void> InstrumentationManager::UninstrumentProcess(pid_t pid) {
     return outcome::success();
   }
 
+  // Persistently instrumented functions stay instrumented between captures, but the payloads stop
+  // emitting events. The next capture only patches the differences.
   if (process_map_.contains(pid)) {
-    OUTCOME_TRY(process_map_[pid]->UninstrumentFunctions());
+    if (process_map_[pid]->IsPersistent()) {
+      OUTCOME_TRY(process_map_[pid]->StopCapture());
+    } else {
+      OUTCOME_TRY(process_map_[pid]->UninstrumentFunctions());
+    }
   }
 
   return outcome::success();
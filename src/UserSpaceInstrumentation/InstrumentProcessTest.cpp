@@ -8,10 +8,12 @@
 #include <unistd.h>
 
 #include <cstdint>
+#include <cstring>
 #include <random>
 #include <string>
 #include <string_view>
 
+#include "AccessTraceesMemory.h"
 #include "AddressRange.h"
 #include "FindFunctionAddress.h"
 #include "ObjectUtils/ElfFile.h"
@@ -61,6 +63,21 @@ extern "C" int SomethingToInstrument() {
   return dis(gen);
 }
 
+namespace {
+
+// Returns the first byte of `SomethingToInstrument` in the child process `pid`.
+[[nodiscard]] uint8_t ReadFirstByteOfSomethingToInstrument(pid_t pid) {
+  CHECK(!AttachAndStopProcess(pid).has_error());
+  // The child is forked from this process, so the function is at the same address.
+  auto bytes_or_error =
+      ReadTraceesMemory(pid, reinterpret_cast<uint64_t>(&SomethingToInstrument), 1);
+  CHECK(!DetachAndContinueProcess(pid).has_error());
+  CHECK(bytes_or_error.has_value());
+  return bytes_or_error.value()[0];
+}
+
+}  // namespace
+
 TEST(InstrumentProcessTest, FailToInstrumentAlreadyAttached) {
   InstrumentationManager* instrumentation_manager = GetInstrumentationManager();
 
@@ -172,4 +189,52 @@ TEST(InstrumentProcessTest, Instrument) {
   waitpid(pid_process_2, NULL, 0);
 }
 
-}  // namespace orbit_user_space_instrumentation
\ No newline at end of file
+TEST(InstrumentProcessTest, PersistentInstrumentationSurvivesUninstrument) {
+  InstrumentationManager* instrumentation_manager = GetInstrumentationManager();
+
+  const pid_t pid = fork();
+  CHECK(pid != -1);
+  if (pid == 0) {
+    int sum = 0;
+    while (true) {
+      sum += SomethingToInstrument();
+    }
+  }
+  uint8_t original_first_byte = 0;
+  std::memcpy(&original_first_byte, reinterpret_cast<const void*>(&SomethingToInstrument), 1);
+  constexpr uint8_t kJmp = 0xe9;
+
+  orbit_grpc_protos::CaptureOptions capture_options = BuildCaptureOptions();
+  capture_options.set_pid(pid);
+  capture_options.set_user_space_instrumentation_persistent(true);
+  for (int i = 0; i < 3; i++) {
+    auto function_ids_or_error = instrumentation_manager->InstrumentProcess(capture_options);
+    ASSERT_THAT(function_ids_or_error, HasNoError());
+    EXPECT_TRUE(function_ids_or_error.value().contains(kFunctionId));
+    ASSERT_THAT(instrumentation_manager->UninstrumentProcess(pid), HasNoError());
+    // The jump into the trampoline is still in place.
+    EXPECT_EQ(ReadFirstByteOfSomethingToInstrument(pid), kJmp);
+  }
+
+  // Instrumenting nothing restores the function.
+  orbit_grpc_protos::CaptureOptions empty_capture_options;
+  empty_capture_options.set_pid(pid);
+  empty_capture_options.set_user_space_instrumentation_persistent(true);
+  auto function_ids_or_error = instrumentation_manager->InstrumentProcess(empty_capture_options);
+  ASSERT_THAT(function_ids_or_error, HasNoError());
+  EXPECT_TRUE(function_ids_or_error.value().empty());
+  EXPECT_EQ(ReadFirstByteOfSomethingToInstrument(pid), original_first_byte);
+
+  // Without persistence, uninstrumenting restores the function right away.
+  capture_options.set_user_space_instrumentation_persistent(false);
+  function_ids_or_error = instrumentation_manager->InstrumentProcess(capture_options);
+  ASSERT_THAT(function_ids_or_error, HasNoError());
+  EXPECT_EQ(ReadFirstByteOfSomethingToInstrument(pid), kJmp);
+  ASSERT_THAT(instrumentation_manager->UninstrumentProcess(pid), HasNoError());
+  EXPECT_EQ(ReadFirstByteOfSomethingToInstrument(pid), original_first_byte);
+
+  kill(pid, SIGKILL);
+  waitpid(pid, NULL, 0);
+}
+
+}  // namespace orbit_user_space_instrumentation
@@ -0,0 +1,134 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef USER_SPACE_INSTRUMENTATION_OPEN_FUNCTION_CALL_STACK_H_
+#define USER_SPACE_INSTRUMENTATION_OPEN_FUNCTION_CALL_STACK_H_
+
+#include <sys/mman.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "OrbitBase/Logging.h"
+#include "OrbitBase/SafeStrerror.h"
+
+namespace orbit_user_space_instrumentation {
+
+struct OpenFunctionCall {
+  OpenFunctionCall() = default;
+  OpenFunctionCall(uint64_t return_address, uint64_t function_id, uint64_t timestamp_on_entry)
+      : return_address(return_address),
+        function_id(function_id),
+        timestamp_on_entry(timestamp_on_entry) {}
+  uint64_t return_address;
+  uint64_t function_id;
+  // In nanoseconds, or in timestamp counter ticks if the timestamp counter is used.
+  uint64_t timestamp_on_entry;
+};
+
+// The amount of data we store for each call is relevant for the overall performance. The assert is
+// here for awareness and to avoid packing issues in the struct.
+static_assert(sizeof(OpenFunctionCall) == 24, "OpenFunctionCall should be 24 bytes.");
+// The fast path of the trampolines writes OpenFunctionCalls with this layout.
+static_assert(offsetof(OpenFunctionCall, return_address) == 0 &&
+                  offsetof(OpenFunctionCall, function_id) == 8 &&
+                  offsetof(OpenFunctionCall, timestamp_on_entry) == 16,
+              "The layout of OpenFunctionCall is used by the trampolines.");
+
+// The stack of open function calls of a thread: `top` points to the first free element and `limit`
+// to the end of the accessible part of the stack. Both are null until the thread calls
+// `EntryPayload` for the first time, which makes the fast path of the trampolines fall back to
+// `EntryPayload`.
+struct OpenFunctionCallStack {
+  OpenFunctionCall* top;
+  OpenFunctionCall* limit;
+};
+
+// Owns the memory of the stack of open function calls of a thread, whose pointers are kept in
+// `stack`. We reserve the address space for the deepest stack we support up front, such that the
+// stack never moves, but only make it accessible in steps of `kCommitSize` bytes: what lies beyond
+// `limit` is an inaccessible guard region. When the top reaches the guard, `EntryPayload` is called
+// and grows the accessible part.
+// Calls that don't fit into the accessible part, because the reserved address space is exhausted
+// or because making more of it accessible failed, go to `overflow_`. Once a call went there, all
+// following calls also go there until it is empty again, so that the calls are still popped in
+// reverse order. These are always the most recent calls, as the fast path doesn't push while the
+// stack is at its limit.
+// `mprotect_function` is only replaced in tests.
+class ThreadOpenFunctionCallStack {
+ public:
+  using MprotectFunction = int (*)(void* address, size_t length, int protection);
+
+  explicit ThreadOpenFunctionCallStack(OpenFunctionCallStack* stack,
+                                       MprotectFunction mprotect_function = &mprotect)
+      : stack_{stack}, mprotect_function_{mprotect_function} {
+    void* memory = mmap(nullptr, kReservedSize, PROT_NONE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED) {
+      ERROR("Reserving memory for the stack of open function calls: %s", SafeStrerror(errno));
+      return;
+    }
+    memory_ = static_cast<char*>(memory);
+    stack_->top = reinterpret_cast<OpenFunctionCall*>(memory_);
+    stack_->limit = stack_->top;
+  }
+
+  ~ThreadOpenFunctionCallStack() {
+    stack_->top = nullptr;
+    stack_->limit = nullptr;
+    if (memory_ != nullptr) munmap(memory_, kReservedSize);
+  }
+
+  ThreadOpenFunctionCallStack(const ThreadOpenFunctionCallStack&) = delete;
+  ThreadOpenFunctionCallStack& operator=(const ThreadOpenFunctionCallStack&) = delete;
+
+  void Push(uint64_t return_address, uint64_t function_id, uint64_t timestamp_on_entry) {
+    if (overflow_.empty() && (stack_->top < stack_->limit || Grow())) {
+      *stack_->top++ = OpenFunctionCall(return_address, function_id, timestamp_on_entry);
+    } else {
+      overflow_.emplace_back(return_address, function_id, timestamp_on_entry);
+    }
+  }
+
+  [[nodiscard]] OpenFunctionCall Pop() {
+    if (!overflow_.empty()) {
+      OpenFunctionCall open_function_call = overflow_.back();
+      overflow_.pop_back();
+      return open_function_call;
+    }
+    return *--stack_->top;
+  }
+
+  // 64 MiB hold more than 2.7 million open calls. Each call also takes at least 8 bytes of the
+  // stack of the thread, so we don't expect to ever use `overflow_`.
+  static constexpr size_t kReservedSize = 64 * 1024 * 1024;
+  static constexpr size_t kCommitSize = 64 * 1024;
+
+ private:
+  // Makes the next `kCommitSize` bytes of the reserved memory accessible.
+  [[nodiscard]] bool Grow() {
+    if (memory_ == nullptr || committed_size_ == kReservedSize) return false;
+    if (mprotect_function_(memory_ + committed_size_, kCommitSize, PROT_READ | PROT_WRITE) != 0) {
+      ERROR("Growing the stack of open function calls: %s", SafeStrerror(errno));
+      return false;
+    }
+    committed_size_ += kCommitSize;
+    stack_->limit =
+        reinterpret_cast<OpenFunctionCall*>(memory_) + committed_size_ / sizeof(OpenFunctionCall);
+    return true;
+  }
+
+  // Not owned.
+  OpenFunctionCallStack* stack_;
+  MprotectFunction mprotect_function_;
+  char* memory_ = nullptr;
+  size_t committed_size_ = 0;
+  std::vector<OpenFunctionCall> overflow_;
+};
+
+}  // namespace orbit_user_space_instrumentation
+
+#endif  // USER_SPACE_INSTRUMENTATION_OPEN_FUNCTION_CALL_STACK_H_
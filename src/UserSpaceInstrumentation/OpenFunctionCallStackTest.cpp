@@ -0,0 +1,79 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+#include "OpenFunctionCallStack.h"
+
+namespace orbit_user_space_instrumentation {
+
+namespace {
+
+bool fail_mprotect = false;
+
+int MprotectThatCanFail(void* address, size_t length, int protection) {
+  if (fail_mprotect) {
+    errno = ENOMEM;
+    return -1;
+  }
+  return mprotect(address, length, protection);
+}
+
+}  // namespace
+
+TEST(OpenFunctionCallStack, PopsInReverseOrderOfPush) {
+  constexpr uint64_t kCallCount =
+      3 * ThreadOpenFunctionCallStack::kCommitSize / sizeof(OpenFunctionCall);
+  OpenFunctionCallStack stack{nullptr, nullptr};
+  ThreadOpenFunctionCallStack thread_stack{&stack};
+  for (uint64_t i = 0; i < kCallCount; ++i) {
+    thread_stack.Push(/*return_address=*/i, /*function_id=*/i, /*timestamp_on_entry=*/i);
+  }
+  for (uint64_t i = kCallCount; i > 0; --i) {
+    EXPECT_EQ(thread_stack.Pop().function_id, i - 1);
+  }
+}
+
+TEST(OpenFunctionCallStack, PopsInReverseOrderOfPushAfterGrowingFailed) {
+  constexpr uint64_t kCallsPerCommit =
+      ThreadOpenFunctionCallStack::kCommitSize / sizeof(OpenFunctionCall);
+  OpenFunctionCallStack stack{nullptr, nullptr};
+  ThreadOpenFunctionCallStack thread_stack{&stack, &MprotectThatCanFail};
+
+  fail_mprotect = false;
+  uint64_t call_count = 0;
+  for (; call_count < kCallsPerCommit; ++call_count) {
+    thread_stack.Push(call_count, call_count, call_count);
+  }
+  EXPECT_EQ(stack.top, stack.limit);
+
+  // The stack can't grow, so the next call goes to the overflow.
+  fail_mprotect = true;
+  thread_stack.Push(call_count, call_count, call_count);
+  ++call_count;
+
+  // Even though the stack could grow again, the following calls also need to go to the overflow,
+  // and the fast path must not push onto the stack in the meantime.
+  fail_mprotect = false;
+  for (uint64_t i = 0; i < 2 * kCallsPerCommit; ++i, ++call_count) {
+    thread_stack.Push(call_count, call_count, call_count);
+  }
+  EXPECT_EQ(stack.top, stack.limit);
+
+  for (; call_count > 0; --call_count) {
+    EXPECT_EQ(thread_stack.Pop().function_id, call_count - 1);
+  }
+
+  // Once the overflow is empty, the stack grows again.
+  thread_stack.Push(0, 0, 0);
+  EXPECT_LT(stack.top, stack.limit);
+  EXPECT_EQ(thread_stack.Pop().function_id, 0);
+}
+
+}  // namespace orbit_user_space_instrumentation
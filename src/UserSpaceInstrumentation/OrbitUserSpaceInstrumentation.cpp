@@ -4,42 +4,130 @@
 
 #include "OrbitUserSpaceInstrumentation.h"
 
+#include <absl/base/casts.h>
+#include <absl/base/thread_annotations.h>
+#include <absl/container/flat_hash_map.h>
+#include <absl/synchronization/mutex.h>
+#include <cpuid.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <sys/types.h>
+#include <x86intrin.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
-#include <stack>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
 
 #include "CaptureEventProducer/LockFreeBufferCaptureEventProducer.h"
+#include "OpenFunctionCallStack.h"
+#include "OrbitBase/Logging.h"
 #include "OrbitBase/Profiling.h"
 #include "OrbitBase/ThreadUtils.h"
 #include "ProducerSideChannel/ProducerSideChannel.h"
+#include "SharedMemoryTransport/ProducerEventRecords.h"
+#include "SharedMemoryTransport/SharedMemoryRingBuffer.h"
 
 namespace {
 
 using orbit_base::CaptureTimestampNs;
+using orbit_user_space_instrumentation::OpenFunctionCall;
+using orbit_user_space_instrumentation::OpenFunctionCallStack;
+using orbit_user_space_instrumentation::ThreadOpenFunctionCallStack;
 
-struct OpenFunctionCall {
-  OpenFunctionCall(uint64_t return_address, uint64_t function_id, uint64_t timestamp_on_entry_ns)
-      : return_address(return_address),
-        function_id(function_id),
-        timestamp_on_entry_ns(timestamp_on_entry_ns) {}
-  uint64_t return_address;
-  uint64_t function_id;
-  uint64_t timestamp_on_entry_ns;
-};
+// Where the pointers of the stack of each thread are kept when the fast path is disabled. When it
+// is enabled, they are kept in liborbituserspaceinstrumentationfastpath.so instead, at the fixed
+// offset from the thread pointer that the fast path accesses, and `EnableFastPath` sets
+// `get_fast_path_open_function_call_stack` to the function of that library that returns them.
+thread_local OpenFunctionCallStack thread_local_open_function_call_stack{nullptr, nullptr};
+std::atomic<void* (*)()> get_fast_path_open_function_call_stack = nullptr;
+
+[[nodiscard]] OpenFunctionCallStack* GetOpenFunctionCallStackOfThisThread() {
+  void* (*get_fast_path_stack)() =
+      get_fast_path_open_function_call_stack.load(std::memory_order_acquire);
+  if (get_fast_path_stack != nullptr) {
+    return static_cast<OpenFunctionCallStack*>(get_fast_path_stack());
+  }
+  return &thread_local_open_function_call_stack;
+}
+
+// Only valid while the thread holds a `ThreadOpenFunctionCallStack`.
+thread_local ThreadOpenFunctionCallStack* thread_open_function_call_stack = nullptr;
+
+void DeleteThreadOpenFunctionCallStack(void* stack) {
+  thread_open_function_call_stack = nullptr;
+  delete static_cast<ThreadOpenFunctionCallStack*>(stack);
+}
+
+// We free the stack of a thread through a pthread key destructor, not a thread_local object: if
+// an instrumented function is called by a destructor that runs later during the thread exit, the
+// thread gets a new stack (and the key destructor runs again) instead of accessing a destroyed
+// object.
+pthread_key_t GetThreadOpenFunctionCallStackKey() {
+  static const pthread_key_t key = [] {
+    pthread_key_t key;
+    CHECK(pthread_key_create(&key, &DeleteThreadOpenFunctionCallStack) == 0);
+    return key;
+  }();
+  return key;
+}
+
+ThreadOpenFunctionCallStack& GetThreadOpenFunctionCallStack() {
+  if (thread_open_function_call_stack == nullptr) {
+    thread_open_function_call_stack =
+        new ThreadOpenFunctionCallStack(GetOpenFunctionCallStackOfThisThread());
+    CHECK(pthread_setspecific(GetThreadOpenFunctionCallStackKey(),
+                              thread_open_function_call_stack) == 0);
+  }
+  return *thread_open_function_call_stack;
+}
 
-// The amount of data we store for each call is relevant for the overall performance. The assert is
-// here for awareness and to avoid packing issues in the struct.
-static_assert(sizeof(OpenFunctionCall) == 24, "OpenFunctionCall should be 24 bytes.");
+// Set by `EnableFastPath` before any function is instrumented: from then on the timestamps are read
+// from the timestamp counter, as the fast path of the trampolines does.
+bool timestamps_in_tsc_ticks = false;
+double ns_per_tsc_tick = 1.;
+
+[[nodiscard]] uint64_t ReadTimestamp() {
+  return timestamps_in_tsc_ticks ? __rdtsc() : CaptureTimestampNs();
+}
 
-std::stack<OpenFunctionCall>& GetOpenFunctionCallStack() {
-  thread_local std::stack<OpenFunctionCall> open_function_calls;
-  return open_function_calls;
+[[nodiscard]] bool HasInvariantTsc() {
+  unsigned int eax = 0;
+  unsigned int ebx = 0;
+  unsigned int ecx = 0;
+  unsigned int edx = 0;
+  // CPUID.80000007H:EDX[8] is the "Invariant TSC" bit.
+  if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0) return false;
+  return (edx & (1u << 8)) != 0;
+}
+
+// Measures the duration of a timestamp counter tick against CaptureTimestampNs. This is called
+// while the process is stopped for the instrumentation, so we keep it short.
+[[nodiscard]] double MeasureNsPerTscTick() {
+  constexpr uint64_t kMeasurementDurationNs = 1'000'000;
+  const uint64_t start_ns = CaptureTimestampNs();
+  const uint64_t start_tsc = __rdtsc();
+  uint64_t end_ns = start_ns;
+  while (end_ns - start_ns < kMeasurementDurationNs) {
+    end_ns = CaptureTimestampNs();
+  }
+  const uint64_t end_tsc = __rdtsc();
+  return static_cast<double>(end_ns - start_ns) / static_cast<double>(end_tsc - start_tsc);
 }
 
 uint64_t start_current_capture_timestamp = 0;
 
+// Set by `StartNewCapture` and cleared by `StopCapture`, which OrbitService calls when it
+// instruments and uninstruments the process. The producer alone can't tell: it also captures when
+// OrbitService captures another process, and functions can stay instrumented between captures.
+std::atomic<bool> capture_enabled = false;
+
 struct FunctionCallEvent {
   FunctionCallEvent() = default;
   FunctionCallEvent(int32_t pid, int32_t tid, uint64_t function_id, uint64_t duration_ns,
@@ -59,9 +147,109 @@ struct FunctionCallEvent {
 // The amount of data we transmit for each call is relevant for the overall performance. The assert
 // is here for awareness and to avoid packing issues in the struct.
 static_assert(sizeof(FunctionCallEvent) == 32, "FunctionCallEvent should be 32 bytes.");
+// FunctionCallEvents are copied as they are into the shared memory ring buffer.
+static_assert(sizeof(FunctionCallEvent) == sizeof(orbit_shared_memory_transport::FunctionCallRecord),
+              "FunctionCallEvent should have the layout of FunctionCallRecord.");
+
+// Statistics of the calls of one function by one thread, see orbit_grpc_protos::FunctionCallStats.
+struct FunctionCallStatsAccumulator {
+  static constexpr size_t kHistogramBucketCount = 64;
+
+  void AddCall(uint64_t duration_ns) {
+    ++count;
+    total_time_ns += duration_ns;
+    min_ns = std::min(min_ns, duration_ns);
+    max_ns = std::max(max_ns, duration_ns);
+    sum_of_squared_durations_ns +=
+        static_cast<double>(duration_ns) * static_cast<double>(duration_ns);
+    // Bucket i holds the durations in [2^i, 2^(i+1)).
+    size_t bucket = duration_ns == 0 ? 0 : 63 - __builtin_clzll(duration_ns);
+    ++duration_histogram[bucket];
+  }
+
+  void Add(const FunctionCallStatsAccumulator& other) {
+    count += other.count;
+    total_time_ns += other.total_time_ns;
+    min_ns = std::min(min_ns, other.min_ns);
+    max_ns = std::max(max_ns, other.max_ns);
+    sum_of_squared_durations_ns += other.sum_of_squared_durations_ns;
+    for (size_t bucket = 0; bucket < kHistogramBucketCount; ++bucket) {
+      duration_histogram[bucket] += other.duration_histogram[bucket];
+    }
+  }
+
+  uint64_t count = 0;
+  uint64_t total_time_ns = 0;
+  uint64_t min_ns = std::numeric_limits<uint64_t>::max();
+  uint64_t max_ns = 0;
+  double sum_of_squared_durations_ns = 0;
+  std::array<uint64_t, kHistogramBucketCount> duration_histogram{};
+};
+
+// The statistics of the calls a thread made since they were last collected.
+struct FunctionCallStatsTable {
+  // The capture the statistics belong to, see LockFreeBufferCaptureEventProducer::GetCaptureCount.
+  uint64_t capture_count = 0;
+  absl::flat_hash_map<uint64_t, FunctionCallStatsAccumulator> function_id_to_stats;
+};
+
+// The statistics of all the functions called by one thread. The thread adds its calls to one of two
+// tables without any lock. To collect them, the forwarder thread of the producer switches the
+// thread to the other table, then waits for an update of the previous table that could still be in
+// progress, which is signaled by `update_sequence` being odd.
+class ThreadFunctionCallStats {
+ public:
+  explicit ThreadFunctionCallStats(pid_t tid) : tid_{tid} {}
+
+  [[nodiscard]] pid_t tid() const { return tid_; }
+
+  // Only called by the thread itself.
+  void AddCall(uint64_t capture_count, uint64_t function_id, uint64_t duration_ns) {
+    const uint64_t sequence = update_sequence_.load(std::memory_order_relaxed);
+    // Both the store and the load below need to be sequentially consistent, and so do the store and
+    // the load in TakeTable: either TakeTable sees the odd sequence and waits, or this update goes
+    // to the new table.
+    update_sequence_.store(sequence + 1, std::memory_order_seq_cst);
+    FunctionCallStatsTable& table = tables_[active_table_index_.load(std::memory_order_seq_cst)];
+    if (table.capture_count != capture_count) {
+      table.function_id_to_stats.clear();
+      table.capture_count = capture_count;
+    }
+    table.function_id_to_stats[function_id].AddCall(duration_ns);
+    update_sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  // Only called by the forwarder thread. The table returned stays valid until the next call, after
+  // which the thread adds its calls to it again.
+  [[nodiscard]] FunctionCallStatsTable& TakeTable() {
+    const uint32_t previous_table_index = active_table_index_.load(std::memory_order_relaxed);
+    active_table_index_.store(1 - previous_table_index, std::memory_order_seq_cst);
+    const uint64_t sequence = update_sequence_.load(std::memory_order_seq_cst);
+    if (sequence % 2 == 1) {
+      while (update_sequence_.load(std::memory_order_acquire) == sequence) {
+        std::this_thread::yield();
+      }
+    }
+    return tables_[previous_table_index];
+  }
+
+  // Only accessed by the forwarder thread: the statistics of the current capture collected so far.
+  uint64_t collected_capture_count = 0;
+  absl::flat_hash_map<uint64_t, FunctionCallStatsAccumulator> collected_function_id_to_stats;
+
+ private:
+  const pid_t tid_;
+  std::array<FunctionCallStatsTable, 2> tables_;
+  std::atomic<uint32_t> active_table_index_ = 0;
+  std::atomic<uint64_t> update_sequence_ = 0;
+};
 
 // This class is used to enqueue FunctionCallEvent events from multiple threads and relay them to
 // OrbitService in the form of orbit_grpc_protos::FunctionCall events.
+//
+// When the capture only asks for statistics, the threads instead accumulate the statistics of their
+// calls in ThreadFunctionCallStats, which the forwarder thread periodically sends as
+// orbit_grpc_protos::FunctionCallStats events.
 class LockFreeUserSpaceInstrumentationEventProducer
     : public orbit_capture_event_producer::LockFreeBufferCaptureEventProducer<FunctionCallEvent> {
  public:
@@ -71,7 +259,44 @@ class LockFreeUserSpaceInstrumentationEventProducer
 
   ~LockFreeUserSpaceInstrumentationEventProducer() { ShutdownAndWait(); }
 
+  [[nodiscard]] bool IsStatisticsOnly() const {
+    return statistics_only_.load(std::memory_order_relaxed);
+  }
+
+  void AddFunctionCallToThreadStats(pid_t tid, uint64_t function_id, uint64_t duration_ns) {
+    thread_local std::shared_ptr<ThreadFunctionCallStats> thread_stats;
+    if (thread_stats == nullptr) {
+      thread_stats = std::make_shared<ThreadFunctionCallStats>(tid);
+      absl::MutexLock lock{&all_thread_stats_mutex_};
+      all_thread_stats_.push_back(thread_stats);
+    }
+
+    thread_stats->AddCall(GetCaptureCount(), function_id, duration_ns);
+  }
+
  protected:
+  void OnCaptureStart(orbit_grpc_protos::CaptureOptions capture_options) override {
+    statistics_only_ = capture_options.user_space_instrumentation_statistics_only();
+    last_stats_collection_timestamp_ns_ = 0;
+    LockFreeBufferCaptureEventProducer::OnCaptureStart(std::move(capture_options));
+  }
+
+  [[nodiscard]] size_t ProcessDequeuedIntermediateEvents(
+      std::vector<FunctionCallEvent>* /*events*/, size_t event_count,
+      bool is_last_call_of_capture) override {
+    if (!IsStatisticsOnly()) {
+      return event_count;
+    }
+    static constexpr uint64_t kStatsCollectionIntervalNs = 100'000'000;
+    const uint64_t now_ns = CaptureTimestampNs();
+    if (is_last_call_of_capture ||
+        now_ns - last_stats_collection_timestamp_ns_ >= kStatsCollectionIntervalNs) {
+      SendUpdatedFunctionCallStats(now_ns);
+      last_stats_collection_timestamp_ns_ = now_ns;
+    }
+    return event_count;
+  }
+
   [[nodiscard]] virtual orbit_grpc_protos::ProducerCaptureEvent* TranslateIntermediateEvent(
       FunctionCallEvent&& raw_event, google::protobuf::Arena* arena) override {
     auto* capture_event =
@@ -84,35 +309,144 @@ class LockFreeUserSpaceInstrumentationEventProducer
     function_call->set_end_timestamp_ns(raw_event.end_timestamp_ns);
     return capture_event;
   }
+
+  [[nodiscard]] bool CanWriteIntermediateEventsToSharedMemory() const override { return true; }
+
+  [[nodiscard]] bool TryWriteIntermediateEventToSharedMemory(
+      const FunctionCallEvent& raw_event,
+      orbit_shared_memory_transport::SharedMemoryRingBuffer* ring_buffer) override {
+    char* record = ring_buffer->TryReserveRecord(
+        static_cast<uint32_t>(orbit_shared_memory_transport::ProducerEventRecordType::kFunctionCall),
+        sizeof(FunctionCallEvent));
+    if (record == nullptr) {
+      return false;
+    }
+    memcpy(record, &raw_event, sizeof(FunctionCallEvent));
+    ring_buffer->CommitRecord();
+    return true;
+  }
+
+ private:
+  // Only sends the statistics that changed since they were last sent. This always goes through
+  // gRPC, even with the shared memory ring buffer, as there are few of these events.
+  void SendUpdatedFunctionCallStats(uint64_t timestamp_ns) {
+    std::vector<std::shared_ptr<ThreadFunctionCallStats>> all_thread_stats;
+    {
+      absl::MutexLock lock{&all_thread_stats_mutex_};
+      all_thread_stats = all_thread_stats_;
+      // Stop tracking the threads that exited: these statistics are sent one last time below.
+      all_thread_stats_.erase(
+          std::remove_if(all_thread_stats_.begin(), all_thread_stats_.end(),
+                         [](const std::shared_ptr<ThreadFunctionCallStats>& thread_stats) {
+                           // One reference is held by `all_thread_stats`.
+                           return thread_stats.use_count() == 2;
+                         }),
+          all_thread_stats_.end());
+    }
+
+    static const pid_t pid = orbit_base::GetCurrentProcessId();
+    const uint64_t capture_count = GetCaptureCount();
+    orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest send_request;
+    auto* capture_events = send_request.mutable_buffered_capture_events()->mutable_capture_events();
+    for (const std::shared_ptr<ThreadFunctionCallStats>& thread_stats : all_thread_stats) {
+      if (thread_stats->collected_capture_count != capture_count) {
+        thread_stats->collected_function_id_to_stats.clear();
+        thread_stats->collected_capture_count = capture_count;
+      }
+      FunctionCallStatsTable& table = thread_stats->TakeTable();
+      if (table.capture_count != capture_count) {
+        table.function_id_to_stats.clear();
+        continue;
+      }
+      for (const auto& [function_id, new_stats] : table.function_id_to_stats) {
+        FunctionCallStatsAccumulator& stats =
+            thread_stats->collected_function_id_to_stats[function_id];
+        stats.Add(new_stats);
+
+        orbit_grpc_protos::FunctionCallStats* function_call_stats =
+            capture_events->Add()->mutable_function_call_stats();
+        function_call_stats->set_pid(pid);
+        function_call_stats->set_tid(thread_stats->tid());
+        function_call_stats->set_function_id(function_id);
+        function_call_stats->set_timestamp_ns(timestamp_ns);
+        function_call_stats->set_count(stats.count);
+        function_call_stats->set_total_time_ns(stats.total_time_ns);
+        function_call_stats->set_min_ns(stats.min_ns);
+        function_call_stats->set_max_ns(stats.max_ns);
+        function_call_stats->set_sum_of_squared_durations_ns(stats.sum_of_squared_durations_ns);
+        auto last_non_empty_bucket =
+            std::find_if(stats.duration_histogram.rbegin(), stats.duration_histogram.rend(),
+                         [](uint64_t bucket_count) { return bucket_count != 0; });
+        function_call_stats->mutable_duration_histogram()->Add(
+            stats.duration_histogram.begin(), last_non_empty_bucket.base());
+      }
+      table.function_id_to_stats.clear();
+    }
+
+    if (capture_events->empty()) {
+      return;
+    }
+    if (!SendCaptureEvents(send_request)) {
+      ERROR("Sending %d FunctionCallStats", capture_events->size());
+    }
+  }
+
+  std::atomic<bool> statistics_only_ = false;
+  // Reset in OnCaptureStart, which can run concurrently with the forwarder thread.
+  std::atomic<uint64_t> last_stats_collection_timestamp_ns_ = 0;
+
+  absl::Mutex all_thread_stats_mutex_;
+  std::vector<std::shared_ptr<ThreadFunctionCallStats>> all_thread_stats_
+      ABSL_GUARDED_BY(all_thread_stats_mutex_);
 };
 
 }  // namespace
 
-void StartNewCapture() { start_current_capture_timestamp = CaptureTimestampNs(); }
+void StartNewCapture() {
+  start_current_capture_timestamp = ReadTimestamp();
+  capture_enabled.store(true, std::memory_order_relaxed);
+}
+
+void StopCapture() { capture_enabled.store(false, std::memory_order_relaxed); }
 
 void EntryPayload(uint64_t return_address, uint64_t function_id) {
-  const uint64_t timestamp_on_entry_ns = CaptureTimestampNs();
-  auto& open_function_call_stack = GetOpenFunctionCallStack();
-  open_function_call_stack.emplace(return_address, function_id, timestamp_on_entry_ns);
+  const uint64_t timestamp_on_entry = ReadTimestamp();
+  GetThreadOpenFunctionCallStack().Push(return_address, function_id, timestamp_on_entry);
 }
 
 uint64_t ExitPayload() {
-  const uint64_t timestamp_on_exit_ns = CaptureTimestampNs();
-  auto& open_function_call_stack = GetOpenFunctionCallStack();
-  OpenFunctionCall current_return_address = open_function_call_stack.top();
-  open_function_call_stack.pop();
+  const uint64_t timestamp_on_exit = ReadTimestamp();
+  const uint64_t timestamp_on_exit_ns =
+      timestamps_in_tsc_ticks ? CaptureTimestampNs() : timestamp_on_exit;
+  OpenFunctionCall current_return_address = GetThreadOpenFunctionCallStack().Pop();
 
   static LockFreeUserSpaceInstrumentationEventProducer producer;
   // Skip emitting an event if we are not capturing or the event belongs to a previous capture.
-  if (producer.IsCapturing() &&
-      start_current_capture_timestamp < current_return_address.timestamp_on_entry_ns) {
+  if (capture_enabled.load(std::memory_order_relaxed) && producer.IsCapturing() &&
+      start_current_capture_timestamp < current_return_address.timestamp_on_entry) {
     static pid_t pid = orbit_base::GetCurrentProcessId();
     thread_local pid_t tid = orbit_base::GetCurrentThreadId();
-    const uint64_t duration_ns =
-        timestamp_on_exit_ns - current_return_address.timestamp_on_entry_ns;
-    producer.EnqueueIntermediateEvent(FunctionCallEvent(
-        pid, tid, current_return_address.function_id, duration_ns, timestamp_on_exit_ns));
+    uint64_t duration_ns = timestamp_on_exit - current_return_address.timestamp_on_entry;
+    if (timestamps_in_tsc_ticks) {
+      duration_ns = static_cast<uint64_t>(static_cast<double>(duration_ns) * ns_per_tsc_tick);
+    }
+    if (producer.IsStatisticsOnly()) {
+      producer.AddFunctionCallToThreadStats(tid, current_return_address.function_id, duration_ns);
+    } else {
+      producer.EnqueueIntermediateEvent(FunctionCallEvent(
+          pid, tid, current_return_address.function_id, duration_ns, timestamp_on_exit_ns));
+    }
   }
 
   return current_return_address.return_address;
 }
+
+uint64_t EnableFastPath(uint64_t get_open_function_call_stack_function_address) {
+  if (!HasInvariantTsc()) return 0;
+  ns_per_tsc_tick = MeasureNsPerTscTick();
+  timestamps_in_tsc_ticks = true;
+  get_fast_path_open_function_call_stack.store(
+      absl::bit_cast<void* (*)()>(get_open_function_call_stack_function_address),
+      std::memory_order_release);
+  return 1;
+}
@@ -10,6 +10,10 @@
 // Needs to be called when the capture starts.
 extern "C" void StartNewCapture();
 
+// Needs to be called when the capture stops. Until the next call to `StartNewCapture`, functions
+// that are still instrumented don't produce any events.
+extern "C" void StopCapture();
+
 // Payload called on entry of an instrumented function. Needs to record the return address of the
 // function (in order to have it available in `ExitPayload`). `function_id` is the id of the
 // instrumented function.
@@ -19,4 +23,14 @@ extern "C" void EntryPayload(uint64_t return_address, uint64_t function_id);
 // the function such that the execution can be continued there.
 extern "C" uint64_t ExitPayload();
 
+// Makes the stacks of open function calls of the threads that call `EntryPayload` for the first
+// time from now on use the pointers returned by the function at
+// `get_open_function_call_stack_function_address`, i.e., `GetOpenFunctionCallStack` of
+// liborbituserspaceinstrumentationfastpath.so, which the fast path of the trampolines pushes to
+// without calling `EntryPayload` (see `CreateTrampoline` in Trampoline.h). Returns 0 if the fast
+// path can't be used, i.e., when the timestamp counter of the cpu is not invariant, and 1
+// otherwise. Once this returned 1, the open function calls hold timestamp counter values instead of
+// timestamps in nanoseconds.
+extern "C" uint64_t EnableFastPath(uint64_t get_open_function_call_stack_function_address);
+
 #endif  // ORBIT_USER_SPACE_INSTRUMENTATION_H_
\ No newline at end of file
@@ -0,0 +1,32 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+
+#include "OrbitUserSpaceInstrumentation.h"
+
+namespace {
+
+// Enters range(0) nested calls and then returns from all of them, as a recursive instrumented
+// function would. No capture is running, so this measures the bookkeeping of the open function
+// calls and the timestamps, but not the production of events.
+void BM_EntryAndExitPayloadAtDepth(benchmark::State& state) {
+  const auto depth = static_cast<uint64_t>(state.range(0));
+  constexpr uint64_t kFunctionId = 1;
+  for (auto _ : state) {
+    for (uint64_t i = 0; i < depth; ++i) {
+      EntryPayload(/*return_address=*/i, kFunctionId);
+    }
+    for (uint64_t i = 0; i < depth; ++i) {
+      benchmark::DoNotOptimize(ExitPayload());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(depth));
+}
+
+}  // namespace
+
+BENCHMARK(BM_EntryAndExitPayloadAtDepth)->ArgName("depth")->Range(1, 64 * 1024);
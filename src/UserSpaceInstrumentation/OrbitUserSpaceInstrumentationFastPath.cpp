@@ -0,0 +1,24 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "OrbitUserSpaceInstrumentationFastPath.h"
+
+namespace {
+
+struct OpenFunctionCallStackPointers {
+  void* top;
+  void* limit;
+};
+__attribute__((tls_model("initial-exec"))) thread_local OpenFunctionCallStackPointers
+    open_function_call_stack{nullptr, nullptr};
+
+}  // namespace
+
+void* GetOpenFunctionCallStack() { return &open_function_call_stack; }
+
+uint64_t GetOpenFunctionCallStackTlsOffset() {
+  uint64_t thread_pointer = 0;
+  __asm__ __volatile__("mov %%fs:0, %0" : "=r"(thread_pointer));
+  return reinterpret_cast<uint64_t>(&open_function_call_stack) - thread_pointer;
+}
@@ -0,0 +1,26 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_USER_SPACE_INSTRUMENTATION_FAST_PATH_H_
+#define ORBIT_USER_SPACE_INSTRUMENTATION_FAST_PATH_H_
+
+#include <cstdint>
+
+// This library only holds the thread local stack pointers that the fast path of the trampolines
+// (see `CreateTrampoline` in Trampoline.h) accesses at a fixed offset from the thread pointer. This
+// requires the initial-exec TLS model, which in a library loaded with dlopen takes space from the
+// static TLS block of the process: loading the library fails if not enough of it is left. Keeping
+// these pointers out of liborbituserspaceinstrumentation.so means that this library is only loaded
+// when the fast path is requested, and that the instrumentation can fall back to calling
+// `EntryPayload` if loading it fails.
+
+// Returns the address of the pair {top, limit} of pointers into the stack of open function calls
+// of the calling thread. Both are null until the entry payload sets them up.
+extern "C" void* GetOpenFunctionCallStack();
+
+// Returns the offset of the same pair of pointers from the thread pointer (fs:0), which is the
+// same for all threads.
+extern "C" uint64_t GetOpenFunctionCallStackTlsOffset();
+
+#endif  // ORBIT_USER_SPACE_INSTRUMENTATION_FAST_PATH_H_
@@ -51,6 +51,11 @@ size_t kMaxRelocatedPrologueSize = kSizeOfJmp * 16;
 // sure this number is correct.
 constexpr uint64_t kOffsetOfFunctionIdInCallToEntryPayload = 105;
 
+// Size of the code added by `AppendFastPathEntryCode` at the beginning of the trampolines that have
+// a fast path. As with the constant above there is a CHECK in the code below to make sure this
+// number is correct.
+constexpr uint64_t kSizeOfFastPathEntryCode = 99;
+
 [[nodiscard]] std::string InstructionBytesAsString(cs_insn* instruction) {
   std::string result;
   for (int i = 0; i < instruction->size; i++) {
@@ -195,15 +200,20 @@ void AppendCallToEntryPayloadAndOverwriteReturnAddress(uint64_t entry_payload_fu
   // At this point rax is the rsp after pushing the general purpose registers, so adding 0x40 gets
   // us the location of the return address (see above in `AppendBackupCode`).
 
+  // The stack is 32 byte aligned after `AppendBackupCode`. The calling convention requires rsp + 8
+  // to be 16 byte aligned on entry of the payload, so we subtract another 8 bytes after pushing
+  // rax.
   // add rax, 0x40                                   48 83 c0 40
   // push rax                                        50
   // mov rdi, (rax)                                  48 8b 38
   // mov rsi, function_id                            48 be function_id
   // mov rax, entry_payload_function_address         48 b8 addr
+  // sub rsp, 0x08                                   48 83 ec 08
   // call rax                                        ff d0
-  // pop rax                                         58
-  // mov rdi, return_trampoline_address              48 bf addr
-  // mov (rax), rdi                                  48 89 38
+  // add rsp, 0x08                                   48 83 c4 08
+  // pop rdi                                         5f
+  // mov rax, return_trampoline_address              48 b8 addr
+  // mov (rdi), rax                                  48 89 07
   trampoline.AppendBytes({0x48, 0x83, 0xc0, 0x40})
       .AppendBytes({0x50})
       .AppendBytes({0x48, 0x8b, 0x38})
@@ -216,13 +226,116 @@ void AppendCallToEntryPayloadAndOverwriteReturnAddress(uint64_t entry_payload_fu
   trampoline.AppendImmediate64(0xDEADBEEFDEADBEEF)
       .AppendBytes({0x48, 0xb8})
       .AppendImmediate64(entry_payload_function_address)
+      .AppendBytes({0x48, 0x83, 0xec, 0x08})
       .AppendBytes({0xff, 0xd0})
+      .AppendBytes({0x48, 0x83, 0xc4, 0x08})
       .AppendBytes({0x5f})
       .AppendBytes({0x48, 0xb8})
       .AppendImmediate64(return_trampoline_address)
       .AppendBytes({0x48, 0x89, 0x07});
 }
 
+// Pushes the return address, the function id and the time stamp counter onto the thread local
+// stack of open function calls at `open_function_call_stack_tls_offset` from the thread pointer and
+// overwrites the return address with `return_trampoline_address`, all without calling into the
+// payload. The stack is expected to be laid out as described at `CreateTrampoline`. Only if the
+// stack is full (or not yet allocated for the thread) we fall through to the code calling the entry
+// payload (`AppendBackupCode`, ...) which is expected to be `entry_payload_call_size` bytes long
+// and to be placed directly after this code. The relocated prologue is expected to follow right
+// after.
+// Apart from the flags, the code only modifies rax, rcx and rdx and restores them before leaving.
+// In particular, it doesn't touch the vector registers, so these don't need a backup.
+void AppendFastPathEntryCode(int32_t open_function_call_stack_tls_offset,
+                             uint64_t return_trampoline_address, uint64_t entry_payload_call_size,
+                             MachineCode& trampoline) {
+  // The jumps below are computed relative to the beginning of the trampoline.
+  CHECK(trampoline.GetResultAsVector().empty());
+  const int32_t top_offset = open_function_call_stack_tls_offset;
+  const int32_t limit_offset = open_function_call_stack_tls_offset + 8;
+
+  // push rax                                        50
+  // push rcx                                        51
+  // push rdx                                        52
+  // mov rcx, fs:[top_offset]                        64 48 8b 0c 25 top_offset
+  // cmp rcx, fs:[limit_offset]                      64 48 3b 0c 25 limit_offset
+  // jae slow_path                                   0f 83 offset
+  trampoline.AppendBytes({0x50})
+      .AppendBytes({0x51})
+      .AppendBytes({0x52})
+      .AppendBytes({0x64, 0x48, 0x8b, 0x0c, 0x25})
+      .AppendImmediate32(top_offset)
+      .AppendBytes({0x64, 0x48, 0x3b, 0x0c, 0x25})
+      .AppendImmediate32(limit_offset)
+      .AppendBytes({0x0f, 0x83});
+  // The slow path starts with the three 'pop's right before the code calling the entry payload.
+  const int32_t offset_to_slow_path = static_cast<int32_t>(kSizeOfFastPathEntryCode) - 3 -
+                                      static_cast<int32_t>(trampoline.GetResultAsVector().size()) -
+                                      4;
+  trampoline.AppendImmediate32(offset_to_slow_path);
+
+  // Reserve the slot on the stack first, and only then fill it: a signal handler running an
+  // instrumented function in between uses the slots above.
+  // add rcx, 24                                     48 83 c1 18
+  // mov fs:[top_offset], rcx                        64 48 89 0c 25 top_offset
+  trampoline.AppendBytes({0x48, 0x83, 0xc1, 0x18})
+      .AppendBytes({0x64, 0x48, 0x89, 0x0c, 0x25})
+      .AppendImmediate32(top_offset);
+
+  // Store the return address (above the three registers we pushed), the function id and the time
+  // stamp counter. The function id is read from the code calling the entry payload such that there
+  // is only one place to patch in `InstrumentFunction`.
+  // mov rax, [rsp+24]                               48 8b 44 24 18
+  // mov [rcx-24], rax                               48 89 41 e8
+  // mov rax, [rip+offset_to_function_id]            48 8b 05 offset
+  // mov [rcx-16], rax                               48 89 41 f0
+  // rdtsc                                           0f 31
+  // shl rdx, 32                                     48 c1 e2 20
+  // or rdx, rax                                     48 09 c2
+  // mov [rcx-8], rdx                                48 89 51 f8
+  trampoline.AppendBytes({0x48, 0x8b, 0x44, 0x24, 0x18})
+      .AppendBytes({0x48, 0x89, 0x41, 0xe8})
+      .AppendBytes({0x48, 0x8b, 0x05});
+  const int32_t offset_to_function_id =
+      static_cast<int32_t>(kSizeOfFastPathEntryCode + kOffsetOfFunctionIdInCallToEntryPayload) -
+      static_cast<int32_t>(trampoline.GetResultAsVector().size()) - 4;
+  trampoline.AppendImmediate32(offset_to_function_id)
+      .AppendBytes({0x48, 0x89, 0x41, 0xf0})
+      .AppendBytes({0x0f, 0x31})
+      .AppendBytes({0x48, 0xc1, 0xe2, 0x20})
+      .AppendBytes({0x48, 0x09, 0xc2})
+      .AppendBytes({0x48, 0x89, 0x51, 0xf8});
+
+  // Overwrite the return address, restore the registers and jump over the slow path into the
+  // relocated prologue.
+  // mov rax, return_trampoline_address              48 b8 addr
+  // mov [rsp+24], rax                               48 89 44 24 18
+  // pop rdx                                         5a
+  // pop rcx                                         59
+  // pop rax                                         58
+  // jmp relocated_prologue                          e9 offset
+  trampoline.AppendBytes({0x48, 0xb8})
+      .AppendImmediate64(return_trampoline_address)
+      .AppendBytes({0x48, 0x89, 0x44, 0x24, 0x18})
+      .AppendBytes({0x5a})
+      .AppendBytes({0x59})
+      .AppendBytes({0x58})
+      .AppendBytes({0xe9});
+  const int32_t offset_to_relocated_prologue =
+      static_cast<int32_t>(kSizeOfFastPathEntryCode + entry_payload_call_size) -
+      static_cast<int32_t>(trampoline.GetResultAsVector().size()) - 4;
+  trampoline.AppendImmediate32(offset_to_relocated_prologue);
+
+  // Slow path: restore the registers and continue with the code calling the entry payload.
+  // pop rdx                                         5a
+  // pop rcx                                         59
+  // pop rax                                         58
+  trampoline.AppendBytes({0x5a}).AppendBytes({0x59}).AppendBytes({0x58});
+
+  // This fails if the code above was changed - see the comment at the declaration of
+  // kSizeOfFastPathEntryCode above.
+  CHECK(trampoline.GetResultAsVector().size() == kSizeOfFastPathEntryCode);
+}
+
 void AppendRestoreCode(MachineCode& trampoline) {
   // Restore vector registers (see comment on AppendBackupCode above).
   if (HasAvx()) {
@@ -752,11 +865,17 @@ ErrorMessageOr<RelocatedInstruction> RelocateInstruction(cs_insn* instruction, u
 uint64_t GetMaxTrampolineSize() {
   // The maximum size of a trampoline is constant. So the calculation can be cached on first call.
   static const uint64_t trampoline_size = []() -> uint64_t {
-    MachineCode unused_code;
-    AppendBackupCode(unused_code);
+    MachineCode unused_entry_payload_call;
+    AppendBackupCode(unused_entry_payload_call);
     AppendCallToEntryPayloadAndOverwriteReturnAddress(/*entry_payload_function_address=*/0,
-                                                      /*return_trampoline_address=*/0, unused_code);
-    AppendRestoreCode(unused_code);
+                                                      /*return_trampoline_address=*/0,
+                                                      unused_entry_payload_call);
+    AppendRestoreCode(unused_entry_payload_call);
+    MachineCode unused_code;
+    AppendFastPathEntryCode(/*open_function_call_stack_tls_offset=*/0,
+                            /*return_trampoline_address=*/0,
+                            unused_entry_payload_call.GetResultAsVector().size(), unused_code);
+    unused_code.AppendBytes(unused_entry_payload_call.GetResultAsVector());
     unused_code.AppendBytes(std::vector<uint8_t>(kMaxRelocatedPrologueSize, 0));
     auto result =
         AppendJumpBackCode(/*address_after_prologue=*/0, /*trampoline_address=*/0, unused_code);
@@ -770,18 +889,25 @@ uint64_t GetMaxTrampolineSize() {
   return trampoline_size;
 }
 
-ErrorMessageOr<uint64_t> CreateTrampoline(pid_t pid, uint64_t function_address,
-                                          const std::vector<uint8_t>& function,
-                                          uint64_t trampoline_address,
-                                          uint64_t entry_payload_function_address,
-                                          uint64_t return_trampoline_address, csh capstone_handle,
-                                          absl::flat_hash_map<uint64_t, uint64_t>& relocation_map) {
-  MachineCode trampoline;
-  // Add code to backup register state, execute the payload and restore the register state.
-  AppendBackupCode(trampoline);
+ErrorMessageOr<uint64_t> AssembleTrampoline(
+    uint64_t function_address, const std::vector<uint8_t>& function, uint64_t trampoline_address,
+    uint64_t entry_payload_function_address, uint64_t return_trampoline_address,
+    std::optional<int32_t> open_function_call_stack_tls_offset, csh capstone_handle,
+    absl::flat_hash_map<uint64_t, uint64_t>& relocation_map,
+    std::vector<uint8_t>& trampoline_code) {
+  // Code to backup register state, execute the payload and restore the register state.
+  MachineCode entry_payload_call;
+  AppendBackupCode(entry_payload_call);
   AppendCallToEntryPayloadAndOverwriteReturnAddress(entry_payload_function_address,
-                                                    return_trampoline_address, trampoline);
-  AppendRestoreCode(trampoline);
+                                                    return_trampoline_address, entry_payload_call);
+  AppendRestoreCode(entry_payload_call);
+
+  MachineCode trampoline;
+  if (open_function_call_stack_tls_offset.has_value()) {
+    AppendFastPathEntryCode(open_function_call_stack_tls_offset.value(), return_trampoline_address,
+                            entry_payload_call.GetResultAsVector().size(), trampoline);
+  }
+  trampoline.AppendBytes(entry_payload_call.GetResultAsVector());
 
   // Relocate prologue into trampoline.
   OUTCOME_TRY(auto&& address_after_prologue,
@@ -791,9 +917,25 @@ ErrorMessageOr<uint64_t> CreateTrampoline(pid_t pid, uint64_t function_address,
   // Add code for jump from trampoline back into function.
   OUTCOME_TRY(AppendJumpBackCode(address_after_prologue, trampoline_address, trampoline));
 
+  trampoline_code = trampoline.GetResultAsVector();
+  return address_after_prologue;
+}
+
+ErrorMessageOr<uint64_t> CreateTrampoline(
+    pid_t pid, uint64_t function_address, const std::vector<uint8_t>& function,
+    uint64_t trampoline_address, uint64_t entry_payload_function_address,
+    uint64_t return_trampoline_address, csh capstone_handle,
+    absl::flat_hash_map<uint64_t, uint64_t>& relocation_map,
+    std::optional<int32_t> open_function_call_stack_tls_offset) {
+  std::vector<uint8_t> trampoline_code;
+  OUTCOME_TRY(auto&& address_after_prologue,
+              AssembleTrampoline(function_address, function, trampoline_address,
+                                 entry_payload_function_address, return_trampoline_address,
+                                 open_function_call_stack_tls_offset, capstone_handle,
+                                 relocation_map, trampoline_code));
+
   // Copy trampoline into tracee.
-  auto write_result_or_error =
-      WriteTraceesMemory(pid, trampoline_address, trampoline.GetResultAsVector());
+  auto write_result_or_error = WriteTraceesMemory(pid, trampoline_address, trampoline_code);
   if (write_result_or_error.has_error()) {
     return write_result_or_error.error();
   }
@@ -801,6 +943,10 @@ ErrorMessageOr<uint64_t> CreateTrampoline(pid_t pid, uint64_t function_address,
   return address_after_prologue;
 }
 
+uint64_t GetOffsetOfFunctionIdInTrampoline(bool has_fast_path) {
+  return (has_fast_path ? kSizeOfFastPathEntryCode : 0) + kOffsetOfFunctionIdInCallToEntryPayload;
+}
+
 uint64_t GetReturnTrampolineSize() {
   // The size is constant. So the calculation can be cached on first call.
   static const uint64_t return_trampoline_size = []() -> uint64_t {
@@ -826,9 +972,9 @@ ErrorMessageOr<void> CreateReturnTrampoline(pid_t pid, uint64_t exit_payload_fun
   return outcome::success();
 }
 
-ErrorMessageOr<void> InstrumentFunction(pid_t pid, uint64_t function_address, uint64_t function_id,
-                                        uint64_t address_after_prologue,
-                                        uint64_t trampoline_address) {
+ErrorMessageOr<std::vector<uint8_t>> AssembleJumpToTrampoline(uint64_t function_address,
+                                                              uint64_t address_after_prologue,
+                                                              uint64_t trampoline_address) {
   MachineCode jump;
   jump.AppendBytes({0xe9});
   ErrorMessageOr<int32_t> offset_or_error =
@@ -847,13 +993,24 @@ ErrorMessageOr<void> InstrumentFunction(pid_t pid, uint64_t function_address, ui
   while (jump.GetResultAsVector().size() < address_after_prologue - function_address) {
     jump.AppendBytes({0x90});
   }
-  OUTCOME_TRY(WriteTraceesMemory(pid, function_address, jump.GetResultAsVector()));
+  return jump.GetResultAsVector();
+}
+
+ErrorMessageOr<void> InstrumentFunction(pid_t pid, uint64_t function_address, uint64_t function_id,
+                                        uint64_t address_after_prologue,
+                                        uint64_t trampoline_address, bool has_fast_path) {
+  OUTCOME_TRY(auto&& jump,
+              AssembleJumpToTrampoline(function_address, address_after_prologue,
+                                       trampoline_address));
+  OUTCOME_TRY(WriteTraceesMemory(pid, function_address, jump));
 
   // Patch the trampoline to hand over the current function_id to the entry payload.
   MachineCode function_id_as_bytes;
   function_id_as_bytes.AppendImmediate64(function_id);
-  OUTCOME_TRY(WriteTraceesMemory(pid, trampoline_address + kOffsetOfFunctionIdInCallToEntryPayload,
-                                 function_id_as_bytes.GetResultAsVector()));
+  const uint64_t function_id_address =
+      trampoline_address + GetOffsetOfFunctionIdInTrampoline(has_fast_path);
+  OUTCOME_TRY(
+      WriteTraceesMemory(pid, function_id_address, function_id_as_bytes.GetResultAsVector()));
 
   return outcome::success();
 }
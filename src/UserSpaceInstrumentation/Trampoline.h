@@ -128,11 +128,37 @@ struct RelocatedInstruction {
 // away from the overwritten bytes at the beginning of the function, compare
 // MoveInstructionPointersOutOfOverwrittenCode below). The return value is the address of the first
 // instruction not relocated into the trampoline (i.e. the address the trampoline jump back to).
+//
+// If `open_function_call_stack_tls_offset` is set the trampoline gets a fast path: instead of
+// backing up the registers and calling the entry payload, it directly pushes the return address,
+// the function id and the time stamp counter (as read by `rdtsc`) onto a thread local stack. The
+// stack is found at `open_function_call_stack_tls_offset` from the thread pointer (the base of the
+// fs segment) and consists of two pointers: the top of the stack (one past the last element) and
+// its limit. Each element is 24 bytes: the return address, the function id and the time stamp
+// counter. The entry payload is only called when the top reaches the limit (in particular when
+// both are null); it is then responsible for keeping track of the call. The exit payload needs to
+// pop from the same stack.
 [[nodiscard]] ErrorMessageOr<uint64_t> CreateTrampoline(
     pid_t pid, uint64_t function_address, const std::vector<uint8_t>& function,
     uint64_t trampoline_address, uint64_t entry_payload_function_address,
     uint64_t return_trampoline_address, csh capstone_handle,
-    absl::flat_hash_map<uint64_t, uint64_t>& relocation_map);
+    absl::flat_hash_map<uint64_t, uint64_t>& relocation_map,
+    std::optional<int32_t> open_function_call_stack_tls_offset = std::nullopt);
+
+// Same as `CreateTrampoline` above but only assembles the trampoline into `trampoline_code` instead
+// of writing it into the tracee. Since this does not access the tracee, it can be called
+// concurrently for different functions as long as each thread uses its own `capstone_handle` and
+// `relocation_map`.
+[[nodiscard]] ErrorMessageOr<uint64_t> AssembleTrampoline(
+    uint64_t function_address, const std::vector<uint8_t>& function, uint64_t trampoline_address,
+    uint64_t entry_payload_function_address, uint64_t return_trampoline_address,
+    std::optional<int32_t> open_function_call_stack_tls_offset, csh capstone_handle,
+    absl::flat_hash_map<uint64_t, uint64_t>& relocation_map,
+    std::vector<uint8_t>& trampoline_code);
+
+// Returns the offset of the function id in a trampoline (compare `InstrumentFunction` below).
+// `has_fast_path` tells whether the trampoline was created with a fast path.
+[[nodiscard]] uint64_t GetOffsetOfFunctionIdInTrampoline(bool has_fast_path);
 
 // As above with `GetMaxTrampolineSize` this is a compile time constant, but we prefer to compute it
 // here since this captures every change to the code constructing the return trampoline.
@@ -153,11 +179,20 @@ struct RelocatedInstruction {
 // Instrument function at `function_address` in process `pid`. This simply overwrites the beginning
 // of the fuction with a jump to `trampoline_address`. The trampoline needs to be constructed with
 // `CreateTrampoline` above. The trampoline gets patched such that it hands over the current
-// `function_id` to the entry payload.
+// `function_id` to the entry payload. `has_fast_path` tells whether the trampoline was created with
+// a fast path.
 [[nodiscard]] ErrorMessageOr<void> InstrumentFunction(pid_t pid, uint64_t function_address,
                                                       uint64_t function_id,
                                                       uint64_t address_of_instruction_after_jump,
-                                                      uint64_t trampoline_address);
+                                                      uint64_t trampoline_address,
+                                                      bool has_fast_path = false);
+
+// Returns the code `InstrumentFunction` writes to the beginning of the function at
+// `function_address`: a jump to `trampoline_address` padded with 'nop's up to
+// `address_of_instruction_after_jump`.
+[[nodiscard]] ErrorMessageOr<std::vector<uint8_t>> AssembleJumpToTrampoline(
+    uint64_t function_address, uint64_t address_of_instruction_after_jump,
+    uint64_t trampoline_address);
 
 // Move every instruction pointer that was in the middle of an overwritten function prologue to
 // the corresponding place in the trampoline.
@@ -0,0 +1,162 @@
+// Copyright (c) 2021 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <absl/container/flat_hash_map.h>
+#include <benchmark/benchmark.h>
+#include <capstone/capstone.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "AccessTraceesMemory.h"
+#include "AddressRange.h"
+#include "OrbitBase/Logging.h"
+#include "Trampoline.h"
+
+// Measures the overhead of the trampolines by instrumenting a function of this process: writing to
+// /proc/self/mem works without attaching. The payloads only maintain the stack of open function
+// calls, so the numbers are the cost of the trampolines, not of producing events.
+
+namespace orbit_user_space_instrumentation {
+
+namespace {
+
+struct OpenFunctionCall {
+  uint64_t return_address;
+  uint64_t function_id;
+  uint64_t timestamp;
+};
+
+// Layout expected by the fast path, see `CreateTrampoline`.
+struct OpenFunctionCallStack {
+  OpenFunctionCall* top;
+  OpenFunctionCall* limit;
+};
+__attribute__((tls_model("initial-exec"))) thread_local OpenFunctionCallStack
+    open_function_call_stack{nullptr, nullptr};
+thread_local std::array<OpenFunctionCall, 1024> open_function_calls;
+thread_local uint64_t sum_of_durations = 0;
+
+extern "C" void BenchmarkEntryPayload(uint64_t return_address, uint64_t function_id) {
+  if (open_function_call_stack.top == nullptr) {
+    open_function_call_stack.top = open_function_calls.data();
+    open_function_call_stack.limit = open_function_calls.data() + open_function_calls.size();
+  }
+  CHECK(open_function_call_stack.top < open_function_call_stack.limit);
+  *open_function_call_stack.top++ = {return_address, function_id, __rdtsc()};
+}
+
+extern "C" uint64_t BenchmarkExitPayload() {
+  const OpenFunctionCall& open_function_call = *--open_function_call_stack.top;
+  sum_of_durations += __rdtsc() - open_function_call.timestamp;
+  return open_function_call.return_address;
+}
+
+[[nodiscard]] uint64_t GetOpenFunctionCallStackTlsOffset() {
+  uint64_t thread_pointer = 0;
+  __asm__ __volatile__("mov %%fs:0, %0" : "=r"(thread_pointer));
+  return reinterpret_cast<uint64_t>(&open_function_call_stack) - thread_pointer;
+}
+
+// push rbp; mov rbp, rsp; mov eax, 42; pop rbp; ret
+extern "C" __attribute__((naked, noinline)) int FunctionToInstrument() {
+  __asm__ __volatile__(
+      "push %%rbp\n\t"
+      "mov %%rsp, %%rbp\n\t"
+      "mov $42, %%eax\n\t"
+      "pop %%rbp\n\t"
+      "ret\n\t"
+      :
+      :
+      :);
+}
+
+// Instruments `FunctionToInstrument` for the lifetime of the object.
+class ScopedInstrumentation {
+ public:
+  explicit ScopedInstrumentation(bool fast_path) {
+    const pid_t pid = getpid();
+    function_address_ = reinterpret_cast<uint64_t>(&FunctionToInstrument);
+    constexpr uint64_t kFunctionSize = 11;
+    auto function_code_or_error = ReadTraceesMemory(pid, function_address_, kFunctionSize);
+    CHECK(function_code_or_error.has_value());
+    function_code_ = std::move(function_code_or_error.value());
+
+    // The trampoline needs to be within +-2GB of the function.
+    auto unavailable_ranges_or_error = GetUnavailableAddressRanges(pid);
+    CHECK(unavailable_ranges_or_error.has_value());
+    auto trampoline_range_or_error = FindAddressRangeForTrampoline(
+        unavailable_ranges_or_error.value(),
+        AddressRange(function_address_, function_address_ + kFunctionSize),
+        GetMaxTrampolineSize());
+    CHECK(trampoline_range_or_error.has_value());
+    trampoline_memory_size_ = GetMaxTrampolineSize() + GetReturnTrampolineSize();
+    trampoline_memory_ = mmap(reinterpret_cast<void*>(trampoline_range_or_error.value().start),
+                              trampoline_memory_size_, PROT_READ | PROT_WRITE | PROT_EXEC,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    CHECK(trampoline_memory_ != MAP_FAILED);
+    const auto trampoline_address = reinterpret_cast<uint64_t>(trampoline_memory_);
+    const uint64_t return_trampoline_address = trampoline_address + GetMaxTrampolineSize();
+    CHECK(!CreateReturnTrampoline(pid, reinterpret_cast<uint64_t>(&BenchmarkExitPayload),
+                                  return_trampoline_address)
+               .has_error());
+
+    csh capstone_handle = 0;
+    CHECK(cs_open(CS_ARCH_X86, CS_MODE_64, &capstone_handle) == CS_ERR_OK);
+    CHECK(cs_option(capstone_handle, CS_OPT_DETAIL, CS_OPT_ON) == CS_ERR_OK);
+    std::optional<int32_t> open_function_call_stack_tls_offset;
+    if (fast_path) {
+      open_function_call_stack_tls_offset =
+          static_cast<int32_t>(static_cast<int64_t>(GetOpenFunctionCallStackTlsOffset()));
+    }
+    absl::flat_hash_map<uint64_t, uint64_t> relocation_map;
+    auto address_after_prologue_or_error = CreateTrampoline(
+        pid, function_address_, function_code_, trampoline_address,
+        reinterpret_cast<uint64_t>(&BenchmarkEntryPayload), return_trampoline_address,
+        capstone_handle, relocation_map, open_function_call_stack_tls_offset);
+    cs_close(&capstone_handle);
+    CHECK(address_after_prologue_or_error.has_value());
+    CHECK(!InstrumentFunction(pid, function_address_, /*function_id=*/1,
+                              address_after_prologue_or_error.value(), trampoline_address,
+                              fast_path)
+               .has_error());
+  }
+
+  ~ScopedInstrumentation() {
+    CHECK(!WriteTraceesMemory(getpid(), function_address_, function_code_).has_error());
+    munmap(trampoline_memory_, trampoline_memory_size_);
+  }
+
+ private:
+  uint64_t function_address_ = 0;
+  std::vector<uint8_t> function_code_;
+  void* trampoline_memory_ = nullptr;
+  uint64_t trampoline_memory_size_ = 0;
+};
+
+void CallFunctionToInstrument(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(FunctionToInstrument());
+  }
+  benchmark::DoNotOptimize(sum_of_durations);
+}
+
+void BM_UninstrumentedFunction(benchmark::State& state) { CallFunctionToInstrument(state); }
+
+void BM_InstrumentedFunction(benchmark::State& state) {
+  ScopedInstrumentation instrumentation{/*fast_path=*/state.range(0) != 0};
+  CallFunctionToInstrument(state);
+}
+
+}  // namespace
+
+BENCHMARK(BM_UninstrumentedFunction);
+BENCHMARK(BM_InstrumentedFunction)->ArgName("fast_path")->Arg(0)->Arg(1);
+
+}  // namespace orbit_user_space_instrumentation
@@ -14,6 +14,7 @@
 #include <algorithm>
 #include <chrono>
 #include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <limits>
 #include <memory>
@@ -36,6 +37,7 @@
 #include "TestUtils.h"
 #include "Trampoline.h"
 #include "UserSpaceInstrumentation/Attach.h"
+#include "UserSpaceInstrumentation/ExecuteInProcess.h"
 #include "UserSpaceInstrumentation/InjectLibraryInTracee.h"
 
 namespace orbit_user_space_instrumentation {
@@ -581,16 +583,16 @@ class InstrumentFunctionTest : public testing::Test {
     const std::string library_path = orbit_base::GetExecutableDir() / ".." / "lib" / kLibName;
     auto library_handle_or_error = DlopenInTracee(pid_, library_path, RTLD_NOW);
     CHECK(library_handle_or_error.has_value());
-    void* library_handle = library_handle_or_error.value();
+    library_handle_ = library_handle_or_error.value();
 
     auto entry_payload_function_address_or_error =
-        DlsymInTracee(pid_, library_handle, entry_payload_function_name);
+        DlsymInTracee(pid_, library_handle_, entry_payload_function_name);
     CHECK(entry_payload_function_address_or_error.has_value());
     entry_payload_function_address_ =
         absl::bit_cast<uint64_t>(entry_payload_function_address_or_error.value());
 
     auto exit_payload_function_address_or_error =
-        DlsymInTracee(pid_, library_handle, exit_payload_function_name);
+        DlsymInTracee(pid_, library_handle_, exit_payload_function_name);
     CHECK(exit_payload_function_address_or_error.has_value());
     exit_payload_function_address_ =
         absl::bit_cast<uint64_t>(exit_payload_function_address_or_error.value());
@@ -625,9 +627,8 @@ class InstrumentFunctionTest : public testing::Test {
     function_code_ = function_backup.value();
   }
 
-  // Runs the child for a millisecond to assert it is still working fine, stops it, removes the
-  // instrumentation, restarts and stops it again.
-  void RestartAndRemoveInstrumentation() {
+  // Runs the instrumented child for a millisecond and stops it again.
+  void RestartInstrumented() {
     CHECK(!trampoline_memory_->EnsureMemoryExecutable().has_error());
 
     MoveInstructionPointersOutOfOverwrittenCode(pid_, relocation_map_);
@@ -635,6 +636,19 @@ class InstrumentFunctionTest : public testing::Test {
     CHECK(!DetachAndContinueProcess(pid_).has_error());
     std::this_thread::sleep_for(std::chrono::milliseconds(1));
     CHECK(AttachAndStopProcess(pid_).has_value());
+  }
+
+  [[nodiscard]] uint64_t ExecuteInChildOrDie(std::string_view function_name) {
+    ErrorMessageOr<uint64_t> result_or_error =
+        ExecuteInProcess(pid_, library_handle_, function_name);
+    CHECK(result_or_error.has_value());
+    return result_or_error.value();
+  }
+
+  // Runs the child for a millisecond to assert it is still working fine, stops it, removes the
+  // instrumentation, restarts and stops it again.
+  void RestartAndRemoveInstrumentation() {
+    RestartInstrumented();
 
     auto write_result_or_error = WriteTraceesMemory(pid_, function_address_, function_code_);
     CHECK(!write_result_or_error.has_error());
@@ -658,6 +672,7 @@ class InstrumentFunctionTest : public testing::Test {
   pid_t pid_ = -1;
   csh capstone_handle_ = 0;
   uint64_t max_trampoline_size_ = 0;
+  void* library_handle_ = nullptr;
   std::unique_ptr<MemoryInTracee> trampoline_memory_;
   uint64_t trampoline_address_;
   uint64_t return_trampoline_address_;
@@ -699,6 +714,57 @@ TEST_F(InstrumentFunctionTest, DoSomething) {
   RestartAndRemoveInstrumentation();
 }
 
+// Same as above, but the trampoline pushes onto the stack of open function calls of the test
+// library without calling the entry payload whenever the stack is allocated and not full.
+TEST_F(InstrumentFunctionTest, FastPath) {
+  RunChild(&DoSomething, "DoSomething");
+  PrepareInstrumentation(kEntryPayloadFunctionName, kExitPayloadFunctionName);
+  ErrorMessageOr<uint64_t> tls_offset_or_error =
+      ExecuteInProcess(pid_, library_handle_, "GetOpenFunctionCallStackTlsOffset");
+  ASSERT_THAT(tls_offset_or_error, HasNoError());
+  const auto tls_offset =
+      static_cast<int32_t>(absl::bit_cast<int64_t>(tls_offset_or_error.value()));
+  ErrorMessageOr<uint64_t> address_after_prologue_or_error = CreateTrampoline(
+      pid_, function_address_, function_code_, trampoline_address_, entry_payload_function_address_,
+      return_trampoline_address_, capstone_handle_, relocation_map_, tls_offset);
+  ASSERT_THAT(address_after_prologue_or_error, HasNoError());
+  ErrorMessageOr<void> result = InstrumentFunction(
+      pid_, function_address_, /*function_id=*/42, address_after_prologue_or_error.value(),
+      trampoline_address_, /*has_fast_path=*/true);
+  EXPECT_THAT(result, HasNoError());
+
+  // The function id is written behind the code of the fast path.
+  ErrorMessageOr<std::vector<uint8_t>> function_id_bytes_or_error = ReadTraceesMemory(
+      pid_, trampoline_address_ + GetOffsetOfFunctionIdInTrampoline(/*has_fast_path=*/true),
+      sizeof(uint64_t));
+  ASSERT_THAT(function_id_bytes_or_error, HasNoError());
+  uint64_t function_id = 0;
+  std::memcpy(&function_id, function_id_bytes_or_error.value().data(), sizeof(function_id));
+  EXPECT_EQ(function_id, 42);
+
+  // The first call goes to the entry payload, which allocates the stack. The fast path pushes the
+  // following calls, which only reach the exit payload.
+  RestartInstrumented();
+  const uint64_t entry_payload_call_count = ExecuteInChildOrDie("GetEntryPayloadCallCount");
+  const uint64_t exit_payload_call_count = ExecuteInChildOrDie("GetExitPayloadCallCount");
+  EXPECT_GE(entry_payload_call_count, 1);
+  EXPECT_GT(exit_payload_call_count, entry_payload_call_count);
+
+  // Once the stack is full, the fast path falls back to the entry payload for every call.
+  (void)ExecuteInChildOrDie("MakeOpenFunctionCallStackFull");
+  RestartInstrumented();
+  const uint64_t entry_payload_call_count_when_full =
+      ExecuteInChildOrDie("GetEntryPayloadCallCount") - entry_payload_call_count;
+  const uint64_t exit_payload_call_count_when_full =
+      ExecuteInChildOrDie("GetExitPayloadCallCount") - exit_payload_call_count;
+  EXPECT_GT(entry_payload_call_count_when_full, 0);
+  // One call could have been open when the stack was made full, and one when the child was stopped.
+  EXPECT_LE(entry_payload_call_count_when_full, exit_payload_call_count_when_full + 1);
+  EXPECT_LE(exit_payload_call_count_when_full, entry_payload_call_count_when_full + 1);
+
+  RestartAndRemoveInstrumentation();
+}
+
 // We will not be able to instrument this - the function is just four bytes long and we need five
 // bytes to write a jump.
 extern "C" __attribute__((naked)) int TooShort() {
@@ -8,18 +8,61 @@
 
 #include <chrono>
 #include <ratio>
-#include <stack>
+#include <vector>
 
 namespace {
 
+// Laid out as the fast path of the trampolines expects it; the fast path also writes a timestamp.
 struct ReturnAddressOfFunction {
+  ReturnAddressOfFunction() = default;
   ReturnAddressOfFunction(uint64_t return_address, uint64_t function_id)
       : return_address(return_address), function_id(function_id) {}
   uint64_t return_address;
   uint64_t function_id;
+  uint64_t unused_timestamp;
 };
 
-thread_local std::stack<ReturnAddressOfFunction> return_addresses;
+struct ReturnAddressStack {
+  ReturnAddressOfFunction* top;
+  ReturnAddressOfFunction* limit;
+};
+__attribute__((tls_model("initial-exec"))) thread_local ReturnAddressStack return_address_stack{
+    nullptr, nullptr};
+
+// A small capacity, such that the tests also exercise the fallback of the fast path to the entry
+// payload.
+constexpr size_t kReturnAddressStackCapacity = 16;
+thread_local std::vector<ReturnAddressOfFunction> return_address_stack_storage;
+thread_local std::vector<ReturnAddressOfFunction> return_address_stack_overflow;
+
+// The calls pushed by the fast path of the trampolines are the ones that are popped but were not
+// pushed here.
+uint64_t push_count = 0;
+uint64_t pop_count = 0;
+
+void PushReturnAddress(uint64_t return_address, uint64_t function_id) {
+  ++push_count;
+  if (return_address_stack.top == nullptr) {
+    return_address_stack_storage.resize(kReturnAddressStackCapacity);
+    return_address_stack.top = return_address_stack_storage.data();
+    return_address_stack.limit = return_address_stack.top + kReturnAddressStackCapacity;
+  }
+  if (return_address_stack.top < return_address_stack.limit) {
+    *return_address_stack.top++ = ReturnAddressOfFunction(return_address, function_id);
+  } else {
+    return_address_stack_overflow.emplace_back(return_address, function_id);
+  }
+}
+
+ReturnAddressOfFunction PopReturnAddress() {
+  ++pop_count;
+  if (!return_address_stack_overflow.empty()) {
+    ReturnAddressOfFunction result = return_address_stack_overflow.back();
+    return_address_stack_overflow.pop_back();
+    return result;
+  }
+  return *--return_address_stack.top;
+}
 
 }  // namespace
 
@@ -30,12 +73,11 @@ uint64_t TrivialSum(uint64_t p0, uint64_t p1, uint64_t p2, uint64_t p3, uint64_t
 }
 
 void EntryPayload(uint64_t return_address, uint64_t function_id) {
-  return_addresses.emplace(return_address, function_id);
+  PushReturnAddress(return_address, function_id);
 }
 
 uint64_t ExitPayload() {
-  ReturnAddressOfFunction current_return_address = return_addresses.top();
-  return_addresses.pop();
+  ReturnAddressOfFunction current_return_address = PopReturnAddress();
 
   using std::chrono::system_clock;
   constexpr std::chrono::duration<int, std::ratio<1, 1000000>> k500Microseconds(500);
@@ -57,9 +99,24 @@ uint64_t ExitPayload() {
   return current_return_address.return_address;
 }
 
+uint64_t GetOpenFunctionCallStackTlsOffset() {
+  uint64_t thread_pointer = 0;
+  __asm__ __volatile__("mov %%fs:0, %0" : "=r"(thread_pointer));
+  return reinterpret_cast<uint64_t>(&return_address_stack) - thread_pointer;
+}
+
+uint64_t GetEntryPayloadCallCount() { return push_count; }
+
+uint64_t GetExitPayloadCallCount() { return pop_count; }
+
+void MakeOpenFunctionCallStackFull() {
+  if (return_address_stack.top == nullptr) return;
+  return_address_stack.limit = return_address_stack.top;
+}
+
 // rdi, rsi, rdx, rcx, r8, r9, rax, r10
 void EntryPayloadClobberParameterRegisters(uint64_t return_address, uint64_t function_id) {
-  return_addresses.emplace(return_address, function_id);
+  PushReturnAddress(return_address, function_id);
   __asm__ __volatile__(
       "mov $0xffffffffffffffff, %%rdi\n\t"
       "mov $0xffffffffffffffff, %%rsi\n\t"
@@ -75,7 +132,7 @@ void EntryPayloadClobberParameterRegisters(uint64_t return_address, uint64_t fun
 }
 
 void EntryPayloadClobberXmmRegisters(uint64_t return_address, uint64_t function_id) {
-  return_addresses.emplace(return_address, function_id);
+  PushReturnAddress(return_address, function_id);
   __asm__ __volatile__(
       "movdqu 0x3a(%%rip), %%xmm0\n\t"
       "movdqu 0x32(%%rip), %%xmm1\n\t"
@@ -94,7 +151,7 @@ void EntryPayloadClobberXmmRegisters(uint64_t return_address, uint64_t function_
 }
 
 void EntryPayloadClobberYmmRegisters(uint64_t return_address, uint64_t function_id) {
-  return_addresses.emplace(return_address, function_id);
+  PushReturnAddress(return_address, function_id);
   __asm__ __volatile__(
       "vmovdqu 0x3a(%%rip), %%ymm0\n\t"
       "vmovdqu 0x32(%%rip), %%ymm1\n\t"
@@ -26,6 +26,21 @@ extern "C" void EntryPayload(uint64_t return_address, uint64_t function_id);
 // the function such that the execution can be continued there.
 extern "C" uint64_t ExitPayload();
 
+// Returns the offset of the thread local stack of open function calls from the thread pointer. The
+// stack has the layout expected by the fast path of the trampolines (see `CreateTrampoline`).
+extern "C" uint64_t GetOpenFunctionCallStackTlsOffset();
+
+// Returns how often the entry payloads and the exit payload above were called. The difference is
+// the number of calls the fast path of the trampolines pushed to the stack of open function calls
+// without calling an entry payload.
+extern "C" uint64_t GetEntryPayloadCallCount();
+extern "C" uint64_t GetExitPayloadCallCount();
+
+// Makes the stack of open function calls of the calling thread look full, such that the fast path
+// of the trampolines falls back to calling the entry payload, which then pushes to its overflow
+// storage.
+extern "C" void MakeOpenFunctionCallStackFull();
+
 // Overwrites rdi, rsi, rdx, rcx, r8, r9, rax, r10. These registers are used to hand over parameters
 // to a called function. This function is used to assert our backup of these registers works
 // properly. The two functions below do the same thing for SSE/AVX registers that can be used to
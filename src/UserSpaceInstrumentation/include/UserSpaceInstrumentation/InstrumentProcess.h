@@ -37,11 +37,17 @@ class InstrumentationManager {
   // were not instrumented before and instrument all functions by overwriting the prologue with a
   // jump into the trampoline. Returns the function_id's of the instrumented functions. Note that
   // there is no guarantee that we can instrument all the functions in a binary.
+  // Functions that are still instrumented from a previous capture (see
+  // `CaptureOptions::user_space_instrumentation_persistent`) keep their jump, and functions that
+  // are not in `capture_options` anymore are uninstrumented.
   [[nodiscard]] ErrorMessageOr<absl::flat_hash_set<uint64_t>> InstrumentProcess(
       const orbit_grpc_protos::CaptureOptions& capture_options);
 
   // Undo the instrumentation of the functions. Leaves the library and trampolines in the target
-  // process intact. We merely restore the function prologues that were overwritten.
+  // process intact. We merely restore the function prologues that were overwritten, except in
+  // modules that were unloaded in the meantime. If the last call to `InstrumentProcess` asked for
+  // persistent instrumentation, the functions stay instrumented and only stop producing events:
+  // in that case they are uninstrumented when this object is destroyed.
   [[nodiscard]] ErrorMessageOr<void> UninstrumentProcess(pid_t pid);
 
  private: